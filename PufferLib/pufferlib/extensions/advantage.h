@@ -0,0 +1,208 @@
+// CPU kernels for puff advantage, shared by the torch extension and
+// tests/bench_puff_advantage.cpp. Torch free so the benchmark can build
+// without it; threading over rows is left to the caller.
+#pragma once
+
+#include <math.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define PUFF_ADV_X86
+#endif
+
+namespace pufferlib {
+
+static inline void puff_advantage_row(float* values, float* rewards, float* dones,
+        float* importance, float* advantages, float gamma, float lambda,
+        float rho_clip, float c_clip, int horizon) {
+    float lastpufferlam = 0;
+    for (int t = horizon-2; t >= 0; t--) {
+        int t_next = t + 1;
+        float nextnonterminal = 1.0 - dones[t_next];
+        float rho_t = fminf(importance[t], rho_clip);
+        float c_t = fminf(importance[t], c_clip);
+        float delta = rho_t*(rewards[t_next] + gamma*values[t_next]*nextnonterminal - values[t]);
+        lastpufferlam = delta + gamma*lambda*c_t*lastpufferlam*nextnonterminal;
+        advantages[t] = lastpufferlam;
+    }
+}
+
+// Columns of a block transposed per pass. 5 buffers of
+// PUFF_ADV_CHUNK x 16 floats stay within L1
+#define PUFF_ADV_CHUNK 64
+
+// Runs the row recursion for L consecutive rows at once, one row per
+// SIMD lane. The rows are transposed PUFF_ADV_CHUNK columns at a time
+// into [column][lane] buffers so each step of the backward recursion
+// is a contiguous L wide vector op. Same arithmetic as puff_advantage_row
+template <int L>
+inline __attribute__((always_inline)) void _puff_advantage_block(
+        float* values, float* rewards, float* dones, float* importance,
+        float* advantages, float gamma, float lambda, float rho_clip,
+        float c_clip, int horizon) {
+    float v[PUFF_ADV_CHUNK][L];
+    float r[PUFF_ADV_CHUNK][L];
+    float d[PUFF_ADV_CHUNK][L];
+    float imp[PUFF_ADV_CHUNK][L];
+    float adv[PUFF_ADV_CHUNK][L];
+
+    // Values at t_next, carried across chunk boundaries
+    float next_value[L];
+    float next_reward[L];
+    float next_done[L];
+    float lastpufferlam[L];
+    for (int l = 0; l < L; l++) {
+        int last = l*horizon + horizon - 1;
+        next_value[l] = values[last];
+        next_reward[l] = rewards[last];
+        next_done[l] = dones[last];
+        lastpufferlam[l] = 0;
+    }
+
+    for (int end = horizon - 1; end > 0; end -= PUFF_ADV_CHUNK) {
+        int start = (end > PUFF_ADV_CHUNK) ? end - PUFF_ADV_CHUNK : 0;
+        int n = end - start;
+        for (int c = 0; c < n; c++) {
+            for (int l = 0; l < L; l++) {
+                int offset = l*horizon + start + c;
+                v[c][l] = values[offset];
+                r[c][l] = rewards[offset];
+                d[c][l] = dones[offset];
+                imp[c][l] = importance[offset];
+            }
+        }
+        for (int c = n - 1; c >= 0; c--) {
+            for (int l = 0; l < L; l++) {
+                float nextnonterminal = 1.0f - next_done[l];
+                float rho_t = (imp[c][l] < rho_clip) ? imp[c][l] : rho_clip;
+                float c_t = (imp[c][l] < c_clip) ? imp[c][l] : c_clip;
+                float delta = rho_t*(next_reward[l] + gamma*next_value[l]*nextnonterminal - v[c][l]);
+                lastpufferlam[l] = delta + gamma*lambda*c_t*lastpufferlam[l]*nextnonterminal;
+                adv[c][l] = lastpufferlam[l];
+                next_value[l] = v[c][l];
+                next_reward[l] = r[c][l];
+                next_done[l] = d[c][l];
+            }
+        }
+        for (int l = 0; l < L; l++) {
+            int offset = l*horizon + start;
+            for (int c = 0; c < n; c++) {
+                advantages[offset + c] = adv[c][l];
+            }
+        }
+    }
+}
+
+typedef void (*PuffAdvantageBlock)(float*, float*, float*, float*, float*,
+    float, float, float, float, int);
+
+static inline void _puff_advantage_block_default(float* values, float* rewards,
+        float* dones, float* importance, float* advantages, float gamma,
+        float lambda, float rho_clip, float c_clip, int horizon) {
+    _puff_advantage_block<8>(values, rewards, dones, importance,
+        advantages, gamma, lambda, rho_clip, c_clip, horizon);
+}
+
+#ifdef PUFF_ADV_X86
+__attribute__((target("avx2")))
+static inline void _puff_advantage_block_avx2(float* values, float* rewards,
+        float* dones, float* importance, float* advantages, float gamma,
+        float lambda, float rho_clip, float c_clip, int horizon) {
+    _puff_advantage_block<8>(values, rewards, dones, importance,
+        advantages, gamma, lambda, rho_clip, c_clip, horizon);
+}
+
+__attribute__((target("avx512f")))
+static inline void _puff_advantage_block_avx512(float* values, float* rewards,
+        float* dones, float* importance, float* advantages, float gamma,
+        float lambda, float rho_clip, float c_clip, int horizon) {
+    _puff_advantage_block<16>(values, rewards, dones, importance,
+        advantages, gamma, lambda, rho_clip, c_clip, horizon);
+}
+#endif
+
+struct PuffAdvantageKernel {
+    PuffAdvantageBlock block;
+    int lanes;
+};
+
+// Widest block kernel the CPU supports, picked once
+static inline PuffAdvantageKernel puff_advantage_kernel() {
+#ifdef PUFF_ADV_X86
+    static PuffAdvantageKernel kernel = []() -> PuffAdvantageKernel {
+        if (__builtin_cpu_supports("avx512f")) {
+            return {_puff_advantage_block_avx512, 16};
+        }
+        if (__builtin_cpu_supports("avx2")) {
+            return {_puff_advantage_block_avx2, 8};
+        }
+        return {_puff_advantage_block_default, 8};
+    }();
+    return kernel;
+#else
+    return {_puff_advantage_block_default, 8};
+#endif
+}
+
+// Rows [row_start, row_end) of a [num_steps, horizon] buffer. Full blocks
+// of kernel.lanes rows go through the block kernel, the rest row by row
+static inline void puff_advantage_rows(float* values, float* rewards, float* dones,
+        float* importance, float* advantages, float gamma, float lambda,
+        float rho_clip, float c_clip, int row_start, int row_end,
+        const int horizon) {
+    PuffAdvantageKernel kernel = puff_advantage_kernel();
+    int row = row_start;
+    for (; row + kernel.lanes <= row_end; row += kernel.lanes) {
+        long offset = (long)row*horizon;
+        kernel.block(values + offset, rewards + offset, dones + offset,
+            importance + offset, advantages + offset,
+            gamma, lambda, rho_clip, c_clip, horizon);
+    }
+    for (; row < row_end; row++) {
+        long offset = (long)row*horizon;
+        puff_advantage_row(values + offset, rewards + offset,
+            dones + offset, importance + offset, advantages + offset,
+            gamma, lambda, rho_clip, c_clip, horizon);
+    }
+}
+
+// Returns and priority scores for rows the advantage kernel just wrote,
+// while they are still in cache. The last column has no successor, so its
+// advantage is 0 and its return is the value. Priority is the row's
+// |advantage| sum raised to prio_alpha, with nan/inf mapped to 0
+static inline void puff_advantage_epilogue(float* values, float* advantages,
+        float* returns, float* priorities, float prio_alpha, int rows,
+        const int horizon) {
+    for (int row = 0; row < rows; row++) {
+        long offset = (long)row*horizon;
+        float* adv = advantages + offset;
+        float* val = values + offset;
+        float* ret = returns + offset;
+        adv[horizon - 1] = 0;
+        float abs_sum = 0;
+        for (int t = 0; t < horizon; t++) {
+            ret[t] = adv[t] + val[t];
+            abs_sum += fabsf(adv[t]);
+        }
+        float prio = powf(abs_sum, prio_alpha);
+        priorities[row] = isfinite(prio) ? prio : 0.0f;
+    }
+}
+
+// Fused advantages, returns and priorities for rows [row_start, row_end)
+static inline void puff_advantage_fused_rows(float* values, float* rewards, float* dones,
+        float* importance, float* advantages, float* returns,
+        float* priorities, float gamma, float lambda, float rho_clip,
+        float c_clip, float prio_alpha, int row_start, int row_end,
+        const int horizon) {
+    int lanes = puff_advantage_kernel().lanes;
+    for (int row = row_start; row < row_end; row += lanes) {
+        int rows = (row_end - row < lanes) ? row_end - row : lanes;
+        puff_advantage_rows(values, rewards, dones, importance, advantages,
+            gamma, lambda, rho_clip, c_clip, row, row + rows, horizon);
+        long offset = (long)row*horizon;
+        puff_advantage_epilogue(values + offset, advantages + offset,
+            returns + offset, priorities + row, prio_alpha, rows, horizon);
+    }
+}
+
+}
@@ -81,8 +81,145 @@ void compute_puff_advantage_cuda(torch::Tensor values, torch::Tensor rewards,
     }
 }
 
+// One thread per row: advantages, then returns and the row's priority
+// score while the row is still in L1/L2
+__global__ void puff_advantage_fused_kernel(float* values, float* rewards,
+        float* dones, float* importance, float* advantages, float* returns,
+        float* priorities, float gamma, float lambda, float rho_clip,
+        float c_clip, float prio_alpha, int num_steps, int horizon) {
+    int row = blockIdx.x*blockDim.x + threadIdx.x;
+    if (row >= num_steps) {
+        return;
+    }
+    int offset = row*horizon;
+    float* adv = advantages + offset;
+    puff_advantage_row_cuda(values + offset, rewards + offset, dones + offset,
+        importance + offset, adv, gamma, lambda, rho_clip, c_clip, horizon);
+    adv[horizon - 1] = 0;
+    float abs_sum = 0;
+    for (int t = 0; t < horizon; t++) {
+        returns[offset + t] = adv[t] + values[offset + t];
+        abs_sum += fabsf(adv[t]);
+    }
+    float prio = powf(abs_sum, prio_alpha);
+    priorities[row] = isfinite(prio) ? prio : 0.0f;
+}
+
+void compute_puff_advantage_fused_cuda(torch::Tensor values, torch::Tensor rewards,
+        torch::Tensor dones, torch::Tensor importance, torch::Tensor advantages,
+        torch::Tensor returns, torch::Tensor priorities, double gamma,
+        double lambda, double rho_clip, double c_clip, double prio_alpha) {
+    int num_steps = values.size(0);
+    int horizon = values.size(1);
+    vtrace_check_cuda(values, rewards, dones, importance, advantages, num_steps, horizon);
+    vtrace_check_cuda(values, rewards, dones, importance, returns, num_steps, horizon);
+    TORCH_CHECK(values.is_cuda(), "All tensors must be on GPU");
+    TORCH_CHECK(priorities.dim() == 1, "Priorities must be 1D");
+    TORCH_CHECK(priorities.size(0) == num_steps, "Priorities must match num_steps");
+    TORCH_CHECK(priorities.dtype() == torch::kFloat32, "Priorities must be float32");
+    TORCH_CHECK(priorities.device() == values.device(), "All tensors must be on same device");
+
+    int threads_per_block = 256;
+    int blocks = (num_steps + threads_per_block - 1) / threads_per_block;
+
+    puff_advantage_fused_kernel<<<blocks, threads_per_block>>>(
+        values.data_ptr<float>(),
+        rewards.data_ptr<float>(),
+        dones.data_ptr<float>(),
+        importance.data_ptr<float>(),
+        advantages.data_ptr<float>(),
+        returns.data_ptr<float>(),
+        priorities.data_ptr<float>(),
+        gamma,
+        lambda,
+        rho_clip,
+        c_clip,
+        prio_alpha,
+        num_steps,
+        horizon
+    );
+
+    cudaError_t err = cudaGetLastError();
+    if (err != cudaSuccess) {
+        throw std::runtime_error(cudaGetErrorString(err));
+    }
+}
+
+struct BitfieldLayout {
+    int num_fields;
+    unsigned char offset[16];
+    unsigned char shift[16];
+    unsigned char mask[16];
+};
+
+// One thread per (row, group)
+__global__ void unpack_bitfields_kernel(const uint8_t* packed, uint8_t* out,
+        int64_t rows, int64_t cols, int group_bytes, int64_t num_groups,
+        BitfieldLayout layout) {
+    int64_t idx = (int64_t)blockIdx.x*blockDim.x + threadIdx.x;
+    if (idx >= rows*num_groups) {
+        return;
+    }
+    int64_t row = idx / num_groups;
+    int64_t g = idx % num_groups;
+    const uint8_t* group = packed + row*cols + g*group_bytes;
+    uint8_t* o = out + idx*layout.num_fields;
+    for (int f = 0; f < layout.num_fields; f++) {
+        o[f] = (group[layout.offset[f]] >> layout.shift[f]) & layout.mask[f];
+    }
+}
+
+torch::Tensor unpack_bitfields_cuda(torch::Tensor packed, int64_t group_bytes,
+        int64_t num_groups, at::IntArrayRef offsets, at::IntArrayRef shifts,
+        at::IntArrayRef bits) {
+    TORCH_CHECK(packed.is_cuda(), "Packed tensor must be on GPU");
+    TORCH_CHECK(packed.dim() == 2, "Packed tensor must be 2D");
+    TORCH_CHECK(packed.dtype() == torch::kUInt8, "Packed tensor must be uint8");
+    TORCH_CHECK(packed.size(1) >= group_bytes*num_groups, "Packed rows are shorter than num_groups*group_bytes");
+    TORCH_CHECK(offsets.size() == shifts.size() && offsets.size() == bits.size(), "offsets, shifts and bits must be the same length");
+    TORCH_CHECK(offsets.size() <= 16, "At most 16 fields per group");
+
+    BitfieldLayout layout;
+    layout.num_fields = offsets.size();
+    for (int f = 0; f < layout.num_fields; f++) {
+        TORCH_CHECK(offsets[f] >= 0 && offsets[f] < group_bytes, "Field offset outside of group");
+        TORCH_CHECK(bits[f] > 0 && shifts[f] >= 0 && shifts[f] + bits[f] <= 8, "Fields must lie within one byte");
+        layout.offset[f] = offsets[f];
+        layout.shift[f] = shifts[f];
+        layout.mask[f] = (1 << bits[f]) - 1;
+    }
+
+    packed = packed.contiguous();
+    int64_t rows = packed.size(0);
+    torch::Tensor out = torch::empty({rows, num_groups*layout.num_fields}, packed.options());
+    int64_t total = rows*num_groups;
+    if (total == 0) {
+        return out;
+    }
+    int threads_per_block = 256;
+    int64_t blocks = (total + threads_per_block - 1) / threads_per_block;
+
+    unpack_bitfields_kernel<<<blocks, threads_per_block>>>(
+        packed.data_ptr<uint8_t>(),
+        out.data_ptr<uint8_t>(),
+        rows,
+        packed.size(1),
+        group_bytes,
+        num_groups,
+        layout
+    );
+
+    cudaError_t err = cudaGetLastError();
+    if (err != cudaSuccess) {
+        throw std::runtime_error(cudaGetErrorString(err));
+    }
+    return out;
+}
+
 TORCH_LIBRARY_IMPL(pufferlib, CUDA, m) {
   m.impl("compute_puff_advantage", &compute_puff_advantage_cuda);
+  m.impl("compute_puff_advantage_fused", &compute_puff_advantage_fused_cuda);
+  m.impl("unpack_bitfields", &unpack_bitfields_cuda);
 }
 
 }
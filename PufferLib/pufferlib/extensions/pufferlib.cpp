@@ -2,8 +2,12 @@
 #include <ATen/Operators.h>
 #include <torch/all.h>
 #include <torch/library.h>
+#include <ATen/Parallel.h>
+#include <algorithm>
 #include <vector>
 
+#include "advantage.h"
+
 extern "C" {
   /* Creates a dummy empty _C module that can be imported from Python.
      The import from Python will load the .so consisting of this file
@@ -25,21 +29,6 @@ extern "C" {
 
 namespace pufferlib {
 
-void puff_advantage_row(float* values, float* rewards, float* dones,
-        float* importance, float* advantages, float gamma, float lambda,
-        float rho_clip, float c_clip, int horizon) {
-    float lastpufferlam = 0;
-    for (int t = horizon-2; t >= 0; t--) {
-        int t_next = t + 1;
-        float nextnonterminal = 1.0 - dones[t_next];
-        float rho_t = fminf(importance[t], rho_clip);
-        float c_t = fminf(importance[t], c_clip);
-        float delta = rho_t*(rewards[t_next] + gamma*values[t_next]*nextnonterminal - values[t]);
-        lastpufferlam = delta + gamma*lambda*c_t*lastpufferlam*nextnonterminal;
-        advantages[t] = lastpufferlam;
-    }
-}
-
 void vtrace_check(torch::Tensor values, torch::Tensor rewards,
         torch::Tensor dones, torch::Tensor importance, torch::Tensor advantages,
         int num_steps, int horizon) {
@@ -59,16 +48,20 @@ void vtrace_check(torch::Tensor values, torch::Tensor rewards,
 }
 
 
-// [num_steps, horizon]
+// [num_steps, horizon]. Rows are independent, so blocks of rows are split
+// across the intra-op thread pool and vectorized within each block
 void puff_advantage(float* values, float* rewards, float* dones, float* importance,
         float* advantages, float gamma, float lambda, float rho_clip, float c_clip,
         int num_steps, const int horizon){
-    for (int offset = 0; offset < num_steps*horizon; offset+=horizon) {
-        puff_advantage_row(values + offset, rewards + offset,
-            dones + offset, importance + offset, advantages + offset,
-            gamma, lambda, rho_clip, c_clip, horizon
-        );
-    }
+    int lanes = puff_advantage_kernel().lanes;
+    int num_blocks = (num_steps + lanes - 1)/lanes;
+    int64_t grain = std::max<int64_t>(1, 32768/((int64_t)lanes*horizon));
+    at::parallel_for(0, num_blocks, grain, [&](int64_t begin, int64_t end) {
+        int row_start = begin*lanes;
+        int row_end = std::min<int64_t>(end*lanes, num_steps);
+        puff_advantage_rows(values, rewards, dones, importance, advantages,
+            gamma, lambda, rho_clip, c_clip, row_start, row_end, horizon);
+    });
 }
 
 
@@ -84,12 +77,106 @@ void compute_puff_advantage_cpu(torch::Tensor values, torch::Tensor rewards,
     );
 }
 
+// Advantages, returns (advantages + values) and per row priority scores
+// (sum |advantages|)^prio_alpha in one pass over the experience buffer
+void compute_puff_advantage_fused_cpu(torch::Tensor values, torch::Tensor rewards,
+        torch::Tensor dones, torch::Tensor importance, torch::Tensor advantages,
+        torch::Tensor returns, torch::Tensor priorities, double gamma,
+        double lambda, double rho_clip, double c_clip, double prio_alpha) {
+    int num_steps = values.size(0);
+    int horizon = values.size(1);
+    vtrace_check(values, rewards, dones, importance, advantages, num_steps, horizon);
+    vtrace_check(values, rewards, dones, importance, returns, num_steps, horizon);
+    TORCH_CHECK(priorities.dim() == 1, "Priorities must be 1D");
+    TORCH_CHECK(priorities.size(0) == num_steps, "Priorities must match num_steps");
+    TORCH_CHECK(priorities.dtype() == torch::kFloat32, "Priorities must be float32");
+    TORCH_CHECK(priorities.device() == values.device(), "All tensors must be on same device");
+
+    float* values_ptr = values.data_ptr<float>();
+    float* rewards_ptr = rewards.data_ptr<float>();
+    float* dones_ptr = dones.data_ptr<float>();
+    float* importance_ptr = importance.data_ptr<float>();
+    float* advantages_ptr = advantages.data_ptr<float>();
+    float* returns_ptr = returns.data_ptr<float>();
+    float* priorities_ptr = priorities.data_ptr<float>();
+    int lanes = puff_advantage_kernel().lanes;
+    int num_blocks = (num_steps + lanes - 1)/lanes;
+    int64_t grain = std::max<int64_t>(1, 32768/((int64_t)lanes*horizon));
+    at::parallel_for(0, num_blocks, grain, [&](int64_t begin, int64_t end) {
+        int row_start = begin*lanes;
+        int row_end = std::min<int64_t>(end*lanes, num_steps);
+        puff_advantage_fused_rows(values_ptr, rewards_ptr, dones_ptr,
+            importance_ptr, advantages_ptr, returns_ptr, priorities_ptr,
+            gamma, lambda, rho_clip, c_clip, prio_alpha, row_start, row_end, horizon);
+    });
+}
+
+void unpack_bitfields_check(torch::Tensor packed, int64_t group_bytes,
+        int64_t num_groups, at::IntArrayRef offsets, at::IntArrayRef shifts,
+        at::IntArrayRef bits) {
+    TORCH_CHECK(packed.dim() == 2, "Packed tensor must be 2D");
+    TORCH_CHECK(packed.dtype() == torch::kUInt8, "Packed tensor must be uint8");
+    TORCH_CHECK(packed.size(1) >= group_bytes*num_groups, "Packed rows are shorter than num_groups*group_bytes");
+    TORCH_CHECK(offsets.size() == shifts.size() && offsets.size() == bits.size(), "offsets, shifts and bits must be the same length");
+    TORCH_CHECK(offsets.size() <= 16, "At most 16 fields per group");
+    for (size_t f = 0; f < offsets.size(); f++) {
+        TORCH_CHECK(offsets[f] >= 0 && offsets[f] < group_bytes, "Field offset outside of group");
+        TORCH_CHECK(bits[f] > 0 && shifts[f] >= 0 && shifts[f] + bits[f] <= 8, "Fields must lie within one byte");
+    }
+}
+
+// Inverse of the packed observation modes in Ocean envs. Each row of packed
+// holds num_groups groups of group_bytes bytes, and field f of a group is
+// bits[f] bits at shifts[f] in byte offsets[f]. Returns [rows, num_groups*fields]
+// uint8, the layout the env writes when packing is off. Bytes after the
+// last group are left for the caller
+torch::Tensor unpack_bitfields_cpu(torch::Tensor packed, int64_t group_bytes,
+        int64_t num_groups, at::IntArrayRef offsets, at::IntArrayRef shifts,
+        at::IntArrayRef bits) {
+    unpack_bitfields_check(packed, group_bytes, num_groups, offsets, shifts, bits);
+    packed = packed.contiguous();
+    int64_t rows = packed.size(0);
+    int64_t cols = packed.size(1);
+    int fields = offsets.size();
+    torch::Tensor out = torch::empty({rows, num_groups*fields}, packed.options());
+
+    int offset[16];
+    int shift[16];
+    int mask[16];
+    for (int f = 0; f < fields; f++) {
+        offset[f] = offsets[f];
+        shift[f] = shifts[f];
+        mask[f] = (1 << bits[f]) - 1;
+    }
+    const uint8_t* src = packed.data_ptr<uint8_t>();
+    uint8_t* dst = out.data_ptr<uint8_t>();
+    int64_t grain = std::max<int64_t>(1, 32768/std::max<int64_t>(1, num_groups*fields));
+    at::parallel_for(0, rows, grain, [&](int64_t begin, int64_t end) {
+        for (int64_t row = begin; row < end; row++) {
+            const uint8_t* group = src + row*cols;
+            uint8_t* o = dst + row*num_groups*fields;
+            for (int64_t g = 0; g < num_groups; g++) {
+                for (int f = 0; f < fields; f++) {
+                    o[f] = (group[offset[f]] >> shift[f]) & mask[f];
+                }
+                group += group_bytes;
+                o += fields;
+            }
+        }
+    });
+    return out;
+}
+
 TORCH_LIBRARY(pufferlib, m) {
    m.def("compute_puff_advantage(Tensor(a!) values, Tensor(b!) rewards, Tensor(c!) dones, Tensor(d!) importance, Tensor(e!) advantages, float gamma, float lambda, float rho_clip, float c_clip) -> ()");
+   m.def("compute_puff_advantage_fused(Tensor values, Tensor rewards, Tensor dones, Tensor importance, Tensor(a!) advantages, Tensor(b!) returns, Tensor(c!) priorities, float gamma, float lambda, float rho_clip, float c_clip, float prio_alpha) -> ()");
+   m.def("unpack_bitfields(Tensor packed, int group_bytes, int num_groups, int[] offsets, int[] shifts, int[] bits) -> Tensor");
  }
 
 TORCH_LIBRARY_IMPL(pufferlib, CPU, m) {
   m.impl("compute_puff_advantage", &compute_puff_advantage_cpu);
+  m.impl("compute_puff_advantage_fused", &compute_puff_advantage_fused_cpu);
+  m.impl("unpack_bitfields", &unpack_bitfields_cpu);
 }
 
 }
@@ -1,5 +1,7 @@
 #include <stdio.h>
+#include <stdlib.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <string.h>
 #include <math.h>
 #include <assert.h>
@@ -85,159 +87,443 @@ inline float _sigmoid(float x) {
     return 1.0f / (1.0f + expf(-x));
 }
 
-void _linear(float* input, float* weights, float* bias, float* output,
-        int batch_size, int input_dim, int output_dim) {
-    for (int b = 0; b < batch_size; b++) {
-        for (int o = 0; o < output_dim; o++) {
-            float sum = 0.0f;
-            for (int i = 0; i < input_dim; i++)
-                sum += input[b*input_dim + i] * weights[o*input_dim + i];
-            output[b*output_dim + o] = sum + bias[o];
+// GEMM backend shared by _linear, _linear_accumulate, _conv2d and _conv3d.
+// Computes C = A*B^T + bias with A [M x K] and B [N x K], both row major.
+// That is the native layout of PyTorch linear and conv weights, so weights
+// are never repacked. C is written through row/column strides rs and cs.
+// The fastest kernel the CPU supports is picked on first use. Override it
+// with set_gemm_kernel or the PUFFERNET_KERNEL env var (scalar|avx2|avx512)
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    #define PUFFERNET_X86 1
+    #include <immintrin.h>
+#else
+    #define PUFFERNET_X86 0
+#endif
+
+// Rows of B kept hot in L2 while every row of A streams past them
+#define GEMM_L2_FLOATS 32768
+
+typedef void (*GemmKernel)(const float* A, const float* B, const float* bias,
+    float* C, int M, int N, int K, int rs, int cs, int accumulate);
+
+int _gemm_block_n(int K, int nr) {
+    int nb = GEMM_L2_FLOATS/K/nr*nr;
+    return nb < nr ? nr : nb;
+}
+
+static inline void _gemm_store(float* C, float sum, float bias, int accumulate) {
+    *C = accumulate ? *C + sum + bias : sum + bias;
+}
+
+// Portable fallback. 4x4 register tile, inlined with constant mr, nr for
+// full tiles so the accumulators stay in registers
+__attribute__((always_inline))
+static inline void _gemm_tile_scalar(const float* A, const float* B, const float* bias,
+        float* C, int K, int rs, int cs, int accumulate, int mr, int nr) {
+    float acc[4][4] = {{0}};
+    for (int k = 0; k < K; k++) {
+        for (int i = 0; i < mr; i++) {
+            float a = A[i*K + k];
+            for (int j = 0; j < nr; j++) {
+                acc[i][j] += a*B[j*K + k];
+            }
+        }
+    }
+    for (int i = 0; i < mr; i++) {
+        for (int j = 0; j < nr; j++) {
+            _gemm_store(&C[i*rs + j*cs], acc[i][j], bias[j], accumulate);
+        }
+    }
+}
+
+void _gemm_scalar(const float* A, const float* B, const float* bias,
+        float* C, int M, int N, int K, int rs, int cs, int accumulate) {
+    int nb = _gemm_block_n(K, 4);
+    for (int n0 = 0; n0 < N; n0 += nb) {
+        int n1 = (n0 + nb < N) ? n0 + nb : N;
+        for (int m = 0; m < M; m += 4) {
+            int mr = (M - m < 4) ? M - m : 4;
+            for (int n = n0; n < n1; n += 4) {
+                int nr = (n1 - n < 4) ? n1 - n : 4;
+                const float* a = A + m*K;
+                const float* b = B + n*K;
+                float* c = C + m*rs + n*cs;
+                if (mr == 4 && nr == 4) {
+                    _gemm_tile_scalar(a, b, bias + n, c, K, rs, cs, accumulate, 4, 4);
+                } else {
+                    _gemm_tile_scalar(a, b, bias + n, c, K, rs, cs, accumulate, mr, nr);
+                }
+            }
         }
     }
 }
 
+#if PUFFERNET_X86
+static const int _gemm_mask_table[16] = {
+    -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0,
+};
+
+__attribute__((target("avx2,fma")))
+static inline float _hsum_avx2(__m256 v) {
+    __m128 lo = _mm_add_ps(_mm256_castps256_ps128(v), _mm256_extractf128_ps(v, 1));
+    lo = _mm_add_ps(lo, _mm_movehl_ps(lo, lo));
+    lo = _mm_add_ss(lo, _mm_movehdup_ps(lo));
+    return _mm_cvtss_f32(lo);
+}
+
+// 4x2 tile, 8 floats of K per step. Inlined with constant mr, nr for full
+// tiles so acc stays in registers. Edge tiles take the same path
+__attribute__((target("avx2,fma"), always_inline))
+static inline void _gemm_tile_avx2(const float* A, const float* B, const float* bias,
+        float* C, int K, int rs, int cs, int accumulate, int mr, int nr, __m256i tail) {
+    __m256 acc[4][2];
+    for (int i = 0; i < 4; i++) {
+        acc[i][0] = _mm256_setzero_ps();
+        acc[i][1] = _mm256_setzero_ps();
+    }
+    int k = 0;
+    for (; k + 8 <= K; k += 8) {
+        __m256 b0 = _mm256_loadu_ps(B + k);
+        __m256 b1 = (nr > 1) ? _mm256_loadu_ps(B + K + k) : b0;
+        for (int i = 0; i < mr; i++) {
+            __m256 a = _mm256_loadu_ps(A + i*K + k);
+            acc[i][0] = _mm256_fmadd_ps(a, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(a, b1, acc[i][1]);
+        }
+    }
+    if (k < K) {
+        __m256 b0 = _mm256_maskload_ps(B + k, tail);
+        __m256 b1 = (nr > 1) ? _mm256_maskload_ps(B + K + k, tail) : b0;
+        for (int i = 0; i < mr; i++) {
+            __m256 a = _mm256_maskload_ps(A + i*K + k, tail);
+            acc[i][0] = _mm256_fmadd_ps(a, b0, acc[i][0]);
+            acc[i][1] = _mm256_fmadd_ps(a, b1, acc[i][1]);
+        }
+    }
+    for (int i = 0; i < mr; i++) {
+        for (int j = 0; j < nr; j++) {
+            _gemm_store(&C[i*rs + j*cs], _hsum_avx2(acc[i][j]), bias[j], accumulate);
+        }
+    }
+}
+
+__attribute__((target("avx2,fma")))
+void _gemm_avx2(const float* A, const float* B, const float* bias,
+        float* C, int M, int N, int K, int rs, int cs, int accumulate) {
+    __m256i tail = _mm256_loadu_si256((const __m256i*)(_gemm_mask_table + 8 - K%8));
+    int nb = _gemm_block_n(K, 2);
+    for (int n0 = 0; n0 < N; n0 += nb) {
+        int n1 = (n0 + nb < N) ? n0 + nb : N;
+        for (int m = 0; m < M; m += 4) {
+            int mr = (M - m < 4) ? M - m : 4;
+            for (int n = n0; n < n1; n += 2) {
+                int nr = (n1 - n < 2) ? n1 - n : 2;
+                const float* a = A + m*K;
+                const float* b = B + n*K;
+                float* c = C + m*rs + n*cs;
+                if (mr == 4 && nr == 2) {
+                    _gemm_tile_avx2(a, b, bias + n, c, K, rs, cs, accumulate, 4, 2, tail);
+                } else {
+                    _gemm_tile_avx2(a, b, bias + n, c, K, rs, cs, accumulate, mr, nr, tail);
+                }
+            }
+        }
+    }
+}
+
+// 4x4 tile, 16 floats of K per step. Tail handled with a load mask
+__attribute__((target("avx512f"), always_inline))
+static inline void _gemm_tile_avx512(const float* A, const float* B, const float* bias,
+        float* C, int K, int rs, int cs, int accumulate, int mr, int nr, __mmask16 tail) {
+    __m512 acc[4][4];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            acc[i][j] = _mm512_setzero_ps();
+        }
+    }
+    int k = 0;
+    for (; k + 16 <= K; k += 16) {
+        __m512 b[4];
+        for (int j = 0; j < 4; j++) {
+            b[j] = (j < nr) ? _mm512_loadu_ps(B + j*K + k) : _mm512_setzero_ps();
+        }
+        for (int i = 0; i < mr; i++) {
+            __m512 a = _mm512_loadu_ps(A + i*K + k);
+            for (int j = 0; j < 4; j++) {
+                acc[i][j] = _mm512_fmadd_ps(a, b[j], acc[i][j]);
+            }
+        }
+    }
+    if (k < K) {
+        __m512 b[4];
+        for (int j = 0; j < 4; j++) {
+            b[j] = (j < nr) ? _mm512_maskz_loadu_ps(tail, B + j*K + k) : _mm512_setzero_ps();
+        }
+        for (int i = 0; i < mr; i++) {
+            __m512 a = _mm512_maskz_loadu_ps(tail, A + i*K + k);
+            for (int j = 0; j < 4; j++) {
+                acc[i][j] = _mm512_fmadd_ps(a, b[j], acc[i][j]);
+            }
+        }
+    }
+    for (int i = 0; i < mr; i++) {
+        for (int j = 0; j < nr; j++) {
+            _gemm_store(&C[i*rs + j*cs], _mm512_reduce_add_ps(acc[i][j]), bias[j], accumulate);
+        }
+    }
+}
+
+__attribute__((target("avx512f")))
+void _gemm_avx512(const float* A, const float* B, const float* bias,
+        float* C, int M, int N, int K, int rs, int cs, int accumulate) {
+    __mmask16 tail = (__mmask16)((1u << (K%16)) - 1);
+    int nb = _gemm_block_n(K, 4);
+    for (int n0 = 0; n0 < N; n0 += nb) {
+        int n1 = (n0 + nb < N) ? n0 + nb : N;
+        for (int m = 0; m < M; m += 4) {
+            int mr = (M - m < 4) ? M - m : 4;
+            for (int n = n0; n < n1; n += 4) {
+                int nr = (n1 - n < 4) ? n1 - n : 4;
+                const float* a = A + m*K;
+                const float* b = B + n*K;
+                float* c = C + m*rs + n*cs;
+                if (mr == 4 && nr == 4) {
+                    _gemm_tile_avx512(a, b, bias + n, c, K, rs, cs, accumulate, 4, 4, tail);
+                } else {
+                    _gemm_tile_avx512(a, b, bias + n, c, K, rs, cs, accumulate, mr, nr, tail);
+                }
+            }
+        }
+    }
+}
+#endif
+
+// Benign race if several threads hit the first call at once:
+// they all select and store the same kernel
+GemmKernel _gemm_kernel = NULL;
+const char* _gemm_kernel_name = NULL;
+
+// Returns 0 if the named kernel is unknown or unsupported on this CPU
+int set_gemm_kernel(const char* name) {
+    if (strcmp(name, "scalar") == 0) {
+        _gemm_kernel = _gemm_scalar;
+        _gemm_kernel_name = "scalar";
+        return 1;
+    }
+#if PUFFERNET_X86
+    __builtin_cpu_init();
+    if (strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2")
+            && __builtin_cpu_supports("fma")) {
+        _gemm_kernel = _gemm_avx2;
+        _gemm_kernel_name = "avx2";
+        return 1;
+    }
+    if (strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f")) {
+        _gemm_kernel = _gemm_avx512;
+        _gemm_kernel_name = "avx512";
+        return 1;
+    }
+#endif
+    return 0;
+}
+
+const char* gemm_kernel_name(void) {
+    if (_gemm_kernel_name == NULL) {
+        const char* name = getenv("PUFFERNET_KERNEL");
+        if (name == NULL || !set_gemm_kernel(name)) {
+            if (!set_gemm_kernel("avx512") && !set_gemm_kernel("avx2")) {
+                set_gemm_kernel("scalar");
+            }
+        }
+    }
+    return _gemm_kernel_name;
+}
+
+void _gemm(const float* A, const float* B, const float* bias, float* C,
+        int M, int N, int K, int rs, int cs, int accumulate) {
+    if (_gemm_kernel == NULL) {
+        gemm_kernel_name();
+    }
+    _gemm_kernel(A, B, bias, C, M, N, K, rs, cs, accumulate);
+}
+
+void _linear(float* input, float* weights, float* bias, float* output,
+        int batch_size, int input_dim, int output_dim) {
+    _gemm(input, weights, bias, output, batch_size, output_dim, input_dim, output_dim, 1, 0);
+}
+
 void _linear_accumulate(float* input, float* weights, float* bias, float* output,
         int batch_size, int input_dim, int output_dim) {
-    for (int b = 0; b < batch_size; b++) {
-        for (int o = 0; o < output_dim; o++) {
-            float sum = 0.0f;
-            for (int i = 0; i < input_dim; i++)
-                sum += input[b*input_dim + i] * weights[o*input_dim + i];
-            output[b*output_dim + o] += sum + bias[o];
+    _gemm(input, weights, bias, output, batch_size, output_dim, input_dim, output_dim, 1, 1);
+}
+
+// Convolutions are lowered to GEMM via im2col. Each output position gets a
+// row of its receptive field, in the same (ic, kd, kh, kw) order as the
+// weights. Batches are processed in chunks to bound the scratch size,
+// and the [position x out_channel] result is scattered back to NC(D)HW
+#define CONV_CHUNK_ROWS 256
+
+void _im2col2d(float* input, float* col, int in_width, int in_height,
+        int in_channels, int kernel_size, int stride, int h_out, int w_out) {
+    int K = in_channels*kernel_size*kernel_size;
+    for (int h = 0; h < h_out; h++) {
+        for (int w = 0; w < w_out; w++) {
+            float* row = col + (h*w_out + w)*K;
+            for (int ic = 0; ic < in_channels; ic++) {
+                for (int kh = 0; kh < kernel_size; kh++) {
+                    int in_adr = (
+                        ic*in_height*in_width
+                        + (h*stride + kh)*in_width
+                        + w*stride
+                    );
+                    memcpy(row, input + in_adr, kernel_size*sizeof(float));
+                    row += kernel_size;
+                }
+            }
         }
     }
 }
 
-void _conv2d(float* input, float* weights, float* bias,
-        float* output, int batch_size, int in_width, int in_height,
-        int in_channels, int out_channels, int kernel_size, int stride) {
-    int h_out = (in_height - kernel_size)/stride + 1;
-    int w_out = (in_width - kernel_size)/stride + 1;
-    for (int b = 0; b < batch_size; b++) {
-        for (int oc = 0; oc < out_channels; oc++) {
-            for (int h = 0; h < h_out; h++) {
-                for (int w = 0; w < w_out; w++) {
-                    int out_adr = (
-                        b*out_channels*h_out*w_out
-                        + oc*h_out*w_out+ 
-                        + h*w_out
-                        + w
-                    );
-                    output[out_adr] = bias[oc];
-                    for (int ic = 0; ic < in_channels; ic++) {
+void _im2col3d(float* input, float* col, int in_width, int in_height, int in_depth,
+        int in_channels, int kernel_size, int stride, int d_out, int h_out, int w_out) {
+    int K = in_channels*kernel_size*kernel_size*kernel_size;
+    for (int d = 0; d < d_out; d++) {
+        for (int h = 0; h < h_out; h++) {
+            for (int w = 0; w < w_out; w++) {
+                float* row = col + ((d*h_out + h)*w_out + w)*K;
+                for (int ic = 0; ic < in_channels; ic++) {
+                    for (int kd = 0; kd < kernel_size; kd++) {
                         for (int kh = 0; kh < kernel_size; kh++) {
-                            for (int kw = 0; kw < kernel_size; kw++) {
-                                int in_adr = (
-                                    b*in_channels*in_height*in_width
-                                    + ic*in_height*in_width
-                                    + (h*stride + kh)*in_width
-                                    + (w*stride + kw)
-                                );
-                                int weight_adr = (
-                                    oc*in_channels*kernel_size*kernel_size
-                                    + ic*kernel_size*kernel_size
-                                    + kh*kernel_size
-                                    + kw
-                                );
-                                output[out_adr] += input[in_adr]*weights[weight_adr];
-                            }
+                            int in_adr = (
+                                ic*in_depth*in_height*in_width
+                                + (d*stride + kd)*in_height*in_width
+                                + (h*stride + kh)*in_width
+                                + w*stride
+                            );
+                            memcpy(row, input + in_adr, kernel_size*sizeof(float));
+                            row += kernel_size;
                         }
                     }
-               }
+                }
             }
         }
     }
 }
 
-void _conv3d(float* input, float* weights, float* bias,
-        float* output, int batch_size, int in_width, int in_height, int in_depth,
+void _scatter_channels(float* gemm_out, float* output, int chunk, int positions, int out_channels) {
+    for (int b = 0; b < chunk; b++) {
+        float* out = output + b*out_channels*positions;
+        float* src = gemm_out + b*positions*out_channels;
+        for (int p = 0; p < positions; p++) {
+            for (int oc = 0; oc < out_channels; oc++) {
+                out[oc*positions + p] = src[p*out_channels + oc];
+            }
+        }
+    }
+}
+
+int _conv_chunk(int batch_size, int positions) {
+    int chunk = CONV_CHUNK_ROWS/positions;
+    return (chunk < 1) ? 1 : (chunk > batch_size) ? batch_size : chunk;
+}
+
+// Floats of scratch _conv2d needs for the im2col rows and the GEMM output
+size_t _conv2d_buffer_size(int batch_size, int in_width, int in_height,
         int in_channels, int out_channels, int kernel_size, int stride) {
-    int d_out = (in_depth - kernel_size)/stride + 1;
     int h_out = (in_height - kernel_size)/stride + 1;
     int w_out = (in_width - kernel_size)/stride + 1;
-    for (int b = 0; b < batch_size; b++) {
-        for (int oc = 0; oc < out_channels; oc++) {
-            for (int d = 0; d < d_out; d++) {
-                for (int h = 0; h < h_out; h++) {
-                    for (int w = 0; w < w_out; w++) {
-                        int out_adr = (
-                            b*out_channels*d_out*h_out*w_out
-                            + oc*d_out*h_out*w_out
-                            + d*h_out*w_out
-                            + h*w_out
-                            + w
-                        );
-                        output[out_adr] = bias[oc];
-                        for (int ic = 0; ic < in_channels; ic++) {
-                            for (int kd = 0; kd < kernel_size; kd++) {
-                                for (int kh = 0; kh < kernel_size; kh++) {
-                                    for (int kw = 0; kw < kernel_size; kw++) {
-                                        int in_adr = (
-                                            b*in_channels*in_depth*in_height*in_width
-                                            + ic*in_depth*in_height*in_width
-                                            + (d*stride + kd)*in_height*in_width
-                                            + (h*stride + kh)*in_width
-                                            + (w*stride + kw)
-                                        );
-                                        int weight_adr = (
-                                            oc*in_channels*kernel_size*kernel_size*kernel_size
-                                            + ic*kernel_size*kernel_size*kernel_size
-                                            + kd*kernel_size*kernel_size
-                                            + kh*kernel_size
-                                            + kw
-                                        );
-                                        output[out_adr] += input[in_adr]*weights[weight_adr];
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            }
+    int positions = h_out*w_out;
+    int K = in_channels*kernel_size*kernel_size;
+    return (size_t)_conv_chunk(batch_size, positions)*positions*(K + out_channels);
+}
+
+void _conv2d(float* input, float* weights, float* bias, float* output,
+        float* buffer, int batch_size, int in_width, int in_height,
+        int in_channels, int out_channels, int kernel_size, int stride) {
+    int h_out = (in_height - kernel_size)/stride + 1;
+    int w_out = (in_width - kernel_size)/stride + 1;
+    int positions = h_out*w_out;
+    int K = in_channels*kernel_size*kernel_size;
+    int in_size = in_channels*in_height*in_width;
+    int chunk = _conv_chunk(batch_size, positions);
+
+    float* col = buffer;
+    float* gemm_out = buffer + (size_t)chunk*positions*K;
+    for (int b0 = 0; b0 < batch_size; b0 += chunk) {
+        int n = (batch_size - b0 < chunk) ? batch_size - b0 : chunk;
+        for (int b = 0; b < n; b++) {
+            _im2col2d(input + (b0 + b)*in_size, col + b*positions*K, in_width,
+                in_height, in_channels, kernel_size, stride, h_out, w_out);
         }
+        _gemm(col, weights, bias, gemm_out, n*positions, out_channels, K, out_channels, 1, 0);
+        _scatter_channels(gemm_out, output + b0*out_channels*positions,
+            n, positions, out_channels);
     }
 }
 
-void _lstm(float* input, float* state_h, float* state_c, float* weights_input,
-        float* weights_state, float* bias_input, float*bias_state,
-        float *buffer, int batch_size, int input_size, int hidden_size) {
-    _linear(input, weights_input, bias_input, buffer, batch_size, input_size, 4*hidden_size);
-    _linear_accumulate(state_h, weights_state, bias_state, buffer, batch_size, hidden_size, 4*hidden_size);
+// Floats of scratch _conv3d needs for the im2col rows and the GEMM output
+size_t _conv3d_buffer_size(int batch_size, int in_width, int in_height, int in_depth,
+        int in_channels, int out_channels, int kernel_size, int stride) {
+    int d_out = (in_depth - kernel_size)/stride + 1;
+    int h_out = (in_height - kernel_size)/stride + 1;
+    int w_out = (in_width - kernel_size)/stride + 1;
+    int positions = d_out*h_out*w_out;
+    int K = in_channels*kernel_size*kernel_size*kernel_size;
+    return (size_t)_conv_chunk(batch_size, positions)*positions*(K + out_channels);
+}
 
-    // Activation functions
-    for (int b=0; b<batch_size; b++) {
-        int b_offset = 4*b*hidden_size;
-        for (int i=0; i<2*hidden_size; i++) {
-            int buf_adr = b_offset + i;
-            buffer[buf_adr] = _sigmoid(buffer[buf_adr]);
-        }
-        for (int i=2*hidden_size; i<3*hidden_size; i++) {
-            int buf_adr = b_offset + i;
-            buffer[buf_adr] = tanh(buffer[buf_adr]);
-        }
-        for (int i=3*hidden_size; i<4*hidden_size; i++) {
-            int buf_adr = b_offset + i;
-            buffer[buf_adr] = _sigmoid(buffer[buf_adr]);
+void _conv3d(float* input, float* weights, float* bias, float* output,
+        float* buffer, int batch_size, int in_width, int in_height, int in_depth,
+        int in_channels, int out_channels, int kernel_size, int stride) {
+    int d_out = (in_depth - kernel_size)/stride + 1;
+    int h_out = (in_height - kernel_size)/stride + 1;
+    int w_out = (in_width - kernel_size)/stride + 1;
+    int positions = d_out*h_out*w_out;
+    int K = in_channels*kernel_size*kernel_size*kernel_size;
+    int in_size = in_channels*in_depth*in_height*in_width;
+    int chunk = _conv_chunk(batch_size, positions);
+
+    float* col = buffer;
+    float* gemm_out = buffer + (size_t)chunk*positions*K;
+    for (int b0 = 0; b0 < batch_size; b0 += chunk) {
+        int n = (batch_size - b0 < chunk) ? batch_size - b0 : chunk;
+        for (int b = 0; b < n; b++) {
+            _im2col3d(input + (b0 + b)*in_size, col + b*positions*K, in_width, in_height,
+                in_depth, in_channels, kernel_size, stride, d_out, h_out, w_out);
         }
+        _gemm(col, weights, bias, gemm_out, n*positions, out_channels, K, out_channels, 1, 0);
+        _scatter_channels(gemm_out, output + b0*out_channels*positions,
+            n, positions, out_channels);
     }
+}
 
-    // Gates
+// Gate activations fused with the state update, one pass per row. gates holds
+// the summed input and state projections, 4*hidden_size per row
+static inline void _lstm_gates(float* gates, float* state_h, float* state_c,
+        int batch_size, int hidden_size) {
     for (int b=0; b<batch_size; b++) {
-        int hidden_offset = b*hidden_size;
-        int b_offset = 4*b*hidden_size;
+        float* g = gates + 4*b*hidden_size;
+        float* h = state_h + b*hidden_size;
+        float* c = state_c + b*hidden_size;
         for (int i=0; i<hidden_size; i++) {
-            state_c[hidden_offset + i] = (
-                buffer[b_offset + hidden_size + i] * state_c[hidden_offset + i]
-                + buffer[b_offset + i] * buffer[b_offset + 2*hidden_size + i]
-            );
-            state_h[hidden_offset + i] = (
-                buffer[b_offset + 3*hidden_size + i] * tanh(state_c[hidden_offset + i])
-            );
+            float input_gate = _sigmoid(g[i]);
+            float forget_gate = _sigmoid(g[hidden_size + i]);
+            float cell_gate = tanhf(g[2*hidden_size + i]);
+            float output_gate = _sigmoid(g[3*hidden_size + i]);
+            c[i] = forget_gate*c[i] + input_gate*cell_gate;
+            h[i] = output_gate*tanhf(c[i]);
         }
     }
 }
 
+void _lstm(float* input, float* state_h, float* state_c, float* weights_input,
+        float* weights_state, float* bias_input, float*bias_state,
+        float *buffer, int batch_size, int input_size, int hidden_size) {
+    _linear(input, weights_input, bias_input, buffer, batch_size, input_size, 4*hidden_size);
+    _linear_accumulate(state_h, weights_state, bias_state, buffer, batch_size, hidden_size, 4*hidden_size);
+    _lstm_gates(buffer, state_h, state_c, batch_size, hidden_size);
+}
+
 void _embedding(int* input, float* weights, float* output, int batch_size, int num_embeddings, int embedding_dim) {
     for (int b = 0; b < batch_size; b++) {
         memcpy(output + b*embedding_dim, weights + input[b]*embedding_dim, embedding_dim*sizeof(float));
@@ -462,6 +748,7 @@ void max_dim1(MaxDim1* layer, float* input) {
 typedef struct Conv2D Conv2D;
 struct Conv2D {
     float* output;
+    float* buffer;
     float* weights;
     float* bias;
     int batch_size;
@@ -475,11 +762,14 @@ struct Conv2D {
 
 Conv2D* make_conv2d(Weights* weights, int batch_size, int in_width, int in_height,
         int in_channels, int out_channels, int kernel_size, int stride) {
-    size_t buffer_size = batch_size*out_channels*in_height*in_width*sizeof(float);
+    size_t output_size = batch_size*out_channels*in_height*in_width;
+    size_t buffer_size = (output_size + _conv2d_buffer_size(batch_size, in_width,
+        in_height, in_channels, out_channels, kernel_size, stride))*sizeof(float);
     int num_weights = out_channels*in_channels*kernel_size*kernel_size;
     Conv2D* layer = calloc(1, sizeof(Conv2D) + buffer_size);
     *layer = (Conv2D){
         .output = (float*)(layer + 1),
+        .buffer = (float*)(layer + 1) + output_size,
         .weights = get_weights(weights, num_weights),
         .bias = get_weights(weights, out_channels),
         .batch_size = batch_size,
@@ -495,13 +785,14 @@ Conv2D* make_conv2d(Weights* weights, int batch_size, int in_width, int in_heigh
 
 void conv2d(Conv2D* layer, float* input) {
     _conv2d(input, layer->weights, layer->bias, layer->output,
-        layer->batch_size, layer->in_width, layer->in_height,
+        layer->buffer, layer->batch_size, layer->in_width, layer->in_height,
         layer->in_channels, layer->out_channels, layer->kernel_size, layer->stride);
 }
 
 typedef struct Conv3D Conv3D;
 struct Conv3D {
     float* output;
+    float* buffer;
     float* weights;
     float* bias;
     int batch_size;
@@ -517,11 +808,14 @@ struct Conv3D {
 Conv3D* make_conv3d(Weights* weights, int batch_size, int in_width, int in_height, int in_depth,
         int in_channels, int out_channels, int kernel_size, int stride) {
     
-    size_t buffer_size = batch_size*out_channels*in_depth*in_height*in_width*sizeof(float);
+    size_t output_size = batch_size*out_channels*in_depth*in_height*in_width;
+    size_t buffer_size = (output_size + _conv3d_buffer_size(batch_size, in_width,
+        in_height, in_depth, in_channels, out_channels, kernel_size, stride))*sizeof(float);
     int num_weights = out_channels*in_channels*kernel_size*kernel_size*kernel_size;
     Conv3D* layer = calloc(1, sizeof(Conv3D) + buffer_size);
     *layer = (Conv3D){
         .output = (float*)(layer + 1),
+        .buffer = (float*)(layer + 1) + output_size,
         .weights = get_weights(weights, num_weights),
         .bias = get_weights(weights, out_channels),
         .batch_size = batch_size,
@@ -538,7 +832,7 @@ Conv3D* make_conv3d(Weights* weights, int batch_size, int in_width, int in_heigh
 
 void conv3d(Conv3D* layer, float* input) {
     _conv3d(input, layer->weights, layer->bias, layer->output,
-        layer->batch_size, layer->in_width, layer->in_height, layer->in_depth,
+        layer->buffer, layer->batch_size, layer->in_width, layer->in_height, layer->in_depth,
         layer->in_channels, layer->out_channels, layer->kernel_size, layer->stride);
 }
 
@@ -857,3 +1151,1160 @@ void forward_convlstm(ConvLSTM* net, float* observations, int* actions) {
     linear(net->value_fn, net->lstm->state_h);
     softmax_multidiscrete(net->multidiscrete, net->actor->output, actions);
 }
+
+// Graph executor. An alternative to the per-layer structs above for nets run
+// on a varying number of agents. Nodes are added in execution order and
+// reference tensors by id. compile_graph folds an activation into the linear
+// or conv that feeds it, then plans every intermediate tensor into one Arena:
+// tensors that are never live at the same time share memory. The arena is
+// sized for max_batch and any batch up to that runs without reallocating.
+// LSTM state is kept per agent and forward_graph is told which agent each
+// row belongs to, so any subset of agents can be stepped in any order
+#define GRAPH_MAX_NODES 32
+#define GRAPH_MAX_TENSORS 64
+// Output floats per chunk when a linear runs fused with its activation,
+// so the activation is applied while the rows are still in L1
+#define GRAPH_FUSE_FLOATS 4096
+
+typedef enum {
+    ACT_NONE,
+    ACT_RELU,
+    ACT_GELU,
+} Activation;
+
+typedef enum {
+    NODE_LINEAR,
+    NODE_ACTIVATION,
+    NODE_CONV2D,
+    NODE_LSTM,
+    NODE_LAYERNORM,
+    NODE_FUSED,
+} NodeType;
+
+typedef struct GraphTensor GraphTensor;
+struct GraphTensor {
+    // Floats per sample
+    int dim;
+    // First and last node the tensor is live for
+    int first;
+    int last;
+    int producer;
+    int uses;
+    bool external;
+    bool is_output;
+    bool fused;
+    size_t offset;
+};
+
+typedef struct GraphNode GraphNode;
+struct GraphNode {
+    NodeType type;
+    Activation activation;
+    int input;
+    int output;
+    int scratch;
+    float* weights;
+    float* bias;
+    float* weights_state;
+    float* bias_state;
+    float* state_h;
+    float* state_c;
+    int input_dim;
+    int output_dim;
+    int in_width;
+    int in_height;
+    int in_channels;
+    int out_channels;
+    int kernel_size;
+    int stride;
+};
+
+typedef struct Graph Graph;
+struct Graph {
+    GraphNode nodes[GRAPH_MAX_NODES];
+    GraphTensor tensors[GRAPH_MAX_TENSORS];
+    int num_nodes;
+    int num_tensors;
+    int num_agents;
+    int max_batch;
+    float* input;
+    Arena* arena;
+    float* activations;
+    // Floats per sample with a buffer per tensor and after planning
+    size_t naive_size;
+    size_t planned_size;
+    // Floats of recurrent state across all agents
+    size_t state_size;
+};
+
+Graph* make_graph(int num_agents, int max_batch) {
+    Graph* graph = calloc(1, sizeof(Graph));
+    graph->num_agents = num_agents;
+    graph->max_batch = max_batch;
+    return graph;
+}
+
+int _graph_tensor(Graph* graph, int dim) {
+    assert(graph->num_tensors < GRAPH_MAX_TENSORS);
+    int id = graph->num_tensors++;
+    graph->tensors[id] = (GraphTensor){
+        .dim = dim,
+        .first = graph->num_nodes,
+        .last = graph->num_nodes,
+        .producer = graph->num_nodes,
+    };
+    return id;
+}
+
+GraphNode* _graph_node(Graph* graph, NodeType type, int input, int output_dim) {
+    assert(graph->num_nodes < GRAPH_MAX_NODES);
+    assert(graph->arena == NULL && "Cannot add nodes after compile_graph");
+    GraphNode* node = &graph->nodes[graph->num_nodes];
+    *node = (GraphNode){
+        .type = type,
+        .input = input,
+        .output = _graph_tensor(graph, output_dim),
+        .scratch = -1,
+        .input_dim = graph->tensors[input].dim,
+        .output_dim = output_dim,
+    };
+    graph->tensors[input].last = graph->num_nodes;
+    graph->tensors[input].uses++;
+    graph->num_nodes++;
+    return node;
+}
+
+// Scratch only lives for the node that uses it
+int _graph_scratch(Graph* graph, GraphNode* node, size_t floats) {
+    int id = _graph_tensor(graph, (floats + graph->max_batch - 1)/graph->max_batch);
+    int idx = node - graph->nodes;
+    graph->tensors[id].first = idx;
+    graph->tensors[id].last = idx;
+    graph->tensors[id].producer = idx;
+    node->scratch = id;
+    return id;
+}
+
+// The input is read straight from the pointer passed to forward_graph
+int graph_input(Graph* graph, int dim) {
+    int id = _graph_tensor(graph, dim);
+    graph->tensors[id].external = true;
+    graph->tensors[id].first = -1;
+    graph->tensors[id].producer = -1;
+    return id;
+}
+
+// Keeps a tensor alive until the end of forward_graph so it can be read
+void graph_output(Graph* graph, int tensor) {
+    graph->tensors[tensor].is_output = true;
+}
+
+// Linear and conv take raw weight pointers rather than Weights because
+// exported nets usually store the heads before the LSTM they read from
+int graph_linear(Graph* graph, int input, float* weights, float* bias, int output_dim) {
+    GraphNode* node = _graph_node(graph, NODE_LINEAR, input, output_dim);
+    node->weights = weights;
+    node->bias = bias;
+    return node->output;
+}
+
+int graph_activation(Graph* graph, int input, Activation activation) {
+    GraphNode* node = _graph_node(graph, NODE_ACTIVATION, input, graph->tensors[input].dim);
+    node->activation = activation;
+    return node->output;
+}
+
+int graph_conv2d(Graph* graph, int input, float* weights, float* bias, int in_width,
+        int in_height, int in_channels, int out_channels, int kernel_size, int stride) {
+    assert(graph->tensors[input].dim == in_width*in_height*in_channels);
+    int h_out = (in_height - kernel_size)/stride + 1;
+    int w_out = (in_width - kernel_size)/stride + 1;
+    GraphNode* node = _graph_node(graph, NODE_CONV2D, input, out_channels*h_out*w_out);
+    node->weights = weights;
+    node->bias = bias;
+    node->in_width = in_width;
+    node->in_height = in_height;
+    node->in_channels = in_channels;
+    node->out_channels = out_channels;
+    node->kernel_size = kernel_size;
+    node->stride = stride;
+    _graph_scratch(graph, node, _conv2d_buffer_size(graph->max_batch, in_width,
+        in_height, in_channels, out_channels, kernel_size, stride));
+    return node->output;
+}
+
+// Weight order matches make_lstm. The input projection is its own linear
+// node so the input can be freed before the gates are computed. Returns the
+// hidden state of the stepped rows
+int graph_lstm(Graph* graph, int input, Weights* weights, int hidden_size) {
+    int input_size = graph->tensors[input].dim;
+    float* weights_input = get_weights(weights, 4*hidden_size*input_size);
+    float* weights_state = get_weights(weights, 4*hidden_size*hidden_size);
+    float* bias_input = get_weights(weights, 4*hidden_size);
+    float* bias_state = get_weights(weights, 4*hidden_size);
+    int gates = graph_linear(graph, input, weights_input, bias_input, 4*hidden_size);
+    GraphNode* node = _graph_node(graph, NODE_LSTM, gates, hidden_size);
+    node->weights_state = weights_state;
+    node->bias_state = bias_state;
+    size_t state_size = (size_t)graph->num_agents*hidden_size;
+    node->state_h = calloc(2*state_size, sizeof(float));
+    node->state_c = node->state_h + state_size;
+    graph->state_size += 2*state_size;
+    return node->output;
+}
+
+int graph_layernorm(Graph* graph, int input, Weights* weights) {
+    int dim = graph->tensors[input].dim;
+    GraphNode* node = _graph_node(graph, NODE_LAYERNORM, input, dim);
+    node->weights = get_weights(weights, dim);
+    node->bias = get_weights(weights, dim);
+    return node->output;
+}
+
+// Folds an activation into the linear or conv feeding it when nothing else
+// reads the tensor in between, dropping that tensor
+void _fuse_activations(Graph* graph) {
+    for (int i = 0; i < graph->num_nodes; i++) {
+        GraphNode* node = &graph->nodes[i];
+        if (node->type != NODE_ACTIVATION) {
+            continue;
+        }
+        GraphTensor* between = &graph->tensors[node->input];
+        if (between->external || between->is_output || between->uses != 1) {
+            continue;
+        }
+        GraphNode* producer = &graph->nodes[between->producer];
+        if ((producer->type != NODE_LINEAR && producer->type != NODE_CONV2D)
+                || producer->activation != ACT_NONE) {
+            continue;
+        }
+        producer->activation = node->activation;
+        producer->output = node->output;
+        graph->tensors[node->output].first = between->producer;
+        graph->tensors[node->output].producer = between->producer;
+        between->fused = true;
+        node->type = NODE_FUSED;
+    }
+}
+
+bool _lifetimes_overlap(GraphTensor* a, GraphTensor* b) {
+    return a->first <= b->last && b->first <= a->last;
+}
+
+// Greedy by size: the largest tensors are placed first, each at the lowest
+// offset that does not collide with an already placed, simultaneously live tensor
+void compile_graph(Graph* graph) {
+    _fuse_activations(graph);
+
+    int order[GRAPH_MAX_TENSORS];
+    int n = 0;
+    graph->naive_size = 0;
+    for (int t = 0; t < graph->num_tensors; t++) {
+        GraphTensor* tensor = &graph->tensors[t];
+        if (!tensor->external) {
+            graph->naive_size += tensor->dim;
+        }
+        if (tensor->is_output) {
+            tensor->last = graph->num_nodes;
+        }
+        if (!tensor->external && !tensor->fused) {
+            order[n++] = t;
+        }
+    }
+    for (int i = 1; i < n; i++) {
+        int t = order[i];
+        int j = i - 1;
+        while (j >= 0 && graph->tensors[order[j]].dim < graph->tensors[t].dim) {
+            order[j + 1] = order[j];
+            j--;
+        }
+        order[j + 1] = t;
+    }
+
+    graph->planned_size = 0;
+    for (int i = 0; i < n; i++) {
+        GraphTensor* tensor = &graph->tensors[order[i]];
+        size_t offset = 0;
+        bool moved = true;
+        while (moved) {
+            moved = false;
+            for (int j = 0; j < i; j++) {
+                GraphTensor* other = &graph->tensors[order[j]];
+                if (!_lifetimes_overlap(tensor, other)) {
+                    continue;
+                }
+                if (offset < other->offset + other->dim && other->offset < offset + tensor->dim) {
+                    offset = other->offset + other->dim;
+                    moved = true;
+                }
+            }
+        }
+        tensor->offset = offset;
+        if (offset + tensor->dim > graph->planned_size) {
+            graph->planned_size = offset + tensor->dim;
+        }
+    }
+
+    // Offsets are per sample. Scale by max_batch so each tensor is a
+    // contiguous [batch x dim] block valid for any batch <= max_batch
+    size_t bytes = graph->planned_size*graph->max_batch*sizeof(float);
+    graph->arena = make_allocator(bytes);
+    graph->activations = alloc(graph->arena, bytes);
+}
+
+float* graph_tensor(Graph* graph, int tensor) {
+    GraphTensor* t = &graph->tensors[tensor];
+    if (t->external) {
+        return graph->input;
+    }
+    return graph->activations + t->offset*graph->max_batch;
+}
+
+void _activate(float* input, float* output, int size, Activation activation) {
+    if (activation == ACT_RELU) {
+        _relu(input, output, size);
+    } else if (activation == ACT_GELU) {
+        _gelu(input, output, size);
+    } else if (input != output) {
+        memcpy(output, input, size*sizeof(float));
+    }
+}
+
+// Linear with bias and activation, a chunk of rows at a time
+void _linear_activate(float* input, float* weights, float* bias, float* output,
+        int batch_size, int input_dim, int output_dim, Activation activation) {
+    if (activation == ACT_NONE) {
+        _linear(input, weights, bias, output, batch_size, input_dim, output_dim);
+        return;
+    }
+    int chunk = GRAPH_FUSE_FLOATS/output_dim;
+    chunk = (chunk < 1) ? 1 : chunk;
+    for (int r = 0; r < batch_size; r += chunk) {
+        int rows = (batch_size - r < chunk) ? batch_size - r : chunk;
+        float* rows_out = output + r*output_dim;
+        _linear(input + r*input_dim, weights, bias, rows_out, rows, input_dim, output_dim);
+        _activate(rows_out, rows_out, rows*output_dim, activation);
+    }
+}
+
+// Steps the LSTM state of the agent of each row. input holds the input
+// projection, which the state projection is added to in place
+void _graph_lstm(GraphNode* node, float* input, float* output, int batch_size, const int* agents) {
+    int hidden_size = node->output_dim;
+    for (int b = 0; b < batch_size; b++) {
+        int agent = (agents == NULL) ? b : agents[b];
+        memcpy(output + b*hidden_size, node->state_h + agent*hidden_size, hidden_size*sizeof(float));
+    }
+    _linear_accumulate(output, node->weights_state, node->bias_state, input,
+        batch_size, hidden_size, 4*hidden_size);
+    for (int b = 0; b < batch_size; b++) {
+        int agent = (agents == NULL) ? b : agents[b];
+        float* h = output + b*hidden_size;
+        _lstm_gates(input + 4*b*hidden_size, h, node->state_c + agent*hidden_size, 1, hidden_size);
+        memcpy(node->state_h + agent*hidden_size, h, hidden_size*sizeof(float));
+    }
+}
+
+// Runs batch_size rows of input. Row b belongs to agents[b], or to agent b
+// if agents is NULL. An agent may appear at most once per call
+void forward_graph(Graph* graph, float* input, int batch_size, const int* agents) {
+    assert(graph->arena != NULL && "Call compile_graph before forward_graph");
+    assert(batch_size <= graph->max_batch);
+    graph->input = input;
+    for (int i = 0; i < graph->num_nodes; i++) {
+        GraphNode* node = &graph->nodes[i];
+        float* in = graph_tensor(graph, node->input);
+        float* out = graph_tensor(graph, node->output);
+        switch (node->type) {
+        case NODE_LINEAR:
+            _linear_activate(in, node->weights, node->bias, out, batch_size,
+                node->input_dim, node->output_dim, node->activation);
+            break;
+        case NODE_ACTIVATION:
+            _activate(in, out, batch_size*node->output_dim, node->activation);
+            break;
+        case NODE_CONV2D:
+            _conv2d(in, node->weights, node->bias, out, graph_tensor(graph, node->scratch),
+                batch_size, node->in_width, node->in_height, node->in_channels,
+                node->out_channels, node->kernel_size, node->stride);
+            _activate(out, out, batch_size*node->output_dim, node->activation);
+            break;
+        case NODE_LSTM:
+            _graph_lstm(node, in, out, batch_size, agents);
+            break;
+        case NODE_LAYERNORM:
+            _layernorm(in, node->weights, node->bias, out, batch_size, node->input_dim);
+            break;
+        case NODE_FUSED:
+            // Applied by the node that produced its input
+            break;
+        }
+    }
+}
+
+// Zeros the recurrent state of the given agent, e.g. on episode reset
+void reset_graph_agent(Graph* graph, int agent) {
+    for (int i = 0; i < graph->num_nodes; i++) {
+        GraphNode* node = &graph->nodes[i];
+        if (node->type == NODE_LSTM) {
+            memset(node->state_h + agent*node->output_dim, 0, node->output_dim*sizeof(float));
+            memset(node->state_c + agent*node->output_dim, 0, node->output_dim*sizeof(float));
+        }
+    }
+}
+
+void free_graph(Graph* graph) {
+    for (int i = 0; i < graph->num_nodes; i++) {
+        if (graph->nodes[i].type == NODE_LSTM) {
+            free(graph->nodes[i].state_h);
+        }
+    }
+    free(graph->arena);
+    free(graph);
+}
+
+// Int8 inference. Weight matrices are quantized per output row with a
+// symmetric float scale. Activations are quantized per row on the fly, the
+// product accumulates in int32 and is rescaled to float with the bias added,
+// so everything between layers stays float. Biases and vectors stay float.
+
+// Per row symmetric quantization. Zero rows get scale 0
+typedef void (*QuantizeKernel)(const float* input, int8_t* output, float* scales,
+    int rows, int cols);
+
+void _quantize_rows_scalar(const float* input, int8_t* output, float* scales, int rows, int cols) {
+    for (int r = 0; r < rows; r++) {
+        const float* x = input + (size_t)r*cols;
+        float max_abs = 0.0f;
+        for (int i = 0; i < cols; i++) {
+            max_abs = fmaxf(max_abs, fabsf(x[i]));
+        }
+        scales[r] = max_abs/127.0f;
+        float inv = (max_abs > 0.0f) ? 127.0f/max_abs : 0.0f;
+        for (int i = 0; i < cols; i++) {
+            output[(size_t)r*cols + i] = (int8_t)lrintf(x[i]*inv);
+        }
+    }
+}
+
+#if PUFFERNET_X86
+__attribute__((target("avx2")))
+void _quantize_rows_avx2(const float* input, int8_t* output, float* scales, int rows, int cols) {
+    const __m256 abs_mask = _mm256_castsi256_ps(_mm256_set1_epi32(0x7fffffff));
+    const __m256i lane_order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+    for (int r = 0; r < rows; r++) {
+        const float* x = input + (size_t)r*cols;
+        int8_t* q = output + (size_t)r*cols;
+        __m256 vmax = _mm256_setzero_ps();
+        int i = 0;
+        for (; i + 8 <= cols; i += 8) {
+            vmax = _mm256_max_ps(vmax, _mm256_and_ps(_mm256_loadu_ps(x + i), abs_mask));
+        }
+        __m128 m = _mm_max_ps(_mm256_castps256_ps128(vmax), _mm256_extractf128_ps(vmax, 1));
+        m = _mm_max_ps(m, _mm_movehl_ps(m, m));
+        m = _mm_max_ss(m, _mm_movehdup_ps(m));
+        float max_abs = _mm_cvtss_f32(m);
+        for (; i < cols; i++) {
+            max_abs = fmaxf(max_abs, fabsf(x[i]));
+        }
+        scales[r] = max_abs/127.0f;
+        float inv = (max_abs > 0.0f) ? 127.0f/max_abs : 0.0f;
+
+        // 32 floats -> 32 int8. packs works within 128 bit lanes,
+        // so the result is permuted back into order
+        __m256 vinv = _mm256_set1_ps(inv);
+        i = 0;
+        for (; i + 32 <= cols; i += 32) {
+            __m256i a = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i), vinv));
+            __m256i b = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i + 8), vinv));
+            __m256i c = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i + 16), vinv));
+            __m256i d = _mm256_cvtps_epi32(_mm256_mul_ps(_mm256_loadu_ps(x + i + 24), vinv));
+            __m256i packed = _mm256_packs_epi16(_mm256_packs_epi32(a, b), _mm256_packs_epi32(c, d));
+            _mm256_storeu_si256((__m256i*)(q + i), _mm256_permutevar8x32_epi32(packed, lane_order));
+        }
+        for (; i < cols; i++) {
+            q[i] = (int8_t)lrintf(x[i]*inv);
+        }
+    }
+}
+#endif
+
+// C = (A*B^T)*a_scale*b_scale + bias with A [M x K] and B [N x K] int8.
+// Same tiling and strides as _gemm
+typedef void (*QGemmKernel)(const int8_t* A, const float* a_scales, const int8_t* B,
+    const float* b_scales, const float* bias, float* C, int M, int N, int K,
+    int rs, int cs, int accumulate);
+
+static inline void _qgemm_store(float* C, int sum, float a_scale, float b_scale,
+        float bias, int accumulate) {
+    _gemm_store(C, sum*a_scale*b_scale, bias, accumulate);
+}
+
+__attribute__((always_inline))
+static inline void _qgemm_tile_scalar(const int8_t* A, const float* a_scales,
+        const int8_t* B, const float* b_scales, const float* bias, float* C,
+        int K, int rs, int cs, int accumulate, int mr, int nr) {
+    int acc[4][4] = {{0}};
+    for (int k = 0; k < K; k++) {
+        for (int i = 0; i < mr; i++) {
+            int a = A[i*K + k];
+            for (int j = 0; j < nr; j++) {
+                acc[i][j] += a*B[j*K + k];
+            }
+        }
+    }
+    for (int i = 0; i < mr; i++) {
+        for (int j = 0; j < nr; j++) {
+            _qgemm_store(&C[i*rs + j*cs], acc[i][j], a_scales[i], b_scales[j], bias[j], accumulate);
+        }
+    }
+}
+
+void _qgemm_scalar(const int8_t* A, const float* a_scales, const int8_t* B,
+        const float* b_scales, const float* bias, float* C, int M, int N, int K,
+        int rs, int cs, int accumulate) {
+    int nb = _gemm_block_n(K/4 + 1, 4);
+    for (int n0 = 0; n0 < N; n0 += nb) {
+        int n1 = (n0 + nb < N) ? n0 + nb : N;
+        for (int m = 0; m < M; m += 4) {
+            int mr = (M - m < 4) ? M - m : 4;
+            for (int n = n0; n < n1; n += 4) {
+                int nr = (n1 - n < 4) ? n1 - n : 4;
+                const int8_t* a = A + (size_t)m*K;
+                const int8_t* b = B + (size_t)n*K;
+                float* c = C + m*rs + n*cs;
+                if (mr == 4 && nr == 4) {
+                    _qgemm_tile_scalar(a, a_scales + m, b, b_scales + n, bias + n,
+                        c, K, rs, cs, accumulate, 4, 4);
+                } else {
+                    _qgemm_tile_scalar(a, a_scales + m, b, b_scales + n, bias + n,
+                        c, K, rs, cs, accumulate, mr, nr);
+                }
+            }
+        }
+    }
+}
+
+#if PUFFERNET_X86
+__attribute__((target("avx2")))
+static inline int _hsum_epi32_avx2(__m256i v) {
+    __m128i lo = _mm_add_epi32(_mm256_castsi256_si128(v), _mm256_extracti128_si256(v, 1));
+    lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(1, 0, 3, 2)));
+    lo = _mm_add_epi32(lo, _mm_shuffle_epi32(lo, _MM_SHUFFLE(2, 3, 0, 1)));
+    return _mm_cvtsi128_si32(lo);
+}
+
+// 4x2 tile, 16 int8 of K per step, widened to int16 and summed in pairs
+// into int32 with madd
+__attribute__((target("avx2"), always_inline))
+static inline void _qgemm_tile_avx2(const int8_t* A, const float* a_scales,
+        const int8_t* B, const float* b_scales, const float* bias, float* C,
+        int K, int rs, int cs, int accumulate, int mr, int nr) {
+    __m256i acc[4][2];
+    for (int i = 0; i < 4; i++) {
+        acc[i][0] = _mm256_setzero_si256();
+        acc[i][1] = _mm256_setzero_si256();
+    }
+    int k = 0;
+    for (; k + 16 <= K; k += 16) {
+        __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(B + k)));
+        __m256i b1 = (nr > 1) ? _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(B + K + k))) : b0;
+        for (int i = 0; i < mr; i++) {
+            __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)(A + i*K + k)));
+            acc[i][0] = _mm256_add_epi32(acc[i][0], _mm256_madd_epi16(a, b0));
+            acc[i][1] = _mm256_add_epi32(acc[i][1], _mm256_madd_epi16(a, b1));
+        }
+    }
+    if (k < K) {
+        // Zero padded copies of the tail so it takes one more full step
+        int8_t tail[6][16] = {{0}};
+        for (int j = 0; j < nr; j++) {
+            memcpy(tail[4 + j], B + j*K + k, K - k);
+        }
+        __m256i b0 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)tail[4]));
+        __m256i b1 = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)tail[5]));
+        for (int i = 0; i < mr; i++) {
+            memcpy(tail[i], A + i*K + k, K - k);
+            __m256i a = _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i*)tail[i]));
+            acc[i][0] = _mm256_add_epi32(acc[i][0], _mm256_madd_epi16(a, b0));
+            acc[i][1] = _mm256_add_epi32(acc[i][1], _mm256_madd_epi16(a, b1));
+        }
+    }
+    for (int i = 0; i < mr; i++) {
+        for (int j = 0; j < nr; j++) {
+            int sum = _hsum_epi32_avx2(acc[i][j]);
+            _qgemm_store(&C[i*rs + j*cs], sum, a_scales[i], b_scales[j], bias[j], accumulate);
+        }
+    }
+}
+
+__attribute__((target("avx2")))
+void _qgemm_avx2(const int8_t* A, const float* a_scales, const int8_t* B,
+        const float* b_scales, const float* bias, float* C, int M, int N, int K,
+        int rs, int cs, int accumulate) {
+    int nb = _gemm_block_n(K/4 + 1, 2);
+    for (int n0 = 0; n0 < N; n0 += nb) {
+        int n1 = (n0 + nb < N) ? n0 + nb : N;
+        for (int m = 0; m < M; m += 4) {
+            int mr = (M - m < 4) ? M - m : 4;
+            for (int n = n0; n < n1; n += 2) {
+                int nr = (n1 - n < 2) ? n1 - n : 2;
+                const int8_t* a = A + (size_t)m*K;
+                const int8_t* b = B + (size_t)n*K;
+                float* c = C + m*rs + n*cs;
+                if (mr == 4 && nr == 2) {
+                    _qgemm_tile_avx2(a, a_scales + m, b, b_scales + n, bias + n,
+                        c, K, rs, cs, accumulate, 4, 2);
+                } else {
+                    _qgemm_tile_avx2(a, a_scales + m, b, b_scales + n, bias + n,
+                        c, K, rs, cs, accumulate, mr, nr);
+                }
+            }
+        }
+    }
+}
+
+// 4x4 tile, 32 int8 of K per step
+__attribute__((target("avx512f,avx512bw,avx512vl"), always_inline))
+static inline void _qgemm_tile_avx512(const int8_t* A, const float* a_scales,
+        const int8_t* B, const float* b_scales, const float* bias, float* C,
+        int K, int rs, int cs, int accumulate, int mr, int nr) {
+    __m512i acc[4][4];
+    for (int i = 0; i < 4; i++) {
+        for (int j = 0; j < 4; j++) {
+            acc[i][j] = _mm512_setzero_si512();
+        }
+    }
+    int k = 0;
+    for (; k + 32 <= K; k += 32) {
+        __m512i b[4];
+        for (int j = 0; j < 4; j++) {
+            b[j] = (j < nr) ? _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)(B + j*K + k)))
+                : _mm512_setzero_si512();
+        }
+        for (int i = 0; i < mr; i++) {
+            __m512i a = _mm512_cvtepi8_epi16(_mm256_loadu_si256((const __m256i*)(A + i*K + k)));
+            for (int j = 0; j < 4; j++) {
+                acc[i][j] = _mm512_add_epi32(acc[i][j], _mm512_madd_epi16(a, b[j]));
+            }
+        }
+    }
+    if (k < K) {
+        __mmask32 tail = (__mmask32)((1u << (K - k)) - 1);
+        __m512i b[4];
+        for (int j = 0; j < 4; j++) {
+            b[j] = (j < nr) ? _mm512_cvtepi8_epi16(_mm256_maskz_loadu_epi8(tail, B + j*K + k))
+                : _mm512_setzero_si512();
+        }
+        for (int i = 0; i < mr; i++) {
+            __m512i a = _mm512_cvtepi8_epi16(_mm256_maskz_loadu_epi8(tail, A + i*K + k));
+            for (int j = 0; j < 4; j++) {
+                acc[i][j] = _mm512_add_epi32(acc[i][j], _mm512_madd_epi16(a, b[j]));
+            }
+        }
+    }
+    for (int i = 0; i < mr; i++) {
+        for (int j = 0; j < nr; j++) {
+            int sum = _mm512_reduce_add_epi32(acc[i][j]);
+            _qgemm_store(&C[i*rs + j*cs], sum, a_scales[i], b_scales[j], bias[j], accumulate);
+        }
+    }
+}
+
+__attribute__((target("avx512f,avx512bw,avx512vl")))
+void _qgemm_avx512(const int8_t* A, const float* a_scales, const int8_t* B,
+        const float* b_scales, const float* bias, float* C, int M, int N, int K,
+        int rs, int cs, int accumulate) {
+    int nb = _gemm_block_n(K/4 + 1, 4);
+    for (int n0 = 0; n0 < N; n0 += nb) {
+        int n1 = (n0 + nb < N) ? n0 + nb : N;
+        for (int m = 0; m < M; m += 4) {
+            int mr = (M - m < 4) ? M - m : 4;
+            for (int n = n0; n < n1; n += 4) {
+                int nr = (n1 - n < 4) ? n1 - n : 4;
+                const int8_t* a = A + (size_t)m*K;
+                const int8_t* b = B + (size_t)n*K;
+                float* c = C + m*rs + n*cs;
+                if (mr == 4 && nr == 4) {
+                    _qgemm_tile_avx512(a, a_scales + m, b, b_scales + n, bias + n,
+                        c, K, rs, cs, accumulate, 4, 4);
+                } else {
+                    _qgemm_tile_avx512(a, a_scales + m, b, b_scales + n, bias + n,
+                        c, K, rs, cs, accumulate, mr, nr);
+                }
+            }
+        }
+    }
+}
+#endif
+
+// Follows the float kernel chosen by set_gemm_kernel
+QGemmKernel _qgemm_kernel = NULL;
+QuantizeKernel _quantize_kernel = NULL;
+const char* _int8_kernels_for = NULL;
+
+void _select_int8_kernels(void) {
+    const char* name = gemm_kernel_name();
+    if (name == _int8_kernels_for) {
+        return;
+    }
+    _qgemm_kernel = _qgemm_scalar;
+    _quantize_kernel = _quantize_rows_scalar;
+#if PUFFERNET_X86
+    if (strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512bw")
+            && __builtin_cpu_supports("avx512vl")) {
+        _qgemm_kernel = _qgemm_avx512;
+        _quantize_kernel = _quantize_rows_avx2;
+    } else if (strcmp(name, "avx2") == 0 || strcmp(name, "avx512") == 0) {
+        _qgemm_kernel = _qgemm_avx2;
+        _quantize_kernel = _quantize_rows_avx2;
+    }
+#endif
+    _int8_kernels_for = name;
+}
+
+void _quantize_rows(const float* input, int8_t* output, float* scales, int rows, int cols) {
+    _select_int8_kernels();
+    _quantize_kernel(input, output, scales, rows, cols);
+}
+
+void _qgemm(const int8_t* A, const float* a_scales, const int8_t* B,
+        const float* b_scales, const float* bias, float* C, int M, int N, int K,
+        int rs, int cs, int accumulate) {
+    _select_int8_kernels();
+    _qgemm_kernel(A, a_scales, B, b_scales, bias, C, M, N, K, rs, cs, accumulate);
+}
+
+// Int8 weights. Like the float format, a file is its blocks concatenated in
+// the order layers consume them, after a "PQ8" magic: a matrix is float
+// scales[rows] then int8 data[rows*cols] padded to 4 bytes, a vector is
+// float data[n]. Matrices smaller than QUANTIZE_MIN_WEIGHTS are stored as
+// float data[rows*cols] and run in fp32.
+// A QWeights made with convert_weights wraps a float Weights and quantizes
+// blocks as layers request them. Build the net once, then save_qweights.
+#define QWEIGHTS_MAGIC 0x00385150
+
+// On small matrices quantizing every input row costs more than the int8
+// GEMM saves. bench_puffernet measured the 128x4 actor, the 32x128 ConvLSTM
+// linear and its 125x32 conv at 0.7-0.9x of fp32, and the 288x32 conv at 1.3x
+#define QUANTIZE_MIN_WEIGHTS 8192
+
+typedef struct QWeights QWeights;
+struct QWeights {
+    Weights* source;
+    char* data;
+    size_t size;
+    size_t capacity;
+    size_t idx;
+};
+
+QWeights* convert_weights(Weights* source) {
+    // Worst case block is a one column matrix: 4 + 4 bytes per float row
+    size_t capacity = 2*source->size*sizeof(float);
+    QWeights* weights = calloc(1, sizeof(QWeights) + capacity);
+    weights->source = source;
+    weights->data = (char*)(weights + 1);
+    weights->capacity = capacity;
+    return weights;
+}
+
+QWeights* load_qweights(const char* filename) {
+    FILE* file = fopen(filename, "rb");
+    if (!file) {
+        perror("Error opening file");
+        return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    rewind(file);
+    int magic = 0;
+    if (fread(&magic, sizeof(int), 1, file) != 1 || magic != QWEIGHTS_MAGIC) {
+        fprintf(stderr, "%s is not an int8 weights file\n", filename);
+        fclose(file);
+        return NULL;
+    }
+    size_t size = file_size - sizeof(int);
+    QWeights* weights = calloc(1, sizeof(QWeights) + size);
+    weights->data = (char*)(weights + 1);
+    weights->size = size;
+    weights->capacity = size;
+    size_t read_size = fread(weights->data, 1, size, file);
+    fclose(file);
+    if (read_size != size) {
+        perror("Error reading file");
+        free(weights);
+        return NULL;
+    }
+    return weights;
+}
+
+int save_qweights(QWeights* weights, const char* filename) {
+    FILE* file = fopen(filename, "wb");
+    if (!file) {
+        perror("Error opening file");
+        return 1;
+    }
+    int magic = QWEIGHTS_MAGIC;
+    fwrite(&magic, sizeof(int), 1, file);
+    size_t written = fwrite(weights->data, 1, weights->size, file);
+    fclose(file);
+    return written != weights->size;
+}
+
+void* _qweights_block(QWeights* weights, size_t bytes) {
+    void* block = weights->data + weights->idx;
+    weights->idx += bytes;
+    if (weights->source) {
+        assert(weights->idx <= weights->capacity);
+        weights->size = weights->idx;
+    }
+    assert(weights->idx <= weights->size);
+    return block;
+}
+
+int8_t* get_qmatrix(QWeights* weights, int rows, int cols, float** scales) {
+    *scales = _qweights_block(weights, rows*sizeof(float));
+    int8_t* data = _qweights_block(weights, ((size_t)rows*cols + 3) & ~(size_t)3);
+    if (weights->source) {
+        _quantize_rows(get_weights(weights->source, rows*cols), data, *scales, rows, cols);
+    }
+    return data;
+}
+
+float* get_qvector(QWeights* weights, int n) {
+    float* data = _qweights_block(weights, n*sizeof(float));
+    if (weights->source) {
+        memcpy(data, get_weights(weights->source, n), n*sizeof(float));
+    }
+    return data;
+}
+
+// Reads a matrix in whichever format its size calls for. Exactly one
+// of the int8 and fp32 pointers is set
+void get_qmatrix_or_fp32(QWeights* weights, int rows, int cols,
+        int8_t** data, float** scales, float** fp32) {
+    *data = NULL;
+    *scales = NULL;
+    *fp32 = NULL;
+    if ((size_t)rows*cols < QUANTIZE_MIN_WEIGHTS) {
+        *fp32 = get_qvector(weights, rows*cols);
+    } else {
+        *data = get_qmatrix(weights, rows, cols, scales);
+    }
+}
+
+// input_q and input_scales are scratch of batch_size*input_dim and batch_size
+void _qlinear(float* input, int8_t* weights, float* weight_scales, float* bias,
+        float* output, int8_t* input_q, float* input_scales,
+        int batch_size, int input_dim, int output_dim, int accumulate) {
+    _quantize_rows(input, input_q, input_scales, batch_size, input_dim);
+    _qgemm(input_q, input_scales, weights, weight_scales, bias, output,
+        batch_size, output_dim, input_dim, output_dim, 1, accumulate);
+}
+
+typedef struct QLinear QLinear;
+struct QLinear {
+    float* output;
+    int8_t* weights;
+    float* weight_scales;
+    float* weights_fp32;
+    float* bias;
+    int8_t* input_q;
+    float* input_scales;
+    int batch_size;
+    int input_dim;
+    int output_dim;
+};
+
+QLinear* make_qlinear(QWeights* weights, int batch_size, int input_dim, int output_dim) {
+    size_t buffer_size = batch_size*(output_dim + 1)*sizeof(float) + batch_size*input_dim;
+    QLinear* layer = calloc(1, sizeof(QLinear) + buffer_size);
+    float* output = (float*)(layer + 1);
+    *layer = (QLinear){
+        .output = output,
+        .input_scales = output + batch_size*output_dim,
+        .input_q = (int8_t*)(output + batch_size*(output_dim + 1)),
+        .batch_size = batch_size,
+        .input_dim = input_dim,
+        .output_dim = output_dim,
+    };
+    get_qmatrix_or_fp32(weights, output_dim, input_dim, &layer->weights,
+        &layer->weight_scales, &layer->weights_fp32);
+    layer->bias = get_qvector(weights, output_dim);
+    return layer;
+}
+
+void qlinear(QLinear* layer, float* input) {
+    if (layer->weights_fp32) {
+        _linear(input, layer->weights_fp32, layer->bias, layer->output,
+            layer->batch_size, layer->input_dim, layer->output_dim);
+        return;
+    }
+    _qlinear(input, layer->weights, layer->weight_scales, layer->bias, layer->output,
+        layer->input_q, layer->input_scales, layer->batch_size, layer->input_dim,
+        layer->output_dim, 0);
+}
+
+typedef struct QConv2D QConv2D;
+struct QConv2D {
+    float* output;
+    float* buffer;
+    int8_t* weights;
+    float* weight_scales;
+    float* weights_fp32;
+    float* bias;
+    int batch_size;
+    int in_width;
+    int in_height;
+    int in_channels;
+    int out_channels;
+    int kernel_size;
+    int stride;
+};
+
+// Floats of scratch _qconv2d needs: im2col rows, their scales, the GEMM
+// output and the quantized rows. Also covers _conv2d for the fp32 fallback
+size_t _qconv2d_buffer_size(int batch_size, int in_width, int in_height,
+        int in_channels, int out_channels, int kernel_size, int stride) {
+    int h_out = (in_height - kernel_size)/stride + 1;
+    int w_out = (in_width - kernel_size)/stride + 1;
+    int positions = h_out*w_out;
+    size_t K = in_channels*kernel_size*kernel_size;
+    size_t rows = (size_t)_conv_chunk(batch_size, positions)*positions;
+    return rows*(K + 1 + out_channels) + (rows*K + 3)/4;
+}
+
+QConv2D* make_qconv2d(QWeights* weights, int batch_size, int in_width, int in_height,
+        int in_channels, int out_channels, int kernel_size, int stride) {
+    size_t output_size = batch_size*out_channels*in_height*in_width;
+    size_t buffer_size = (output_size + _qconv2d_buffer_size(batch_size, in_width,
+        in_height, in_channels, out_channels, kernel_size, stride))*sizeof(float);
+    QConv2D* layer = calloc(1, sizeof(QConv2D) + buffer_size);
+    *layer = (QConv2D){
+        .output = (float*)(layer + 1),
+        .buffer = (float*)(layer + 1) + output_size,
+        .batch_size = batch_size,
+        .in_width = in_width,
+        .in_height = in_height,
+        .in_channels = in_channels,
+        .out_channels = out_channels,
+        .kernel_size = kernel_size,
+        .stride = stride,
+    };
+    get_qmatrix_or_fp32(weights, out_channels, in_channels*kernel_size*kernel_size,
+        &layer->weights, &layer->weight_scales, &layer->weights_fp32);
+    layer->bias = get_qvector(weights, out_channels);
+    return layer;
+}
+
+// Same chunked im2col lowering as _conv2d, with each receptive field
+// row quantized with its own scale
+void _qconv2d(float* input, int8_t* weights, float* weight_scales, float* bias,
+        float* output, float* buffer, int batch_size, int in_width, int in_height,
+        int in_channels, int out_channels, int kernel_size, int stride) {
+    int h_out = (in_height - kernel_size)/stride + 1;
+    int w_out = (in_width - kernel_size)/stride + 1;
+    int positions = h_out*w_out;
+    int K = in_channels*kernel_size*kernel_size;
+    int in_size = in_channels*in_height*in_width;
+    int chunk = _conv_chunk(batch_size, positions);
+
+    size_t rows = (size_t)chunk*positions;
+    float* col = buffer;
+    float* col_scales = col + rows*K;
+    float* gemm_out = col_scales + rows;
+    int8_t* col_q = (int8_t*)(gemm_out + rows*out_channels);
+    for (int b0 = 0; b0 < batch_size; b0 += chunk) {
+        int n = (batch_size - b0 < chunk) ? batch_size - b0 : chunk;
+        for (int b = 0; b < n; b++) {
+            _im2col2d(input + (b0 + b)*in_size, col + b*positions*K, in_width,
+                in_height, in_channels, kernel_size, stride, h_out, w_out);
+        }
+        _quantize_rows(col, col_q, col_scales, n*positions, K);
+        _qgemm(col_q, col_scales, weights, weight_scales, bias, gemm_out,
+            n*positions, out_channels, K, out_channels, 1, 0);
+        _scatter_channels(gemm_out, output + b0*out_channels*positions,
+            n, positions, out_channels);
+    }
+}
+
+void qconv2d(QConv2D* layer, float* input) {
+    if (layer->weights_fp32) {
+        _conv2d(input, layer->weights_fp32, layer->bias, layer->output, layer->buffer,
+            layer->batch_size, layer->in_width, layer->in_height,
+            layer->in_channels, layer->out_channels, layer->kernel_size, layer->stride);
+        return;
+    }
+    _qconv2d(input, layer->weights, layer->weight_scales, layer->bias, layer->output,
+        layer->buffer, layer->batch_size, layer->in_width, layer->in_height,
+        layer->in_channels, layer->out_channels, layer->kernel_size, layer->stride);
+}
+
+// Input and state projections in int8. Gates and cell state stay float
+typedef struct QLSTM QLSTM;
+struct QLSTM {
+    float* state_h;
+    float* state_c;
+    int8_t* weights_input;
+    float* scales_input;
+    float* weights_input_fp32;
+    int8_t* weights_state;
+    float* scales_state;
+    float* weights_state_fp32;
+    float* bias_input;
+    float* bias_state;
+    float* buffer;
+    int8_t* input_q;
+    float* input_scales;
+    int batch_size;
+    int input_size;
+    int hidden_size;
+};
+
+QLSTM* make_qlstm(QWeights* weights, int batch_size, int input_size, int hidden_size) {
+    int state_size = batch_size*hidden_size;
+    int q_size = batch_size*(input_size > hidden_size ? input_size : hidden_size);
+    size_t buffer_size = (6*state_size + batch_size)*sizeof(float) + q_size;
+    QLSTM* layer = calloc(1, sizeof(QLSTM) + buffer_size);
+    float* buffer = (float*)(layer + 1);
+    *layer = (QLSTM){
+        .state_h = buffer,
+        .state_c = buffer + state_size,
+        .buffer = buffer + 2*state_size,
+        .input_scales = buffer + 6*state_size,
+        .input_q = (int8_t*)(buffer + 6*state_size + batch_size),
+        .batch_size = batch_size,
+        .input_size = input_size,
+        .hidden_size = hidden_size,
+    };
+    get_qmatrix_or_fp32(weights, 4*hidden_size, input_size, &layer->weights_input,
+        &layer->scales_input, &layer->weights_input_fp32);
+    get_qmatrix_or_fp32(weights, 4*hidden_size, hidden_size, &layer->weights_state,
+        &layer->scales_state, &layer->weights_state_fp32);
+    layer->bias_input = get_qvector(weights, 4*hidden_size);
+    layer->bias_state = get_qvector(weights, 4*hidden_size);
+    return layer;
+}
+
+void qlstm(QLSTM* layer, float* input) {
+    int hidden_size = layer->hidden_size;
+    if (layer->weights_input_fp32) {
+        _linear(input, layer->weights_input_fp32, layer->bias_input, layer->buffer,
+            layer->batch_size, layer->input_size, 4*hidden_size);
+    } else {
+        _qlinear(input, layer->weights_input, layer->scales_input, layer->bias_input,
+            layer->buffer, layer->input_q, layer->input_scales, layer->batch_size,
+            layer->input_size, 4*hidden_size, 0);
+    }
+    if (layer->weights_state_fp32) {
+        _linear_accumulate(layer->state_h, layer->weights_state_fp32, layer->bias_state,
+            layer->buffer, layer->batch_size, hidden_size, 4*hidden_size);
+    } else {
+        _qlinear(layer->state_h, layer->weights_state, layer->scales_state, layer->bias_state,
+            layer->buffer, layer->input_q, layer->input_scales, layer->batch_size,
+            hidden_size, 4*hidden_size, 1);
+    }
+    _lstm_gates(layer->buffer, layer->state_h, layer->state_c,
+        layer->batch_size, hidden_size);
+}
+
+// Int8 counterpart of LinearLSTM. Reads the same weights, either a float
+// Weights through convert_weights or a file from save_qweights
+typedef struct QLinearLSTM QLinearLSTM;
+struct QLinearLSTM {
+    int num_agents;
+    QLinear* encoder;
+    GELU* gelu1;
+    QLSTM* lstm;
+    QLinear* actor;
+    QLinear* value_fn;
+    Multidiscrete* multidiscrete;
+};
+
+QLinearLSTM* make_qlinearlstm(QWeights* weights, int num_agents, int input_dim,
+        int logit_sizes[], int num_actions) {
+    QLinearLSTM* net = calloc(1, sizeof(QLinearLSTM));
+    net->num_agents = num_agents;
+    net->encoder = make_qlinear(weights, num_agents, input_dim, 128);
+    net->gelu1 = make_gelu(num_agents, 128);
+    int atn_sum = 0;
+    for (int i = 0; i < num_actions; i++) {
+        atn_sum += logit_sizes[i];
+    }
+    net->actor = make_qlinear(weights, num_agents, 128, atn_sum);
+    net->value_fn = make_qlinear(weights, num_agents, 128, 1);
+    net->lstm = make_qlstm(weights, num_agents, 128, 128);
+    net->multidiscrete = make_multidiscrete(num_agents, logit_sizes, num_actions);
+    return net;
+}
+
+void free_qlinearlstm(QLinearLSTM* net) {
+    free(net->encoder);
+    free(net->gelu1);
+    free(net->actor);
+    free(net->value_fn);
+    free(net->lstm);
+    free(net->multidiscrete);
+    free(net);
+}
+
+void forward_qlinearlstm(QLinearLSTM* net, float* observations, int* actions) {
+    qlinear(net->encoder, observations);
+    gelu(net->gelu1, net->encoder->output);
+    qlstm(net->lstm, net->gelu1->output);
+    qlinear(net->actor, net->lstm->state_h);
+    qlinear(net->value_fn, net->lstm->state_h);
+    softmax_multidiscrete(net->multidiscrete, net->actor->output, actions);
+}
+
+// Int8 counterpart of the LinearContLSTM in drone_pp.c and drone_race.c.
+// The weights start with one log std per action, then the LinearLSTM layers.
+// forward writes the Gaussian means to actions. Callers sample around them
+// with expf(log_std[i]) the way those envs do, so the noise stays theirs
+typedef struct QLinearContLSTM QLinearContLSTM;
+struct QLinearContLSTM {
+    int num_agents;
+    int num_actions;
+    float* log_std;
+    QLinear* encoder;
+    GELU* gelu1;
+    QLSTM* lstm;
+    QLinear* actor;
+    QLinear* value_fn;
+};
+
+QLinearContLSTM* make_qlinearcontlstm(QWeights* weights, int num_agents, int input_dim,
+        int logit_sizes[], int num_actions) {
+    QLinearContLSTM* net = calloc(1, sizeof(QLinearContLSTM));
+    net->num_agents = num_agents;
+    net->num_actions = logit_sizes[0];
+    net->log_std = get_qvector(weights, net->num_actions);
+    net->encoder = make_qlinear(weights, num_agents, input_dim, 128);
+    net->gelu1 = make_gelu(num_agents, 128);
+    int atn_sum = 0;
+    for (int i = 0; i < num_actions; i++) {
+        atn_sum += logit_sizes[i];
+    }
+    net->actor = make_qlinear(weights, num_agents, 128, atn_sum);
+    net->value_fn = make_qlinear(weights, num_agents, 128, 1);
+    net->lstm = make_qlstm(weights, num_agents, 128, 128);
+    return net;
+}
+
+void free_qlinearcontlstm(QLinearContLSTM* net) {
+    free(net->encoder);
+    free(net->gelu1);
+    free(net->actor);
+    free(net->value_fn);
+    free(net->lstm);
+    free(net);
+}
+
+void forward_qlinearcontlstm(QLinearContLSTM* net, float* observations, float* actions) {
+    qlinear(net->encoder, observations);
+    gelu(net->gelu1, net->encoder->output);
+    qlstm(net->lstm, net->gelu1->output);
+    qlinear(net->actor, net->lstm->state_h);
+    qlinear(net->value_fn, net->lstm->state_h);
+    memcpy(actions, net->actor->output, net->num_agents*net->num_actions*sizeof(float));
+}
@@ -19,11 +19,15 @@ cdef extern from "puffernet.h":
         int batch_size, int input_dim, int output_dim)
     void _relu(float* input, float* output,int size)
     float _sigmoid(float x)
-    void _conv2d(float* input, float* weights, float* bias,
-        float* output, int batch_size, int in_width, int in_height,
+    size_t _conv2d_buffer_size(int batch_size, int in_width, int in_height,
         int in_channels, int out_channels, int kernel_size, int stride)
-    void _conv3d(float* input, float* weights, float* bias,
-        float* output, int batch_size, int in_width, int in_height, int in_depth,
+    void _conv2d(float* input, float* weights, float* bias, float* output,
+        float* buffer, int batch_size, int in_width, int in_height,
+        int in_channels, int out_channels, int kernel_size, int stride)
+    size_t _conv3d_buffer_size(int batch_size, int in_width, int in_height, int in_depth,
+        int in_channels, int out_channels, int kernel_size, int stride)
+    void _conv3d(float* input, float* weights, float* bias, float* output,
+        float* buffer, int batch_size, int in_width, int in_height, int in_depth,
         int in_channels, int out_channels, int kernel_size, int stride)
     void _embedding(int* input, float* weights, float* output,
         int batch_size, int num_embeddings, int embedding_dim)
@@ -53,16 +57,20 @@ def puf_sigmoid(float x):
 def puf_convolution_layer(cnp.ndarray input, cnp.ndarray weights, cnp.ndarray bias,
         cnp.ndarray output, int batch_size, int in_width, int in_height,
         int in_channels, int out_channels, int kernel_size, int stride):
+    cdef cnp.ndarray buffer = np.empty(_conv2d_buffer_size(batch_size, in_width,
+        in_height, in_channels, out_channels, kernel_size, stride), dtype=np.float32)
     _conv2d(<float*> input.data, <float*> weights.data, <float*> bias.data,
-        <float*> output.data, batch_size, in_width, in_height, in_channels, out_channels,
-        kernel_size, stride)
+        <float*> output.data, <float*> buffer.data, batch_size, in_width, in_height,
+        in_channels, out_channels, kernel_size, stride)
 
 def puf_convolution_3d_layer(cnp.ndarray input, cnp.ndarray weights, cnp.ndarray bias,
         cnp.ndarray output, int batch_size, int in_width, int in_height, int in_depth,
         int in_channels, int out_channels, int kernel_size, int stride):
+    cdef cnp.ndarray buffer = np.empty(_conv3d_buffer_size(batch_size, in_width,
+        in_height, in_depth, in_channels, out_channels, kernel_size, stride), dtype=np.float32)
     _conv3d(<float*> input.data, <float*> weights.data, <float*> bias.data,
-        <float*> output.data, batch_size, in_width, in_height, in_depth, in_channels, out_channels,
-        kernel_size, stride)
+        <float*> output.data, <float*> buffer.data, batch_size, in_width, in_height, in_depth,
+        in_channels, out_channels, kernel_size, stride)
 
 def puf_lstm(cnp.ndarray input, cnp.ndarray state_h, cnp.ndarray state_c, cnp.ndarray weights_input,
         cnp.ndarray weights_state, cnp.ndarray bias_input, cnp.ndarray bias_state,
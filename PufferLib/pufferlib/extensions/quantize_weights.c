@@ -0,0 +1,80 @@
+// Converts an exported float .bin of a LinearLSTM policy to the int8 format
+// read by load_qweights and make_qlinearlstm. With --continuous it converts
+// the LinearContLSTM of drone_pp and drone_race for make_qlinearcontlstm,
+// which has one log std per action ahead of the same layers. The float file
+// has no header, so the net shape is passed on the command line and the file
+// size is checked against it.
+// Build: gcc -O2 -I./pufferlib/extensions pufferlib/extensions/quantize_weights.c -o quantize_weights -lm
+// Run: ./quantize_weights [--continuous] policy.bin policy_int8.bin input_dim logit_size [logit_size ...]
+#include "puffernet.h"
+
+int main(int argc, char** argv) {
+    const char* program = argv[0];
+    int continuous = argc > 1 && strcmp(argv[1], "--continuous") == 0;
+    if (continuous) {
+        argv++;
+        argc--;
+    }
+    if (argc < 5) {
+        fprintf(stderr, "Usage: %s [--continuous] in.bin out.bin input_dim logit_size [logit_size ...]\n",
+            program);
+        return 1;
+    }
+    const char* in_path = argv[1];
+    const char* out_path = argv[2];
+    int input_dim = atoi(argv[3]);
+    int num_actions = argc - 4;
+    int* logit_sizes = calloc(num_actions, sizeof(int));
+    int atn_sum = 0;
+    for (int i = 0; i < num_actions; i++) {
+        logit_sizes[i] = atoi(argv[4 + i]);
+        atn_sum += logit_sizes[i];
+    }
+    if (input_dim <= 0 || atn_sum <= 0) {
+        fprintf(stderr, "input_dim and logit sizes must be positive\n");
+        return 1;
+    }
+
+    // Same layers and order as make_linearlstm, after the log stds of
+    // make_qlinearcontlstm when continuous
+    size_t num_weights = 128*(size_t)input_dim + 128 + atn_sum*128 + atn_sum
+        + 128 + 1 + 4*128*128 + 4*128*128 + 8*128;
+    if (continuous) {
+        num_weights += logit_sizes[0];
+    }
+    FILE* file = fopen(in_path, "rb");
+    if (!file) {
+        perror("Error opening file");
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long file_size = ftell(file);
+    fclose(file);
+    if (file_size != (long)(num_weights*sizeof(float))) {
+        fprintf(stderr, "%s has %ld bytes, a %s with input_dim %d and %d logits needs %zu\n",
+            in_path, file_size, continuous ? "LinearContLSTM" : "LinearLSTM",
+            input_dim, atn_sum, num_weights*sizeof(float));
+        return 1;
+    }
+
+    Weights* weights = load_weights(in_path, num_weights);
+    QWeights* converted = convert_weights(weights);
+    // Building the net quantizes its layers into converted
+    if (continuous) {
+        free_qlinearcontlstm(make_qlinearcontlstm(converted, 1, input_dim, logit_sizes, num_actions));
+    } else {
+        free_qlinearlstm(make_qlinearlstm(converted, 1, input_dim, logit_sizes, num_actions));
+    }
+    int err = save_qweights(converted, out_path);
+    if (err) {
+        fprintf(stderr, "Error writing %s\n", out_path);
+    } else {
+        printf("%s: %zu -> %zu bytes\n", out_path, num_weights*sizeof(float),
+            converted->size + sizeof(int));
+    }
+
+    free(converted);
+    free(weights);
+    free(logit_sizes);
+    return err;
+}
@@ -23,7 +23,7 @@ int main() {
         env.actions[0] = -1;
       }
     } else {
-      env.actions[0] = rand() % 4;
+      env.actions[0] = puffer_randint(&env.rng, 0, 4);
     }
     c_step(&env);
     c_render(&env);
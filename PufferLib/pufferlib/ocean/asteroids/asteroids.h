@@ -5,6 +5,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../rng.h"
 
 #define MAX_PARTICLES 10
 #define MAX_ASTEROIDS 20
@@ -59,6 +60,7 @@ typedef struct {
 
 typedef struct {
   Log log;
+  PufferRng rng;
   float *observations;
   int *actions;
   float *rewards;
@@ -80,17 +82,17 @@ typedef struct {
   int frameskip;
 } Asteroids;
 
-float random_float(float low, float high) {
-  return low + (high - low) * ((float)rand() / (float)RAND_MAX);
+float random_float(PufferRng* rng, float low, float high) {
+  return low + (high - low) * ((float)puffer_rand(rng) / (float)RAND_MAX);
 }
 
-void generate_asteroid_shape(Asteroid *as) {
+void generate_asteroid_shape(PufferRng* rng, Asteroid *as) {
   as->num_vertices = 8 + (as->radius / 10);
 
   for (int v = 0; v < as->num_vertices; v++) {
     float angle = (2.0f * PI * v) / as->num_vertices;
     float radius_variation =
-        as->radius * (0.7f + 0.6f * random_float(0.0f, 1.0f));
+        as->radius * (0.7f + 0.6f * random_float(rng, 0.0f, 1.0f));
     as->shape[v].x = cosf(angle) * radius_variation;
     as->shape[v].y = sinf(angle) * radius_variation;
   }
@@ -158,38 +160,38 @@ Vector2 angle_to_vector(float angle) {
 void spawn_asteroids(Asteroids *env) {
   float px, py;
   float angle;
-  if (rand() % 10 == 0) {
-    switch (rand() % 4) {
+  if (puffer_randint(&env->rng, 0, 10) == 0) {
+    switch (puffer_randint(&env->rng, 0, 4)) {
     case 0:
       // left edge
       px = 0;
-      py = rand() % env->size;
-      angle = random_float(-PI / 2, PI / 2);
+      py = puffer_randint(&env->rng, 0, env->size);
+      angle = random_float(&env->rng, -PI / 2, PI / 2);
       break;
     case 1:
       // right edge
       px = env->size;
-      py = rand() % env->size;
-      angle = random_float(PI / 2, 3 * PI / 2);
+      py = puffer_randint(&env->rng, 0, env->size);
+      angle = random_float(&env->rng, PI / 2, 3 * PI / 2);
       break;
     case 2:
       // top edge
-      px = rand() % env->size;
+      px = puffer_randint(&env->rng, 0, env->size);
       py = 0;
-      angle = random_float(PI, 2 * PI);
+      angle = random_float(&env->rng, PI, 2 * PI);
       break;
     default:
       // bottom edge
-      px = rand() % env->size;
+      px = puffer_randint(&env->rng, 0, env->size);
       py = env->size;
-      angle = random_float(0, PI);
+      angle = random_float(&env->rng, 0, PI);
       break;
     }
 
     Vector2 direction = angle_to_vector(angle);
     Vector2 start_pos = (Vector2){px, py};
     Asteroid as;
-    switch (rand() % 3) {
+    switch (puffer_randint(&env->rng, 0, 3)) {
     case 0:
       // small
       as = (Asteroid){start_pos, direction, 10, 100};
@@ -206,7 +208,7 @@ void spawn_asteroids(Asteroids *env) {
     env->asteroid_index = (env->asteroid_index + 1) % MAX_ASTEROIDS;
     env->asteroids[env->asteroid_index] = as;
     if (global_render_flag)
-      generate_asteroid_shape(&env->asteroids[env->asteroid_index]);
+      generate_asteroid_shape(&env->rng, &env->asteroids[env->asteroid_index]);
   }
 }
 
@@ -221,8 +223,8 @@ void split_asteroid(Asteroids *env, Asteroid *as) {
 
   float original_angle = atan2f(as->velocity.y, as->velocity.x);
 
-  float offset1 = random_float(-PI / 4, PI / 4);
-  float offset2 = random_float(-PI / 4, PI / 4);
+  float offset1 = random_float(&env->rng, -PI / 4, PI / 4);
+  float offset2 = random_float(&env->rng, -PI / 4, PI / 4);
 
   float angle1 = original_angle + offset1;
   float angle2 = original_angle + offset2;
@@ -254,8 +256,8 @@ void split_asteroid(Asteroids *env, Asteroid *as) {
   env->asteroid_index = new_index2;
 
   // Generate shapes for the new asteroids
-  generate_asteroid_shape(as);
-  generate_asteroid_shape(&env->asteroids[new_index1]);
+  generate_asteroid_shape(&env->rng, as);
+  generate_asteroid_shape(&env->rng, &env->asteroids[new_index1]);
 }
 
 void check_particle_asteroid_collision(Asteroids *env) {
@@ -14,6 +14,7 @@
 #include "raymath.h"
 #include "rlgl.h"
 #include "simplex.h"
+#include "../rng.h"
 
 #define RLIGHTS_IMPLEMENTATION
 #include "rlights.h"
@@ -65,12 +66,12 @@ float clip_angle(float theta) {
     return theta;
 }
 
-float randf(float min, float max) {
-    return min + (max - min)*(float)rand()/(float)RAND_MAX;
+float randf(PufferRng* rng, float min, float max) {
+    return min + (max - min)*(float)puffer_rand(rng)/(float)RAND_MAX;
 }
 
-float randi(int min, int max) {
-    return min + (max - min)*(float)rand()/(float)RAND_MAX;
+float randi(PufferRng* rng, int min, int max) {
+    return min + (max - min)*(float)puffer_rand(rng)/(float)RAND_MAX;
 }
 
 typedef struct {
@@ -118,11 +119,37 @@ typedef struct {
     float episode_return;
 } Entity;
 
+// Uniform grid over the x/z extent of the arena for nearest enemy queries,
+// rebuilt by compute_observations. Units are counting sorted by cell with
+// packed copies of their positions and armies, so a query reads each cell
+// contiguously. Cells hold about UNIT_GRID_PER_CELL units when spread out
+#define UNIT_GRID_PER_CELL 4
+
+typedef struct {
+    float x;
+    float y;
+    float z;
+    int army;
+} GridUnit;
+
+typedef struct {
+    int n_x;
+    int n_z;
+    float cell_x;
+    float cell_z;
+    int* cell_start; // [n_x*n_z + 1] first sorted slot of each cell
+    int* sorted; // [num_agents] agent in each sorted slot
+    GridUnit* units; // [num_agents] copy of the agent in each sorted slot
+    int* cell; // [num_agents] scratch for the counting sort
+} UnitGrid;
+
 typedef struct {
     Log log;
+    PufferRng rng;
     Client* client;
     Entity* agents;
     Entity* bases;
+    float* base_dists; // [num_armies] scratch for compute_observations
     float* observations;
     float* actions;
     float* rewards;
@@ -137,6 +164,7 @@ typedef struct {
     int num_agents;
     int num_armies;
     float* terrain;
+    UnitGrid grid;
 } Battle;
 
 int map_idx(Battle* env, float x, float y) {
@@ -200,10 +228,25 @@ void perlin_noise(float* map, int width, int height,
 void init(Battle* env) {
     env->agents = calloc(env->num_agents, sizeof(Entity));
     env->bases = calloc(env->num_armies, sizeof(Entity));
+    env->base_dists = calloc(env->num_armies, sizeof(float));
     env->terrain_width = 256*env->size_x;
     env->terrain_height = 256*env->size_z;
     env->terrain = calloc(env->terrain_width*env->terrain_height, sizeof(float));
     perlin_noise(env->terrain, env->terrain_width, env->terrain_height, 1.0/2048.0, 8, 0, 0, 256);
+
+    // Roughly square cells over the arena
+    UnitGrid* grid = &env->grid;
+    int cells = env->num_agents/UNIT_GRID_PER_CELL;
+    grid->n_x = sqrtf(cells*env->size_x/env->size_z);
+    grid->n_x = (grid->n_x < 1) ? 1 : grid->n_x;
+    grid->n_z = cells/grid->n_x;
+    grid->n_z = (grid->n_z < 1) ? 1 : grid->n_z;
+    grid->cell_x = 2.0f*env->size_x/grid->n_x;
+    grid->cell_z = 2.0f*env->size_z/grid->n_z;
+    grid->cell_start = calloc(grid->n_x*grid->n_z + 1, sizeof(int));
+    grid->sorted = calloc(env->num_agents, sizeof(int));
+    grid->units = calloc(env->num_agents, sizeof(GridUnit));
+    grid->cell = calloc(env->num_agents, sizeof(int));
 }
 
 void update_abilities(Entity* agent) {
@@ -479,9 +522,9 @@ void scripted_move(Battle* env, Entity* agent, bool is_air) {
     float dz = target->z - agent->z;
 
     // Add some noise
-    dx += randf(-0.1f, 0.1f);
-    dy += randf(-0.1f, 0.1f);
-    dz += randf(-0.1f, 0.1f);
+    dx += randf(&env->rng, -0.1f, 0.1f);
+    dy += randf(&env->rng, -0.1f, 0.1f);
+    dz += randf(&env->rng, -0.1f, 0.1f);
 
     float dd = dx*dx + dz*dz;
     if (is_air) {
@@ -610,37 +653,122 @@ void move_ship(Battle* env, Entity* agent, float* actions, int i) {
     agent->z = clampf(agent->z, -env->size_z, env->size_z);
 }
 
-typedef struct {
-    float distance;
-    float dx;
-    float dy;
-    float dz;
-    float same_team;
-    int idx;
-} AgentObs;
-
-int compare_agent_obs(const void* a, const void* b) {
-    AgentObs* oa = (AgentObs*)a;
-    AgentObs* ob = (AgentObs*)b;
-    if (oa->distance < ob->distance) {
-        return -1;
-    } else if (oa->distance > ob->distance) {
-        return 1;
+static inline int grid_coord(float v, float size, float cell, int n) {
+    int c = (v + size)/cell;
+    return (c < 0) ? 0 : (c >= n) ? n - 1 : c;
+}
+
+void build_grid(Battle* env) {
+    UnitGrid* grid = &env->grid;
+    int cells = grid->n_x*grid->n_z;
+    memset(grid->cell_start, 0, (cells + 1)*sizeof(int));
+    for (int i=0; i<env->num_agents; i++) {
+        Entity* agent = &env->agents[i];
+        int cx = grid_coord(agent->x, env->size_x, grid->cell_x, grid->n_x);
+        int cz = grid_coord(agent->z, env->size_z, grid->cell_z, grid->n_z);
+        grid->cell[i] = cz*grid->n_x + cx;
+        grid->cell_start[grid->cell[i] + 1]++;
+    }
+    for (int c=0; c<cells; c++) {
+        grid->cell_start[c + 1] += grid->cell_start[c];
+    }
+    for (int i=0; i<env->num_agents; i++) {
+        Entity* agent = &env->agents[i];
+        int slot = grid->cell_start[grid->cell[i]]++;
+        grid->sorted[slot] = i;
+        grid->units[slot] = (GridUnit){agent->x, agent->y, agent->z, agent->army};
+    }
+    // The scatter advanced each start to the next cell's start
+    for (int c=cells; c>0; c--) {
+        grid->cell_start[c] = grid->cell_start[c - 1];
     }
-    return 0;
+    grid->cell_start[0] = 0;
 }
 
-void compute_observations(Battle* env) {
-    AgentObs agent_obs[env->num_agents];
+// Distance from p to the outside of cells [c - r, c + r] along one axis.
+// Sides on the arena border have no cells past them
+static inline float grid_margin(float p, float size, float cell, int c, int r, int n) {
+    float margin = FLT_MAX;
+    if (c - r > 0) {
+        margin = p - ((c - r)*cell - size);
+    }
+    if (c + r < n - 1) {
+        margin = fminf(margin, (c + r + 1)*cell - size - p);
+    }
+    return margin;
+}
 
+// Writes the indices of the k units nearest to agent that are not in its
+// army to nearest, closest first with ties to the lower index, and
+// returns how many it found. Searches rings of cells outward until the
+// kth best is closer than any cell outside the searched block. k is at
+// most AGENT_OBS
+int nearest_enemies(Battle* env, Entity* agent, int k, int* nearest) {
+    assert(k <= AGENT_OBS);
+    UnitGrid* grid = &env->grid;
+    float dists[AGENT_OBS];
+    int found = 0;
+    int cx = grid_coord(agent->x, env->size_x, grid->cell_x, grid->n_x);
+    int cz = grid_coord(agent->z, env->size_z, grid->cell_z, grid->n_z);
+    int max_r = (grid->n_x > grid->n_z) ? grid->n_x : grid->n_z;
+    for (int r=0; r<max_r; r++) {
+        for (int z=cz - r; z<=cz + r; z++) {
+            if (z < 0 || z >= grid->n_z) {
+                continue;
+            }
+            // Interior rows of the ring only touch its two ends
+            int step = (z == cz - r || z == cz + r || r == 0) ? 1 : 2*r;
+            for (int x=cx - r; x<=cx + r; x+=step) {
+                if (x < 0 || x >= grid->n_x) {
+                    continue;
+                }
+                int cell = z*grid->n_x + x;
+                for (int s=grid->cell_start[cell]; s<grid->cell_start[cell + 1]; s++) {
+                    GridUnit* unit = &grid->units[s];
+                    if (unit->army == agent->army) {
+                        continue;
+                    }
+                    float dx = unit->x - agent->x;
+                    float dy = unit->y - agent->y;
+                    float dz = unit->z - agent->z;
+                    float dd = dx*dx + dy*dy + dz*dz;
+                    int idx = grid->sorted[s];
+                    if (found == k && (dd > dists[k - 1] || (dd == dists[k - 1] && idx > nearest[k - 1]))) {
+                        continue;
+                    }
+                    // Insertion into the sorted top k
+                    int j = (found < k) ? found++ : k - 1;
+                    while (j > 0 && (dists[j - 1] > dd || (dists[j - 1] == dd && nearest[j - 1] > idx))) {
+                        dists[j] = dists[j - 1];
+                        nearest[j] = nearest[j - 1];
+                        j--;
+                    }
+                    dists[j] = dd;
+                    nearest[j] = idx;
+                }
+            }
+        }
+        if (found == k) {
+            float bound = grid_margin(agent->x, env->size_x, grid->cell_x, cx, r, grid->n_x);
+            bound = fminf(bound, grid_margin(agent->z, env->size_z, grid->cell_z, cz, r, grid->n_z));
+            if (bound == FLT_MAX || dists[k - 1] <= bound*bound) {
+                break;
+            }
+        }
+    }
+    return found;
+}
+
+void compute_observations(Battle* env) {
+    build_grid(env);
     int obs_idx = 0;
     for (int a=0; a<env->num_agents/2; a++) {
-        assert(obs_idx == a*(6*env->num_armies + 19 + 8));
+        assert(obs_idx == a*(3*env->num_armies + 4*AGENT_OBS + 22 + 8));
 
         // Distance to each base
         Entity* agent = &env->agents[a];
         int team = agent->army;
-        float dists[env->num_armies];
+        float* dists = env->base_dists;
         for (int i=0; i<env->num_armies; i++) {
             dists[i] = 999999;
         }
@@ -661,36 +789,21 @@ void compute_observations(Battle* env) {
         obs_idx += 3*env->num_armies;
 
 
-        // Distance to each agent. Slow O(n^2) naive implementation
-        float x = agent->x;
-        float y = agent->y;
-        float z = agent->z;
-        for (int i=0; i<env->num_agents; i++) {
-            Entity* other = &env->agents[i];
-            float dx = other->x - x;
-            float dy = other->y - y;
-            float dz = other->z - z;
-            float distance = dx*dx + dy*dy + dz*dz;
-            AgentObs* o = &agent_obs[i];
-            o->dx = dx;
-            o->dy = dy;
-            o->dz = dz;
-            if (other->army == agent->army) {
-                o->same_team = 1.0f;
-                o->distance = 99999.0f;
-            } else {
-                o->same_team = 0.0f;
-                o->distance = distance;
+        // Nearest enemies, then teammates in index order if there are
+        // fewer than AGENT_OBS enemies
+        int nearest[AGENT_OBS];
+        int found = nearest_enemies(env, agent, AGENT_OBS, nearest);
+        for (int i=0; i<env->num_agents && found<AGENT_OBS; i++) {
+            if (env->agents[i].army == agent->army) {
+                nearest[found++] = i;
             }
-            o->idx = i;
         }
-        qsort(agent_obs, env->num_agents, sizeof(AgentObs), compare_agent_obs);
-
         for (int i=0; i<AGENT_OBS; i++) {
-            env->observations[obs_idx++] = agent_obs[i].dx;
-            env->observations[obs_idx++] = agent_obs[i].dy;
-            env->observations[obs_idx++] = agent_obs[i].dz;
-            env->observations[obs_idx++] = agent_obs[i].same_team;
+            Entity* other = &env->agents[nearest[i]];
+            env->observations[obs_idx++] = other->x - agent->x;
+            env->observations[obs_idx++] = other->y - agent->y;
+            env->observations[obs_idx++] = other->z - agent->z;
+            env->observations[obs_idx++] = (other->army == agent->army) ? 1.0f : 0.0f;
         }
 
         // Individual agent stats
@@ -731,8 +844,8 @@ void c_reset(Battle* env) {
         bool spawn = false;
         Entity* base = &env->bases[i];
         while (!spawn) {
-            base->x = randf(0.5 - env->size_x, env->size_x - 0.5);
-            base->z = randf(0.5 - env->size_z, env->size_z - 0.5);
+            base->x = randf(&env->rng, 0.5 - env->size_x, env->size_x - 0.5);
+            base->z = randf(&env->rng, 0.5 - env->size_z, env->size_z - 0.5);
             base->y = ground_height(env, base->x, base->z);
             base->army = i;
             spawn = true;
@@ -885,7 +998,7 @@ void c_step(Battle* env) {
         }
     }
 
-    if (rand() % 9000 == 0) {
+    if (puffer_randint(&env->rng, 0, 9000) == 0) {
         c_reset(env);
     }
 
@@ -1190,6 +1303,11 @@ void c_render(Battle* env) {
 void c_close(Battle* env) {
     free(env->agents);
     free(env->bases);
+    free(env->base_dists);
+    free(env->grid.cell_start);
+    free(env->grid.sorted);
+    free(env->grid.units);
+    free(env->grid.cell);
     if (env->client != NULL) {
         Client* client = env->client;
         //UnloadTexture(client->sprites);
@@ -36,7 +36,7 @@ int demo() {
     allocate(&env, env.num_obs);
     Client* client = make_client(&env);
     unsigned int seed = 12345;
-    srand(seed);
+    puffer_rng_seed(&env.rng, seed);
     c_reset(&env);
     int running = 1;
     while (running) {
@@ -64,12 +64,12 @@ void perftest(float test_time) {
     };
     allocate(&env, env.num_obs);
     unsigned int seed = 12345;
-    srand(seed);
+    puffer_rng_seed(&env.rng, seed);
     c_reset(&env);
     int start = time(NULL);
     int steps = 0;
     while (time(NULL) - start < test_time) {
-        env.actions[0] = rand() % ACTIONS_SIZE;  // Random actions
+        env.actions[0] = puffer_randint(&env.rng, 0, ACTIONS_SIZE);  // Random actions
         c_step(&env);
         steps++;
     }
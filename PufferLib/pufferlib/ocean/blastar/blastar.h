@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include "../rng.h"
 
 #include "raylib.h"
 
@@ -89,6 +90,7 @@ typedef struct Blastar {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    PufferRng rng;
 } Blastar;
 
 void add_log(Blastar* env) {
@@ -113,8 +115,8 @@ void c_reset(Blastar* env) {
     env->player.player_speed = 2.0f;
     env->enemy.enemy_speed = 1.0f;
     scale_speeds(env);
-    env->player.x = (float)(rand() % (SCREEN_WIDTH - PLAYER_WIDTH));
-    env->player.y = (float)(rand() % (SCREEN_HEIGHT - PLAYER_HEIGHT));
+    env->player.x = (float)puffer_randint(&env->rng, 0, SCREEN_WIDTH - PLAYER_WIDTH);
+    env->player.y = (float)puffer_randint(&env->rng, 0, SCREEN_HEIGHT - PLAYER_HEIGHT);
     env->player.score = 0;
     env->player.lives = PLAYER_MAX_LIVES;
     env->player.bullet_fired = false;
@@ -231,9 +233,9 @@ void c_step(Blastar* env) {
         if (env->enemy_explosion_timer == 0) {
             env->enemy.crossed_screen = 0;
             float respawn_bias = 0.1f;
-            if ((float)rand() / (float)RAND_MAX > respawn_bias) {
+            if ((float)puffer_rand(&env->rng) / (float)RAND_MAX > respawn_bias) {
                 env->enemy.x = -ENEMY_WIDTH;
-                env->enemy.y = rand() % (SCREEN_HEIGHT - ENEMY_HEIGHT);
+                env->enemy.y = puffer_randint(&env->rng, 0, SCREEN_HEIGHT - ENEMY_HEIGHT);
                 env->enemy_respawns += 1;
             }
             env->enemy.active = true;
@@ -290,7 +292,7 @@ void c_step(Blastar* env) {
     if (fabs(player_center_x - enemy_center_x) < SPEED_SCALE &&
         !env->enemy.attacking && env->enemy.active &&
         env->enemy.y < env->player.y - (ENEMY_HEIGHT / 2)) {
-        if (rand() % 2 == 0) {
+        if (puffer_randint(&env->rng, 0, 2) == 0) {
             env->enemy.attacking = true;
             if (!env->enemy.bullet.active) {
                 env->enemy.bullet.active = true;
@@ -321,7 +323,7 @@ void c_step(Blastar* env) {
         env->enemy.active = false;
         env->enemy_explosion_timer = 30;
         env->enemy.x = -ENEMY_WIDTH;
-        env->enemy.y = rand() % (SCREEN_HEIGHT - ENEMY_HEIGHT);
+        env->enemy.y = puffer_randint(&env->rng, 0, SCREEN_HEIGHT - ENEMY_HEIGHT);
         env->player_explosion_timer = 30;
         env->player.player_stuck = false;
 
@@ -363,7 +365,7 @@ void c_step(Blastar* env) {
         env->player.player_stuck = false;
         env->enemy.attacking = false;
         env->enemy.x = -ENEMY_WIDTH;
-        env->enemy.y = rand() % (SCREEN_HEIGHT - ENEMY_HEIGHT);
+        env->enemy.y = puffer_randint(&env->rng, 0, SCREEN_HEIGHT - ENEMY_HEIGHT);
 
         if (env->player.lives <= 0) {
             env->player.lives = 0;
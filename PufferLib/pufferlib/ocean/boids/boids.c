@@ -14,8 +14,8 @@
 void generate_dummy_actions(Boids* env) {
     for (unsigned int i = 0; i < env->num_boids; ++i) {
         // Generate random floats in [-1, 1] range
-        float rand_vx = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
-        float rand_vy = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+        float rand_vx = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 2.0f - 1.0f;
+        float rand_vy = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 2.0f - 1.0f;
         
         // Scale to the action space [-ACTION_SCALE, ACTION_SCALE]
         env->actions[i * 2 + 0] = rand_vx * ACTION_SCALE;
@@ -26,6 +26,7 @@ void generate_dummy_actions(Boids* env) {
 void demo() {
     // Initialize Boids environment struct
     Boids env = {0}; 
+    puffer_rng_seed(&env.rng, time(NULL)); // Seed random number generator
     env.num_boids = NUM_BOIDS_DEMO;
     
     // In the Python binding, these pointers are assigned from NumPy arrays.
@@ -74,7 +75,6 @@ void demo() {
 }
 
 int main() {
-    srand(time(NULL)); // Seed random number generator
     demo();
     return 0;
 }
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <limits.h>
 #include <stdbool.h>
+#include "../rng.h"
 
 #include "raylib.h"
 
@@ -57,6 +58,7 @@ typedef struct {
     float matching_factor;
     unsigned tick;
     Log log;
+    PufferRng rng;
     Log* boid_logs;
     unsigned report_interval;
     Client* client;
@@ -66,11 +68,11 @@ typedef struct {
 static inline float flmax(float a, float b) { return a > b ? a : b; }
 static inline float flmin(float a, float b) { return a > b ? b : a; }
 static inline float flclip(float x,float lo,float hi) { return flmin(hi,flmax(lo,x)); }
-static inline float rndf(float lo,float hi) { return lo + (float)rand()/(float)RAND_MAX*(hi-lo); }
+static inline float rndf(PufferRng* rng, float lo,float hi) { return lo + (float)puffer_rand(rng)/(float)RAND_MAX*(hi-lo); }
 
 static void respawn_boid(Boids *env, unsigned int i) {
-    env->boids[i].x = rndf(LEFT_MARGIN, WIDTH  - RIGHT_MARGIN);
-    env->boids[i].y = rndf(BOTTOM_MARGIN, HEIGHT - TOP_MARGIN);
+    env->boids[i].x = rndf(&env->rng, LEFT_MARGIN, WIDTH  - RIGHT_MARGIN);
+    env->boids[i].y = rndf(&env->rng, BOTTOM_MARGIN, HEIGHT - TOP_MARGIN);
     env->boids[i].velocity.x = 0;
     env->boids[i].velocity.y = 0;
     env->boid_logs[i]       = (Log){0};
@@ -83,8 +85,8 @@ void init(Boids *env) {
     env->tick = 0;
 
     for (unsigned current_indx = 0; current_indx < env->num_boids; current_indx++) {
-        env->boids[current_indx].x = rndf(LEFT_MARGIN, WIDTH  - RIGHT_MARGIN);
-        env->boids[current_indx].y = rndf(BOTTOM_MARGIN, HEIGHT - TOP_MARGIN);
+        env->boids[current_indx].x = rndf(&env->rng, LEFT_MARGIN, WIDTH  - RIGHT_MARGIN);
+        env->boids[current_indx].y = rndf(&env->rng, BOTTOM_MARGIN, HEIGHT - TOP_MARGIN);
         env->boids[current_indx].velocity.x = 0;
         env->boids[current_indx].velocity.y = 0;
     }
@@ -80,7 +80,7 @@ void test_performance(int timeout) {
     int start = time(NULL);
     int num_steps = 0;
     while (time(NULL) - start < timeout) {
-        env.actions[0] = rand() % 3;
+        env.actions[0] = puffer_randint(&env.rng, 0, 3);
         c_step(&env);
         num_steps++;
     }
@@ -5,6 +5,7 @@
 #include <limits.h>
 #include <string.h>
 #include "raylib.h"
+#include "../rng.h"
 
 #define NOOP 0
 #define LEFT 1
@@ -39,6 +40,7 @@ typedef struct Client {
 typedef struct Breakout {
     Client* client;
     Log log;
+    PufferRng rng;
     float* observations;
     float* actions;
     float* rewards;
@@ -430,7 +432,7 @@ void step_frame(Breakout* env, float action) {
 
         env->ball_vy = cos(direction) * env->ball_speed * TICK_RATE;
         env->ball_vx = sin(direction) * env->ball_speed * TICK_RATE;
-        if (rand() % 2 == 0) {
+        if (puffer_randint(&env->rng, 0, 2) == 0) {
             env->ball_vx = -env->ball_vx;
         }
     }   
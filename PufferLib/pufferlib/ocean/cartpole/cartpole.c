@@ -30,6 +30,7 @@ void demo() {
     int logit_sizes[1] = {ACTIONS_SIZE};
     net = make_linearlstm(weights, 1, OBSERVATIONS_SIZE, logit_sizes, 1);
     Cartpole env = {0};
+    puffer_rng_seed(&env.rng, time(NULL));
     env.continuous = CONTINUOUS;
     allocate(&env);
     c_reset(&env);
@@ -66,7 +67,6 @@ void demo() {
 }
 
 int main() {
-    srand(time(NULL));
     demo();
     return 0;
 }
@@ -5,6 +5,7 @@
 #include <math.h>
 #include <time.h>
 #include "raylib.h"
+#include "../rng.h"
 
 #define X_THRESHOLD 2.4f
 #define THETA_THRESHOLD_RADIANS (12 * 2 * M_PI / 360)
@@ -36,6 +37,7 @@ struct Cartpole {
     unsigned char* terminals;
     unsigned char* truncations;
     Log log;
+    PufferRng rng;
     Client* client;
     float x;
     float x_dot;
@@ -141,10 +143,10 @@ void compute_observations(Cartpole* env) {
 
 void c_reset(Cartpole* env) {
     env->episode_return = 0.0f;
-    env->x = ((float)rand() / (float)RAND_MAX) * 0.08f - 0.04f;
-    env->x_dot = ((float)rand() / (float)RAND_MAX) * 0.08f - 0.04f;
-    env->theta = ((float)rand() / (float)RAND_MAX) * 0.08f - 0.04f;
-    env->theta_dot = ((float)rand() / (float)RAND_MAX) * 0.08f - 0.04f;
+    env->x = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 0.08f - 0.04f;
+    env->x_dot = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 0.08f - 0.04f;
+    env->theta = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 0.08f - 0.04f;
+    env->theta_dot = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 0.08f - 0.04f;
     env->tick = 0;
     
     compute_observations(env);
@@ -22,7 +22,7 @@ int main() {
       if (IsKeyDown(KEY_RIGHT) || IsKeyDown(KEY_D))
         env.actions[0] = 4;
     } else {
-      env.actions[0] = rand() % 5;
+      env.actions[0] = puffer_randint(&env.rng, 0, 5);
     }
     c_step(&env);
     c_render(&env);
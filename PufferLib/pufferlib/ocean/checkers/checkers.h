@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "../rng.h"
 
 #define EMPTY 0
 #define AGENT 1
@@ -29,6 +30,7 @@ typedef struct {
 // Recommended that you name it the same as the env file
 typedef struct {
   Log log;
+  PufferRng rng;
   unsigned char *observations;
   int *actions;
   float *rewards;
@@ -557,11 +559,10 @@ void scripted_random_move(Checkers *env) {
   int current_king = env->current_player == AGENT ? AGENT_KING : OPPONENT_KING;
   int has_captures = capture_available(env);
 
-  srand(time(NULL));
   int i;
   int num_positions = env->size * env->size;
   while (1) {
-    i = random() % num_positions;
+    i = puffer_randint(&env->rng, 0, num_positions);
     int piece = env->observations[i];
     if (piece != current_pawn && piece != current_king)
       continue;
@@ -61,7 +61,7 @@ void performance_test() {
     long start = time(NULL);
     int i = 0;
     while (time(NULL) - start < test_time) {
-        env.actions[0] = rand() % 7;
+        env.actions[0] = puffer_randint(&env.rng, 0, 7);
         c_step(&env);
         i++;
     }
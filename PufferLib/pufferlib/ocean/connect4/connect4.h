@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <stdint.h>
 #include "raylib.h"
+#include "../rng.h"
 
 #define WIN_CONDITION 4
 const int PLAYER_WIN = 1.0;
@@ -38,6 +39,7 @@ struct CConnect4 {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    PufferRng rng;
     Client* client;
 
     // Bit string representation from:
@@ -205,7 +207,7 @@ int compute_env_move(CConnect4* env) {
         }
     }
     //printf("Values: %f, %f, %f, %f, %f, %f, %f\n", values[0], values[1], values[2], values[3], values[4], values[5], values[6]);
-    int best_tie = rand() % num_ties;
+    int best_tie = puffer_randint(&env->rng, 0, num_ties);
     for (uint64_t column = 0; column < 7; column ++) {
         if (values[column] == best_value) {
             if (best_tie == 0) {
@@ -26,8 +26,8 @@ int main() {
 
     while (!WindowShouldClose()) {
         for (int i=0; i<env.num_agents; i++) {
-            env.actions[2*i] = rand() % 9;
-            env.actions[2*i + 1] = rand() % 5;
+            env.actions[2*i] = puffer_randint(&env.rng, 0, 9);
+            env.actions[2*i + 1] = puffer_randint(&env.rng, 0, 5);
         }
 
         forward_linearlstm(net, env.observations, env.actions);
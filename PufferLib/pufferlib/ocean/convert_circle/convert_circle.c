@@ -13,7 +13,7 @@ int main() {
       .equidistant = 1,
       .radius = 400,
   };
-  srand(time(NULL));
+  puffer_rng_seed(&env.rng, time(NULL));
   init(&env);
 
   int num_obs = 2 * env.num_resources + 4 + env.num_resources;
@@ -33,8 +33,8 @@ int main() {
 
   while (!WindowShouldClose()) {
     for (int i = 0; i < env.num_agents; i++) {
-      env.actions[2 * i] = rand() % 9;
-      env.actions[2 * i + 1] = rand() % 5;
+      env.actions[2 * i] = puffer_randint(&env.rng, 0, 9);
+      env.actions[2 * i + 1] = puffer_randint(&env.rng, 0, 5);
     }
 
     forward_linearlstm(net, env.observations, env.actions);
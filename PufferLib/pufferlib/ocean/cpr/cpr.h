@@ -6,6 +6,7 @@
 #include <string.h>
 #include <time.h>
 #include <math.h>
+#include "../rng.h"
 
 #include "raylib.h"
 
@@ -107,6 +108,7 @@ struct CCpr {
   Agent *agents;
 
   Log log;
+  PufferRng rng;
   Log* agent_logs;
 
   uint8_t *interactive_food_agent_count;
@@ -195,8 +197,8 @@ void spawn_food(CCpr *env, int food_type) {
   // Randomly spawns such food in the grid
   int idx, tile;
   do {
-    int r = rand() % (env->height - 1);
-    int c = rand() % (env->width - 1);
+    int r = puffer_randint(&env->rng, 0, env->height - 1);
+    int c = puffer_randint(&env->rng, 0, env->width - 1);
     idx = r * env->width + c;
     tile = env->grid[idx];
   } while (tile != EMPTY);
@@ -252,12 +254,12 @@ void spawn_foods(CCpr *env) {
         switch (env->grid[idx]) {
         // %Chance spawning new food
         case NORMAL_FOOD:
-          if ((rand() / (double)RAND_MAX) < env->food_base_spawn_rate) {
+          if ((puffer_rand(&env->rng) / (double)RAND_MAX) < env->food_base_spawn_rate) {
             add_food(env, grid_idx, env->grid[idx]);
           }
           break;
         case INTERACTIVE_FOOD:
-          if ((rand() / (double)RAND_MAX) <
+          if ((puffer_rand(&env->rng) / (double)RAND_MAX) <
               (env->food_base_spawn_rate / 10.0)) {
             add_food(env, grid_idx, env->grid[idx]);
           }
@@ -383,7 +385,7 @@ void spawn_agent(CCpr *env, int i){
 
   bool allocated = false;
   while (!allocated) {
-    adr = rand() % (env->height * env->width);
+    adr = puffer_randint(&env->rng, 0, env->height * env->width);
     if (env->grid[adr] == EMPTY) {
       int r = adr / env->width;
       int c = adr % env->width;
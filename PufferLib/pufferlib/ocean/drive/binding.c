@@ -1,9 +1,35 @@
+#include <Python.h>
+
 #include "drive.h"
 #define Env Drive
 #define MY_SHARED
 #define MY_PUT
+static PyObject* convert_map(PyObject* self, PyObject* args);
+#define MY_METHODS {"convert_map_binary", convert_map, METH_VARARGS, "Convert a legacy map binary to the scenario format"}
 #include "../env_binding.h"
 
+// Prefers the scenario format, falling back to the legacy binaries
+static void map_path(char* path, int map_id) {
+    sprintf(path, "resources/drive/scenarios/map_%03d.scn", map_id);
+    if (access(path, R_OK) != 0) {
+        sprintf(path, "resources/drive/binaries/map_%03d.bin", map_id);
+    }
+}
+
+static PyObject* convert_map(PyObject* self, PyObject* args) {
+    const char* src;
+    const char* dst;
+    int road_index = 0;
+    if (!PyArg_ParseTuple(args, "ss|p", &src, &dst, &road_index)) {
+        return NULL;
+    }
+    if (convert_map_binary(src, dst, road_index) != 0) {
+        PyErr_Format(PyExc_IOError, "Failed to convert %s to %s", src, dst);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
 static int my_put(Env* env, PyObject* args, PyObject* kwargs) {
     PyObject* obs = PyDict_GetItemString(kwargs, "observations");
     if (!PyObject_TypeCheck(obs, &PyArray_Type)) {
@@ -71,7 +97,8 @@ static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
     int num_agents = unpack(kwargs, "num_agents");
     int num_maps = unpack(kwargs, "num_maps");
     clock_gettime(CLOCK_REALTIME, &ts);
-    srand(ts.tv_nsec);
+    PufferRng rng;
+    puffer_rng_seed(&rng, ts.tv_nsec);
     int total_agent_count = 0;
     int env_count = 0;
     int max_envs = num_agents;
@@ -80,10 +107,11 @@ static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
     // getting env count
     while(total_agent_count < num_agents && env_count < max_envs){
         char map_file[100];
-        int map_id = rand() % num_maps;
+        int map_id = puffer_randint(&rng, 0, num_maps);
         Drive* env = calloc(1, sizeof(Drive));
-        sprintf(map_file, "resources/drive/binaries/map_%03d.bin", map_id);
-        env->entities = load_map_binary(map_file, env);
+        map_path(map_file, map_id);
+        env->map_name = map_file;
+        load_map(env);
         set_active_agents(env);
         // Store map_id
         PyObject* map_id_obj = PyLong_FromLong(map_id);
@@ -93,10 +121,7 @@ static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
         PyList_SetItem(agent_offsets, env_count, offset);
         total_agent_count += env->active_agent_count;
         env_count++;
-        for(int j=0;j<env->num_entities;j++) {
-            free_entity(&env->entities[j]);
-        }
-        free(env->entities);
+        free_map(env);
         free(env->active_agent_indices);
         free(env->static_car_indices);
         free(env->expert_static_car_indices);
@@ -147,7 +172,7 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
     int max_agents = unpack(kwargs, "max_agents");
 
     char map_file[100];
-    sprintf(map_file, "resources/drive/binaries/map_%03d.bin", map_id);
+    map_path(map_file, map_id);
     env->num_agents = max_agents;
     env->map_name = strdup(map_file);
     init(env);
@@ -314,8 +314,8 @@ void performance_test() {
     while (time(NULL) - start < test_time) {
         // Set random actions for all agents
         for(int j = 0; j < env.active_agent_count; j++) {
-            int accel = rand() % 7;
-            int steer = rand() % 13;
+            int accel = puffer_randint(&env.rng, 0, 7);
+            int steer = puffer_randint(&env.rng, 0, 13);
             actions[j][0] = accel;  // -1, 0, or 1
             actions[j][1] = steer;  // Random steering
         }
@@ -10,6 +10,11 @@
 #include "raymath.h"
 #include "rlgl.h"
 #include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../rng.h"
+#include "../broadphase.h"
 // Entity Types
 #define NONE 0
 #define VEHICLE 1
@@ -44,6 +49,7 @@
 #define GRID_CELL_SIZE 5.0f
 #define MAX_ENTITIES_PER_CELL 10
 #define SLOTS_PER_CELL (MAX_ENTITIES_PER_CELL*2 + 1)
+#define VISION_RANGE 21
 
 // Max road segment observation entities
 #define MAX_ROAD_SEGMENT_OBSERVATIONS 200
@@ -88,6 +94,8 @@ struct timespec ts;
 typedef struct Drive Drive;
 typedef struct Client Client;
 typedef struct Log Log;
+typedef struct Scenario Scenario;
+typedef struct RoadIndex RoadIndex;
 
 struct Log {
     float episode_return;
@@ -137,6 +145,7 @@ struct Entity {
     int collided_before_goal;
     int reached_goal_this_episode;
     int active_agent;
+    int removed_at_start;
 };
 
 void free_entity(Entity* entity){
@@ -170,6 +179,7 @@ struct Drive {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    PufferRng rng;
     Log* logs;
     int num_agents;
     int active_agent_count;
@@ -186,6 +196,12 @@ struct Drive {
     int* expert_static_car_indices;
     int timestep;
     int dynamics_model;
+    Scenario* scenario;  // NULL when the map was read from a legacy binary
+    // Road grid and neighbor caches are shared by all envs on a map, see RoadIndex
+    RoadIndex* road_index;
+    // Cars in collision order (active agents, then static cars), refreshed
+    // by update_car_broadphase before each round of collision_check
+    Broadphase car_broadphase;
     float* map_corners;
     int* grid_cells;  // holds entity ids and geometry index per cell
     int grid_cols;
@@ -235,7 +251,7 @@ Entity* load_map_binary(const char* filename, Drive* env) {
     fread(&env->num_objects, sizeof(int), 1, file);
     fread(&env->num_roads, sizeof(int), 1, file);
     env->num_entities = env->num_objects + env->num_roads; 
-    Entity* entities = (Entity*)malloc(env->num_entities * sizeof(Entity));
+    Entity* entities = (Entity*)calloc(env->num_entities, sizeof(Entity));
     for (int i = 0; i < env->num_entities; i++) {
 	// Read base entity data
         fread(&entities[i].type, sizeof(int), 1, file);
@@ -296,8 +312,8 @@ void set_start_position(Drive* env){
             }
         }
         Entity* e = &env->entities[i];
-        e->x = e->traj_x[0];
-        e->y = e->traj_y[0];
+        e->x = e->removed_at_start ? -10000 : e->traj_x[0];
+        e->y = e->removed_at_start ? -10000 : e->traj_y[0];
         e->z = e->traj_z[0];
         //printf("Entity %d is at (%f, %f, %f)\n", i, e->x, e->y, e->z);
         //if (e->type < 4) {
@@ -519,6 +535,13 @@ int get_neighbor_cache_entities(Drive* env, int cell_idx, int* entities, int max
     return pairs;
 }
 
+void build_road_index(Drive* env) {
+    init_grid_map(env);
+    init_neighbor_offsets(env);
+    env->neighbor_cache_indices = (int*)calloc((env->grid_cols*env->grid_rows) + 1, sizeof(int));
+    cache_neighbor_offsets(env);
+}
+
 void set_means(Drive* env) {
     float mean_x = 0.0f;
     float mean_y = 0.0f;
@@ -559,6 +582,486 @@ void set_means(Drive* env) {
     
 }
 
+// Compact scenario format: one versioned blob per map holding a header, a
+// table of entity records and flat SoA trajectory arrays the records index
+// into. Trajectories are stored already centered on the world mean, so envs
+// never write to them and all envs on a map share one read-only mapping.
+// The road index can be stored after them, see RoadIndex. convert_map_binary
+// writes it from the legacy map_*.bin files
+#define SCENARIO_MAGIC 0x4E435344  // "DSCN"
+#define SCENARIO_VERSION 2
+
+typedef struct ScenarioHeader ScenarioHeader;
+struct ScenarioHeader {
+    uint32_t magic;
+    uint32_t version;
+    int32_t num_objects;
+    int32_t num_roads;
+    int32_t num_points;         // x, y, z of every entity
+    int32_t num_object_points;  // vx, vy, vz, heading, valid of objects only
+    float world_mean_x;
+    float world_mean_y;
+    // Byte offsets of each section from the start of the file
+    uint64_t entities;
+    uint64_t traj_x;
+    uint64_t traj_y;
+    uint64_t traj_z;
+    uint64_t traj_vx;
+    uint64_t traj_vy;
+    uint64_t traj_vz;
+    uint64_t traj_heading;
+    uint64_t traj_valid;
+    // Road index, grid_cols is 0 when the file was converted without it
+    float map_corners[4];
+    int32_t grid_cols;
+    int32_t grid_rows;
+    int32_t vision_range;
+    int32_t num_neighbor_cache_entities;
+    uint64_t grid_cells;
+    uint64_t neighbor_offsets;
+    uint64_t neighbor_cache_indices;
+    uint64_t neighbor_cache_entities;
+    uint64_t size;
+};
+
+typedef struct ScenarioEntity ScenarioEntity;
+struct ScenarioEntity {
+    int32_t type;
+    int32_t array_size;
+    int32_t point_offset;
+    int32_t object_point_offset;  // -1 for roads
+    float width;
+    float length;
+    float height;
+    float goal_position_x;
+    float goal_position_y;
+    float goal_position_z;
+    int32_t mark_as_expert;
+    int32_t pad;
+};
+
+struct Scenario {
+    char* path;
+    const char* data;
+    size_t size;
+    Scenario* next;
+};
+
+// Open scenarios, keyed by path. Mappings live until exit: they are clean
+// file pages the kernel can reclaim, and keeping them makes resampling a
+// map a list lookup. Only touched from env init and binding.shared, which
+// Python calls with the GIL held
+Scenario* scenario_cache = NULL;
+
+int is_object(int type) {
+    return type == VEHICLE || type == PEDESTRIAN || type == CYCLIST;
+}
+
+int scenario_section_fits(uint64_t offset, uint64_t count, uint64_t size) {
+    return offset <= size && count <= (size - offset) / sizeof(float);
+}
+
+int scenario_road_index_valid(const ScenarioHeader* h, const char* data, size_t size) {
+    if (h->grid_cols == 0) {
+        return 1;
+    }
+    if (h->grid_cols < 0 || h->grid_rows <= 0 || h->vision_range <= 0
+            || h->num_neighbor_cache_entities < 0) {
+        return 0;
+    }
+    uint64_t cells = (uint64_t)h->grid_cols*h->grid_rows;
+    uint64_t offsets = 2*(uint64_t)h->vision_range*h->vision_range;
+    if (!scenario_section_fits(h->grid_cells, cells*SLOTS_PER_CELL, size)
+            || !scenario_section_fits(h->neighbor_offsets, offsets, size)
+            || !scenario_section_fits(h->neighbor_cache_indices, cells + 1, size)
+            || !scenario_section_fits(h->neighbor_cache_entities, h->num_neighbor_cache_entities, size)) {
+        return 0;
+    }
+    const int* indices = (const int*)(data + h->neighbor_cache_indices);
+    for (uint64_t i = 0; i < cells; i++) {
+        if (indices[i] < 0 || indices[i] > indices[i + 1]) {
+            return 0;
+        }
+    }
+    return indices[cells] == h->num_neighbor_cache_entities;
+}
+
+// Returns the shared mapping of a scenario file, or NULL if path is missing
+// or not a valid scenario (e.g. a legacy binary)
+Scenario* open_scenario(const char* path) {
+    for (Scenario* s = scenario_cache; s != NULL; s = s->next) {
+        if (strcmp(s->path, path) == 0) {
+            return s;
+        }
+    }
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(ScenarioHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = st.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+
+    const ScenarioHeader* h = (const ScenarioHeader*)data;
+    if (h->magic == SCENARIO_MAGIC && h->version != SCENARIO_VERSION) {
+        fprintf(stderr, "%s: scenario version %u, expected %u. Reconvert it with convert_map_binary\n",
+            path, h->version, SCENARIO_VERSION);
+    }
+    int valid = h->magic == SCENARIO_MAGIC && h->version == SCENARIO_VERSION
+        && h->size == size && h->num_objects >= 0 && h->num_roads >= 0
+        && h->num_points >= 0 && h->num_object_points >= 0;
+    uint64_t num_entities = (uint64_t)h->num_objects + h->num_roads;
+    valid = valid && h->entities <= size
+        && num_entities <= (size - h->entities) / sizeof(ScenarioEntity);
+    uint64_t points[2] = {h->num_points, h->num_object_points};
+    const uint64_t offsets[8] = {h->traj_x, h->traj_y, h->traj_z, h->traj_vx,
+        h->traj_vy, h->traj_vz, h->traj_heading, h->traj_valid};
+    for (int i = 0; i < 8 && valid; i++) {
+        valid = scenario_section_fits(offsets[i], points[i >= 3], size);
+    }
+    const ScenarioEntity* records = valid
+        ? (const ScenarioEntity*)((const char*)data + h->entities) : NULL;
+    for (uint64_t i = 0; i < num_entities && valid; i++) {
+        const ScenarioEntity* r = &records[i];
+        valid = r->array_size >= 0 && r->point_offset >= 0
+            && r->point_offset <= h->num_points - r->array_size;
+        if (valid && is_object(r->type)) {
+            valid = r->object_point_offset >= 0
+                && r->object_point_offset <= h->num_object_points - r->array_size;
+        }
+    }
+    valid = valid && scenario_road_index_valid(h, (const char*)data, size);
+    if (!valid) {
+        munmap(data, size);
+        return NULL;
+    }
+
+    Scenario* scenario = (Scenario*)calloc(1, sizeof(Scenario));
+    scenario->path = strdup(path);
+    scenario->data = (const char*)data;
+    scenario->size = size;
+    scenario->next = scenario_cache;
+    scenario_cache = scenario;
+    return scenario;
+}
+
+// Entities point into the read-only mapping: writing to a trajectory faults
+Entity* load_map_scenario(Scenario* scenario, Drive* env) {
+    const ScenarioHeader* h = (const ScenarioHeader*)scenario->data;
+    const ScenarioEntity* records = (const ScenarioEntity*)(scenario->data + h->entities);
+    float* traj_x = (float*)(scenario->data + h->traj_x);
+    float* traj_y = (float*)(scenario->data + h->traj_y);
+    float* traj_z = (float*)(scenario->data + h->traj_z);
+    float* traj_vx = (float*)(scenario->data + h->traj_vx);
+    float* traj_vy = (float*)(scenario->data + h->traj_vy);
+    float* traj_vz = (float*)(scenario->data + h->traj_vz);
+    float* traj_heading = (float*)(scenario->data + h->traj_heading);
+    int* traj_valid = (int*)(scenario->data + h->traj_valid);
+
+    env->num_objects = h->num_objects;
+    env->num_roads = h->num_roads;
+    env->num_entities = env->num_objects + env->num_roads;
+    env->world_mean_x = h->world_mean_x;
+    env->world_mean_y = h->world_mean_y;
+    Entity* entities = (Entity*)calloc(env->num_entities, sizeof(Entity));
+    for (int i = 0; i < env->num_entities; i++) {
+        const ScenarioEntity* r = &records[i];
+        Entity* e = &entities[i];
+        e->type = r->type;
+        e->array_size = r->array_size;
+        e->traj_x = traj_x + r->point_offset;
+        e->traj_y = traj_y + r->point_offset;
+        e->traj_z = traj_z + r->point_offset;
+        if (is_object(r->type)) {
+            e->traj_vx = traj_vx + r->object_point_offset;
+            e->traj_vy = traj_vy + r->object_point_offset;
+            e->traj_vz = traj_vz + r->object_point_offset;
+            e->traj_heading = traj_heading + r->object_point_offset;
+            e->traj_valid = traj_valid + r->object_point_offset;
+        }
+        e->width = r->width;
+        e->length = r->length;
+        e->height = r->height;
+        e->goal_position_x = r->goal_position_x;
+        e->goal_position_y = r->goal_position_y;
+        e->goal_position_z = r->goal_position_z;
+        e->mark_as_expert = r->mark_as_expert;
+    }
+    return entities;
+}
+
+// Maps in the scenario format are shared. Legacy binaries are read into per
+// env copies and centered here
+void load_map(Drive* env) {
+    env->scenario = open_scenario(env->map_name);
+    if (env->scenario != NULL) {
+        env->entities = load_map_scenario(env->scenario, env);
+        return;
+    }
+    env->entities = load_map_binary(env->map_name, env);
+    set_means(env);
+}
+
+void free_map(Drive* env) {
+    if (env->scenario == NULL) {
+        for (int i = 0; i < env->num_entities; i++) {
+            free_entity(&env->entities[i]);
+        }
+    }
+    free(env->entities);
+    env->entities = NULL;
+}
+
+// The road segment grid and per cell neighbor caches depend only on a map's
+// roads, and the neighbor cache alone is several MB, so they are built once
+// per map and shared read-only by every env on it. Cached by path for the
+// life of the process like scenarios. Scenarios converted with the road
+// index carry it in the mapping, which also shares it across processes
+struct RoadIndex {
+    char* path;
+    float* map_corners;
+    int grid_cols;
+    int grid_rows;
+    int vision_range;
+    int* grid_cells;
+    int* neighbor_offsets;
+    int* neighbor_cache_indices;
+    int* neighbor_cache_entities;
+    // Observation features of each road segment, built per process. Segment
+    // j of road entity i is segment_offsets[i] + j
+    int* segment_offsets;
+    float* segment_mid_x;
+    float* segment_mid_y;
+    float* segment_length;  // over MAX_ROAD_SEGMENT_LENGTH
+    float* segment_dir_x;   // unit vector from midpoint to end
+    float* segment_dir_y;
+    float* segment_type;    // entity type - ROAD_LANE
+    RoadIndex* next;
+};
+
+RoadIndex* road_index_cache = NULL;
+
+// Same arithmetic compute_observations did per agent per step, so the
+// observations are unchanged
+void build_segment_features(RoadIndex* index, Drive* env) {
+    index->segment_offsets = (int*)calloc(env->num_entities, sizeof(int));
+    int num_segments = 0;
+    for (int i = 0; i < env->num_entities; i++) {
+        Entity* e = &env->entities[i];
+        index->segment_offsets[i] = num_segments;
+        if (e->type > 3 && e->type < 7 && e->array_size > 1) {
+            num_segments += e->array_size - 1;
+        }
+    }
+    float* features = (float*)calloc(6*(num_segments + 1), sizeof(float));
+    index->segment_mid_x = features;
+    index->segment_mid_y = features + (num_segments + 1);
+    index->segment_length = features + 2*(num_segments + 1);
+    index->segment_dir_x = features + 3*(num_segments + 1);
+    index->segment_dir_y = features + 4*(num_segments + 1);
+    index->segment_type = features + 5*(num_segments + 1);
+    for (int i = 0; i < env->num_entities; i++) {
+        Entity* e = &env->entities[i];
+        if (e->type <= 3 || e->type >= 7) {
+            continue;
+        }
+        for (int j = 0; j < e->array_size - 1; j++) {
+            int seg = index->segment_offsets[i] + j;
+            float start_x = e->traj_x[j];
+            float start_y = e->traj_y[j];
+            float end_x = e->traj_x[j + 1];
+            float end_y = e->traj_y[j + 1];
+            float mid_x = (start_x + end_x) / 2.0f;
+            float mid_y = (start_y + end_y) / 2.0f;
+            float dx = end_x - mid_x;
+            float dy = end_y - mid_y;
+            float hypot = sqrtf(dx*dx + dy*dy);
+            index->segment_mid_x[seg] = mid_x;
+            index->segment_mid_y[seg] = mid_y;
+            index->segment_length[seg] = hypot / MAX_ROAD_SEGMENT_LENGTH;
+            index->segment_dir_x[seg] = (hypot > 0) ? dx / hypot : dx;
+            index->segment_dir_y[seg] = (hypot > 0) ? dy / hypot : dy;
+            index->segment_type[seg] = e->type - 4.0f;
+        }
+    }
+}
+
+void use_road_index(Drive* env, RoadIndex* index) {
+    env->road_index = index;
+    env->map_corners = index->map_corners;
+    env->grid_cols = index->grid_cols;
+    env->grid_rows = index->grid_rows;
+    env->grid_cells = index->grid_cells;
+    env->neighbor_offsets = index->neighbor_offsets;
+    env->neighbor_cache_indices = index->neighbor_cache_indices;
+    env->neighbor_cache_entities = index->neighbor_cache_entities;
+}
+
+// Call after load_map with env->vision_range set
+void load_road_index(Drive* env) {
+    for (RoadIndex* index = road_index_cache; index != NULL; index = index->next) {
+        if (index->vision_range == env->vision_range && strcmp(index->path, env->map_name) == 0) {
+            use_road_index(env, index);
+            return;
+        }
+    }
+
+    RoadIndex* index = (RoadIndex*)calloc(1, sizeof(RoadIndex));
+    index->path = strdup(env->map_name);
+    index->vision_range = env->vision_range;
+    const ScenarioHeader* h = (env->scenario != NULL)
+        ? (const ScenarioHeader*)env->scenario->data : NULL;
+    if (h != NULL && h->grid_cols > 0 && h->vision_range == env->vision_range) {
+        const char* data = env->scenario->data;
+        index->map_corners = (float*)h->map_corners;
+        index->grid_cols = h->grid_cols;
+        index->grid_rows = h->grid_rows;
+        index->grid_cells = (int*)(data + h->grid_cells);
+        index->neighbor_offsets = (int*)(data + h->neighbor_offsets);
+        index->neighbor_cache_indices = (int*)(data + h->neighbor_cache_indices);
+        index->neighbor_cache_entities = (int*)(data + h->neighbor_cache_entities);
+    } else {
+        build_road_index(env);
+        index->map_corners = env->map_corners;
+        index->grid_cols = env->grid_cols;
+        index->grid_rows = env->grid_rows;
+        index->grid_cells = env->grid_cells;
+        index->neighbor_offsets = env->neighbor_offsets;
+        index->neighbor_cache_indices = env->neighbor_cache_indices;
+        index->neighbor_cache_entities = env->neighbor_cache_entities;
+    }
+    build_segment_features(index, env);
+    index->next = road_index_cache;
+    road_index_cache = index;
+    use_road_index(env, index);
+}
+
+void free_road_index(Drive* env) {
+    free(env->map_corners);
+    free(env->grid_cells);
+    free(env->neighbor_offsets);
+    free(env->neighbor_cache_entities);
+    free(env->neighbor_cache_indices);
+}
+
+// Writes a legacy map_*.bin file in the scenario format, with the road
+// index when road_index is set. Returns 0 on success
+int convert_map_binary(const char* src, const char* dst, int road_index) {
+    Drive env = {0};
+    env.entities = load_map_binary(src, &env);
+    if (env.entities == NULL) {
+        return 1;
+    }
+    set_means(&env);
+    int cells = 0;
+    if (road_index) {
+        env.vision_range = VISION_RANGE;
+        build_road_index(&env);
+        cells = env.grid_cols*env.grid_rows;
+    }
+
+    ScenarioHeader h = {0};
+    h.magic = SCENARIO_MAGIC;
+    h.version = SCENARIO_VERSION;
+    h.num_objects = env.num_objects;
+    h.num_roads = env.num_roads;
+    h.world_mean_x = env.world_mean_x;
+    h.world_mean_y = env.world_mean_y;
+    ScenarioEntity* records = (ScenarioEntity*)calloc(env.num_entities, sizeof(ScenarioEntity));
+    for (int i = 0; i < env.num_entities; i++) {
+        Entity* e = &env.entities[i];
+        ScenarioEntity* r = &records[i];
+        r->type = e->type;
+        r->array_size = e->array_size;
+        r->point_offset = h.num_points;
+        h.num_points += e->array_size;
+        r->object_point_offset = -1;
+        if (is_object(e->type)) {
+            r->object_point_offset = h.num_object_points;
+            h.num_object_points += e->array_size;
+        }
+        r->width = e->width;
+        r->length = e->length;
+        r->height = e->height;
+        r->goal_position_x = e->goal_position_x;
+        r->goal_position_y = e->goal_position_y;
+        r->goal_position_z = e->goal_position_z;
+        r->mark_as_expert = e->mark_as_expert;
+    }
+    h.entities = sizeof(ScenarioHeader);
+    h.traj_x = h.entities + env.num_entities*sizeof(ScenarioEntity);
+    h.traj_y = h.traj_x + h.num_points*sizeof(float);
+    h.traj_z = h.traj_y + h.num_points*sizeof(float);
+    h.traj_vx = h.traj_z + h.num_points*sizeof(float);
+    h.traj_vy = h.traj_vx + h.num_object_points*sizeof(float);
+    h.traj_vz = h.traj_vy + h.num_object_points*sizeof(float);
+    h.traj_heading = h.traj_vz + h.num_object_points*sizeof(float);
+    h.traj_valid = h.traj_heading + h.num_object_points*sizeof(float);
+    h.grid_cells = h.traj_valid + h.num_object_points*sizeof(int);
+    h.neighbor_offsets = h.grid_cells;
+    h.neighbor_cache_indices = h.grid_cells;
+    h.neighbor_cache_entities = h.grid_cells;
+    h.size = h.grid_cells;
+    if (road_index) {
+        memcpy(h.map_corners, env.map_corners, 4*sizeof(float));
+        h.grid_cols = env.grid_cols;
+        h.grid_rows = env.grid_rows;
+        h.vision_range = env.vision_range;
+        h.num_neighbor_cache_entities = env.neighbor_cache_indices[cells];
+        h.neighbor_offsets = h.grid_cells + (uint64_t)cells*SLOTS_PER_CELL*sizeof(int);
+        h.neighbor_cache_indices = h.neighbor_offsets + 2*env.vision_range*env.vision_range*sizeof(int);
+        h.neighbor_cache_entities = h.neighbor_cache_indices + (cells + 1)*sizeof(int);
+        h.size = h.neighbor_cache_entities + h.num_neighbor_cache_entities*sizeof(int);
+    }
+
+    FILE* file = fopen(dst, "wb");
+    int err = (file == NULL);
+    if (!err) {
+        fwrite(&h, sizeof(ScenarioHeader), 1, file);
+        fwrite(records, sizeof(ScenarioEntity), env.num_entities, file);
+        // One pass per SoA array, in header order
+        for (int field = 0; field < 8; field++) {
+            for (int i = 0; i < env.num_entities; i++) {
+                Entity* e = &env.entities[i];
+                if (field >= 3 && !is_object(e->type)) {
+                    continue;
+                }
+                void* src_array = (field == 0) ? (void*)e->traj_x
+                    : (field == 1) ? (void*)e->traj_y
+                    : (field == 2) ? (void*)e->traj_z
+                    : (field == 3) ? (void*)e->traj_vx
+                    : (field == 4) ? (void*)e->traj_vy
+                    : (field == 5) ? (void*)e->traj_vz
+                    : (field == 6) ? (void*)e->traj_heading
+                    : (void*)e->traj_valid;
+                fwrite(src_array, 4, e->array_size, file);
+            }
+        }
+        if (road_index) {
+            fwrite(env.grid_cells, sizeof(int), cells*SLOTS_PER_CELL, file);
+            fwrite(env.neighbor_offsets, sizeof(int), 2*env.vision_range*env.vision_range, file);
+            fwrite(env.neighbor_cache_indices, sizeof(int), cells + 1, file);
+            fwrite(env.neighbor_cache_entities, sizeof(int), h.num_neighbor_cache_entities, file);
+        }
+        err = ferror(file) || (uint64_t)ftell(file) != h.size;
+        err = (fclose(file) != 0) || err;
+    }
+    free(records);
+    if (road_index) {
+        free_road_index(&env);
+    }
+    free_map(&env);
+    return err;
+}
+
 void move_expert(Drive* env, int* actions, int agent_idx){
     Entity* agent = &env->entities[agent_idx];
     agent->x = agent->traj_x[env->timestep];
@@ -693,6 +1196,23 @@ int check_aabb_collision(Entity* car1, Entity* car2) {
     return 1;  // Collision
 }
 
+void update_car_broadphase(Drive* env) {
+    int cars[MAX_CARS];
+    int count = 0;
+    for(int i = 0; i < MAX_CARS && i < env->num_cars; i++){
+        int index = (i < env->active_agent_count) ? env->active_agent_indices[i]
+            : env->static_car_indices[i - env->active_agent_count];
+        if(index != -1) cars[count++] = index;
+    }
+    Broadphase* bp = &env->car_broadphase;
+    broadphase_begin(bp, count);
+    for(int slot = 0; slot < count; slot++){
+        Entity* e = &env->entities[cars[slot]];
+        broadphase_set(bp, slot, cars[slot], e->x, e->y, e->heading_x, e->heading_y, e->length, e->width);
+    }
+    broadphase_sort(bp);
+}
+
 int collision_check(Drive* env, int agent_idx) {
     Entity* agent = &env->entities[agent_idx];
     if(agent->x == -10000.0f ) return -1;
@@ -727,25 +1247,12 @@ int collision_check(Drive* env, int agent_idx) {
         }
         if (collided == OFFROAD) break;
     }
-    for(int i = 0; i < MAX_CARS; i++){
-        int index = -1;
-        if(i < env->active_agent_count){
-            index = env->active_agent_indices[i];
-        } else if (i < env->num_cars){
-            index = env->static_car_indices[i - env->active_agent_count];
-        }
-        if(index == -1) continue;
-        if(index == agent_idx) continue;
-        Entity* entity = &env->entities[index];
-        float x1 = entity->x;
-        float y1 = entity->y;
-        float dist = ((x1 - agent->x)*(x1 - agent->x) + (y1 - agent->y)*(y1 - agent->y));
-        if(dist > 225.0f) continue;
-        if(check_aabb_collision(agent, entity)) {
-            collided = VEHICLE_COLLISION;
-            car_collided_with_index = index;
-            break;
-        }
+    // Cars with centres within 15m, first in collision order wins
+    int slot = broadphase_first_overlap(&env->car_broadphase, agent->x, agent->y,
+        agent->heading_x, agent->heading_y, agent->length, agent->width, 15.0f, agent_idx);
+    if(slot != -1) {
+        collided = VEHICLE_COLLISION;
+        car_collided_with_index = env->car_broadphase.ids[slot];
     }
     agent->collision_state = collided;
     // spawn immunity for collisions with other agent cars as agent_idx respawns
@@ -854,6 +1361,9 @@ void remove_bad_trajectories(Drive* env){
     int collided_agents[env->active_agent_count];
     int collided_with_indices[env->active_agent_count];
     memset(collided_agents, 0, env->active_agent_count * sizeof(int));
+    for(int i = 0; i < env->active_agent_count; i++){
+        collided_with_indices[i] = -1;
+    }
     // move experts through trajectories to check for collisions and remove as illegal agents
     for(int t = 0; t < TRAJECTORY_LENGTH; t++){
         for(int i = 0; i < env->active_agent_count; i++){
@@ -866,6 +1376,7 @@ void remove_bad_trajectories(Drive* env){
             move_expert(env, env->actions, expert_idx);
         }
         // check collisions
+        update_car_broadphase(env);
         for(int i = 0; i < env->active_agent_count; i++){
             int agent_idx = env->active_agent_indices[i];
             env->entities[agent_idx].collision_state = 0;
@@ -883,8 +1394,7 @@ void remove_bad_trajectories(Drive* env){
         for(int j = 0; j < env->static_car_count; j++){
             int static_car_idx = env->static_car_indices[j];
             if(static_car_idx != collided_with_indices[i]) continue;
-            env->entities[static_car_idx].traj_x[0] = -10000;
-            env->entities[static_car_idx].traj_y[0] = -10000;
+            env->entities[static_car_idx].removed_at_start = 1;
         }
     }
     env->timestep = 0;
@@ -892,34 +1402,24 @@ void remove_bad_trajectories(Drive* env){
 void init(Drive* env){
     env->human_agent_idx = 0;
     env->timestep = 0;
-    env->entities = load_map_binary(env->map_name, env);
+    load_map(env);
     env->dynamics_model = CLASSIC;
-    set_means(env);
-    init_grid_map(env);
-    env->vision_range = 21;
-    init_neighbor_offsets(env);
-    env->neighbor_cache_indices = (int*)calloc((env->grid_cols*env->grid_rows) + 1, sizeof(int));
-    cache_neighbor_offsets(env);
+    env->vision_range = VISION_RANGE;
+    load_road_index(env);
     set_active_agents(env);
+    broadphase_init(&env->car_broadphase, MAX_CARS);
     remove_bad_trajectories(env);
     set_start_position(env);
     env->logs = (Log*)calloc(env->active_agent_count, sizeof(Log));
 }
 
 void c_close(Drive* env){
-    for(int i = 0; i < env->num_entities; i++){
-        free_entity(&env->entities[i]);
-    }
-    free(env->entities);
+    free_map(env);
     free(env->active_agent_indices);
     free(env->logs);
-    free(env->map_corners);
-    free(env->grid_cells);
-    free(env->neighbor_offsets);
-    free(env->neighbor_cache_entities);
-    free(env->neighbor_cache_indices);
     free(env->static_car_indices);
     free(env->expert_static_car_indices);
+    broadphase_free(&env->car_broadphase);
     // free(env->map_name);
 }
 
@@ -1018,19 +1518,176 @@ float reverse_normalize_value(float value, float min, float max){
     return value*50.0f;
 }
 
+// Observations are built in lanes with GCC/clang vector extensions, as in
+// dronelib.h: partner cars and nearby road segments are gathered into
+// structure of arrays scratch, transformed into the ego frame
+// DRIVE_LANES at a time, then written out row by row. Per car and per
+// segment terms that do not depend on the ego (speeds, sizes, segment
+// midpoints and directions) are computed once per step or once per map.
+// Every slot of the row is written, padding included, so the buffer is
+// never cleared first
+#define DRIVE_LANES 16
+#define CAR_GROUPS ((MAX_CARS + DRIVE_LANES - 1) / DRIVE_LANES)
+#define ROAD_GROUPS ((MAX_ROAD_SEGMENT_OBSERVATIONS + DRIVE_LANES - 1) / DRIVE_LANES)
+
+typedef float LaneF __attribute__((vector_size(DRIVE_LANES*sizeof(float))));
+typedef int LaneI __attribute__((vector_size(DRIVE_LANES*sizeof(int))));
+
+// Element l of an array of lane vectors
+#define LANE(v, l) (((float*)(v))[l])
+
+typedef struct {
+    LaneF x[CAR_GROUPS];
+    LaneF y[CAR_GROUPS];
+    LaneF heading_x[CAR_GROUPS];
+    LaneF heading_y[CAR_GROUPS];
+    LaneF width[CAR_GROUPS];
+    LaneF length[CAR_GROUPS];
+    LaneF speed[CAR_GROUPS];
+    LaneI valid[CAR_GROUPS];
+    int index[MAX_CARS];
+    int count;
+} CarLanes;
+
+typedef struct {
+    LaneF mid_x[ROAD_GROUPS];
+    LaneF mid_y[ROAD_GROUPS];
+    LaneF dir_x[ROAD_GROUPS];
+    LaneF dir_y[ROAD_GROUPS];
+    int segment[MAX_ROAD_SEGMENT_OBSERVATIONS];
+    int count;
+} RoadLanes;
+
+// The cars agents observe, in observation order
+void gather_cars(Drive* env, CarLanes* cars) {
+    memset(cars, 0, sizeof(CarLanes));
+    for (int j = 0; j < MAX_CARS; j++) {
+        int index = -1;
+        if (j < env->active_agent_count) {
+            index = env->active_agent_indices[j];
+        } else if (j < env->num_cars) {
+            index = env->static_car_indices[j - env->active_agent_count];
+        }
+        if (index == -1) continue;
+        Entity* e = &env->entities[index];
+        if (e->type > 3) break;
+        int c = cars->count++;
+        cars->index[c] = index;
+        LANE(cars->x, c) = e->x;
+        LANE(cars->y, c) = e->y;
+        LANE(cars->heading_x, c) = e->heading_x;
+        LANE(cars->heading_y, c) = e->heading_y;
+        LANE(cars->width, c) = e->width / MAX_VEH_WIDTH;
+        LANE(cars->length, c) = e->length / MAX_VEH_LEN;
+        LANE(cars->speed, c) = sqrtf(e->vx*e->vx + e->vy*e->vy) / MAX_SPEED;
+        ((int*)cars->valid)[c] = (e->respawn_timestep == -1) ? -1 : 0;
+    }
+}
+
+// Writes the MAX_CARS - 1 partner slots of one agent, returns floats written
+int write_partner_obs(CarLanes* cars, Entity* ego, int ego_idx, float* obs) {
+    int written = 0;
+    if (ego->respawn_timestep == -1) {
+        LaneF rel_x[CAR_GROUPS], rel_y[CAR_GROUPS];
+        LaneF rel_heading_x[CAR_GROUPS], rel_heading_y[CAR_GROUPS];
+        LaneI keep[CAR_GROUPS];
+        int groups = (cars->count + DRIVE_LANES - 1) / DRIVE_LANES;
+        for (int g = 0; g < groups; g++) {
+            LaneF dx = cars->x[g] - ego->x;
+            LaneF dy = cars->y[g] - ego->y;
+            LaneF dist = dx*dx + dy*dy;
+            rel_x[g] = (dx*ego->heading_x + dy*ego->heading_y) * 0.02f;
+            rel_y[g] = (-dx*ego->heading_y + dy*ego->heading_x) * 0.02f;
+            // cos(a-b) and sin(a-b) from the unit headings
+            rel_heading_x[g] = cars->heading_x[g]*ego->heading_x + cars->heading_y[g]*ego->heading_y;
+            rel_heading_y[g] = cars->heading_y[g]*ego->heading_x - cars->heading_x[g]*ego->heading_y;
+            keep[g] = cars->valid[g] & ~(dist > 2500.0f);
+        }
+        for (int c = 0; c < cars->count && written < 7*(MAX_CARS - 1); c++) {
+            if (!((int*)keep)[c] || cars->index[c] == ego_idx) continue;
+            float* o = &obs[written];
+            o[0] = LANE(rel_x, c);
+            o[1] = LANE(rel_y, c);
+            o[2] = LANE(cars->width, c);
+            o[3] = LANE(cars->length, c);
+            o[4] = LANE(rel_heading_x, c);
+            o[5] = LANE(rel_heading_y, c);
+            o[6] = LANE(cars->speed, c);
+            written += 7;
+        }
+    }
+    memset(&obs[written], 0, (7*(MAX_CARS - 1) - written)*sizeof(float));
+    return 7*(MAX_CARS - 1);
+}
+
+// Writes the MAX_ROAD_SEGMENT_OBSERVATIONS road slots of one agent
+void write_road_obs(Drive* env, RoadLanes* roads, Entity* ego, float* obs) {
+    RoadIndex* index = env->road_index;
+    // Read (entity, geometry) pairs straight from the shared neighbor cache,
+    // as get_neighbor_cache_entities would copy them
+    int grid_idx = getGridIndex(env, ego->x, ego->y);
+    roads->count = 0;
+    int* entity_list = NULL;
+    if (grid_idx >= 0 && grid_idx < env->grid_cols*env->grid_rows) {
+        int base = env->neighbor_cache_indices[grid_idx];
+        int pairs = (env->neighbor_cache_indices[grid_idx + 1] - base) / 2;
+        roads->count = (pairs < MAX_ROAD_SEGMENT_OBSERVATIONS) ? pairs : MAX_ROAD_SEGMENT_OBSERVATIONS;
+        entity_list = &env->neighbor_cache_entities[base];
+    }
+    for (int k = 0; k < roads->count; k++) {
+        int seg = index->segment_offsets[entity_list[k*2]] + entity_list[k*2 + 1];
+        roads->segment[k] = seg;
+        LANE(roads->mid_x, k) = index->segment_mid_x[seg];
+        LANE(roads->mid_y, k) = index->segment_mid_y[seg];
+        LANE(roads->dir_x, k) = index->segment_dir_x[seg];
+        LANE(roads->dir_y, k) = index->segment_dir_y[seg];
+    }
+    int groups = (roads->count + DRIVE_LANES - 1) / DRIVE_LANES;
+    for (int k = roads->count; k < groups*DRIVE_LANES; k++) {
+        LANE(roads->mid_x, k) = 0;
+        LANE(roads->mid_y, k) = 0;
+        LANE(roads->dir_x, k) = 0;
+        LANE(roads->dir_y, k) = 0;
+    }
+
+    LaneF x_obs[ROAD_GROUPS], y_obs[ROAD_GROUPS];
+    LaneF cos_angle[ROAD_GROUPS], sin_angle[ROAD_GROUPS];
+    for (int g = 0; g < groups; g++) {
+        LaneF rel_x = roads->mid_x[g] - ego->x;
+        LaneF rel_y = roads->mid_y[g] - ego->y;
+        x_obs[g] = (rel_x*ego->heading_x + rel_y*ego->heading_y) * 0.02f;
+        y_obs[g] = (-rel_x*ego->heading_y + rel_y*ego->heading_x) * 0.02f;
+        cos_angle[g] = roads->dir_x[g]*ego->heading_x + roads->dir_y[g]*ego->heading_y;
+        sin_angle[g] = -roads->dir_x[g]*ego->heading_y + roads->dir_y[g]*ego->heading_x;
+    }
+    float width = 0.1f / MAX_ROAD_SCALE;
+    for (int k = 0; k < roads->count; k++) {
+        int seg = roads->segment[k];
+        float* o = &obs[7*k];
+        o[0] = LANE(x_obs, k);
+        o[1] = LANE(y_obs, k);
+        o[2] = index->segment_length[seg];
+        o[3] = width;
+        o[4] = LANE(cos_angle, k);
+        o[5] = LANE(sin_angle, k);
+        o[6] = index->segment_type[seg];
+    }
+    memset(&obs[7*roads->count], 0, 7*(MAX_ROAD_SEGMENT_OBSERVATIONS - roads->count)*sizeof(float));
+}
+
 void compute_observations(Drive* env) {
     int max_obs = 7 + 7*(MAX_CARS - 1) + 7*MAX_ROAD_SEGMENT_OBSERVATIONS;
-    memset(env->observations, 0, max_obs*env->active_agent_count*sizeof(float));
     float (*observations)[max_obs] = (float(*)[max_obs])env->observations; 
+    CarLanes cars;
+    RoadLanes roads;
+    gather_cars(env, &cars);
     for(int i = 0; i < env->active_agent_count; i++) {
         float* obs = &observations[i][0];
         Entity* ego_entity = &env->entities[env->active_agent_indices[i]];
-        if(ego_entity->type > 3) break;
-        if(ego_entity->respawn_timestep != -1) {
-            obs[6] = 1;
-            //continue;
+        if(ego_entity->type > 3) {
+            memset(obs, 0, (env->active_agent_count - i)*max_obs*sizeof(float));
+            break;
         }
-        float ego_heading = ego_entity->heading;
         float cos_heading = ego_entity->heading_x;
         float sin_heading = ego_entity->heading_y;
         float ego_speed = sqrtf(ego_entity->vx*ego_entity->vx + ego_entity->vy*ego_entity->vy);
@@ -1040,115 +1697,23 @@ void compute_observations(Drive* env) {
         // Rotate to ego vehicle's frame
         float rel_goal_x = goal_x*cos_heading + goal_y*sin_heading;
         float rel_goal_y = -goal_x*sin_heading + goal_y*cos_heading;
-        //obs[0] = normalize_value(rel_goal_x, MIN_REL_GOAL_COORD, MAX_REL_GOAL_COORD);
-        //obs[1] = normalize_value(rel_goal_y, MIN_REL_GOAL_COORD, MAX_REL_GOAL_COORD);
         obs[0] = rel_goal_x* 0.005f;
         obs[1] = rel_goal_y* 0.005f;
-        //obs[2] = ego_speed / MAX_SPEED;
         obs[2] = ego_speed * 0.01f;
         obs[3] = ego_entity->width / MAX_VEH_WIDTH;
         obs[4] = ego_entity->length / MAX_VEH_LEN;
         obs[5] = (ego_entity->collision_state > 0) ? 1 : 0;
-        
-        // Relative Pos of other cars
-        int obs_idx = 7;  // Start after goal distances
-        int cars_seen = 0;
-        for(int j = 0; j < MAX_CARS; j++) {
-            int index = -1;
-            if(j < env->active_agent_count){
-                index = env->active_agent_indices[j];
-            } else if (j < env->num_cars){
-                index = env->static_car_indices[j - env->active_agent_count];
-            } 
-            if(index == -1) continue;
-            if(env->entities[index].type > 3) break;
-            if(index == env->active_agent_indices[i]) continue;  // Skip self, but don't increment obs_idx
-            Entity* other_entity = &env->entities[index];
-            if(ego_entity->respawn_timestep != -1) continue;
-            if(other_entity->respawn_timestep != -1) continue;
-            // Store original relative positions
-            float dx = other_entity->x - ego_entity->x;
-            float dy = other_entity->y - ego_entity->y;
-            float dist = (dx*dx + dy*dy);
-            if(dist > 2500.0f) continue;
-            // Rotate to ego vehicle's frame
-            float rel_x = dx*cos_heading + dy*sin_heading;
-            float rel_y = -dx*sin_heading + dy*cos_heading;
-            // Store observations with correct indexing
-            obs[obs_idx] = rel_x * 0.02f;
-            obs[obs_idx + 1] = rel_y * 0.02f;
-            obs[obs_idx + 2] = other_entity->width / MAX_VEH_WIDTH;
-            obs[obs_idx + 3] = other_entity->length / MAX_VEH_LEN;
-            // relative heading
-            float rel_heading_x = other_entity->heading_x * ego_entity->heading_x + 
-                     other_entity->heading_y * ego_entity->heading_y;  // cos(a-b) = cos(a)cos(b) + sin(a)sin(b)
-            float rel_heading_y = other_entity->heading_y * ego_entity->heading_x - 
-                                other_entity->heading_x * ego_entity->heading_y;  // sin(a-b) = sin(a)cos(b) - cos(a)sin(b)
-
-            obs[obs_idx + 4] = rel_heading_x;
-            obs[obs_idx + 5] = rel_heading_y;
-            // obs[obs_idx + 4] = cosf(rel_heading) / MAX_ORIENTATION_RAD;
-            // obs[obs_idx + 5] = sinf(rel_heading) / MAX_ORIENTATION_RAD;
-            // // relative speed
-            float other_speed = sqrtf(other_entity->vx*other_entity->vx + other_entity->vy*other_entity->vy);
-            obs[obs_idx + 6] = other_speed / MAX_SPEED;
-            cars_seen++;
-            obs_idx += 7;  // Move to next observation slot
-        }
-        int remaining_partner_obs = (MAX_CARS - 1 - cars_seen) * 7;
-        memset(&obs[obs_idx], 0, remaining_partner_obs * sizeof(float));
-        obs_idx += remaining_partner_obs;
-        // map observations
-        int entity_list[MAX_ROAD_SEGMENT_OBSERVATIONS*2];  // Array big enough for all neighboring cells
-        int grid_idx = getGridIndex(env, ego_entity->x, ego_entity->y);
-        int list_size = get_neighbor_cache_entities(env, grid_idx, entity_list, MAX_ROAD_SEGMENT_OBSERVATIONS);
-        for(int k = 0; k < list_size; k++){
-            int entity_idx = entity_list[k*2];
-            int geometry_idx = entity_list[k*2+1];
-            Entity* entity = &env->entities[entity_idx];
-            float start_x = entity->traj_x[geometry_idx];
-            float start_y = entity->traj_y[geometry_idx];
-            float end_x = entity->traj_x[geometry_idx+1];
-            float end_y = entity->traj_y[geometry_idx+1];
-            float mid_x = (start_x + end_x) / 2.0f;
-            float mid_y = (start_y + end_y) / 2.0f;
-            float rel_x = mid_x - ego_entity->x;
-            float rel_y = mid_y - ego_entity->y;
-            float x_obs = rel_x*cos_heading + rel_y*sin_heading;
-            float y_obs = -rel_x*sin_heading + rel_y*cos_heading;
-            float length = relative_distance_2d(mid_x, mid_y, end_x, end_y);
-            float width = 0.1;
-            // Calculate angle from ego to midpoint (vector from ego to midpoint)
-            float dx = end_x - mid_x;
-            float dy = end_y - mid_y;
-            float dx_norm = dx;
-            float dy_norm = dy;
-            float hypot = sqrtf(dx*dx + dy*dy);
-            if(hypot > 0) {
-                dx_norm /= hypot;
-                dy_norm /= hypot;
-            }
-            // Compute sin and cos of relative angle directly without atan2f
-            float cos_angle = dx_norm*cos_heading + dy_norm*sin_heading;
-            float sin_angle = -dx_norm*sin_heading + dy_norm*cos_heading;
-            obs[obs_idx] = x_obs * 0.02f;
-            obs[obs_idx + 1] = y_obs * 0.02f;
-            obs[obs_idx + 2] = length / MAX_ROAD_SEGMENT_LENGTH;
-            obs[obs_idx + 3] = width / MAX_ROAD_SCALE;
-            obs[obs_idx + 4] = cos_angle;
-            obs[obs_idx + 5] = sin_angle;
-            obs[obs_idx + 6] = entity->type - 4.0f;
-            obs_idx += 7;
-        }
-        int remaining_obs = (MAX_ROAD_SEGMENT_OBSERVATIONS - list_size) * 7;
-        // Set the entire block to 0 at once
-        memset(&obs[obs_idx], 0, remaining_obs * sizeof(float));
+        obs[6] = (ego_entity->respawn_timestep != -1) ? 1 : 0;
+        int obs_idx = 7;
+        obs_idx += write_partner_obs(&cars, ego_entity, env->active_agent_indices[i], &obs[obs_idx]);
+        write_road_obs(env, &roads, ego_entity, &obs[obs_idx]);
     }
 }
 
 void c_reset(Drive* env){
     env->timestep = 0;
     set_start_position(env);
+    update_car_broadphase(env);
     for(int x = 0;x<env->active_agent_count; x++){
         env->logs[x] = (Log){0};
         int agent_idx = env->active_agent_indices[x];
@@ -1198,6 +1763,7 @@ void c_step(Drive* env){
         move_dynamics(env, i, agent_idx);
         // move_expert(env, env->actions, agent_idx);
     }
+    update_car_broadphase(env);
     for(int i = 0; i < env->active_agent_count; i++){
         int agent_idx = env->active_agent_indices[i];
         env->entities[agent_idx].collision_state = 0;
@@ -1297,7 +1863,7 @@ Client* make_client(Drive* env){
     client->cars[4] = LoadModel("resources/drive/GreenCar.glb");
     client->cars[5] = LoadModel("resources/drive/GreyCar.glb");
     for (int i = 0; i < MAX_CARS; i++) {
-        client->car_assignments[i] = (rand() % 4) + 1;
+        client->car_assignments[i] = puffer_randint(&env->rng, 0, 4) + 1;
     }
     // Get initial target position from first active agent
     float map_center_x = (env->map_corners[0] + env->map_corners[2]) / 2.0f;
@@ -1717,7 +2283,7 @@ void c_render(Drive* env) {
             // FPV Camera Control
             if(IsKeyDown(KEY_SPACE) && env->human_agent_idx== agent_index){
                 if(env->entities[agent_index].reached_goal){
-                    env->human_agent_idx = rand() % env->active_agent_count;
+                    env->human_agent_idx = puffer_randint(&env->rng, 0, env->active_agent_count);
                 }
                 Vector3 camera_position = (Vector3){
                         position.x - (25.0f * cosf(heading)),
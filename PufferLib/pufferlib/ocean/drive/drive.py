@@ -42,7 +42,8 @@ class Drive(pufferlib.PufferEnv):
         # )
         # Check if resources directory exists
         binary_path = "resources/drive/binaries/map_000.bin"
-        if not os.path.exists(binary_path):
+        scenario_path = "resources/drive/scenarios/map_000.scn"
+        if not os.path.exists(binary_path) and not os.path.exists(scenario_path):
             raise FileNotFoundError(f"Required directory {binary_path} not found. Please ensure the Drive maps are downloaded and installed correctly per docs.")
         agent_offsets, map_ids, num_envs = binding.shared(num_agents=num_agents, num_maps=num_maps)
         self.num_agents = num_agents
@@ -319,6 +320,22 @@ def process_all_maps():
         # except Exception as e:
         #     print(f"Error processing {map_path.name}: {e}")
 
+def convert_all_maps(road_index=False):
+    """Convert the map binaries to the compact scenario format, which envs
+    memory map and share instead of each reading their own copy. With
+    road_index, the road grid and neighbor caches are stored too (several
+    MB per map) so no process has to build them"""
+    from pathlib import Path
+
+    binary_dir = Path("resources/drive/binaries")
+    scenario_dir = Path("resources/drive/scenarios")
+    scenario_dir.mkdir(parents=True, exist_ok=True)
+    binary_files = sorted(binary_dir.glob("map_*.bin"))
+    print(f"Converting {len(binary_files)} maps")
+    for binary_path in binary_files:
+        scenario_path = scenario_dir / (binary_path.stem + ".scn")
+        binding.convert_map_binary(str(binary_path), str(scenario_path), road_index)
+
 def test_performance(timeout=10, atn_cache=1024, num_agents=1024):
     import time
 
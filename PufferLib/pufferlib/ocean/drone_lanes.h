@@ -0,0 +1,287 @@
+// Batched RK4 dynamics shared by the drone envs. Include after
+// dronelib.h: it uses that file's Drone, State and Params, clamp4, rndf,
+// DT and DT_RNG.
+#pragma once
+
+// Batched dynamics. Drones are gathered DRONE_LANES at a time into
+// structure of arrays lane groups and integrated together with GCC/clang
+// vector extensions, one drone per SIMD lane. Same model as rk4_step, with
+// the rotations of the thrust vector and body rates written out in closed
+// form and rpm^2 as a multiply.
+#define DRONE_LANES 16
+
+typedef float LaneF __attribute__((vector_size(DRONE_LANES*sizeof(float))));
+typedef int LaneI __attribute__((vector_size(DRONE_LANES*sizeof(int))));
+
+// Element l of a lane vector in memory. Scalar stores through this avoid
+// the load/insert/store GCC emits for v[l] on a vector in memory
+#define LANE(v, l) (((float*)&(v))[l])
+
+typedef struct {
+    LaneF pos[3];
+    LaneF vel[3];
+    LaneF quat[4];
+    LaneF omega[3];
+    LaneF rpms[4];
+} StateLanes;
+
+typedef struct {
+    LaneF mass;
+    LaneF ixx;
+    LaneF iyy;
+    LaneF izz;
+    LaneF arm_len;
+    LaneF k_thrust;
+    LaneF k_ang_damp;
+    LaneF k_drag;
+    LaneF b_drag;
+    LaneF gravity;
+    LaneF max_rpm;
+    LaneF max_vel;
+    LaneF max_omega;
+    LaneF k_mot;
+    LaneF j_mot;
+    LaneF actions[4];
+    LaneF dt;
+
+    // Reciprocals, filled once per step by rk4_step_lanes
+    LaneF inv_mass;
+    LaneF inv_ixx;
+    LaneF inv_iyy;
+    LaneF inv_izz;
+    LaneF inv_k_mot;
+} ParamsLanes;
+
+// Vectors are passed by pointer so the lane width does not leak into the
+// calling convention of non x86-64-v4 builds
+static inline __attribute__((always_inline)) void clamp_lanes(LaneF* v, const LaneF* max) {
+    LaneI lo = *v < -*max;
+    LaneI hi = *v > *max;
+    LaneI out = ((LaneI)*v & ~lo & ~hi) | ((LaneI)(-*max) & lo) | ((LaneI)*max & hi);
+    *v = (LaneF)out;
+}
+
+// 1/sqrt(x) from the bit level estimate plus 3 Newton steps, which lands
+// within float rounding for the quaternion norms seen here. Written in
+// vector arithmetic because sqrtf does not vectorize without -fno-math-errno
+static inline __attribute__((always_inline)) void rsqrt_lanes(const LaneF* x, LaneF* out) {
+    LaneF y = (LaneF)(0x5f3759df - ((LaneI)*x >> 1));
+    LaneF half_x = 0.5f * *x;
+    for (int i = 0; i < 3; i++) {
+        y = y * (1.5f - half_x * y * y);
+    }
+    *out = y;
+}
+
+// Derivatives are stored in a StateLanes: pos holds the velocity, vel the
+// acceleration and so on
+static inline __attribute__((always_inline)) void compute_derivatives_lanes(
+        const StateLanes* s, const ParamsLanes* p, StateLanes* d) {
+    LaneF qw = s->quat[0], qx = s->quat[1], qy = s->quat[2], qz = s->quat[3];
+    LaneF wx = s->omega[0], wy = s->omega[1], wz = s->omega[2];
+
+    // first order rpm lag and motor thrusts
+    LaneF T[4];
+    for (int i = 0; i < 4; i++) {
+        LaneF target_rpm = (p->actions[i] + 1.0f) * 0.5f * p->max_rpm;
+        d->rpms[i] = p->inv_k_mot * (target_rpm - s->rpms[i]);
+        T[i] = p->k_thrust * s->rpms[i] * s->rpms[i];
+    }
+    LaneF thrust = T[0] + T[1] + T[2] + T[3];
+
+    // body z thrust rotated to world frame, plus linear drag
+    LaneF fx = 2.0f * thrust * (qx*qz + qw*qy);
+    LaneF fy = 2.0f * thrust * (qy*qz - qw*qx);
+    LaneF fz = thrust * (qw*qw - qx*qx - qy*qy + qz*qz);
+    d->pos[0] = s->vel[0];
+    d->pos[1] = s->vel[1];
+    d->pos[2] = s->vel[2];
+    d->vel[0] = (fx - p->b_drag * s->vel[0]) * p->inv_mass;
+    d->vel[1] = (fy - p->b_drag * s->vel[1]) * p->inv_mass;
+    d->vel[2] = (fz - p->b_drag * s->vel[2]) * p->inv_mass - p->gravity;
+
+    // quaternion rates, 0.5 * q * (0, omega)
+    d->quat[0] = 0.5f * (-qx*wx - qy*wy - qz*wz);
+    d->quat[1] = 0.5f * (qw*wx + qy*wz - qz*wy);
+    d->quat[2] = 0.5f * (qw*wy - qx*wz + qz*wx);
+    d->quat[3] = 0.5f * (qw*wz + qx*wy - qy*wx);
+
+    // propeller, motor, damping and gyroscopic torques
+    LaneF tau_x = p->arm_len*(T[1] - T[3]) - p->k_ang_damp*wx + (p->iyy - p->izz)*wy*wz;
+    LaneF tau_y = p->arm_len*(T[2] - T[0]) - p->k_ang_damp*wy + (p->izz - p->ixx)*wz*wx;
+    LaneF tau_z = p->k_drag*(T[0] - T[1] + T[2] - T[3])
+        + p->j_mot*(d->rpms[0] - d->rpms[1] + d->rpms[2] - d->rpms[3])
+        - p->k_ang_damp*wz + (p->ixx - p->iyy)*wx*wy;
+    d->omega[0] = tau_x * p->inv_ixx;
+    d->omega[1] = tau_y * p->inv_iyy;
+    d->omega[2] = tau_z * p->inv_izz;
+}
+
+static inline __attribute__((always_inline)) void normalize_quat_lanes(StateLanes* s) {
+    LaneF n2 = s->quat[0]*s->quat[0] + s->quat[1]*s->quat[1]
+        + s->quat[2]*s->quat[2] + s->quat[3]*s->quat[3];
+    LaneF inv;
+    rsqrt_lanes(&n2, &inv);
+    for (int i = 0; i < 4; i++) {
+        s->quat[i] *= inv;
+    }
+}
+
+// out = initial + h*deriv, then renormalize the quaternion
+static inline __attribute__((always_inline)) void step_lanes(const StateLanes* initial,
+        const StateLanes* deriv, const LaneF* h, StateLanes* out) {
+    for (int i = 0; i < 3; i++) {
+        out->pos[i] = initial->pos[i] + deriv->pos[i] * *h;
+        out->vel[i] = initial->vel[i] + deriv->vel[i] * *h;
+        out->omega[i] = initial->omega[i] + deriv->omega[i] * *h;
+    }
+    for (int i = 0; i < 4; i++) {
+        out->quat[i] = initial->quat[i] + deriv->quat[i] * *h;
+        out->rpms[i] = initial->rpms[i] + deriv->rpms[i] * *h;
+    }
+    normalize_quat_lanes(out);
+}
+
+static inline __attribute__((always_inline)) void rk4_step_lanes_impl(
+        StateLanes* state, ParamsLanes* params) {
+    params->inv_mass = 1.0f / params->mass;
+    params->inv_ixx = 1.0f / params->ixx;
+    params->inv_iyy = 1.0f / params->iyy;
+    params->inv_izz = 1.0f / params->izz;
+    params->inv_k_mot = 1.0f / params->k_mot;
+
+    StateLanes k1, k2, k3, k4, temp;
+    LaneF half_dt = params->dt * 0.5f;
+    compute_derivatives_lanes(state, params, &k1);
+    step_lanes(state, &k1, &half_dt, &temp);
+    compute_derivatives_lanes(&temp, params, &k2);
+    step_lanes(state, &k2, &half_dt, &temp);
+    compute_derivatives_lanes(&temp, params, &k3);
+    step_lanes(state, &k3, &params->dt, &temp);
+    compute_derivatives_lanes(&temp, params, &k4);
+
+    // Every field of StateLanes gets the same update, so walk it flat
+    LaneF dt_6 = params->dt / 6.0f;
+    LaneF* x = (LaneF*)state;
+    const LaneF* d1 = (const LaneF*)&k1;
+    const LaneF* d2 = (const LaneF*)&k2;
+    const LaneF* d3 = (const LaneF*)&k3;
+    const LaneF* d4 = (const LaneF*)&k4;
+    for (int i = 0; i < (int)(sizeof(StateLanes)/sizeof(LaneF)); i++) {
+        x[i] += (d1[i] + 2.0f*d2[i] + 2.0f*d3[i] + d4[i]) * dt_6;
+    }
+    normalize_quat_lanes(state);
+
+    // clamp for observations
+    for (int i = 0; i < 3; i++) {
+        clamp_lanes(&state->vel[i], &params->max_vel);
+        clamp_lanes(&state->omega[i], &params->max_omega);
+    }
+}
+
+typedef void (*RK4LanesKernel)(StateLanes*, ParamsLanes*);
+
+void rk4_step_lanes_default(StateLanes* state, ParamsLanes* params) {
+    rk4_step_lanes_impl(state, params);
+}
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(__EMSCRIPTEN__)
+__attribute__((target("avx2,fma")))
+void rk4_step_lanes_avx2(StateLanes* state, ParamsLanes* params) {
+    rk4_step_lanes_impl(state, params);
+}
+
+__attribute__((target("avx512f")))
+void rk4_step_lanes_avx512(StateLanes* state, ParamsLanes* params) {
+    rk4_step_lanes_impl(state, params);
+}
+#endif
+
+// Widest kernel the CPU supports, picked on first use
+void rk4_step_lanes(StateLanes* state, ParamsLanes* params) {
+    static RK4LanesKernel kernel = NULL;
+    if (kernel == NULL) {
+        kernel = rk4_step_lanes_default;
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(__EMSCRIPTEN__)
+        if (__builtin_cpu_supports("avx512f")) {
+            kernel = rk4_step_lanes_avx512;
+        } else if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+            kernel = rk4_step_lanes_avx2;
+        }
+#endif
+    }
+    kernel(state, params);
+}
+
+// move_drone for n drones with actions laid out [n, 4]. Lanes past the
+// end of a partial group repeat the group's first drone and are dropped
+void move_drones(PufferRng* rng, Drone* drones, float* actions, int n) {
+    StateLanes state;
+    ParamsLanes params;
+    for (int start = 0; start < n; start += DRONE_LANES) {
+        int count = (n - start < DRONE_LANES) ? n - start : DRONE_LANES;
+        for (int l = 0; l < DRONE_LANES; l++) {
+            int idx = start + ((l < count) ? l : 0);
+            Drone* drone = &drones[idx];
+            float* atn = &actions[4*idx];
+            if (l < count) {
+                clamp4(atn, -1.0f, 1.0f);
+                // Skip the rand() call when dt is not randomized
+                LANE(params.dt, l) = (DT_RNG > 0.0f) ? DT * rndf(rng, 1.0f - DT_RNG, 1.0 + DT_RNG) : DT;
+                drone->prev_pos = drone->state.pos;
+            } else {
+                LANE(params.dt, l) = LANE(params.dt, 0);
+            }
+
+            State* s = &drone->state;
+            LANE(state.pos[0], l) = s->pos.x;
+            LANE(state.pos[1], l) = s->pos.y;
+            LANE(state.pos[2], l) = s->pos.z;
+            LANE(state.vel[0], l) = s->vel.x;
+            LANE(state.vel[1], l) = s->vel.y;
+            LANE(state.vel[2], l) = s->vel.z;
+            LANE(state.quat[0], l) = s->quat.w;
+            LANE(state.quat[1], l) = s->quat.x;
+            LANE(state.quat[2], l) = s->quat.y;
+            LANE(state.quat[3], l) = s->quat.z;
+            LANE(state.omega[0], l) = s->omega.x;
+            LANE(state.omega[1], l) = s->omega.y;
+            LANE(state.omega[2], l) = s->omega.z;
+            for (int i = 0; i < 4; i++) {
+                LANE(state.rpms[i], l) = s->rpms[i];
+                LANE(params.actions[i], l) = atn[i];
+            }
+
+            Params* p = &drone->params;
+            LANE(params.mass, l) = p->mass;
+            LANE(params.ixx, l) = p->ixx;
+            LANE(params.iyy, l) = p->iyy;
+            LANE(params.izz, l) = p->izz;
+            LANE(params.arm_len, l) = p->arm_len;
+            LANE(params.k_thrust, l) = p->k_thrust;
+            LANE(params.k_ang_damp, l) = p->k_ang_damp;
+            LANE(params.k_drag, l) = p->k_drag;
+            LANE(params.b_drag, l) = p->b_drag;
+            LANE(params.gravity, l) = p->gravity;
+            LANE(params.max_rpm, l) = p->max_rpm;
+            LANE(params.max_vel, l) = p->max_vel;
+            LANE(params.max_omega, l) = p->max_omega;
+            LANE(params.k_mot, l) = p->k_mot;
+            LANE(params.j_mot, l) = p->j_mot;
+        }
+
+        rk4_step_lanes(&state, &params);
+
+        for (int l = 0; l < count; l++) {
+            State* s = &drones[start + l].state;
+            s->pos = (Vec3){LANE(state.pos[0], l), LANE(state.pos[1], l), LANE(state.pos[2], l)};
+            s->vel = (Vec3){LANE(state.vel[0], l), LANE(state.vel[1], l), LANE(state.vel[2], l)};
+            s->quat = (Quat){LANE(state.quat[0], l), LANE(state.quat[1], l),
+                LANE(state.quat[2], l), LANE(state.quat[3], l)};
+            s->omega = (Vec3){LANE(state.omega[0], l), LANE(state.omega[1], l), LANE(state.omega[2], l)};
+            for (int i = 0; i < 4; i++) {
+                s->rpms[i] = LANE(state.rpms[i], l);
+            }
+        }
+    }
+}
@@ -5,8 +5,6 @@
 #include <time.h>
 
 int main(int argc, char* argv[]) {
-    srand(time(NULL));
-    
     printf("Drone Pick & Place Environment Demo\n");
     printf("====================================\n");
     printf("Controls:\n");
@@ -18,6 +16,7 @@ int main(int argc, char* argv[]) {
     printf("  ESC - Exit\n\n");
     
     DronePickPlace env = {0};
+    puffer_rng_seed(&env.rng, time(NULL));
     env.num_drones = 1;
     env.num_objects = 3;
     env.num_targets = 2;
@@ -61,7 +60,7 @@ int main(int argc, char* argv[]) {
         else if (IsKeyDown(KEY_R)) action = 8;  // GRIPPER_OPEN
 
         if (action == -1) {
-            action = rand() % 10;
+            action = puffer_randint(&env.rng, 0, 10);
         }
 
         for (int i = 0; i < env.num_drones; i++) {
@@ -9,6 +9,7 @@
 #include <stdint.h>
 #include <math.h>
 #include "raylib.h"
+#include "../rng.h"
 
 const uint8_t MOVE_FORWARD = 0;
 const uint8_t MOVE_BACKWARD = 1;
@@ -77,6 +78,7 @@ typedef struct {
 
 typedef struct {
     Log log; // Required field
+    PufferRng rng;
     Stats stats; // Track attempts and successes
     Client* client;
     Drone* drones; // Support multiple drones
@@ -124,8 +126,8 @@ void init(DronePickPlace* env) {
     env->place_distance = 0.35f; // todo set sweepable reduction over time for curriculum
 }
 
-float randf(float min, float max) {
-    return min + (max - min) * ((float)rand() / (float)RAND_MAX);
+float randf(PufferRng* rng, float min, float max) {
+    return min + (max - min) * ((float)puffer_rand(rng) / (float)RAND_MAX);
 }
 
 float distance3d(float x1, float y1, float z1, float x2, float y2, float z2) {
@@ -435,8 +437,8 @@ void c_reset(DronePickPlace* env) {
         int attempts = 0;
         while (1) {
             attempts++;
-            obj->x = randf(margin + obj->radius, world - margin - obj->radius);
-            obj->y = randf(margin + obj->radius, world - margin - obj->radius);
+            obj->x = randf(&env->rng, margin + obj->radius, world - margin - obj->radius);
+            obj->y = randf(&env->rng, margin + obj->radius, world - margin - obj->radius);
             obj->z = 0.1f;
 
             int ok = 1;
@@ -461,8 +463,8 @@ void c_reset(DronePickPlace* env) {
         int attempts = 0;
         while (1) {
             attempts++;
-            tgt->x = randf(margin + tgt->radius, world - margin - tgt->radius);
-            tgt->y = randf(margin + tgt->radius, world - margin - tgt->radius);
+            tgt->x = randf(&env->rng, margin + tgt->radius, world - margin - tgt->radius);
+            tgt->y = randf(&env->rng, margin + tgt->radius, world - margin - tgt->radius);
             tgt->z = 0.1f;
 
             int ok = 1;
@@ -494,15 +496,15 @@ void c_reset(DronePickPlace* env) {
         int attempts = 0;
         while (1) {
             attempts++;
-            drone->x = randf(margin + drone_clearance, world - margin - drone_clearance);
-            drone->y = randf(margin + drone_clearance, world - margin - drone_clearance);
+            drone->x = randf(&env->rng, margin + drone_clearance, world - margin - drone_clearance);
+            drone->y = randf(&env->rng, margin + drone_clearance, world - margin - drone_clearance);
 
             float z_lo = fminf(0.25f, zmax * 0.2f);
             float z_hi = fmaxf(0.6f, zmax * 0.8f);
             z_hi = fminf(z_hi, zmax - 0.05f);
             z_lo = fmaxf(z_lo, 0.15f);
             if (z_lo > z_hi) { z_lo = 0.2f; z_hi = fmaxf(0.4f, zmax * 0.6f); }
-            drone->z = randf(z_lo, z_hi);
+            drone->z = randf(&env->rng, z_lo, z_hi);
 
             int ok = 1;
 
@@ -531,7 +533,7 @@ void c_reset(DronePickPlace* env) {
         drone->vx = drone->vy = drone->vz = 0.0f;
         drone->wx = drone->wy = drone->wz = 0.0f;
 
-        drone->yaw = randf(-PI, PI);
+        drone->yaw = randf(&env->rng, -PI, PI);
         drone->pitch = 0.0f;
         drone->roll = 0.0f;
 
@@ -6,7 +6,7 @@
 #include <emscripten.h>
 #endif
 
-double randn(double mean, double std) {
+double randn(PufferRng* rng, double mean, double std) {
     static int has_spare = 0;
     static double spare;
 
@@ -18,8 +18,8 @@ double randn(double mean, double std) {
     has_spare = 1;
     double u, v, s;
     do {
-        u = 2.0 * rand() / RAND_MAX - 1.0;
-        v = 2.0 * rand() / RAND_MAX - 1.0;
+        u = 2.0 * puffer_rand(rng) / RAND_MAX - 1.0;
+        v = 2.0 * puffer_rand(rng) / RAND_MAX - 1.0;
         s = u * u + v * v;
     } while (s >= 1.0 || s == 0.0);
 
@@ -71,25 +71,26 @@ void free_linearcontlstm(LinearContLSTM *net) {
     free(net);
 }
 
-void forward_linearcontlstm(LinearContLSTM *net, float *observations, float *actions) {
+void forward_linearcontlstm(PufferRng* rng, LinearContLSTM *net, float *observations, float *actions) {
     linear(net->encoder, observations);
     gelu(net->gelu1, net->encoder->output);
     lstm(net->lstm, net->gelu1->output);
     linear(net->actor, net->lstm->state_h);
     linear(net->value_fn, net->lstm->state_h);
-    for (int i = 0; i < net->num_actions; i++) {
-        float std = expf(net->log_std[i]);
-        float mean = net->actor->output[i];
-        actions[i] = randn(mean, std);
+    for (int a = 0; a < net->num_agents; a++) {
+        for (int i = 0; i < net->num_actions; i++) {
+            int idx = a * net->num_actions + i;
+            actions[idx] = randn(rng, net->actor->output[idx], expf(net->log_std[i]));
+        }
     }
 }
 
 void generate_dummy_actions(DronePP *env) {
     // Generate random floats in [-1, 1] range
-    env->actions[0] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
-    env->actions[1] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
-    env->actions[2] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
-    env->actions[3] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+    env->actions[0] = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 2.0f - 1.0f;
+    env->actions[1] = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 2.0f - 1.0f;
+    env->actions[2] = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 2.0f - 1.0f;
+    env->actions[3] = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 2.0f - 1.0f;
 }
 
 #ifdef __EMSCRIPTEN__
@@ -104,7 +105,7 @@ void emscriptenStep(void *e) {
     DronePP *env = args->env;
     LinearContLSTM *net = args->net;
 
-    forward_linearcontlstm(net, env->observations, env->actions);
+    forward_linearcontlstm(&env->rng, net, env->observations, env->actions);
     c_step(env);
     c_render(env);
     return;
@@ -115,9 +116,8 @@ WebRenderArgs *web_args = NULL;
 
 int main() {
     //srand(time(NULL)); // Seed random number generator
-    srand(42); // Seed random number generator
-
     DronePP *env = calloc(1, sizeof(DronePP));
+    puffer_rng_seed(&env->rng, 42); // Seed random number generator
     env->num_agents = 64;
     env->max_rings = 10;
 
@@ -9,9 +9,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "../rng.h"
 
 #include "raylib.h"
 #include "dronelib.h"
+#include "../drone_lanes.h"
 
 #define TASK_IDLE 0
 #define TASK_HOVER 1
@@ -64,6 +66,67 @@ struct Client {
     Trail* trails;
 };
 
+// Uniform grid for nearest drone queries, fit to the drones' bounding box
+// on each rebuild with cells sized for about DRONE_GRID_PER_CELL drones,
+// so clustered swarms are split as finely as spread out ones. Drones are
+// counting sorted by cell with a packed copy of their positions, so a
+// query reads each cell contiguously. Drones that respawn between
+// rebuilds go on a small overflow list that every query scans. Drones
+// outside the box go in the border cells. Below DRONE_GRID_MIN_AGENTS the
+// full scan is faster and the grid is never built: bench_drone_nearest
+// puts the break even at about 128 agents, uniform or clustered
+#define DRONE_GRID_PER_CELL 2
+#ifndef DRONE_GRID_MIN_AGENTS
+#define DRONE_GRID_MIN_AGENTS 128
+#endif
+
+typedef struct {
+    float lo[3];
+    float cell_size;
+    float inv_cell;
+    int n[3];
+    int max_cells;
+    int* cell_start; // [max_cells + 1] first sorted slot of each cell
+    int* sorted; // [num_agents] drone in each sorted slot, -1 once moved
+    Vec3* sorted_pos; // [num_agents] position in each sorted slot
+    int* slot; // [num_agents] sorted slot of each drone, -1 if in overflow
+    int* overflow; // [num_agents] drones moved since the last rebuild
+    int num_overflow;
+    int* cell; // [num_agents] scratch for the counting sort
+} DroneGrid;
+
+void init_drone_grid(DroneGrid* grid, int num_agents) {
+    grid->max_cells = num_agents/DRONE_GRID_PER_CELL + 1;
+    grid->cell_start = calloc(grid->max_cells + 1, sizeof(int));
+    grid->sorted = calloc(num_agents, sizeof(int));
+    grid->sorted_pos = calloc(num_agents, sizeof(Vec3));
+    grid->slot = calloc(num_agents, sizeof(int));
+    grid->overflow = calloc(num_agents, sizeof(int));
+    grid->cell = calloc(num_agents, sizeof(int));
+    grid->n[0] = grid->n[1] = grid->n[2] = 1;
+    grid->cell_size = 1.0f;
+    grid->inv_cell = 1.0f;
+}
+
+void free_drone_grid(DroneGrid* grid) {
+    free(grid->cell_start);
+    free(grid->sorted);
+    free(grid->sorted_pos);
+    free(grid->slot);
+    free(grid->overflow);
+    free(grid->cell);
+}
+
+static inline int grid_coord(DroneGrid* grid, float v, int axis) {
+    float f = (v - grid->lo[axis]) * grid->inv_cell;
+    int n = grid->n[axis];
+    return (f < 0.0f) ? 0 : (f >= n) ? n - 1 : (int)f;
+}
+
+static inline int grid_cell(DroneGrid* grid, int cx, int cy, int cz) {
+    return (cz*grid->n[1] + cy)*grid->n[0] + cx;
+}
+
 typedef struct {
     float *observations;
     float *actions;
@@ -73,6 +136,7 @@ typedef struct {
     float dist;
 
     Log log;
+    PufferRng rng;
     int tick;
     int report_interval;
     bool render;
@@ -84,6 +148,8 @@ typedef struct {
     int max_rings;
     Ring* ring_buffer;
 
+    DroneGrid grid;
+
     int debug;
 
     float reward_min_dist;
@@ -112,6 +178,7 @@ void init(DronePP *env) {
     env->render = false;
     env->agents = calloc(env->num_agents, sizeof(Drone));
     env->ring_buffer = calloc(env->max_rings, sizeof(Ring));
+    init_drone_grid(&env->grid, env->num_agents);
     env->log = (Log){0};
     env->tick = 0;
 }
@@ -132,31 +199,180 @@ void add_log(DronePP *env, int idx, bool oob) {
     agent->episode_return = 0.0f;
 }
 
-Drone* nearest_drone(DronePP* env, Drone *agent) {
-    float min_dist = 999999.0f;
-    Drone *nearest = NULL;
+void build_grid(DronePP* env) {
+    if (env->num_agents < DRONE_GRID_MIN_AGENTS) {
+        return;
+    }
+    DroneGrid* grid = &env->grid;
+    float lo[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+    float hi[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
     for (int i = 0; i < env->num_agents; i++) {
-        Drone *other = &env->agents[i];
-        if (other == agent) {
-            continue;
+        float* pos = &env->agents[i].state.pos.x;
+        for (int a = 0; a < 3; a++) {
+            lo[a] = fminf(lo[a], pos[a]);
+            hi[a] = fmaxf(hi[a], pos[a]);
         }
-        float dx = agent->state.pos.x - other->state.pos.x;
-        float dy = agent->state.pos.y - other->state.pos.y;
-        float dz = agent->state.pos.z - other->state.pos.z;
-        float dist = sqrtf(dx*dx + dy*dy + dz*dz);
-        if (dist < min_dist) {
-            min_dist = dist;
-            nearest = other;
+    }
+
+    // Pad flat boxes so the cell size stays sane, then grow cells until
+    // the grid fits in max_cells
+    float extent[3];
+    for (int a = 0; a < 3; a++) {
+        extent[a] = fmaxf(hi[a] - lo[a], 1.0f);
+        grid->lo[a] = lo[a];
+    }
+    float cell_size = cbrtf(extent[0]*extent[1]*extent[2] / grid->max_cells);
+    int cells;
+    do {
+        cells = 1;
+        for (int a = 0; a < 3; a++) {
+            grid->n[a] = (int)(extent[a] / cell_size) + 1;
+            cells *= grid->n[a];
         }
+        cell_size *= 1.1f;
+    } while (cells > grid->max_cells);
+    grid->cell_size = cell_size / 1.1f;
+    grid->inv_cell = 1.0f / grid->cell_size;
+
+    // Counting sort by cell
+    memset(grid->cell_start, 0, (cells + 1)*sizeof(int));
+    for (int i = 0; i < env->num_agents; i++) {
+        Vec3 pos = env->agents[i].state.pos;
+        int cell = grid_cell(grid, grid_coord(grid, pos.x, 0),
+            grid_coord(grid, pos.y, 1), grid_coord(grid, pos.z, 2));
+        grid->cell[i] = cell;
+        grid->cell_start[cell + 1]++;
+    }
+    for (int c = 0; c < cells; c++) {
+        grid->cell_start[c + 1] += grid->cell_start[c];
+    }
+    for (int i = 0; i < env->num_agents; i++) {
+        int slot = grid->cell_start[grid->cell[i]]++;
+        grid->sorted[slot] = i;
+        grid->sorted_pos[slot] = env->agents[i].state.pos;
+        grid->slot[i] = slot;
+    }
+    // The scatter advanced each start to the next cell's start
+    for (int c = cells; c > 0; c--) {
+        grid->cell_start[c] = grid->cell_start[c - 1];
     }
-    if (nearest == NULL) {
-        int x = 0;
+    grid->cell_start[0] = 0;
+    grid->num_overflow = 0;
+}
 
+// Call after a drone's position changes outside of c_step's rebuild.
+// Rebuilds once the overflow list would make queries slow
+void move_in_grid(DronePP* env, int idx) {
+    DroneGrid* grid = &env->grid;
+    if (env->num_agents < DRONE_GRID_MIN_AGENTS || grid->slot[idx] == -1) {
+        return;
     }
-    return nearest;
+    if (grid->num_overflow >= 8 + env->num_agents/16) {
+        build_grid(env);
+        return;
+    }
+    grid->sorted[grid->slot[idx]] = -1;
+    grid->slot[idx] = -1;
+    grid->overflow[grid->num_overflow++] = idx;
 }
 
-void compute_observations(DronePP *env) {
+// Distance from p to the outside of the block of cells [c - r, c + r]
+// along one axis. Sides on the grid border have no cells past them
+static inline float grid_block_margin(DroneGrid* grid, float p, int c, int r, int axis) {
+    float margin = FLT_MAX;
+    if (c - r > 0) {
+        margin = p - (grid->lo[axis] + (c - r)*grid->cell_size);
+    }
+    if (c + r < grid->n[axis] - 1) {
+        margin = fminf(margin, grid->lo[axis] + (c + r + 1)*grid->cell_size - p);
+    }
+    return margin;
+}
+
+static inline void nearest_candidate(Vec3 pos, Vec3 other, int i, float* min_dist, int* nearest) {
+    float dx = pos.x - other.x;
+    float dy = pos.y - other.y;
+    float dz = pos.z - other.z;
+    float dist = dx*dx + dy*dy + dz*dz;
+    if (dist < *min_dist || (dist == *min_dist && i < *nearest)) {
+        *min_dist = dist;
+        *nearest = i;
+    }
+}
+
+// Searches shells of cells at increasing Chebyshev distance r from the
+// agent's cell, stopping once the best distance is closer than anything
+// outside the searched block can be. Ties go to the lower index, as in
+// the full scan
+Drone* nearest_drone(DronePP* env, Drone *agent) {
+    DroneGrid* grid = &env->grid;
+    int self = agent - env->agents;
+    Vec3 pos = agent->state.pos;
+    float min_dist = FLT_MAX;
+    int nearest = -1;
+    if (env->num_agents < DRONE_GRID_MIN_AGENTS) {
+        for (int i = 0; i < env->num_agents; i++) {
+            if (i != self) {
+                nearest_candidate(pos, env->agents[i].state.pos, i, &min_dist, &nearest);
+            }
+        }
+        return (nearest == -1) ? NULL : &env->agents[nearest];
+    }
+    for (int k = 0; k < grid->num_overflow; k++) {
+        int i = grid->overflow[k];
+        if (i != self) {
+            nearest_candidate(pos, env->agents[i].state.pos, i, &min_dist, &nearest);
+        }
+    }
+
+    int cx = grid_coord(grid, pos.x, 0);
+    int cy = grid_coord(grid, pos.y, 1);
+    int cz = grid_coord(grid, pos.z, 2);
+    int max_r = grid->n[0];
+    max_r = (grid->n[1] > max_r) ? grid->n[1] : max_r;
+    max_r = (grid->n[2] > max_r) ? grid->n[2] : max_r;
+    for (int r = 0; r < max_r; r++) {
+        for (int z = cz - r; z <= cz + r; z++) {
+            if (z < 0 || z >= grid->n[2]) {
+                continue;
+            }
+            for (int y = cy - r; y <= cy + r; y++) {
+                if (y < 0 || y >= grid->n[1]) {
+                    continue;
+                }
+                // Interior rows of the shell only touch its two x faces
+                bool face = (z == cz - r || z == cz + r || y == cy - r || y == cy + r);
+                int step = (face || r == 0) ? 1 : 2*r;
+                for (int x = cx - r; x <= cx + r; x += step) {
+                    if (x < 0 || x >= grid->n[0]) {
+                        continue;
+                    }
+                    int cell = grid_cell(grid, x, y, z);
+                    for (int s = grid->cell_start[cell]; s < grid->cell_start[cell + 1]; s++) {
+                        int i = grid->sorted[s];
+                        if (i != self && i != -1) {
+                            nearest_candidate(pos, grid->sorted_pos[s], i, &min_dist, &nearest);
+                        }
+                    }
+                }
+            }
+        }
+        if (nearest != -1) {
+            float bound = grid_block_margin(grid, pos.x, cx, r, 0);
+            bound = fminf(bound, grid_block_margin(grid, pos.y, cy, r, 1));
+            bound = fminf(bound, grid_block_margin(grid, pos.z, cz, r, 2));
+            if (bound == FLT_MAX || min_dist <= bound*bound) {
+                break;
+            }
+        }
+    }
+    return (nearest == -1) ? NULL : &env->agents[nearest];
+}
+
+// Task branches below take a compile time task, so each wrapper gets its
+// own copy of the loop with the branches folded away. Tasks other than
+// race and pp2 behave the same here and share the TASK_IDLE copy
+static inline __attribute__((always_inline)) void _compute_observations(DronePP *env, const int task) {
     int idx = 0;
     for (int i = 0; i < env->num_agents; i++) {
         Drone *agent = &env->agents[i];
@@ -224,7 +440,7 @@ void compute_observations(DronePP *env) {
         }
 
         // Ring obs
-        if (env->task == TASK_RACE) {
+        if (task == TASK_RACE) {
             Ring ring = env->ring_buffer[agent->ring_idx];
             Vec3 to_ring = quat_rotate(q_inv, sub3(ring.pos, agent->state.pos));
             Vec3 ring_norm = quat_rotate(q_inv, ring.normal);
@@ -235,7 +451,7 @@ void compute_observations(DronePP *env) {
             env->observations[idx++] = ring_norm.y;
             env->observations[idx++] = ring_norm.z;
             env->observations[idx++] = 0.0f; // TASK_PP2
-        } else if (env->task == TASK_PP2) {
+        } else if (task == TASK_PP2) {
             Vec3 to_box = quat_rotate(q_inv, sub3(agent->box_pos, agent->state.pos));
             Vec3 to_drop = quat_rotate(q_inv, sub3(agent->drop_pos, agent->state.pos));
             env->observations[idx++] = to_box.x / GRID_X;
@@ -245,7 +461,7 @@ void compute_observations(DronePP *env) {
             env->observations[idx++] = to_drop.y / GRID_Y;
             env->observations[idx++] = to_drop.z / GRID_Z;
             env->observations[idx++] = 1.0f; // TASK_PP2
-         } else {
+        } else {
             env->observations[idx++] = 0.0f;
             env->observations[idx++] = 0.0f;
             env->observations[idx++] = 0.0f;
@@ -257,6 +473,34 @@ void compute_observations(DronePP *env) {
     }
 }
 
+void compute_observations_target(DronePP *env) {
+    _compute_observations(env, TASK_IDLE);
+}
+
+void compute_observations_race(DronePP *env) {
+    _compute_observations(env, TASK_RACE);
+}
+
+void compute_observations_pp2(DronePP *env) {
+    _compute_observations(env, TASK_PP2);
+}
+
+void (*COMPUTE_OBSERVATIONS[TASK_N])(DronePP*) = {
+    compute_observations_target, // TASK_IDLE
+    compute_observations_target, // TASK_HOVER
+    compute_observations_target, // TASK_ORBIT
+    compute_observations_target, // TASK_FOLLOW
+    compute_observations_target, // TASK_CUBE
+    compute_observations_target, // TASK_CONGO
+    compute_observations_target, // TASK_FLAG
+    compute_observations_race, // TASK_RACE
+    compute_observations_pp2, // TASK_PP2
+};
+
+void compute_observations(DronePP *env) {
+    COMPUTE_OBSERVATIONS[env->task](env);
+}
+
 void move_target(DronePP* env, Drone *agent) {
     agent->target_pos.x += agent->target_vel.x;
     agent->target_pos.y += agent->target_vel.y;
@@ -276,8 +520,8 @@ void move_target(DronePP* env, Drone *agent) {
 
 void set_target_idle(DronePP* env, int idx) {
     Drone *agent = &env->agents[idx];
-    agent->target_pos = (Vec3){rndf(-MARGIN_X, MARGIN_X), rndf(-MARGIN_Y, MARGIN_Y), rndf(-MARGIN_Z, MARGIN_Z)};
-    agent->target_vel = (Vec3){rndf(-V_TARGET, V_TARGET), rndf(-V_TARGET, V_TARGET), rndf(-V_TARGET, V_TARGET)};
+    agent->target_pos = (Vec3){rndf(&env->rng, -MARGIN_X, MARGIN_X), rndf(&env->rng, -MARGIN_Y, MARGIN_Y), rndf(&env->rng, -MARGIN_Z, MARGIN_Z)};
+    agent->target_vel = (Vec3){rndf(&env->rng, -V_TARGET, V_TARGET), rndf(&env->rng, -V_TARGET, V_TARGET), rndf(&env->rng, -V_TARGET, V_TARGET)};
 }
 
 void set_target_hover(DronePP* env, int idx) {
@@ -397,10 +641,13 @@ void set_target(DronePP* env, int idx) {
     }
 }
 
-float compute_reward(DronePP* env, Drone *agent, bool collision) {
-    if (DEBUG > 0) printf("  Compute Reward\n");
+static inline __attribute__((always_inline)) float _compute_reward(DronePP* env,
+        Drone *agent, bool collision, const int task) {
+#if DEBUG > 0
+    printf("  Compute Reward\n");
+#endif
     Vec3 tgt = agent->target_pos;
-    if (env->task == TASK_PP2) tgt = agent->hidden_pos;
+    if (task == TASK_PP2) tgt = agent->hidden_pos;
 
     Vec3 pos_error = {agent->state.pos.x - tgt.x, agent->state.pos.y - tgt.y, agent->state.pos.z - tgt.z};
     float dist = sqrtf(pos_error.x * pos_error.x + pos_error.y * pos_error.y + pos_error.z * pos_error.z) + 0.00000001;
@@ -420,7 +667,9 @@ float compute_reward(DronePP* env, Drone *agent, bool collision) {
 
     // slight reward for 0.05 for example, large penalty for over 0.4
     float velocity_penalty = clampf(proximity_factor * (2.0f * expf(-(vel_magnitude - 0.05f) * 10.0f) - 1.0f), -1.0f, 1.0f);
-    if (DEBUG > 0) printf("    velocity_penalty = %.3f\n", velocity_penalty);
+#if DEBUG > 0
+    printf("    velocity_penalty = %.3f\n", velocity_penalty);
+#endif
 
     float stability_reward = -angular_vel_magnitude / agent->params.max_omega;
 
@@ -477,9 +726,16 @@ float compute_reward(DronePP* env, Drone *agent, bool collision) {
     return delta_reward;
 }
 
+float compute_reward(DronePP* env, Drone *agent, bool collision) {
+    if (env->task == TASK_PP2) {
+        return _compute_reward(env, agent, collision, TASK_PP2);
+    }
+    return _compute_reward(env, agent, collision, TASK_IDLE);
+}
+
 void reset_pp2(DronePP* env, Drone *agent, int idx) {
-    agent->box_pos = (Vec3){rndf(-MARGIN_X, MARGIN_X), rndf(-MARGIN_Y, MARGIN_Y), -GRID_Z + 0.5f};
-    agent->drop_pos = (Vec3){rndf(-MARGIN_X, MARGIN_X), rndf(-MARGIN_Y, MARGIN_Y), -GRID_Z + 0.5f};
+    agent->box_pos = (Vec3){rndf(&env->rng, -MARGIN_X, MARGIN_X), rndf(&env->rng, -MARGIN_Y, MARGIN_Y), -GRID_Z + 0.5f};
+    agent->drop_pos = (Vec3){rndf(&env->rng, -MARGIN_X, MARGIN_X), rndf(&env->rng, -MARGIN_Y, MARGIN_Y), -GRID_Z + 0.5f};
     agent->gripping = false;
     agent->delivered = false;
     agent->grip_height = 0.0f;
@@ -509,18 +765,19 @@ void reset_agent(DronePP* env, Drone *agent, int idx) {
 
     //float size = 0.2f;
     //init_drone(agent, size, 0.0f);
-    float size = rndf(0.1f, 0.4);
-    init_drone(agent, size, 0.1f);
+    float size = rndf(&env->rng, 0.1f, 0.4);
+    init_drone(&env->rng, agent, size, 0.1f);
     agent->color = FLAG_COLORS[idx];
     agent->color = (Color){255, 0, 0, 255};
 
     agent->state.pos = (Vec3){
-        rndf(-MARGIN_X, MARGIN_X),
-        rndf(-MARGIN_Y, MARGIN_Y),
-        rndf(-MARGIN_Z, MARGIN_Z)
+        rndf(&env->rng, -MARGIN_X, MARGIN_X),
+        rndf(&env->rng, -MARGIN_Y, MARGIN_Y),
+        rndf(&env->rng, -MARGIN_Z, MARGIN_Z)
     };
     agent->prev_pos = agent->state.pos;
     agent->spawn_pos = agent->state.pos;
+    move_in_grid(env, idx);
 
     if (env->task == TASK_PP2) {
         reset_pp2(env, agent, idx);
@@ -533,13 +790,14 @@ void c_reset(DronePP *env) {
     env->tick = 0;
     //env->task = rand() % (TASK_N - 1);
     
-    if (rand() % 4) {
+    if (puffer_randint(&env->rng, 0, 4)) {
         env->task = TASK_PP2; //CHOOSE TASK
     } else {
-        env->task = rand() % (TASK_N - 1);
+        env->task = puffer_randint(&env->rng, 0, TASK_N - 1);
     }
     env->task = TASK_PP2;
 
+    build_grid(env);
     for (int i = 0; i < env->num_agents; i++) {
         Drone *agent = &env->agents[i];
         reset_agent(env, agent, i);
@@ -552,189 +810,203 @@ void c_reset(DronePP *env) {
     }
     if (env->task == TASK_RACE) {
         float ring_radius = 2.0f;
-        reset_rings(env->ring_buffer, env->max_rings, ring_radius);
+        reset_rings(&env->rng, env->ring_buffer, env->max_rings, ring_radius);
 
         // start drone at least MARGIN away from the first ring
         for (int i = 0; i < env->num_agents; i++) {
             Drone *drone = &env->agents[i];
             do {
                 drone->state.pos = (Vec3){
-                    rndf(-MARGIN_X, MARGIN_X), 
-                    rndf(-MARGIN_Y, MARGIN_Y), 
-                    rndf(-MARGIN_Z, MARGIN_Z)
+                    rndf(&env->rng, -MARGIN_X, MARGIN_X), 
+                    rndf(&env->rng, -MARGIN_Y, MARGIN_Y), 
+                    rndf(&env->rng, -MARGIN_Z, MARGIN_Z)
                 };
             } while (norm3(sub3(drone->state.pos, env->ring_buffer[0].pos)) < 2.0f*ring_radius);
         }
+        build_grid(env);
     }
  
     compute_observations(env);
 }
 
-void c_step(DronePP *env) {
-    env->tick = (env->tick + 1) % HORIZON;
-    //env->log.dist = 0.0f;
-    //env->log.dist100 = 0.0f;
-    for (int i = 0; i < env->num_agents; i++) {
-        Drone *agent = &env->agents[i];
-        env->rewards[i] = 0;
-        env->terminals[i] = 0;
-
-        float* atn = &env->actions[4*i];
-        move_drone(agent, atn);
-
-        bool out_of_bounds = agent->state.pos.x < -GRID_X || agent->state.pos.x > GRID_X ||
-                             agent->state.pos.y < -GRID_Y || agent->state.pos.y > GRID_Y ||
-                             agent->state.pos.z < -GRID_Z || agent->state.pos.z > GRID_Z;
-
-        if (!(env->task == TASK_PP2)) move_target(env, agent);
+static inline float norm_xy(Vec3 a) { return sqrtf(a.x*a.x + a.y*a.y); }
+
+static inline __attribute__((always_inline)) float step_race(DronePP* env, Drone *agent, int i) {
+    Ring *ring = &env->ring_buffer[agent->ring_idx];
+    float reward = _compute_reward(env, agent, true, TASK_RACE);
+    float passed_ring = check_ring(agent, ring);
+    if (passed_ring > 0) {
+        agent->ring_idx = (agent->ring_idx + 1) % env->max_rings;
+        env->log.rings_passed += 1.0f;
+        set_target_race(env, i);
+        _compute_reward(env, agent, true, TASK_RACE);
+    }
+    return reward + passed_ring;
+}
 
-        float reward = 0.0f;
-        if (env->task == TASK_RACE) {
-            Ring *ring = &env->ring_buffer[agent->ring_idx];
-            reward = compute_reward(env, agent, true);
-            float passed_ring = check_ring(agent, ring);
-            if (passed_ring > 0) {
-                agent->ring_idx = (agent->ring_idx + 1) % env->max_rings;
-                env->log.rings_passed += 1.0f;
-                set_target(env, i);
-                compute_reward(env, agent, true);
-            }
-            reward += passed_ring;
-        // =========================================================================================================================================
-        // =========================================================================================================================================
-        // =========================================================================================================================================
-        } else if (env->task == TASK_PP2) {
-            if (DEBUG > 0) printf("\n\n===%d===\n", env->tick);
-            agent->hidden_pos.x += agent->hidden_vel.x * DT;
-            agent->hidden_pos.y += agent->hidden_vel.y * DT;
-            agent->hidden_pos.z += agent->hidden_vel.z * DT;
-            if (agent->hidden_pos.z < agent->target_pos.z) {
-                agent->hidden_pos.z = agent->target_pos.z;
-                agent->hidden_vel.z = 0.0f;
-            }
-            agent->approaching_pickup = true;
-            float speed = norm3(agent->state.vel);
-            env->grip_k = clampf(env->tick * -env->grip_k_decay + env->grip_k_max, env->grip_k_min, 100.0f);
-            float k = env->grip_k;
-            if (DEBUG > 0) printf("  PP2\n");
-            if (DEBUG > 0) printf("    K = %.3f\n", k);
-            if (DEBUG > 0) printf("    Hidden = %.3f %.3f %.3f\n", agent->hidden_pos.x, agent->hidden_pos.y, agent->hidden_pos.z);
-            if (DEBUG > 0) printf("    HiddenV = %.3f %.3f %.3f\n", agent->hidden_vel.x, agent->hidden_vel.y, agent->hidden_vel.z);
-            if (DEBUG > 0) printf("    speed = %.3f\n", speed);
-            if (!agent->gripping) {
-                float dist_to_hidden = sqrtf(powf(agent->state.pos.x - agent->hidden_pos.x, 2) +
-                                            powf(agent->state.pos.y - agent->hidden_pos.y, 2) +
-                                            powf(agent->state.pos.z - agent->hidden_pos.z, 2));
-                float xy_dist_to_box = sqrtf(powf(agent->state.pos.x - agent->box_pos.x, 2) +
-                                            powf(agent->state.pos.y - agent->box_pos.y, 2));
-                float z_dist_above_box = agent->state.pos.z - agent->box_pos.z;
-
-                // Phase 1 Box Hover
-                if (!agent->hovering_pickup) {
-                    if (DEBUG > 0) printf("  Phase1\n");
-                    if (DEBUG > 0) printf("    dist_to_hidden = %.3f\n", dist_to_hidden);
-                    if (DEBUG > 0) printf("    xy_dist_to_box = %.3f\n", xy_dist_to_box);
-                    if (DEBUG > 0) printf("    z_dist_above_box = %.3f\n", z_dist_above_box);
-                    if (dist_to_hidden < 0.4f && speed < 0.4f) {
-                        agent->hovering_pickup = true;
-                        agent->color = (Color){255, 255, 255, 255}; // White
-                    } else {
-                        if (!agent->has_delivered) {
-                            agent->color = (Color){255, 100, 100, 255}; // Light Red
-                        }
-                    }
+static inline __attribute__((always_inline)) float step_pp2(DronePP* env, Drone *agent, int i) {
+    float reward = 0.0f;
+#if DEBUG > 0
+    printf("\n\n===%d===\n", env->tick);
+#endif
+    agent->hidden_pos.x += agent->hidden_vel.x * DT;
+    agent->hidden_pos.y += agent->hidden_vel.y * DT;
+    agent->hidden_pos.z += agent->hidden_vel.z * DT;
+    if (agent->hidden_pos.z < agent->target_pos.z) {
+        agent->hidden_pos.z = agent->target_pos.z;
+        agent->hidden_vel.z = 0.0f;
+    }
+    agent->approaching_pickup = true;
+    float speed = norm3(agent->state.vel);
+    env->grip_k = clampf(env->tick * -env->grip_k_decay + env->grip_k_max, env->grip_k_min, 100.0f);
+    float k = env->grip_k;
+#if DEBUG > 0
+    printf("  PP2\n");
+    printf("    K = %.3f\n", k);
+    printf("    Hidden = %.3f %.3f %.3f\n", agent->hidden_pos.x, agent->hidden_pos.y, agent->hidden_pos.z);
+    printf("    HiddenV = %.3f %.3f %.3f\n", agent->hidden_vel.x, agent->hidden_vel.y, agent->hidden_vel.z);
+    printf("    speed = %.3f\n", speed);
+#endif
+    if (!agent->gripping) {
+        float dist_to_hidden = norm3(sub3(agent->state.pos, agent->hidden_pos));
+        Vec3 to_box = sub3(agent->state.pos, agent->box_pos);
+        float xy_dist_to_box = norm_xy(to_box);
+        float z_dist_above_box = to_box.z;
+
+        // Phase 1 Box Hover
+        if (!agent->hovering_pickup) {
+#if DEBUG > 0
+            printf("  Phase1\n");
+            printf("    dist_to_hidden = %.3f\n", dist_to_hidden);
+            printf("    xy_dist_to_box = %.3f\n", xy_dist_to_box);
+            printf("    z_dist_above_box = %.3f\n", z_dist_above_box);
+#endif
+            if (dist_to_hidden < 0.4f && speed < 0.4f) {
+                agent->hovering_pickup = true;
+                agent->color = (Color){255, 255, 255, 255}; // White
+            } else {
+                if (!agent->has_delivered) {
+                    agent->color = (Color){255, 100, 100, 255}; // Light Red
                 }
+            }
+        }
 
-                // Phase 2 Box Descent
-                else {
-                    agent->descent_pickup = true;
-                    agent->hidden_vel = (Vec3){0.0f, 0.0f, -0.1f};
-                    if (DEBUG > 0) printf("  GRIP\n");
-                    if (DEBUG > 0) printf("    xy_dist_to_box = %.3f\n", xy_dist_to_box);
-                    if (DEBUG > 0) printf("    z_dist_above_box = %.3f\n", z_dist_above_box);
-                    if (DEBUG > 0) printf("    speed = %.3f\n", speed);
-                    if (DEBUG > 0) printf("    agent->state.vel.z = %.3f\n", agent->state.vel.z);
-                    if (
-                        xy_dist_to_box < k * 0.1f &&
-                        z_dist_above_box < k * 0.1f && z_dist_above_box > 0.0f &&
-                        speed < k * 0.1f &&
-                        agent->state.vel.z > k * -0.05f && agent->state.vel.z < 0.0f
-                    ) {
-                        if (k < 1.01) {
-                            agent->perfect_grip = true;
-                            agent->color = (Color){100, 100, 255, 255}; // Light Blue
-                        }
-                        agent->gripping = true;
-                        reward += 1.0f;
-                    } else if (dist_to_hidden > 0.4f || speed > 0.4f) {
-                        agent->color = (Color){255, 100, 100, 255}; // Light Red
-                    }
+        // Phase 2 Box Descent
+        else {
+            agent->descent_pickup = true;
+            agent->hidden_vel = (Vec3){0.0f, 0.0f, -0.1f};
+#if DEBUG > 0
+            printf("  GRIP\n");
+            printf("    xy_dist_to_box = %.3f\n", xy_dist_to_box);
+            printf("    z_dist_above_box = %.3f\n", z_dist_above_box);
+            printf("    speed = %.3f\n", speed);
+            printf("    agent->state.vel.z = %.3f\n", agent->state.vel.z);
+#endif
+            if (
+                xy_dist_to_box < k * 0.1f &&
+                z_dist_above_box < k * 0.1f && z_dist_above_box > 0.0f &&
+                speed < k * 0.1f &&
+                agent->state.vel.z > k * -0.05f && agent->state.vel.z < 0.0f
+            ) {
+                if (k < 1.01) {
+                    agent->perfect_grip = true;
+                    agent->color = (Color){100, 100, 255, 255}; // Light Blue
                 }
-            } else {
+                agent->gripping = true;
+                reward += 1.0f;
+            } else if (dist_to_hidden > 0.4f || speed > 0.4f) {
+                agent->color = (Color){255, 100, 100, 255}; // Light Red
+            }
+        }
+    } else {
 
-                // Phase 3 Drop Hover
-                agent->box_pos = agent->state.pos;
-                agent->box_pos.z -= 0.5f;
-                agent->target_pos = agent->drop_pos;
-                float xy_dist_to_drop = sqrtf(powf(agent->state.pos.x - agent->drop_pos.x, 2) +
-                                            powf(agent->state.pos.y - agent->drop_pos.y, 2));
-                float z_dist_above_drop = agent->state.pos.z - agent->drop_pos.z;
-                if (!agent->hovering_drop) {
-                    agent->target_pos = (Vec3){agent->drop_pos.x, agent->drop_pos.y, agent->drop_pos.z + 0.4f};
-                    agent->hidden_pos = (Vec3){agent->drop_pos.x, agent->drop_pos.y, agent->drop_pos.z + 1.0f};
-                    agent->hidden_vel = (Vec3){0.0f, 0.0f, 0.0f};
-                    if (xy_dist_to_drop < k * 0.4f && z_dist_above_drop > 0.7f && z_dist_above_drop < 1.3f) {
-                        agent->hovering_drop = true;
-                        reward += 0.25;
-                        agent->color = (Color){0, 0, 255, 255}; // Blue
-                    }
-                }
+        // Phase 3 Drop Hover
+        agent->box_pos = agent->state.pos;
+        agent->box_pos.z -= 0.5f;
+        agent->target_pos = agent->drop_pos;
+        Vec3 to_drop = sub3(agent->state.pos, agent->drop_pos);
+        float xy_dist_to_drop = norm_xy(to_drop);
+        float z_dist_above_drop = to_drop.z;
+        if (!agent->hovering_drop) {
+            agent->target_pos = (Vec3){agent->drop_pos.x, agent->drop_pos.y, agent->drop_pos.z + 0.4f};
+            agent->hidden_pos = (Vec3){agent->drop_pos.x, agent->drop_pos.y, agent->drop_pos.z + 1.0f};
+            agent->hidden_vel = (Vec3){0.0f, 0.0f, 0.0f};
+            if (xy_dist_to_drop < k * 0.4f && z_dist_above_drop > 0.7f && z_dist_above_drop < 1.3f) {
+                agent->hovering_drop = true;
+                reward += 0.25;
+                agent->color = (Color){0, 0, 255, 255}; // Blue
+            }
+        }
 
-                // Phase 4 Drop Descent
-                else {
-                    agent->target_pos = agent->drop_pos;
-                    agent->hidden_pos.x = agent->drop_pos.x;
-                    agent->hidden_pos.y = agent->drop_pos.y;
-                    agent->hidden_vel = (Vec3){0.0f, 0.0f, -0.1f};
-                    if (xy_dist_to_drop < k * 0.2f && z_dist_above_drop < k * 0.2f) {
-                        agent->hovering_pickup = false;
-                        agent->gripping = false;
-                        agent->hovering_drop = false;
-                        reward += 1.0f;
-                        agent->delivered = true;
-                        agent->has_delivered = true;
-                        if (k < 1.01f && agent->perfect_grip) {
-                            agent->perfect_deliv = true;
-                            agent->color = (Color){0, 255, 0, 255}; // Green
-                        }
-                        reset_pp2(env, agent, i);
-                    }
+        // Phase 4 Drop Descent
+        else {
+            agent->target_pos = agent->drop_pos;
+            agent->hidden_pos.x = agent->drop_pos.x;
+            agent->hidden_pos.y = agent->drop_pos.y;
+            agent->hidden_vel = (Vec3){0.0f, 0.0f, -0.1f};
+            if (xy_dist_to_drop < k * 0.2f && z_dist_above_drop < k * 0.2f) {
+                agent->hovering_pickup = false;
+                agent->gripping = false;
+                agent->hovering_drop = false;
+                reward += 1.0f;
+                agent->delivered = true;
+                agent->has_delivered = true;
+                if (k < 1.01f && agent->perfect_grip) {
+                    agent->perfect_deliv = true;
+                    agent->color = (Color){0, 255, 0, 255}; // Green
                 }
+                reset_pp2(env, agent, i);
             }
+        }
+    }
 
-            reward += compute_reward(env, agent, true);
-
-            for (int i = 0; i < env->num_agents; i++) {
-                Drone *a = &env->agents[i];
-                env->log.dist += env->dist;
-                env->log.dist100 += 100 - env->dist;
-                env->log.jitter += a->jitter;
-                if (a->approaching_pickup) env->log.to_pickup += 1.0f;
-                if (a->hovering_pickup) env->log.ho_pickup += 1.0f;
-                if (a->descent_pickup) env->log.de_pickup += 1.0f;
-                if (a->gripping) env->log.gripping += 1.0f;
-                if (a->delivered) env->log.delivered += 1.0f;
-                if (a->perfect_grip && env->grip_k < 1.01f) env->log.perfect_grip += 1.0f;
-                if (a->perfect_deliv && env->grip_k < 1.01f && a->perfect_grip) env->log.perfect_deliv += 1.0f;
-                if (a->approaching_drop) env->log.to_drop += 1.0f;
-                if (a->hovering_drop) env->log.ho_drop += 1.0f;
-            }
-        // =========================================================================================================================================
-        // =========================================================================================================================================
-        // =========================================================================================================================================
+    reward += _compute_reward(env, agent, true, TASK_PP2);
+    return reward;
+}
+
+// Pick and place phase counts, once per step after every agent has stepped.
+// Running this inside step_pp2 made each step O(N^2) and counted every
+// agent N times.
+void log_pp2(DronePP* env) {
+    for (int i = 0; i < env->num_agents; i++) {
+        Drone *a = &env->agents[i];
+        env->log.dist += env->dist;
+        env->log.dist100 += 100 - env->dist;
+        env->log.jitter += a->jitter;
+        if (a->approaching_pickup) env->log.to_pickup += 1.0f;
+        if (a->hovering_pickup) env->log.ho_pickup += 1.0f;
+        if (a->descent_pickup) env->log.de_pickup += 1.0f;
+        if (a->gripping) env->log.gripping += 1.0f;
+        if (a->delivered) env->log.delivered += 1.0f;
+        if (a->perfect_grip && env->grip_k < 1.01f) env->log.perfect_grip += 1.0f;
+        if (a->perfect_deliv && env->grip_k < 1.01f && a->perfect_grip) env->log.perfect_deliv += 1.0f;
+        if (a->approaching_drop) env->log.to_drop += 1.0f;
+        if (a->hovering_drop) env->log.ho_drop += 1.0f;
+    }
+}
+
+// Per agent half of c_step, specialized on a compile time task like
+// _compute_observations
+static inline __attribute__((always_inline)) void _step_agents(DronePP *env, const int task) {
+    for (int i = 0; i < env->num_agents; i++) {
+        Drone *agent = &env->agents[i];
+        env->rewards[i] = 0;
+        env->terminals[i] = 0;
+
+        bool out_of_bounds = agent->state.pos.x < -GRID_X || agent->state.pos.x > GRID_X ||
+                             agent->state.pos.y < -GRID_Y || agent->state.pos.y > GRID_Y ||
+                             agent->state.pos.z < -GRID_Z || agent->state.pos.z > GRID_Z;
+
+        float reward;
+        if (task == TASK_RACE) {
+            move_target(env, agent);
+            reward = step_race(env, agent, i);
+        } else if (task == TASK_PP2) {
+            reward = step_pp2(env, agent, i);
         } else {
             // Delta reward
-            reward = compute_reward(env, agent, true);
+            move_target(env, agent);
+            reward = _compute_reward(env, agent, true, task);
         }
 
         env->rewards[i] += reward;
@@ -755,6 +1027,45 @@ void c_step(DronePP *env) {
             add_log(env, i, false);
         }
     }
+    if (task == TASK_PP2) {
+        log_pp2(env);
+    }
+}
+
+void step_agents_target(DronePP *env) {
+    _step_agents(env, TASK_IDLE);
+}
+
+void step_agents_race(DronePP *env) {
+    _step_agents(env, TASK_RACE);
+}
+
+void step_agents_pp2(DronePP *env) {
+    _step_agents(env, TASK_PP2);
+}
+
+void (*STEP_AGENTS[TASK_N])(DronePP*) = {
+    step_agents_target, // TASK_IDLE
+    step_agents_target, // TASK_HOVER
+    step_agents_target, // TASK_ORBIT
+    step_agents_target, // TASK_FOLLOW
+    step_agents_target, // TASK_CUBE
+    step_agents_target, // TASK_CONGO
+    step_agents_target, // TASK_FLAG
+    step_agents_race, // TASK_RACE
+    step_agents_pp2, // TASK_PP2
+};
+
+void c_step(DronePP *env) {
+    env->tick = (env->tick + 1) % HORIZON;
+    //env->log.dist = 0.0f;
+    //env->log.dist100 = 0.0f;
+
+    // All drones integrate before any rewards, so each agent's reward sees
+    // every other drone at its post-step position
+    move_drones(&env->rng, env->agents, env->actions, env->num_agents);
+    build_grid(env);
+    STEP_AGENTS[env->task](env);
     if (env->tick >= HORIZON - 1) {
         c_reset(env);
     }
@@ -768,6 +1079,7 @@ void c_close_client(Client *client) {
 }
 
 void c_close(DronePP *env) {
+    free_drone_grid(&env->grid);
     if (env->client != NULL) {
         c_close_client(env->client);
     }
@@ -920,7 +1232,7 @@ void c_render(DronePP *env) {
         }
         if (env->task == TASK_RACE) {
             float ring_radius = 2.0f;
-            reset_rings(env->ring_buffer, env->max_rings, ring_radius);
+            reset_rings(&env->rng, env->ring_buffer, env->max_rings, ring_radius);
         }
     }
 
@@ -28,6 +28,8 @@ class DronePP(pufferlib.PufferEnv):
         grip_k_max=15.0,
         grip_k_decay=0.095,
 
+        num_threads=1,
+        num_buffers=1,
         render_mode=None,
         report_interval=1024,
         buf=None,
@@ -44,7 +46,13 @@ class DronePP(pufferlib.PufferEnv):
             low=-1, high=1, shape=(4,), dtype=np.float32
         )
 
+        if num_envs % num_buffers != 0:
+            raise pufferlib.APIUsageError('num_envs must be divisible by num_buffers')
+
         self.num_agents = num_envs*num_drones
+        self.num_buffers = num_buffers
+        self.agents_per_batch = self.num_agents // num_buffers
+        self.buffer_idx = 0
         self.render_mode = render_mode
         self.report_interval = report_interval
         self.tick = 0
@@ -82,32 +90,76 @@ class DronePP(pufferlib.PufferEnv):
                 grip_k_decay=grip_k_decay
             ))
 
-        self.c_envs = binding.vectorize(*c_envs)
+        # Each buffer is its own vec env so one can step in the
+        # background while the policy runs on the other (send/recv)
+        envs_per_buffer = num_envs // num_buffers
+        self.c_buffers = [
+            binding.vectorize(
+                *c_envs[b*envs_per_buffer:(b+1)*envs_per_buffer],
+                num_threads=num_threads
+            )
+            for b in range(num_buffers)
+        ]
+        self.c_envs = self.c_buffers[0]
 
     def reset(self, seed=None):
         self.tick = 0
-        binding.vec_reset(self.c_envs, seed)
+        self.buffer_idx = 0
+        for b, c_envs in enumerate(self.c_buffers):
+            binding.vec_wait(c_envs)
+            binding.vec_reset(c_envs, seed if seed is None else seed*self.num_buffers + b)
+
         return self.observations, []
 
     def step(self, actions):
         self.actions[:] = actions
 
         self.tick += 1
-        binding.vec_step(self.c_envs)
+        for c_envs in self.c_buffers:
+            binding.vec_wait(c_envs)
+            binding.vec_step(c_envs)
 
         info = []
         if self.tick % self.report_interval == 0:
-            log_data = binding.vec_log(self.c_envs)
-            if log_data:
-                info.append(log_data)
+            for c_envs in self.c_buffers:
+                log_data = binding.vec_log(c_envs)
+                if log_data:
+                    info.append(log_data)
 
         return (self.observations, self.rewards, self.terminals, self.truncations, info)
 
+    def send(self, actions):
+        b = self.buffer_idx
+        n = self.agents_per_batch
+        self.actions[b*n:(b+1)*n] = actions
+        binding.vec_step_async(self.c_buffers[b])
+
+        self.buffer_idx = (b + 1) % self.num_buffers
+        if self.buffer_idx == 0:
+            self.tick += 1
+
+    def recv(self):
+        b = self.buffer_idx
+        c_envs = self.c_buffers[b]
+        binding.vec_wait(c_envs)
+
+        self.infos = []
+        if self.tick % self.report_interval == 0:
+            log_data = binding.vec_log(c_envs)
+            if log_data:
+                self.infos.append(log_data)
+
+        n = self.agents_per_batch
+        batch = slice(b*n, (b+1)*n)
+        return (self.observations[batch], self.rewards[batch], self.terminals[batch],
+            self.truncations[batch], self.infos, self.agent_ids[batch], self.masks[batch])
+
     def render(self):
         binding.vec_render(self.c_envs, 0)
 
     def close(self):
-        binding.vec_close(self.c_envs)
+        for c_envs in self.c_buffers:
+            binding.vec_close(c_envs)
 
 def test_performance(timeout=10, atn_cache=1024):
     env = DronePP(num_envs=1000)
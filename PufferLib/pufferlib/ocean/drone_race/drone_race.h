@@ -36,6 +36,7 @@ struct DroneRace {
     unsigned char *terminals;
 
     Log log;
+    PufferRng rng;
     int tick;
     int report_interval;
     int score;
@@ -133,18 +134,18 @@ void c_reset(DroneRace *env) {
     // creates rings
     env->ring_idx = 0;
     float ring_radius = 2.0f;
-    reset_rings(env->ring_buffer, env->max_rings, ring_radius);
+    reset_rings(&env->rng, env->ring_buffer, env->max_rings, ring_radius);
 
     // creates drone
     Drone *drone = &env->drone;
-    float size = rndf(0.05f, 0.8f);
-    init_drone(drone, size, 0.1f);
+    float size = rndf(&env->rng, 0.05f, 0.8f);
+    init_drone(&env->rng, drone, size, 0.1f);
 
     do {
         drone->state.pos = (Vec3){
-            rndf(-MARGIN_X, MARGIN_X), 
-            rndf(-MARGIN_Y, MARGIN_Y), 
-            rndf(-MARGIN_Z, MARGIN_Z)
+            rndf(&env->rng, -MARGIN_X, MARGIN_X), 
+            rndf(&env->rng, -MARGIN_Y, MARGIN_Y), 
+            rndf(&env->rng, -MARGIN_Z, MARGIN_Z)
         };
     } while (norm3(sub3(drone->state.pos, env->ring_buffer[0].pos)) < 2.0f*ring_radius);
 
@@ -160,7 +161,7 @@ void c_step(DroneRace *env) {
     env->log.score = 0;
 
     Drone *drone = &env->drone;
-    move_drone(drone, env->actions);
+    move_drone(&env->rng, drone, env->actions);
 
     // check out of bounds
     bool out_of_bounds = drone->state.pos.x < -GRID_X || drone->state.pos.x > GRID_X ||
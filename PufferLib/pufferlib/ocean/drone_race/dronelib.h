@@ -9,6 +9,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "../rng.h"
 
 #include "raylib.h"
 
@@ -78,8 +79,8 @@ static inline float clampf(float v, float min, float max) {
     return v;
 }
 
-static inline float rndf(float a, float b) {
-    return a + ((float)rand() / (float)RAND_MAX) * (b - a);
+static inline float rndf(PufferRng* rng, float a, float b) {
+    return a + ((float)puffer_rand(rng) / (float)RAND_MAX) * (b - a);
 }
 
 static inline Vec3 add3(Vec3 a, Vec3 b) { return (Vec3){a.x + b.x, a.y + b.y, a.z + b.z}; }
@@ -138,10 +139,10 @@ static inline Vec3 quat_rotate(Quat q, Vec3 v) {
 
 static inline Quat quat_inverse(Quat q) { return (Quat){q.w, -q.x, -q.y, -q.z}; }
 
-Quat rndquat() {
-    float u1 = rndf(0.0f, 1.0f);
-    float u2 = rndf(0.0f, 1.0f);
-    float u3 = rndf(0.0f, 1.0f);
+Quat rndquat(PufferRng* rng) {
+    float u1 = rndf(rng, 0.0f, 1.0f);
+    float u2 = rndf(rng, 0.0f, 1.0f);
+    float u3 = rndf(rng, 0.0f, 1.0f);
 
     float sqrt_1_minus_u1 = sqrtf(1.0f - u1);
     float sqrt_u1 = sqrtf(u1);
@@ -165,14 +166,14 @@ typedef struct {
     float radius;
 } Ring;
 
-Ring rndring(float radius) {
+Ring rndring(PufferRng* rng, float radius) {
     Ring ring;
 
-    ring.pos.x = rndf(-GRID_X + 2*radius, GRID_X - 2*radius);
-    ring.pos.y = rndf(-GRID_Y + 2*radius, GRID_Y - 2*radius);
-    ring.pos.z = rndf(-GRID_Z + 2*radius, GRID_Z - 2*radius);
+    ring.pos.x = rndf(rng, -GRID_X + 2*radius, GRID_X - 2*radius);
+    ring.pos.y = rndf(rng, -GRID_Y + 2*radius, GRID_Y - 2*radius);
+    ring.pos.z = rndf(rng, -GRID_Z + 2*radius, GRID_Z - 2*radius);
 
-    ring.orientation = rndquat();
+    ring.orientation = rndquat(rng);
 
     Vec3 base_normal = {0.0f, 0.0f, 1.0f};
     ring.normal = quat_rotate(ring.orientation, base_normal);
@@ -247,47 +248,47 @@ typedef struct {
 } Drone;
 
 
-void init_drone(Drone* drone, float size, float dr) {
+void init_drone(PufferRng* rng, Drone* drone, float size, float dr) {
     drone->params.arm_len = size / 2.0f;
 
     // m ~ x^3
     float mass_scale = powf(drone->params.arm_len, 3.0f) / powf(BASE_ARM_LEN, 3.0f);
-    drone->params.mass = BASE_MASS * mass_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->params.mass = BASE_MASS * mass_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // I ~ mx^2
     float base_Iscale = BASE_MASS * BASE_ARM_LEN * BASE_ARM_LEN;
     float I_scale = drone->params.mass * powf(drone->params.arm_len, 2.0f) / base_Iscale;
-    drone->params.ixx = BASE_IXX * I_scale * rndf(1.0f - dr, 1.0f + dr);
-    drone->params.iyy = BASE_IYY * I_scale * rndf(1.0f - dr, 1.0f + dr);
-    drone->params.izz = BASE_IZZ * I_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->params.ixx = BASE_IXX * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->params.iyy = BASE_IYY * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->params.izz = BASE_IZZ * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // k_thrust ~ m/l
     float k_thrust_scale = (drone->params.mass * drone->params.arm_len) / (BASE_MASS * BASE_ARM_LEN);
-    drone->params.k_thrust = BASE_K_THRUST * k_thrust_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->params.k_thrust = BASE_K_THRUST * k_thrust_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // k_ang_damp ~ I
     float base_avg_inertia = (BASE_IXX + BASE_IYY + BASE_IZZ) / 3.0f;
     float avg_inertia = (drone->params.ixx + drone->params.iyy + drone->params.izz) / 3.0f;
     float avg_inertia_scale = avg_inertia / base_avg_inertia;
-    drone->params.k_ang_damp = BASE_K_ANG_DAMP * avg_inertia_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->params.k_ang_damp = BASE_K_ANG_DAMP * avg_inertia_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // drag ~ x^2
     float drag_scale = powf(drone->params.arm_len, 2.0f) / powf(BASE_ARM_LEN, 2.0f);
-    drone->params.k_drag = BASE_K_DRAG * drag_scale * rndf(1.0f - dr, 1.0f + dr);
-    drone->params.b_drag = BASE_B_DRAG * drag_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->params.k_drag = BASE_K_DRAG * drag_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->params.b_drag = BASE_B_DRAG * drag_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     // Small gravity randomization
-    drone->params.gravity = BASE_GRAVITY * rndf(0.99f, 1.01f);
+    drone->params.gravity = BASE_GRAVITY * rndf(rng, 0.99f, 1.01f);
 
     // RPM ~ 1/x
     float rpm_scale = (BASE_ARM_LEN) / (drone->params.arm_len);
-    drone->params.max_rpm = BASE_MAX_RPM * rpm_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->params.max_rpm = BASE_MAX_RPM * rpm_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
 
     drone->params.max_vel = BASE_MAX_VEL;
     drone->params.max_omega = BASE_MAX_OMEGA;
 
-    drone->params.k_mot = BASE_K_MOT * rndf(1.0f - dr, 1.0f + dr);
-    drone->params.j_mot = BASE_J_MOT * I_scale * rndf(1.0f - dr, 1.0f + dr);
+    drone->params.k_mot = BASE_K_MOT * rndf(rng, 1.0f - dr, 1.0f + dr);
+    drone->params.j_mot = BASE_J_MOT * I_scale * rndf(rng, 1.0f - dr, 1.0f + dr);
     
     for (int i = 0; i < 4; i++) {
         drone->state.rpms[i] = 0.0f;
@@ -432,12 +433,12 @@ void rk4_step(State* state, Params* params, float* actions, float dt) {
     quat_normalize(&state->quat);
 }
 
-void move_drone(Drone* drone, float* actions) {
+void move_drone(PufferRng* rng, Drone* drone, float* actions) {
     // clamp actions
     clamp4(actions, -1.0f, 1.0f);
 
     // Domain randomized dt
-    float dt = DT * rndf(1.0f - DT_RNG, 1.0 + DT_RNG);
+    float dt = DT * rndf(rng, 1.0f - DT_RNG, 1.0 + DT_RNG);
 
     // update drone state
     drone->prev_pos = drone->state.pos;
@@ -448,13 +449,13 @@ void move_drone(Drone* drone, float* actions) {
     clamp3(&drone->state.omega, -drone->params.max_omega, drone->params.max_omega);
 }
 
-void reset_rings(Ring* ring_buffer, int num_rings, float ring_radius) {
-    ring_buffer[0] = rndring(ring_radius);
+void reset_rings(PufferRng* rng, Ring* ring_buffer, int num_rings, float ring_radius) {
+    ring_buffer[0] = rndring(rng, ring_radius);
     
     // ensure rings are spaced at least 2*ring_radius apart
     for (int i = 1; i < num_rings; i++) {
         do {
-            ring_buffer[i] = rndring(ring_radius);
+            ring_buffer[i] = rndring(rng, ring_radius);
         }  while (norm3(sub3(ring_buffer[i].pos, ring_buffer[i - 1].pos)) < 2.0f*ring_radius);
     }   
 }
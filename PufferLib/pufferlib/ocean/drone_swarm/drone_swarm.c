@@ -10,7 +10,7 @@
 #include <emscripten.h>
 #endif
 
-double randn(double mean, double std) {
+double randn(PufferRng* rng, double mean, double std) {
     static int has_spare = 0;
     static double spare;
 
@@ -22,8 +22,8 @@ double randn(double mean, double std) {
     has_spare = 1;
     double u, v, s;
     do {
-        u = 2.0 * rand() / RAND_MAX - 1.0;
-        v = 2.0 * rand() / RAND_MAX - 1.0;
+        u = 2.0 * puffer_rand(rng) / RAND_MAX - 1.0;
+        v = 2.0 * puffer_rand(rng) / RAND_MAX - 1.0;
         s = u * u + v * v;
     } while (s >= 1.0 || s == 0.0);
 
@@ -75,7 +75,7 @@ void free_linearcontlstm(LinearContLSTM *net) {
     free(net);
 }
 
-void forward_linearcontlstm(LinearContLSTM *net, float *observations, float *actions) {
+void forward_linearcontlstm(PufferRng* rng, LinearContLSTM *net, float *observations, float *actions) {
     linear(net->encoder, observations);
     gelu(net->gelu1, net->encoder->output);
     lstm(net->lstm, net->gelu1->output);
@@ -84,16 +84,16 @@ void forward_linearcontlstm(LinearContLSTM *net, float *observations, float *act
     for (int i = 0; i < net->num_actions; i++) {
         float std = expf(net->log_std[i]);
         float mean = net->actor->output[i];
-        actions[i] = randn(mean, std);
+        actions[i] = randn(rng, mean, std);
     }
 }
 
 void generate_dummy_actions(DroneSwarm *env) {
     // Generate random floats in [-1, 1] range
-    env->actions[0] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
-    env->actions[1] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
-    env->actions[2] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
-    env->actions[3] = ((float)rand() / (float)RAND_MAX) * 2.0f - 1.0f;
+    env->actions[0] = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 2.0f - 1.0f;
+    env->actions[1] = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 2.0f - 1.0f;
+    env->actions[2] = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 2.0f - 1.0f;
+    env->actions[3] = ((float)puffer_rand(&env->rng) / (float)RAND_MAX) * 2.0f - 1.0f;
 }
 
 #ifdef __EMSCRIPTEN__
@@ -108,7 +108,7 @@ void emscriptenStep(void *e) {
     DroneSwarm *env = args->env;
     LinearContLSTM *net = args->net;
 
-    forward_linearcontlstm(net, env->observations, env->actions);
+    forward_linearcontlstm(&env->rng, net, env->observations, env->actions);
     c_step(env);
     c_render(env);
     return;
@@ -118,9 +118,8 @@ WebRenderArgs *web_args = NULL;
 #endif
 
 int main() {
-    srand(time(NULL)); // Seed random number generator
-
     DroneSwarm *env = calloc(1, sizeof(DroneSwarm));
+    puffer_rng_seed(&env->rng, time(NULL)); // Seed random number generator
     env->num_agents = 64;
     env->max_rings = 10;
     env->task = TASK_ORBIT;
@@ -9,9 +9,11 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "../rng.h"
 
 #include "raylib.h"
 #include "dronelib.h"
+#include "../drone_lanes.h"
 
 #define TASK_IDLE 0
 #define TASK_HOVER 1
@@ -68,6 +70,7 @@ typedef struct {
     unsigned char *terminals;
 
     Log log;
+    PufferRng rng;
     int tick;
     int report_interval;
 
@@ -233,8 +236,8 @@ void move_target(DroneSwarm* env, Drone *agent) {
 
 void set_target_idle(DroneSwarm* env, int idx) {
     Drone *agent = &env->agents[idx];
-    agent->target_pos = (Vec3){rndf(-MARGIN_X, MARGIN_X), rndf(-MARGIN_Y, MARGIN_Y), rndf(-MARGIN_Z, MARGIN_Z)};
-    agent->target_vel = (Vec3){rndf(-V_TARGET, V_TARGET), rndf(-V_TARGET, V_TARGET), rndf(-V_TARGET, V_TARGET)};
+    agent->target_pos = (Vec3){rndf(&env->rng, -MARGIN_X, MARGIN_X), rndf(&env->rng, -MARGIN_Y, MARGIN_Y), rndf(&env->rng, -MARGIN_Z, MARGIN_Z)};
+    agent->target_vel = (Vec3){rndf(&env->rng, -V_TARGET, V_TARGET), rndf(&env->rng, -V_TARGET, V_TARGET), rndf(&env->rng, -V_TARGET, V_TARGET)};
 }
 
 void set_target_hover(DroneSwarm* env, int idx) {
@@ -384,13 +387,13 @@ void reset_agent(DroneSwarm* env, Drone *agent, int idx) {
 
     //float size = 0.2f;
     //init_drone(agent, size, 0.0f);
-    float size = rndf(0.1f, 0.4);
-    init_drone(agent, size, 0.1f);
+    float size = rndf(&env->rng, 0.1f, 0.4);
+    init_drone(&env->rng, agent, size, 0.1f);
 
     agent->state.pos = (Vec3){
-        rndf(-MARGIN_X, MARGIN_X),
-        rndf(-MARGIN_Y, MARGIN_Y),
-        rndf(-MARGIN_Z, MARGIN_Z)
+        rndf(&env->rng, -MARGIN_X, MARGIN_X),
+        rndf(&env->rng, -MARGIN_Y, MARGIN_Y),
+        rndf(&env->rng, -MARGIN_Z, MARGIN_Z)
     };
     agent->prev_pos = agent->state.pos;
     agent->spawn_pos = agent->state.pos;
@@ -402,10 +405,10 @@ void c_reset(DroneSwarm *env) {
     env->tick = 0;
     //env->task = rand() % (TASK_N - 1);
     
-    if (rand() % 4) {
+    if (puffer_randint(&env->rng, 0, 4)) {
         env->task = TASK_RACE;
     } else {
-        env->task = rand() % (TASK_N - 1);
+        env->task = puffer_randint(&env->rng, 0, TASK_N - 1);
     }
     
     //env->task = TASK_RACE;
@@ -424,16 +427,16 @@ void c_reset(DroneSwarm *env) {
     }
     if (env->task == TASK_RACE) {
         float ring_radius = 2.0f;
-        reset_rings(env->ring_buffer, env->max_rings, ring_radius);
+        reset_rings(&env->rng, env->ring_buffer, env->max_rings, ring_radius);
 
         // start drone at least MARGIN away from the first ring
         for (int i = 0; i < env->num_agents; i++) {
             Drone *drone = &env->agents[i];
             do {
                 drone->state.pos = (Vec3){
-                    rndf(-MARGIN_X, MARGIN_X), 
-                    rndf(-MARGIN_Y, MARGIN_Y), 
-                    rndf(-MARGIN_Z, MARGIN_Z)
+                    rndf(&env->rng, -MARGIN_X, MARGIN_X), 
+                    rndf(&env->rng, -MARGIN_Y, MARGIN_Y), 
+                    rndf(&env->rng, -MARGIN_Z, MARGIN_Z)
                 };
             } while (norm3(sub3(drone->state.pos, env->ring_buffer[0].pos)) < 2.0f*ring_radius);
         }
@@ -444,14 +447,15 @@ void c_reset(DroneSwarm *env) {
 
 void c_step(DroneSwarm *env) {
     env->tick = (env->tick + 1) % HORIZON;
+
+    // All drones integrate before any rewards, so each agent's reward sees
+    // every other drone at its post-step position
+    move_drones(&env->rng, env->agents, env->actions, env->num_agents);
     for (int i = 0; i < env->num_agents; i++) {
         Drone *agent = &env->agents[i];
         env->rewards[i] = 0;
         env->terminals[i] = 0;
 
-        float* atn = &env->actions[4*i];
-        move_drone(agent, atn);
-
         // check out of bounds
         bool out_of_bounds = agent->state.pos.x < -GRID_X || agent->state.pos.x > GRID_X ||
                              agent->state.pos.y < -GRID_Y || agent->state.pos.y > GRID_Y ||
@@ -652,7 +656,7 @@ void c_render(DroneSwarm *env) {
         }
         if (env->task == TASK_RACE) {
             float ring_radius = 2.0f;
-            reset_rings(env->ring_buffer, env->max_rings, ring_radius);
+            reset_rings(&env->rng, env->ring_buffer, env->max_rings, ring_radius);
         }
     }
 
@@ -80,7 +80,7 @@ void perftest(float test_time) {
     int start = time(NULL);
     int i = 0;
     while (time(NULL) - start < test_time) {
-        env.actions[0] = rand()%9;
+        env.actions[0] = puffer_randint(&env.rng, 0, 9);
         c_step(&env);
         i++;
     }
@@ -10,6 +10,7 @@
 #include <string.h>
 #include <float.h>
 #include "raylib.h"
+#include "../rng.h"
 
 // Constant defs
 #define MAX_ENEMIES 10
@@ -180,6 +181,7 @@ typedef struct Enduro Enduro;
 typedef struct Enduro {
     Client* client;
     Log log;
+    PufferRng rng;
     float* observations;
     int* actions;
     float* rewards;
@@ -929,9 +931,9 @@ void add_enemy_car(Enduro* env) {
     }
 
     // Randomly select a lane
-    int lane = possible_lanes[rand() % num_possible_lanes];
+    int lane = possible_lanes[puffer_randint(&env->rng, 0, num_possible_lanes)];
     // Preferentially spawn in the last_spawned_lane 30% of the time
-    if (rand() % 100 < 60 && env->last_spawned_lane != -1) {
+    if (puffer_randint(&env->rng, 0, 100) < 60 && env->last_spawned_lane != -1) {
         lane = env->last_spawned_lane;
     }
     env->last_spawned_lane = lane;
@@ -943,14 +945,14 @@ void add_enemy_car(Enduro* env) {
         .last_x = car_x_in_lane(env, lane, VANISHING_POINT_Y),
         .last_y = VANISHING_POINT_Y,
         .passed = false,
-        .colorIndex = rand() % 6
+        .colorIndex = puffer_randint(&env->rng, 0, 6)
     };
     // Ensure minimum spacing between cars in the same lane
     float depth = (car.y - VANISHING_POINT_Y) / (PLAYABLE_AREA_BOTTOM - VANISHING_POINT_Y);
     float scale = fmax(0.1f, 0.9f * depth + 0.1f);
     float scaled_car_length = CAR_HEIGHT * scale;
     // Randomize min spacing between 1.0f and 6.0f car lengths
-    float dynamic_spacing_factor = (rand() / (float)RAND_MAX) * 6.0f + 0.5f;
+    float dynamic_spacing_factor = (puffer_rand(&env->rng) / (float)RAND_MAX) * 6.0f + 0.5f;
     float min_spacing = dynamic_spacing_factor * scaled_car_length;
     for (int i = 0; i < env->numEnemies; i++) {
         Car* existing_car = &env->enemyCars[i];
@@ -1374,8 +1376,8 @@ void c_step(Enduro* env) {
             int num_to_spawn = 1;
 
             // Randomly decide to spawn more cars in a clump
-            if ((rand() / (float)RAND_MAX) < clump_probability) {
-                num_to_spawn = 1 + rand() % 2; // Spawn 1 to 3 cars
+            if ((puffer_rand(&env->rng) / (float)RAND_MAX) < clump_probability) {
+                num_to_spawn = 1 + puffer_randint(&env->rng, 0, 2); // Spawn 1 to 3 cars
             }
 
             // Track occupied lanes to prevent over-blocking
@@ -1385,7 +1387,7 @@ void c_step(Enduro* env) {
                 // Find an unoccupied lane
                 int lane;
                 do {
-                    lane = rand() % NUM_LANES;
+                    lane = puffer_randint(&env->rng, 0, NUM_LANES);
                 } while (occupied_lanes[lane]);
 
                 // Mark the lane as occupied
@@ -1611,14 +1613,14 @@ void update_road_curve(Enduro* env) {
 
     for (int i = 0; i < 3; i++) {
         // Generate random step thresholds
-        step_thresholds[i] = 1500 + rand() % 3801; // Random value between 1500 and 3800
+        step_thresholds[i] = 1500 + puffer_randint(&env->rng, 0, 3801); // Random value between 1500 and 3800
 
         // Generate a random curve direction (-1, 0, 1) with rules
         int direction_choices[] = {-1, 0, 1};
         int next_direction;
 
         do {
-            next_direction = direction_choices[rand() % 3];
+            next_direction = direction_choices[puffer_randint(&env->rng, 0, 3)];
         } while ((last_direction == -1 && next_direction == 1) || (last_direction == 1 && next_direction == -1));
 
         curve_directions[i] = next_direction;
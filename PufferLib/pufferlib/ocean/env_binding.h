@@ -1,5 +1,7 @@
 #include <Python.h>
 #include <numpy/arrayobject.h>
+#include <pthread.h>
+#include "rng.h"
 
 // Forward declarations for env-specific functions supplied by user
 static int my_log(PyObject* dict, Log* log);
@@ -26,6 +28,15 @@ static int my_put(Env* env, PyObject* args, PyObject* kwargs) {
 }
 #endif
 
+// Seeds the env's random stream. Envs without one define MY_SEED and
+// supply their own
+static void my_seed(Env* env, int seed);
+#ifndef MY_SEED
+static void my_seed(Env* env, int seed) {
+    puffer_rng_seed(&env->rng, seed);
+}
+#endif
+
 #ifndef MY_METHODS
 #define MY_METHODS {NULL, NULL, 0, NULL}
 #endif
@@ -46,6 +57,25 @@ static Env* unpack_env(PyObject* args) {
     return env;
 }
 
+// Converts a Python int argument to a C int. Sets an exception and
+// returns 1 if it isn't an int or doesn't fit in one
+static int unpack_int(PyObject* obj, const char* name, int* out) {
+    if (obj == NULL || !PyLong_Check(obj)) {
+        PyErr_Format(PyExc_TypeError, "%s must be an integer", name);
+        return 1;
+    }
+    long val = PyLong_AsLong(obj);
+    if (val == -1 && PyErr_Occurred()) {
+        return 1;
+    }
+    if (val > INT_MAX || val < INT_MIN) {
+        PyErr_Format(PyExc_OverflowError, "%s is out of range", name);
+        return 1;
+    }
+    *out = (int)val;
+    return 0;
+}
+
 // Python function to initialize the environment
 static PyObject* env_init(PyObject* self, PyObject* args, PyObject* kwargs) {
     if (PyTuple_Size(args) != 6) {
@@ -136,15 +166,13 @@ static PyObject* env_init(PyObject* self, PyObject* args, PyObject* kwargs) {
     // env->truncations = PyArray_DATA(truncations);
     
     
-    PyObject* seed_arg = PyTuple_GetItem(args, 5);
-    if (!PyObject_TypeCheck(seed_arg, &PyLong_Type)) {
-        PyErr_SetString(PyExc_TypeError, "seed must be an integer");
+    int seed;
+    if (unpack_int(PyTuple_GetItem(args, 5), "seed", &seed)) {
         return NULL;
     }
-    int seed = PyLong_AsLong(seed_arg);
  
     // Assumes each process has the same number of environments
-    srand(seed);
+    my_seed(env, seed);
 
     // If kwargs is NULL, create a new dictionary
     if (kwargs == NULL) {
@@ -259,10 +287,208 @@ static PyObject* env_put(PyObject* self, PyObject* args, PyObject* kwargs) {
     Py_RETURN_NONE;
 }
 
+// Persistent worker pool for vec_step. Envs are split into num_threads
+// contiguous chunks. For synchronous steps the calling thread steps chunk 0
+// itself and the workers step the rest, so num_threads=1 runs fully serial
+// with no pool. vec_step_async hands chunk 0 to an extra background worker
+// instead, which is only spawned the first time an async step is requested.
+typedef struct VecEnv VecEnv;
+
 typedef struct {
+    VecEnv* vec;
+    pthread_t thread;
+    int start;
+    int end;
+    int seen;
+    int running;
+} VecWorker;
+
+struct VecEnv {
     Env** envs;
     int num_envs;
-} VecEnv;
+    int num_threads;
+    VecWorker* workers;
+    pthread_mutex_t lock;
+    pthread_cond_t work_ready;
+    pthread_cond_t work_done;
+    int generation;
+    int pending;
+    int shutdown;
+    int job_async;
+    int in_flight;
+};
+
+static void vec_step_range(VecEnv* vec, int start, int end) {
+    for (int i = start; i < end; i++) {
+        c_step(vec->envs[i]);
+    }
+}
+
+static void* vec_worker_loop(void* arg) {
+    VecWorker* worker = (VecWorker*)arg;
+    VecEnv* vec = worker->vec;
+    int is_async_worker = (worker == &vec->workers[0]);
+    int seen = worker->seen;
+    while (1) {
+        pthread_mutex_lock(&vec->lock);
+        while (vec->generation == seen && !vec->shutdown) {
+            pthread_cond_wait(&vec->work_ready, &vec->lock);
+        }
+        if (vec->shutdown) {
+            pthread_mutex_unlock(&vec->lock);
+            return NULL;
+        }
+        seen = vec->generation;
+        int skip = is_async_worker && !vec->job_async;
+        pthread_mutex_unlock(&vec->lock);
+        if (skip) {
+            continue;
+        }
+
+        vec_step_range(vec, worker->start, worker->end);
+
+        pthread_mutex_lock(&vec->lock);
+        vec->pending--;
+        if (vec->pending == 0) {
+            pthread_cond_signal(&vec->work_done);
+        }
+        pthread_mutex_unlock(&vec->lock);
+    }
+}
+
+static int vec_spawn_worker(VecEnv* vec, int idx) {
+    VecWorker* worker = &vec->workers[idx];
+    // Only called between jobs, so no dispatch can race this read
+    worker->seen = vec->generation;
+    if (pthread_create(&worker->thread, NULL, vec_worker_loop, worker) != 0) {
+        PyErr_SetString(PyExc_RuntimeError, "Failed to start vec env worker thread");
+        return 1;
+    }
+    worker->running = 1;
+    return 0;
+}
+
+static void vec_stop_threads(VecEnv* vec);
+
+// Allocates one chunk per thread and spawns workers 1..num_threads-1.
+// Worker i owns envs [start, end)
+static int vec_init_pool(VecEnv* vec) {
+    int num_threads = vec->num_threads;
+    vec->workers = (VecWorker*)calloc(num_threads, sizeof(VecWorker));
+    if (!vec->workers) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to allocate vec env workers");
+        return 1;
+    }
+    pthread_mutex_init(&vec->lock, NULL);
+    pthread_cond_init(&vec->work_ready, NULL);
+    pthread_cond_init(&vec->work_done, NULL);
+
+    for (int i = 0; i < num_threads; i++) {
+        VecWorker* worker = &vec->workers[i];
+        worker->vec = vec;
+        worker->start = (long)vec->num_envs*i/num_threads;
+        worker->end = (long)vec->num_envs*(i + 1)/num_threads;
+    }
+
+    for (int i = 1; i < num_threads; i++) {
+        if (vec_spawn_worker(vec, i)) {
+            // Joins the workers that did start
+            vec_stop_threads(vec);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static int vec_start_threads(VecEnv* vec, int num_threads) {
+    if (num_threads > vec->num_envs) {
+        num_threads = vec->num_envs;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    vec->num_threads = num_threads;
+    if (num_threads == 1) {
+        return 0;
+    }
+    return vec_init_pool(vec);
+}
+
+// Kicks off a step on the pool. Call with the GIL released
+static void vec_dispatch(VecEnv* vec, int async) {
+    pthread_mutex_lock(&vec->lock);
+    vec->job_async = async;
+    vec->pending = async ? vec->num_threads : vec->num_threads - 1;
+    vec->generation++;
+    pthread_cond_broadcast(&vec->work_ready);
+    pthread_mutex_unlock(&vec->lock);
+}
+
+static void vec_join(VecEnv* vec) {
+    pthread_mutex_lock(&vec->lock);
+    while (vec->pending > 0) {
+        pthread_cond_wait(&vec->work_done, &vec->lock);
+    }
+    pthread_mutex_unlock(&vec->lock);
+}
+
+static void vec_stop_threads(VecEnv* vec) {
+    if (vec->workers == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&vec->lock);
+    vec->shutdown = 1;
+    pthread_cond_broadcast(&vec->work_ready);
+    pthread_mutex_unlock(&vec->lock);
+    for (int i = 0; i < vec->num_threads; i++) {
+        if (vec->workers[i].running) {
+            pthread_join(vec->workers[i].thread, NULL);
+        }
+    }
+    pthread_mutex_destroy(&vec->lock);
+    pthread_cond_destroy(&vec->work_ready);
+    pthread_cond_destroy(&vec->work_done);
+    free(vec->workers);
+    vec->workers = NULL;
+    vec->shutdown = 0;
+}
+
+// Stops the pool and frees the vec. Envs made by vec_init are closed too,
+// envs passed to vectorize still belong to their env_init handles
+static void vec_free(VecEnv* vec, int owns_envs) {
+    vec_stop_threads(vec);
+    if (owns_envs) {
+        for (int i = 0; i < vec->num_envs; i++) {
+            if (vec->envs[i] == NULL) {
+                continue;
+            }
+            c_close(vec->envs[i]);
+            free(vec->envs[i]);
+        }
+    }
+    free(vec->envs);
+    free(vec);
+}
+
+// Optional num_threads kwarg shared by vec_init and vectorize
+static int unpack_num_threads(PyObject* kwargs) {
+    if (kwargs == NULL) {
+        return 1;
+    }
+    PyObject* val = PyDict_GetItemString(kwargs, "num_threads");
+    if (val == NULL || val == Py_None) {
+        return 1;
+    }
+    int num_threads;
+    if (unpack_int(val, "num_threads", &num_threads)) {
+        return -1;
+    }
+    if (num_threads < 0) {
+        PyErr_SetString(PyExc_ValueError, "num_threads must be non-negative");
+        return -1;
+    }
+    return num_threads;
+}
 
 static VecEnv* unpack_vecenv(PyObject* args) {
     PyObject* handle_obj = PyTuple_GetItem(args, 0);
@@ -291,34 +517,19 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
         return NULL;
     }
 
-    VecEnv* vec = (VecEnv*)calloc(1, sizeof(VecEnv));
-    if (!vec) {
-        PyErr_SetString(PyExc_MemoryError, "Failed to allocate vec env");
-        return NULL;
-    }
-    PyObject* num_envs_arg = PyTuple_GetItem(args, 5);
-    if (!PyObject_TypeCheck(num_envs_arg, &PyLong_Type)) {
-        PyErr_SetString(PyExc_TypeError, "num_envs must be an integer");
+    int num_envs;
+    if (unpack_int(PyTuple_GetItem(args, 5), "num_envs", &num_envs)) {
         return NULL;
     }
-    int num_envs = PyLong_AsLong(num_envs_arg);
     if (num_envs <= 0) {
         PyErr_SetString(PyExc_TypeError, "num_envs must be greater than 0");
         return NULL;
     }
-    vec->num_envs = num_envs;
-    vec->envs = (Env**)calloc(num_envs, sizeof(Env*));
-    if (!vec->envs) {
-        PyErr_SetString(PyExc_MemoryError, "Failed to allocate vec env");
-        return NULL;
-    }
 
-    PyObject* seed_obj = PyTuple_GetItem(args, 6);
-    if (!PyObject_TypeCheck(seed_obj, &PyLong_Type)) {
-        PyErr_SetString(PyExc_TypeError, "seed must be an integer");
+    int seed;
+    if (unpack_int(PyTuple_GetItem(args, 6), "seed", &seed)) {
         return NULL;
     }
-    int seed = PyLong_AsLong(seed_obj);
 
     PyObject* obs = PyTuple_GetItem(args, 0);
     if (!PyObject_TypeCheck(obs, &PyArray_Type)) {
@@ -395,6 +606,24 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
         return NULL;
     }
 
+    int num_threads = unpack_num_threads(kwargs);
+    if (num_threads < 0) {
+        return NULL;
+    }
+
+    VecEnv* vec = (VecEnv*)calloc(1, sizeof(VecEnv));
+    if (!vec) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to allocate vec env");
+        return NULL;
+    }
+    vec->num_envs = num_envs;
+    vec->envs = (Env**)calloc(num_envs, sizeof(Env*));
+    if (!vec->envs) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to allocate vec env");
+        free(vec);
+        return NULL;
+    }
+
     // If kwargs is NULL, create a new dictionary
     if (kwargs == NULL) {
         kwargs = PyDict_New();
@@ -407,6 +636,7 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
         if (!env) {
             PyErr_SetString(PyExc_MemoryError, "Failed to allocate environment");
             Py_DECREF(kwargs);
+            vec_free(vec, 1);
             return NULL;
         }
         vec->envs[i] = env;
@@ -422,7 +652,7 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
 
         // Assumes each process has the same number of environments
         int env_seed = i + seed*vec->num_envs;
-        srand(env_seed);
+        my_seed(env, env_seed);
  
         // Add the seed to kwargs for this environment
         PyObject* py_seed = PyLong_FromLong(env_seed);
@@ -442,12 +672,16 @@ static PyObject* vec_init(PyObject* self, PyObject* args, PyObject* kwargs) {
     }
 
     Py_DECREF(kwargs);
+    if (vec_start_threads(vec, num_threads)) {
+        vec_free(vec, 1);
+        return NULL;
+    }
     return PyLong_FromVoidPtr(vec);
 }
 
 
 // Python function to close the environment
-static PyObject* vectorize(PyObject* self, PyObject* args) {
+static PyObject* vectorize(PyObject* self, PyObject* args, PyObject* kwargs) {
     int num_envs = PyTuple_Size(args);
     if (num_envs == 0) {
         PyErr_SetString(PyExc_TypeError, "make_vec requires at least 1 env id");
@@ -463,6 +697,7 @@ static PyObject* vectorize(PyObject* self, PyObject* args) {
     vec->envs = (Env**)calloc(num_envs, sizeof(Env*));
     if (!vec->envs) {
         PyErr_SetString(PyExc_MemoryError, "Failed to allocate vec env");
+        free(vec);
         return NULL;
     }
 
@@ -471,11 +706,21 @@ static PyObject* vectorize(PyObject* self, PyObject* args) {
         PyObject* handle_obj = PyTuple_GetItem(args, i);
         if (!PyObject_TypeCheck(handle_obj, &PyLong_Type)) {
             PyErr_SetString(PyExc_TypeError, "Env ids must be integers. Pass them as separate args with *env_ids, not as a list.");
+            vec_free(vec, 0);
             return NULL;
         }
         vec->envs[i] = (Env*)PyLong_AsVoidPtr(handle_obj);
     }
 
+    int num_threads = unpack_num_threads(kwargs);
+    if (num_threads < 0) {
+        vec_free(vec, 0);
+        return NULL;
+    }
+    if (vec_start_threads(vec, num_threads)) {
+        vec_free(vec, 0);
+        return NULL;
+    }
     return PyLong_FromVoidPtr(vec);
 }
 
@@ -490,16 +735,19 @@ static PyObject* vec_reset(PyObject* self, PyObject* args) {
         return NULL;
     }
 
-    PyObject* seed_arg = PyTuple_GetItem(args, 1);
-    if (!PyObject_TypeCheck(seed_arg, &PyLong_Type)) {
-        PyErr_SetString(PyExc_TypeError, "seed must be an integer");
+    int seed;
+    if (unpack_int(PyTuple_GetItem(args, 1), "seed", &seed)) {
+        return NULL;
+    }
+
+    if (vec->in_flight) {
+        PyErr_SetString(PyExc_RuntimeError, "vec_reset called while an async step is in flight. Call vec_wait first");
         return NULL;
     }
-    int seed = PyLong_AsLong(seed_arg);
  
     for (int i = 0; i < vec->num_envs; i++) {
         // Assumes each process has the same number of environments
-        srand(i + seed*vec->num_envs);
+        my_seed(vec->envs[i], i + seed*vec->num_envs);
         c_reset(vec->envs[i]);
     }
     Py_RETURN_NONE;
@@ -517,9 +765,81 @@ static PyObject* vec_step(PyObject* self, PyObject* arg) {
         return NULL;
     }
 
-    for (int i = 0; i < vec->num_envs; i++) {
-        c_step(vec->envs[i]);
+    if (vec->in_flight) {
+        PyErr_SetString(PyExc_RuntimeError, "vec_step called while an async step is in flight. Call vec_wait first");
+        return NULL;
     }
+
+    // c_step never touches Python objects, so the GIL is released
+    // for the whole step and reacquired after the barrier
+    Py_BEGIN_ALLOW_THREADS
+    if (vec->workers == NULL) {
+        vec_step_range(vec, 0, vec->num_envs);
+    } else {
+        vec_dispatch(vec, 0);
+        vec_step_range(vec, vec->workers[0].start, vec->workers[0].end);
+        vec_join(vec);
+    }
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+// Starts stepping every env on the pool and returns immediately so the
+// caller can run inference on another buffer. Observations, rewards and
+// terminals of this vec must not be read until vec_wait returns.
+static PyObject* vec_step_async(PyObject* self, PyObject* arg) {
+    int num_args = PyTuple_Size(arg);
+    if (num_args != 1) {
+        PyErr_SetString(PyExc_TypeError, "vec_step_async requires 1 argument");
+        return NULL;
+    }
+
+    VecEnv* vec = unpack_vecenv(arg);
+    if (!vec) {
+        return NULL;
+    }
+
+    if (vec->in_flight) {
+        PyErr_SetString(PyExc_RuntimeError, "vec_step_async called twice without vec_wait");
+        return NULL;
+    }
+
+    if (vec->workers == NULL && vec_init_pool(vec)) {
+        return NULL;
+    }
+    if (!vec->workers[0].running && vec_spawn_worker(vec, 0)) {
+        return NULL;
+    }
+
+    vec->in_flight = 1;
+    Py_BEGIN_ALLOW_THREADS
+    vec_dispatch(vec, 1);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+// Blocks until the step started by vec_step_async has finished.
+// No-op if nothing is in flight
+static PyObject* vec_wait(PyObject* self, PyObject* arg) {
+    int num_args = PyTuple_Size(arg);
+    if (num_args != 1) {
+        PyErr_SetString(PyExc_TypeError, "vec_wait requires 1 argument");
+        return NULL;
+    }
+
+    VecEnv* vec = unpack_vecenv(arg);
+    if (!vec) {
+        return NULL;
+    }
+
+    if (!vec->in_flight) {
+        Py_RETURN_NONE;
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    vec_join(vec);
+    Py_END_ALLOW_THREADS
+    vec->in_flight = 0;
     Py_RETURN_NONE;
 }
 
@@ -536,12 +856,14 @@ static PyObject* vec_render(PyObject* self, PyObject* args) {
         return NULL;
     }
 
-    PyObject* env_id_arg = PyTuple_GetItem(args, 1);
-    if (!PyObject_TypeCheck(env_id_arg, &PyLong_Type)) {
-        PyErr_SetString(PyExc_TypeError, "env_id must be an integer");
+    int env_id;
+    if (unpack_int(PyTuple_GetItem(args, 1), "env_id", &env_id)) {
+        return NULL;
+    }
+    if (env_id < 0 || env_id >= vec->num_envs) {
+        PyErr_SetString(PyExc_IndexError, "env_id out of range");
         return NULL;
     }
-    int env_id = PyLong_AsLong(env_id_arg);
  
     c_render(vec->envs[env_id]);
     Py_RETURN_NONE;
@@ -567,6 +889,11 @@ static PyObject* vec_log(PyObject* self, PyObject* args) {
         return NULL;
     }
 
+    if (vec->in_flight) {
+        PyErr_SetString(PyExc_RuntimeError, "vec_log called while an async step is in flight. Call vec_wait first");
+        return NULL;
+    }
+
     // Iterates over logs one float at a time. Will break
     // horribly if Log has non-float data.
     Log aggregate = {0};
@@ -603,12 +930,13 @@ static PyObject* vec_close(PyObject* self, PyObject* args) {
         return NULL;
     }
 
-    for (int i = 0; i < vec->num_envs; i++) {
-        c_close(vec->envs[i]);
-        free(vec->envs[i]);
+    if (vec->in_flight) {
+        Py_BEGIN_ALLOW_THREADS
+        vec_join(vec);
+        Py_END_ALLOW_THREADS
+        vec->in_flight = 0;
     }
-    free(vec->envs);
-    free(vec);
+    vec_free(vec, 1);
     Py_RETURN_NONE;
 }
 
@@ -622,6 +950,9 @@ static double unpack(PyObject* kwargs, char* key) {
     }
     if (PyLong_Check(val)) {
         long out = PyLong_AsLong(val);
+        if (out == -1 && PyErr_Occurred()) {
+            return 1;
+        }
         if (out > INT_MAX || out < INT_MIN) {
             char error_msg[100];
             snprintf(error_msg, sizeof(error_msg), "Value %ld of integer argument %s is out of range", out, key);
@@ -649,10 +980,12 @@ static PyMethodDef methods[] = {
     {"env_close", env_close, METH_VARARGS, "Close the environment"},
     {"env_get", env_get, METH_VARARGS, "Get the environment state"},
     {"env_put", (PyCFunction)env_put, METH_VARARGS | METH_KEYWORDS, "Put stuff into env"},
-    {"vectorize", vectorize, METH_VARARGS, "Make a vector of environment handles"},
+    {"vectorize", (PyCFunction)vectorize, METH_VARARGS | METH_KEYWORDS, "Make a vector of environment handles"},
     {"vec_init", (PyCFunction)vec_init, METH_VARARGS | METH_KEYWORDS, "Initialize a vector of environments"},
     {"vec_reset", vec_reset, METH_VARARGS, "Reset the vector of environments"},
     {"vec_step", vec_step, METH_VARARGS, "Step the vector of environments"},
+    {"vec_step_async", vec_step_async, METH_VARARGS, "Start stepping the vector of environments in the background"},
+    {"vec_wait", vec_wait, METH_VARARGS, "Wait for a background step to finish"},
     {"vec_log", vec_log, METH_VARARGS, "Log the vector of environments"},
     {"vec_render", vec_render, METH_VARARGS, "Render the vector of environments"},
     {"vec_close", vec_close, METH_VARARGS, "Close the vector of environments"},
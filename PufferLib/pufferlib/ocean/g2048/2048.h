@@ -5,6 +5,7 @@
 #include <math.h>
 #include <string.h>
 #include "raylib.h"
+#include "../rng.h"
 
 #define SIZE 4
 #define EMPTY 0
@@ -28,6 +29,7 @@ typedef struct {
 
 typedef struct {
     Log log;                        // Required
+    PufferRng rng;
     unsigned char* observations;    // Cheaper in memory if encoded in uint_8
     int* actions;                   // Required
     float* rewards;                 // Required
@@ -119,11 +121,11 @@ void c_reset(Game* game) {
     
     // Add two random tiles at the start - optimized version
     for (int added = 0; added < 2; ) {
-        int pos = rand() % (SIZE * SIZE);
+        int pos = puffer_randint(&game->rng, 0, SIZE * SIZE);
         int i = pos / SIZE;
         int j = pos % SIZE;
         if (game->grid[i][j] == EMPTY) {
-            game->grid[i][j] = (rand() % 10 == 0) ? 2 : 1;
+            game->grid[i][j] = (puffer_randint(&game->rng, 0, 10) == 0) ? 2 : 1;
             added++;
             game->empty_count--;
         }
@@ -144,7 +146,7 @@ void add_random_tile(Game* game) {
         int j = pos % SIZE;
         if (game->grid[i][j] == EMPTY) {
             count++;
-            if (rand() % count == 0) {
+            if (puffer_randint(&game->rng, 0, count) == 0) {
                 chosen_pos = pos;
             }
         }
@@ -153,7 +155,7 @@ void add_random_tile(Game* game) {
     if (chosen_pos >= 0) {
         int i = chosen_pos / SIZE;
         int j = chosen_pos % SIZE;
-        game->grid[i][j] = (rand() % 10 == 0) ? 2 : 1;
+        game->grid[i][j] = (puffer_randint(&game->rng, 0, 10) == 0) ? 2 : 1;
         game->empty_count--;
         game->grid_changed = true;
     }
@@ -2,8 +2,8 @@
 #include "puffernet.h"
 
 int main() {
-    srand(time(NULL));
     Game env;
+    puffer_rng_seed(&env.rng, time(NULL));
     unsigned char observations[SIZE * SIZE] = {0};
     unsigned char terminals[1] = {0};
     int actions[1] = {0};
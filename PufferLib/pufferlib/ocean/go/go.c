@@ -213,7 +213,7 @@ void performance_test() {
     long start = time(NULL);
     int i = 0;
     while (time(NULL) - start < test_time) {
-        env.actions[0] = rand() % (env.grid_size)*(env.grid_size);
+        env.actions[0] = puffer_randint(&env.rng, 0, env.grid_size)*(env.grid_size);
         c_step(&env);
         i++;
     }
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <string.h>
 #include "raylib.h"
+#include "../rng.h"
 
 #define NOOP 0
 #define MOVE_MIN 1
@@ -68,6 +69,7 @@ struct CGo {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    PufferRng rng;
     float score;
     int width;
     int height;
@@ -507,7 +509,7 @@ void enemy_random_move(CGo* env){
     }
     // Shuffle the positions
     for(int i = count - 1; i > 0; i--){
-        int j = rand() % (i + 1);
+        int j = puffer_randint(&env->rng, 0, i + 1);
         int temp = positions[i];
         positions[i] = positions[j];
         positions[j] = temp;
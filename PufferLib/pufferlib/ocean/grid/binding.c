@@ -20,19 +20,19 @@ static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
     env.max_size = max_size;
     init_grid(&env);
 
-    srand(time(NULL));
-    int start_seed = rand();
+    puffer_rng_seed(&env.rng, time(NULL));
+    int start_seed = puffer_rand(&env.rng);
     for (int i = 0; i < num_maps; i++) {
         int sz = size;
         if (size == -1) {
-            sz = 5 + (rand() % (max_size-5));
+            sz = puffer_randint(&env.rng, 5, max_size);
         }
 
         if (sz % 2 == 0) {
             sz -= 1;
         }
 
-        float difficulty = (float)rand()/(float)(RAND_MAX);
+        float difficulty = (float)puffer_rand(&env.rng)/(float)(RAND_MAX);
         create_maze_level(&env, sz, sz, difficulty, start_seed + i);
         init_state(&levels[i], max_size, 1);
         get_state(&env, &levels[i]);
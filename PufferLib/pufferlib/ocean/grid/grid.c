@@ -73,7 +73,7 @@ int main() {
             }
         } else {
             for (int i = 0; i < num_agents; i++) {
-                env->actions[i] = rand() % 5;
+                env->actions[i] = puffer_randint(&env->rng, 0, 5);
             }
         }
 
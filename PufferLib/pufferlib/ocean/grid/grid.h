@@ -5,6 +5,7 @@
 #include <assert.h>
 #include <math.h>
 #include "raylib.h"
+#include "../rng.h"
 
 #define TWO_PI 2.0*PI
 #define MAX_SIZE 40
@@ -46,8 +47,8 @@ struct Log {
 bool is_agent(int idx) {
     return idx >= AGENT && idx < AGENT + 8;
 }
-int rand_color() {
-    return AGENT + rand()%8;
+int rand_color(PufferRng* rng) {
+    return AGENT + puffer_randint(rng, 0, 8);
 }
 
 // 6 unique keys and doors
@@ -95,6 +96,7 @@ struct Grid{
     int max_size;
     bool discretize;
     Log log;
+    PufferRng rng;
     Agent* agents;
     unsigned char* grid;
     int* counts;
@@ -290,7 +292,7 @@ void c_reset(Grid* env) {
     memset(env->grid, 0, env->max_size*env->max_size);
     memset(env->counts, 0, env->max_size*env->max_size*sizeof(int));
     env->tick = 0;
-    int idx = rand() % env->num_maps;
+    int idx = puffer_randint(&env->rng, 0, env->num_maps);
     set_state(env, &env->levels[idx]);
     compute_observations(env);
 }
@@ -429,7 +431,7 @@ void c_step(Grid* env) {
 
     if (done) {
         c_reset(env);
-        int idx = rand() % env->num_maps;
+        int idx = puffer_randint(&env->rng, 0, env->num_maps);
         set_state(env, &env->levels[idx]);
         compute_observations(env);
     }
@@ -637,7 +639,8 @@ void generate_locked_room(Grid* env) {
 
 void generate_growing_tree_maze(unsigned char* grid,
         int width, int height, int max_size, float difficulty, int seed) {
-    srand(seed);
+    PufferRng rng;
+    puffer_rng_seed(&rng, seed);
     int dx[4] = {-1, 0, 1, 0};
     int dy[4] = {0, 1, 0, -1};
     int dirs[4] = {0, 1, 2, 3};
@@ -657,8 +660,8 @@ void generate_growing_tree_maze(unsigned char* grid,
         }
     }
 
-    int x_init = rand() % (width - 1);
-    int y_init = rand() % (height - 1);
+    int x_init = puffer_randint(&rng, 0, width - 1);
+    int y_init = puffer_randint(&rng, 0, height - 1);
 
     if (x_init % 2 == 0) {
         x_init++;
@@ -677,8 +680,8 @@ void generate_growing_tree_maze(unsigned char* grid,
     //SetTargetFPS(60);
 
     while (num_cells > 0) {
-        if (rand() % 1000 > 1000*difficulty) {
-            int i = rand() % num_cells;
+        if (puffer_randint(&rng, 0, 1000) > 1000*difficulty) {
+            int i = puffer_randint(&rng, 0, num_cells);
             int tmp_x = cells[2*num_cells - 2];
             int tmp_y = cells[2*num_cells - 1];
             cells[2*num_cells - 2] = cells[2*i];
@@ -695,7 +698,7 @@ void generate_growing_tree_maze(unsigned char* grid,
 
         // In-place direction shuffle
         for (int i = 0; i < 4; i++) {
-            int ii = i + rand() % (4 - i);
+            int ii = i + puffer_randint(&rng, 0, 4 - i);
             int tmp = dirs[i];
             dirs[i] = dirs[ii];
             dirs[ii] = tmp;
@@ -33,7 +33,7 @@ void perfTest(const uint32_t numSteps) {
 
     uint64_t seed = time(NULL);
     printf("seed: %lu\n", seed);
-    initEnv(e, NUM_DRONES, 0, -1, seed, false, false, true, false);
+    initEnv(e, NUM_DRONES, 0, -1, seed, false, false, true, false, 1);
     initMaps(e);
 
     // randActions(e);
@@ -58,7 +58,72 @@ void perfTest(const uint32_t numSteps) {
     fastFree(e);
 }
 
-int main(void) {
+// every drone is an agent firing a machinegun with infinite ammo every step,
+// so observations have to pick the nearest of hundreds of projectiles
+void stressTest(const uint32_t numSteps) {
+    const uint8_t NUM_DRONES = MAX_DRONES;
+
+    iwEnv *e = fastCalloc(1, sizeof(iwEnv));
+
+    posix_memalign((void **)&e->observations, sizeof(void *), alignedSize(NUM_DRONES * obsBytes(NUM_DRONES), sizeof(float)));
+    e->rewards = fastCalloc(NUM_DRONES, sizeof(float));
+    e->actions = fastCalloc(NUM_DRONES * CONTINUOUS_ACTION_SIZE, sizeof(float));
+    e->masks = fastCalloc(NUM_DRONES, sizeof(uint8_t));
+    e->terminals = fastCalloc(NUM_DRONES, sizeof(uint8_t));
+    e->truncations = fastCalloc(NUM_DRONES, sizeof(uint8_t));
+
+    uint64_t seed = time(NULL);
+    printf("seed: %lu\n", seed);
+    initEnv(e, NUM_DRONES, NUM_DRONES, NUM_MAPS - 1, seed, false, false, true, true, 1);
+    initMaps(e);
+    setupEnv(e);
+
+    uint64_t totalProjectiles = 0;
+    clock_t stepTime = 0;
+    clock_t obsTime = 0;
+    for (uint32_t steps = 0; steps < numSteps; steps++) {
+        e->defaultWeapon = weaponInfos[MACHINEGUN_WEAPON];
+        for (uint8_t i = 0; i < cc_array_size(e->drones); i++) {
+            droneEntity *drone = safe_array_get_at(e->drones, i);
+            if (drone->weaponInfo->type != MACHINEGUN_WEAPON) {
+                droneChangeWeapon(e, drone, MACHINEGUN_WEAPON);
+            }
+        }
+        randActions(e);
+        for (uint8_t i = 0; i < e->numDrones; i++) {
+            e->actions[(i * CONTINUOUS_ACTION_SIZE) + 4] = 1.0f;
+        }
+
+        clock_t start = clock();
+        stepEnv(e);
+        stepTime += clock() - start;
+
+        totalProjectiles += cc_array_size(e->projectiles);
+        start = clock();
+        computeObs(e);
+        obsTime += clock() - start;
+    }
+
+    const double stepUs = 1e6 * stepTime / CLOCKS_PER_SEC / numSteps;
+    const double obsUs = 1e6 * obsTime / CLOCKS_PER_SEC / numSteps;
+    printf("%d drones | %.1f projectiles on average | step %.1f us | obs %.1f us\n", NUM_DRONES, (double)totalProjectiles / numSteps, stepUs, obsUs);
+
+    destroyEnv(e);
+    destroyMaps();
+    free(e->observations);
+    fastFree(e->actions);
+    fastFree(e->rewards);
+    fastFree(e->masks);
+    fastFree(e->terminals);
+    fastFree(e->truncations);
+    fastFree(e);
+}
+
+int main(int argc, char **argv) {
+    if (argc > 1 && strcmp(argv[1], "stress") == 0) {
+        stressTest(100000);
+        return 0;
+    }
     perfTest(2500000);
     return 0;
 }
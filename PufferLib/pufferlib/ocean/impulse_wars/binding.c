@@ -1,15 +1,27 @@
 #include <Python.h>
 
 #include "env.h"
+#include "snapshot.h"
 
 static PyObject *get_consts(PyObject *self, PyObject *args);
+static PyObject *snapshot_size(PyObject *self, PyObject *args);
+static PyObject *snapshot(PyObject *self, PyObject *args);
+static PyObject *restore(PyObject *self, PyObject *args);
 
 #define Env iwEnv
 #define MY_SHARED
-#define MY_METHODS {"get_consts", get_consts, METH_VARARGS, "Get constants"}
+#define MY_SEED
+#define MY_METHODS                                                                                  \
+    {"get_consts", get_consts, METH_VARARGS, "Get constants"},                                      \
+    {"snapshot_size", snapshot_size, METH_VARARGS, "Get the size of a snapshot of an env"},         \
+    {"snapshot", snapshot, METH_VARARGS, "Write a snapshot of an env to a buffer"},                 \
+    {"restore", restore, METH_VARARGS, "Validate a snapshot and restore an env from it in place"}
 
 #include "../env_binding.h"
 
+// The env has its own PRNG, seeded from the seed kwarg in my_init
+static void my_seed(Env *env, int seed) {}
+
 #define setDictVal(dict, key, val)                                            \
     if (PyDict_SetItemString(dict, key, PyLong_FromLong(val)) < 0) {          \
         PyErr_SetString(PyExc_RuntimeError, "Failed to set " key " in dict"); \
@@ -88,7 +100,82 @@ static PyObject *my_shared(PyObject *self, PyObject *args, PyObject *kwargs) {
     return Py_None;
 }
 
+static iwEnv *unpackSnapshotEnv(PyObject *args) {
+    VecEnv *ve = unpack_vecenv(args);
+    if (ve == NULL) {
+        return NULL;
+    }
+    if (ve->in_flight) {
+        PyErr_SetString(PyExc_RuntimeError, "snapshots can't be used while an async step is in flight. Call vec_wait first");
+        return NULL;
+    }
+    PyObject *idxArg = PyTuple_GetItem(args, 1);
+    if (idxArg == NULL || !PyLong_Check(idxArg)) {
+        PyErr_SetString(PyExc_TypeError, "env_idx must be an integer");
+        return NULL;
+    }
+    const long envIdx = PyLong_AsLong(idxArg);
+    if (envIdx < 0 || envIdx >= ve->num_envs) {
+        PyErr_SetString(PyExc_IndexError, "env_idx out of range");
+        return NULL;
+    }
+    return ve->envs[envIdx];
+}
+
+static PyObject *snapshot_size(PyObject *self, PyObject *args) {
+    iwEnv *e = unpackSnapshotEnv(args);
+    if (e == NULL) {
+        return NULL;
+    }
+    return PyLong_FromSize_t(snapshotEnvSize(e));
+}
+
+static PyObject *snapshot(PyObject *self, PyObject *args) {
+    iwEnv *e = unpackSnapshotEnv(args);
+    if (e == NULL) {
+        return NULL;
+    }
+    PyObject *bufArg = PyTuple_GetItem(args, 2);
+    Py_buffer buf;
+    if (bufArg == NULL || PyObject_GetBuffer(bufArg, &buf, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) < 0) {
+        return NULL;
+    }
+    const size_t size = snapshotEnv(e, buf.buf, buf.len);
+    PyBuffer_Release(&buf);
+    if (size == 0) {
+        PyErr_SetString(PyExc_ValueError, "buffer is too small for snapshot, use snapshot_size");
+        return NULL;
+    }
+    return PyLong_FromSize_t(size);
+}
+
+static PyObject *restore(PyObject *self, PyObject *args) {
+    iwEnv *e = unpackSnapshotEnv(args);
+    if (e == NULL) {
+        return NULL;
+    }
+    PyObject *bufArg = PyTuple_GetItem(args, 2);
+    Py_buffer buf;
+    if (bufArg == NULL || PyObject_GetBuffer(bufArg, &buf, PyBUF_C_CONTIGUOUS) < 0) {
+        return NULL;
+    }
+    // restoreEnv checks the whole buffer before changing the env
+    const bool restored = restoreEnv(e, buf.buf, buf.len);
+    PyBuffer_Release(&buf);
+    if (!restored) {
+        PyErr_SetString(PyExc_ValueError, "snapshot is corrupt, truncated or from an env with different settings");
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
 static int my_init(iwEnv *e, PyObject *args, PyObject *kwargs) {
+    // every world in the process shares one task pool, and so its size
+    const uint32_t physicsThreads = (uint32_t)unpack(kwargs, "physics_threads");
+    if (physicsThreads > 1 && !taskPoolAvailable(physicsThreads)) {
+        PyErr_Format(PyExc_ValueError, "physics_threads must be %u, the number other envs in this process use", sharedTaskPool->numWorkers);
+        return -1;
+    }
     initEnv(
         e,
         (uint8_t)unpack(kwargs, "num_drones"),
@@ -98,7 +185,8 @@ static int my_init(iwEnv *e, PyObject *args, PyObject *kwargs) {
         (bool)unpack(kwargs, "enable_teams"),
         (bool)unpack(kwargs, "sitting_duck"),
         (bool)unpack(kwargs, "is_training"),
-        (bool)unpack(kwargs, "continuous")
+        (bool)unpack(kwargs, "continuous"),
+        physicsThreads
     );
     return 0;
 }
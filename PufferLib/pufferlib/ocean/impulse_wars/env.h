@@ -218,22 +218,21 @@ void computeNearObs(iwEnv *e, const droneEntity *drone, const uint16_t discreteO
 
     if (cc_array_size(e->floatingWalls) != 0) {
         // find N nearest floating walls
-        nearEntity nearFloatingWalls[MAX_FLOATING_WALLS] = {0};
+        nearEntity nearFloatingWalls[_NUM_FLOATING_WALL_OBS];
+        uint8_t numNearFloatingWalls = 0;
         for (uint8_t i = 0; i < cc_array_size(e->floatingWalls); i++) {
             wallEntity *wall = safe_array_get_at(e->floatingWalls, i);
             const nearEntity nearEnt = {
+                .idx = i,
                 .entity = wall,
                 .distanceSquared = b2DistanceSquared(wall->pos, drone->pos),
             };
-            nearFloatingWalls[i] = nearEnt;
+            numNearFloatingWalls = nearHeapPush(nearFloatingWalls, numNearFloatingWalls, NUM_FLOATING_WALL_OBS, nearEnt);
         }
-        insertionSort(nearFloatingWalls, cc_array_size(e->floatingWalls));
+        nearHeapSort(nearFloatingWalls, numNearFloatingWalls);
 
         // compute type, position, angle and velocity of N nearest floating walls
-        for (uint8_t i = 0; i < cc_array_size(e->floatingWalls); i++) {
-            if (i == NUM_FLOATING_WALL_OBS) {
-                break;
-            }
+        for (uint8_t i = 0; i < numNearFloatingWalls; i++) {
             const wallEntity *wall = nearFloatingWalls[i].entity;
 
             const b2Transform wallTransform = b2Body_GetTransform(wall->bodyID);
@@ -258,22 +257,21 @@ void computeNearObs(iwEnv *e, const droneEntity *drone, const uint16_t discreteO
 
     if (cc_array_size(e->pickups) != 0) {
         // find N nearest weapon pickups
-        nearEntity nearPickups[MAX_WEAPON_PICKUPS] = {0};
+        nearEntity nearPickups[_NUM_WEAPON_PICKUP_OBS];
+        uint8_t numNearPickups = 0;
         for (uint8_t i = 0; i < cc_array_size(e->pickups); i++) {
             weaponPickupEntity *pickup = safe_array_get_at(e->pickups, i);
             const nearEntity nearEnt = {
+                .idx = i,
                 .entity = pickup,
                 .distanceSquared = b2DistanceSquared(pickup->pos, drone->pos),
             };
-            nearPickups[i] = nearEnt;
+            numNearPickups = nearHeapPush(nearPickups, numNearPickups, NUM_WEAPON_PICKUP_OBS, nearEnt);
         }
-        insertionSort(nearPickups, cc_array_size(e->pickups));
+        nearHeapSort(nearPickups, numNearPickups);
 
         // compute type and location of N nearest weapon pickups
-        for (uint8_t i = 0; i < cc_array_size(e->pickups); i++) {
-            if (i == NUM_WEAPON_PICKUP_OBS) {
-                break;
-            }
+        for (uint8_t i = 0; i < numNearPickups; i++) {
             const weaponPickupEntity *pickup = nearPickups[i].entity;
 
             offset = discreteObsStart + WEAPON_PICKUP_WEAPONS_OBS_OFFSET + i;
@@ -313,32 +311,26 @@ void computeObs(iwEnv *e) {
 
         computeNearObs(e, agentDrone, discreteObsStart, continuousObs);
 
-        // sort projectiles by distance to the current agent
+        // find N nearest projectiles to the current agent
         const b2Vec2 agentPos = agentDrone->pos;
         const size_t numProjectiles = cc_array_size(e->projectiles);
         if (numProjectiles > 0) {
-            projectileEntity *sortedProjectiles[numProjectiles];
-            memcpy(sortedProjectiles, e->projectiles->buffer, numProjectiles * sizeof(projectileEntity *));
-
-            for (int16_t i = 1; i < (int64_t)numProjectiles; i++) {
-                projectileEntity *key = sortedProjectiles[i];
-                const float keyDistance = b2DistanceSquared(agentPos, key->pos);
-                int16_t j = i - 1;
-
-                while (j >= 0 && b2DistanceSquared(agentPos, sortedProjectiles[j]->pos) > keyDistance) {
-                    sortedProjectiles[j + 1] = sortedProjectiles[j];
-                    j = j - 1;
-                }
-
-                sortedProjectiles[j + 1] = key;
+            nearEntity nearProjectiles[_NUM_PROJECTILE_OBS];
+            uint8_t numNearProjectiles = 0;
+            for (size_t i = 0; i < numProjectiles; i++) {
+                projectileEntity *projectile = e->projectiles->buffer[i];
+                const nearEntity nearEnt = {
+                    .idx = i,
+                    .entity = projectile,
+                    .distanceSquared = b2DistanceSquared(agentPos, projectile->pos),
+                };
+                numNearProjectiles = nearHeapPush(nearProjectiles, numNearProjectiles, NUM_PROJECTILE_OBS, nearEnt);
             }
+            nearHeapSort(nearProjectiles, numNearProjectiles);
 
             // compute type and location of N projectiles
-            for (size_t i = 0; i < numProjectiles; i++) {
-                if (i == NUM_PROJECTILE_OBS) {
-                    break;
-                }
-                const projectileEntity *projectile = sortedProjectiles[i];
+            for (uint8_t i = 0; i < numNearProjectiles; i++) {
+                const projectileEntity *projectile = nearProjectiles[i].entity;
 
                 discreteObsOffset = discreteObsStart + PROJECTILE_DRONE_OBS_OFFSET + i;
                 ASSERTF(discreteObsOffset <= discreteObsStart + PROJECTILE_WEAPONS_OBS_OFFSET, "offset: %d", discreteObsOffset);
@@ -526,7 +518,20 @@ void setEnvFrameRate(iwEnv *e) {
     e->totalSuddenDeathSteps = SUDDEN_DEATH_STEPS * frameRate;
 }
 
-iwEnv *initEnv(iwEnv *e, uint8_t numDrones, uint8_t numAgents, int8_t mapIdx, uint64_t seed, bool enableTeams, bool sittingDuck, bool isTraining, bool continuousActions) {
+void createWorld(iwEnv *e) {
+    b2WorldDef worldDef = b2DefaultWorldDef();
+    worldDef.gravity = (b2Vec2){.x = 0.0f, .y = 0.0f};
+    // let Box2D run its solver on threads shared by every env's world
+    if (e->physicsPool != NULL) {
+        worldDef.workerCount = e->physicsPool->numWorkers;
+        worldDef.enqueueTask = enqueuePoolTask;
+        worldDef.finishTask = finishPoolTask;
+        worldDef.userTaskContext = &e->physicsTasks;
+    }
+    e->worldID = b2CreateWorld(&worldDef);
+}
+
+iwEnv *initEnv(iwEnv *e, uint8_t numDrones, uint8_t numAgents, int8_t mapIdx, uint64_t seed, bool enableTeams, bool sittingDuck, bool isTraining, bool continuousActions, uint32_t physicsThreads) {
     DEBUG_LOGF("seed: %lu", seed);
 
     e->numDrones = numDrones;
@@ -551,9 +556,12 @@ iwEnv *initEnv(iwEnv *e, uint8_t numDrones, uint8_t numAgents, int8_t mapIdx, ui
     e->randState = seed;
     e->needsReset = false;
 
-    b2WorldDef worldDef = b2DefaultWorldDef();
-    worldDef.gravity = (b2Vec2){.x = 0.0f, .y = 0.0f};
-    e->worldID = b2CreateWorld(&worldDef);
+    e->physicsPool = NULL;
+    if (physicsThreads > 1) {
+        e->physicsPool = acquireTaskPool(physicsThreads);
+        initWorldTasks(&e->physicsTasks, e->physicsPool);
+    }
+    createWorld(e);
     e->pinnedMapIdx = mapIdx;
     e->mapIdx = -1;
 
@@ -570,15 +578,6 @@ iwEnv *initEnv(iwEnv *e, uint8_t numDrones, uint8_t numAgents, int8_t mapIdx, ui
     create_array(&e->explodingProjectiles, 8);
     create_array(&e->dronePieces, 16);
 
-    e->mapPathing = fastCalloc(NUM_MAPS, sizeof(pathingInfo));
-    for (uint8_t i = 0; i < NUM_MAPS; i++) {
-        const mapEntry *map = maps[i];
-        pathingInfo *info = &e->mapPathing[i];
-        info->paths = fastMalloc(map->rows * map->columns * map->rows * map->columns * sizeof(uint8_t));
-        memset(info->paths, UINT8_MAX, map->rows * map->columns * map->rows * map->columns * sizeof(uint8_t));
-        info->pathBuffer = fastCalloc(3 * 8 * map->rows * map->columns, sizeof(int8_t));
-    }
-
     e->humanInput = false;
     e->humanDroneInput = 0;
     e->connectedControllers = 0;
@@ -637,13 +636,6 @@ void clearEnv(iwEnv *e) {
 void destroyEnv(iwEnv *e) {
     clearEnv(e);
 
-    for (uint8_t i = 0; i < NUM_MAPS; i++) {
-        pathingInfo *info = &e->mapPathing[i];
-        fastFree(info->paths);
-        fastFree(info->pathBuffer);
-    }
-    fastFree(e->mapPathing);
-
     for (size_t i = 0; i < cc_array_size(e->walls); i++) {
         wallEntity *wall = safe_array_get_at(e->walls, i);
         destroyWall(e, wall, false);
@@ -673,6 +665,9 @@ void destroyEnv(iwEnv *e) {
     cc_array_destroy(e->dronePieces);
 
     b2DestroyWorld(e->worldID);
+    if (e->physicsPool != NULL) {
+        releaseTaskPool(e->physicsPool);
+    }
 }
 
 void resetEnv(iwEnv *e) {
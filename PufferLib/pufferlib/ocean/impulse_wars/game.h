@@ -693,11 +693,30 @@ void createDroneShield(iwEnv *e, droneEntity *drone, const int8_t groupIdx) {
     drone->shield = shield;
 }
 
-void createDrone(iwEnv *e, const uint8_t idx) {
-    const int8_t groupIdx = -(idx + 1);
+void createDroneBodyShape(const iwEnv *e, droneEntity *drone, const b2Vec2 pos) {
     b2BodyDef droneBodyDef = b2DefaultBodyDef();
     droneBodyDef.type = b2_dynamicBody;
+    droneBodyDef.position = pos;
+    droneBodyDef.motionLocks = (b2MotionLocks){.angularZ = true};
+    droneBodyDef.linearDamping = DRONE_LINEAR_DAMPING;
+    droneBodyDef.userData = drone->ent;
+    drone->bodyID = b2CreateBody(e->worldID, &droneBodyDef);
+
+    b2ShapeDef droneShapeDef = b2DefaultShapeDef();
+    droneShapeDef.density = DRONE_DENSITY;
+    droneShapeDef.material.friction = DRONE_FRICTION;
+    droneShapeDef.material.restitution = DRONE_RESTITUTION;
+    droneShapeDef.filter.categoryBits = DRONE_SHAPE;
+    droneShapeDef.filter.maskBits = WALL_SHAPE | FLOATING_WALL_SHAPE | WEAPON_PICKUP_SHAPE | PROJECTILE_SHAPE | DRONE_SHAPE | SHIELD_SHAPE;
+    droneShapeDef.filter.groupIndex = -(drone->idx + 1);
+    droneShapeDef.enableContactEvents = true;
+    droneShapeDef.enableSensorEvents = true;
+    droneShapeDef.userData = drone->ent;
+    const b2Circle droneCircle = {.center = b2Vec2_zero, .radius = DRONE_RADIUS};
+    drone->shapeID = b2CreateCircleShape(drone->bodyID, &droneShapeDef, &droneCircle);
+}
 
+void createDrone(iwEnv *e, const uint8_t idx) {
     int8_t spawnQuad = -1;
     if (!e->isTraining) {
         // spawn drones in diagonal quadrants from each other so that
@@ -713,26 +732,12 @@ void createDrone(iwEnv *e, const uint8_t idx) {
         }
         e->lastSpawnQuad = spawnQuad;
     }
-    if (!findOpenPos(e, DRONE_SHAPE, &droneBodyDef.position, spawnQuad)) {
+    b2Vec2 pos;
+    if (!findOpenPos(e, DRONE_SHAPE, &pos, spawnQuad)) {
         ERROR("no open position for drone");
     }
 
-    droneBodyDef.motionLocks = (b2MotionLocks){.angularZ = true};
-    droneBodyDef.linearDamping = DRONE_LINEAR_DAMPING;
-    b2BodyId droneBodyID = b2CreateBody(e->worldID, &droneBodyDef);
-    b2ShapeDef droneShapeDef = b2DefaultShapeDef();
-    droneShapeDef.density = DRONE_DENSITY;
-    droneShapeDef.material.friction = DRONE_FRICTION;
-    droneShapeDef.material.restitution = DRONE_RESTITUTION;
-    droneShapeDef.filter.categoryBits = DRONE_SHAPE;
-    droneShapeDef.filter.maskBits = WALL_SHAPE | FLOATING_WALL_SHAPE | WEAPON_PICKUP_SHAPE | PROJECTILE_SHAPE | DRONE_SHAPE | SHIELD_SHAPE;
-    droneShapeDef.filter.groupIndex = groupIdx;
-    droneShapeDef.enableContactEvents = true;
-    droneShapeDef.enableSensorEvents = true;
-    const b2Circle droneCircle = {.center = b2Vec2_zero, .radius = DRONE_RADIUS};
-
     droneEntity *drone = fastCalloc(1, sizeof(droneEntity));
-    drone->bodyID = droneBodyID;
     drone->weaponInfo = e->defaultWeapon;
     drone->ammo = weaponAmmo(e->defaultWeapon->type, drone->weaponInfo->type);
     drone->energyLeft = DRONE_ENERGY_MAX;
@@ -741,9 +746,9 @@ void createDrone(iwEnv *e, const uint8_t idx) {
     if (e->teamsEnabled) {
         drone->team = idx / (e->numDrones / 2);
     }
-    drone->initalPos = droneBodyDef.position;
-    drone->pos = droneBodyDef.position;
-    drone->mapCellIdx = entityPosToCellIdx(e, droneBodyDef.position);
+    drone->initalPos = pos;
+    drone->pos = pos;
+    drone->mapCellIdx = entityPosToCellIdx(e, pos);
     drone->lastAim = (b2Vec2){.x = 0.0f, .y = -1.0f};
     drone->livesLeft = DRONE_LIVES;
     create_array(&drone->brakeTrailPoints, 64);
@@ -754,14 +759,11 @@ void createDrone(iwEnv *e, const uint8_t idx) {
 
     entity *ent = createEntity(e, DRONE_ENTITY, drone);
     drone->ent = ent;
-
-    droneShapeDef.userData = ent;
-    drone->shapeID = b2CreateCircleShape(droneBodyID, &droneShapeDef, &droneCircle);
-    b2Body_SetUserData(drone->bodyID, ent);
+    createDroneBodyShape(e, drone, pos);
 
     cc_array_add(e->drones, drone);
 
-    createDroneShield(e, drone, groupIdx);
+    createDroneShield(e, drone, -(idx + 1));
 }
 
 void droneAddEnergy(droneEntity *drone, float energy) {
@@ -773,6 +775,30 @@ void droneAddEnergy(droneEntity *drone, float energy) {
     }
 }
 
+void createDronePieceBodyShape(const iwEnv *e, dronePieceEntity *piece, const b2Vec2 velocity, const float angularVelocity) {
+    b2BodyDef pieceBodyDef = b2DefaultBodyDef();
+    pieceBodyDef.type = b2_dynamicBody;
+    pieceBodyDef.position = piece->pos;
+    pieceBodyDef.rotation = piece->rot;
+    pieceBodyDef.linearDamping = DRONE_PIECE_LINEAR_DAMPING;
+    pieceBodyDef.angularDamping = DRONE_PIECE_ANGULAR_DAMPING;
+    pieceBodyDef.linearVelocity = velocity;
+    pieceBodyDef.angularVelocity = angularVelocity;
+    pieceBodyDef.userData = piece->ent;
+    piece->bodyID = b2CreateBody(e->worldID, &pieceBodyDef);
+
+    b2ShapeDef pieceShapeDef = b2DefaultShapeDef();
+    pieceShapeDef.filter.categoryBits = DRONE_PIECE_SHAPE;
+    pieceShapeDef.filter.maskBits = WALL_SHAPE | FLOATING_WALL_SHAPE | DRONE_PIECE_SHAPE;
+    pieceShapeDef.density = 1.0f;
+    pieceShapeDef.material.friction = 0.5f;
+    pieceShapeDef.userData = piece->ent;
+
+    const b2Hull pieceHull = b2ComputeHull(piece->vertices, 3);
+    const b2Polygon piecePolygon = b2MakePolygon(&pieceHull, 0.0f);
+    piece->shapeID = b2CreatePolygonShape(piece->bodyID, &pieceShapeDef, &piecePolygon);
+}
+
 void createDronePiece(iwEnv *e, droneEntity *drone, const bool fromShield) {
     const float distance = randFloat(&e->randState, DRONE_PIECE_MIN_DISTANCE, DRONE_PIECE_MAX_DISTANCE);
     const b2Vec2 direction = {.x = randFloat(&e->randState, -1.0f, 1.0f), .y = randFloat(&e->randState, -1.0f, 1.0f)};
@@ -789,27 +815,6 @@ void createDronePiece(iwEnv *e, droneEntity *drone, const bool fromShield) {
     entity *ent = createEntity(e, DRONE_PIECE_ENTITY, piece);
     piece->ent = ent;
 
-    b2BodyDef pieceBodyDef = b2DefaultBodyDef();
-    pieceBodyDef.type = b2_dynamicBody;
-
-    pieceBodyDef.position = pos;
-    pieceBodyDef.rotation = rot;
-    pieceBodyDef.linearDamping = DRONE_PIECE_LINEAR_DAMPING;
-    pieceBodyDef.angularDamping = DRONE_PIECE_ANGULAR_DAMPING;
-    const float bonus = 1.0f + min(b2Length(drone->velocity) / 15.0f, 5.0f);
-    const float speed = randFloat(&e->randState, DRONE_PIECE_MIN_SPEED, DRONE_PIECE_MAX_SPEED) * bonus;
-    pieceBodyDef.linearVelocity = b2MulSV(speed, direction);
-    pieceBodyDef.angularVelocity = randFloat(&e->randState, -PI, PI);
-    pieceBodyDef.userData = ent;
-    piece->bodyID = b2CreateBody(e->worldID, &pieceBodyDef);
-
-    b2ShapeDef pieceShapeDef = b2DefaultShapeDef();
-    pieceShapeDef.filter.categoryBits = DRONE_PIECE_SHAPE;
-    pieceShapeDef.filter.maskBits = WALL_SHAPE | FLOATING_WALL_SHAPE | DRONE_PIECE_SHAPE;
-    pieceShapeDef.density = 1.0f;
-    pieceShapeDef.material.friction = 0.5f;
-    pieceShapeDef.userData = ent;
-
     // make pieces from the shield a bit smaller
     if (fromShield) {
         piece->vertices[0] = (b2Vec2){.x = 0.0f, .y = -1.0f};
@@ -821,9 +826,10 @@ void createDronePiece(iwEnv *e, droneEntity *drone, const bool fromShield) {
         piece->vertices[2] = (b2Vec2){.x = 0.75f, .y = 0.0f};
     }
 
-    const b2Hull pieceHull = b2ComputeHull(piece->vertices, 3);
-    const b2Polygon piecePolygon = b2MakePolygon(&pieceHull, 0.0f);
-    piece->shapeID = b2CreatePolygonShape(piece->bodyID, &pieceShapeDef, &piecePolygon);
+    const float bonus = 1.0f + min(b2Length(drone->velocity) / 15.0f, 5.0f);
+    const float speed = randFloat(&e->randState, DRONE_PIECE_MIN_SPEED, DRONE_PIECE_MAX_SPEED) * bonus;
+    const float angularVelocity = randFloat(&e->randState, -PI, PI);
+    createDronePieceBodyShape(e, piece, b2MulSV(speed, direction), angularVelocity);
 
     cc_array_add(e->dronePieces, piece);
 }
@@ -1044,6 +1050,35 @@ bool respawnDrone(iwEnv *e, droneEntity *drone) {
     return true;
 }
 
+void createProjectileBodyShape(const iwEnv *e, projectileEntity *projectile, const b2Vec2 pos) {
+    const weaponInformation *weaponInfo = projectile->weaponInfo;
+    b2BodyDef projectileBodyDef = b2DefaultBodyDef();
+    projectileBodyDef.type = b2_dynamicBody;
+    projectileBodyDef.isBullet = weaponInfo->isPhysicsBullet;
+    projectileBodyDef.linearDamping = weaponInfo->damping;
+    projectileBodyDef.enableSleep = weaponInfo->canSleep;
+    projectileBodyDef.position = pos;
+    projectileBodyDef.userData = projectile->ent;
+    projectile->bodyID = b2CreateBody(e->worldID, &projectileBodyDef);
+
+    b2ShapeDef projectileShapeDef = b2DefaultShapeDef();
+    projectileShapeDef.enableContactEvents = true;
+    projectileShapeDef.density = weaponInfo->density;
+    projectileShapeDef.material.restitution = 1.0f;
+    projectileShapeDef.material.friction = 0.0f;
+    projectileShapeDef.filter.categoryBits = PROJECTILE_SHAPE;
+    projectileShapeDef.filter.maskBits = WALL_SHAPE | FLOATING_WALL_SHAPE | PROJECTILE_SHAPE | DRONE_SHAPE | SHIELD_SHAPE;
+    projectileShapeDef.userData = projectile->ent;
+    const b2Circle projectileCircle = {.center = b2Vec2_zero, .radius = weaponInfo->radius};
+    projectile->shapeID = b2CreateCircleShape(projectile->bodyID, &projectileShapeDef, &projectileCircle);
+
+    // create a sensor shape if needed
+    if (weaponInfo->hasSensor) {
+        projectile->sensorID = weaponSensor(projectile->bodyID, weaponInfo->type);
+        b2Shape_SetUserData(projectile->sensorID, projectile->ent);
+    }
+}
+
 void createProjectile(iwEnv *e, droneEntity *drone, const b2Vec2 normAim) {
     ASSERT_VEC_NORMALIZED(normAim);
 
@@ -1078,40 +1113,25 @@ void createProjectile(iwEnv *e, droneEntity *drone, const b2Vec2 normAim) {
         }
     }
 
-    b2BodyDef projectileBodyDef = b2DefaultBodyDef();
-    projectileBodyDef.type = b2_dynamicBody;
-    projectileBodyDef.isBullet = drone->weaponInfo->isPhysicsBullet;
-    projectileBodyDef.linearDamping = drone->weaponInfo->damping;
-    projectileBodyDef.enableSleep = drone->weaponInfo->canSleep;
-    projectileBodyDef.position = pos;
-    b2BodyId projectileBodyID = b2CreateBody(e->worldID, &projectileBodyDef);
-    b2ShapeDef projectileShapeDef = b2DefaultShapeDef();
-    projectileShapeDef.enableContactEvents = true;
-    projectileShapeDef.density = drone->weaponInfo->density;
-    projectileShapeDef.material.restitution = 1.0f;
-    projectileShapeDef.material.friction = 0.0f;
-    projectileShapeDef.filter.categoryBits = PROJECTILE_SHAPE;
-    projectileShapeDef.filter.maskBits = WALL_SHAPE | FLOATING_WALL_SHAPE | PROJECTILE_SHAPE | DRONE_SHAPE | SHIELD_SHAPE;
-    const b2Circle projectileCircle = {.center = b2Vec2_zero, .radius = radius};
+    projectileEntity *projectile = fastCalloc(1, sizeof(projectileEntity));
+    projectile->droneIdx = drone->idx;
+    projectile->weaponInfo = drone->weaponInfo;
+    projectile->pos = pos;
+    projectile->lastPos = pos;
 
-    b2ShapeId projectileShapeID = b2CreateCircleShape(projectileBodyID, &projectileShapeDef, &projectileCircle);
+    entity *ent = createEntity(e, PROJECTILE_ENTITY, projectile);
+    projectile->ent = ent;
+    createProjectileBodyShape(e, projectile, pos);
 
     // add a bit of lateral drone velocity to projectile
     b2Vec2 forwardVel = b2MulSV(b2Dot(drone->velocity, normAim), normAim);
     b2Vec2 lateralVel = b2Sub(drone->velocity, forwardVel);
-    lateralVel = b2MulSV(projectileShapeDef.density * DRONE_MOVE_AIM_COEF, lateralVel);
+    lateralVel = b2MulSV(drone->weaponInfo->density * DRONE_MOVE_AIM_COEF, lateralVel);
     b2Vec2 aim = weaponAdjustAim(&e->randState, drone->weaponInfo->type, drone->heat, normAim);
     b2Vec2 fire = b2MulAdd(lateralVel, weaponFire(&e->randState, drone->weaponInfo->type), aim);
-    b2Body_ApplyLinearImpulseToCenter(projectileBodyID, fire, true);
+    b2Body_ApplyLinearImpulseToCenter(projectile->bodyID, fire, true);
 
-    projectileEntity *projectile = fastCalloc(1, sizeof(projectileEntity));
-    projectile->droneIdx = drone->idx;
-    projectile->bodyID = projectileBodyID;
-    projectile->shapeID = projectileShapeID;
-    projectile->weaponInfo = drone->weaponInfo;
-    projectile->pos = projectileBodyDef.position;
-    projectile->lastPos = projectileBodyDef.position;
-    projectile->velocity = b2Body_GetLinearVelocity(projectileBodyID);
+    projectile->velocity = b2Body_GetLinearVelocity(projectile->bodyID);
     projectile->lastVelocity = projectile->velocity;
     projectile->speed = b2Length(projectile->velocity);
     projectile->lastSpeed = projectile->speed;
@@ -1119,17 +1139,6 @@ void createProjectile(iwEnv *e, droneEntity *drone, const b2Vec2 normAim) {
         create_array(&projectile->entsInBlackHole, 4);
     }
     cc_array_add(e->projectiles, projectile);
-
-    entity *ent = createEntity(e, PROJECTILE_ENTITY, projectile);
-    projectile->ent = ent;
-    b2Body_SetUserData(projectile->bodyID, ent);
-    b2Shape_SetUserData(projectile->shapeID, ent);
-
-    // create a sensor shape if needed
-    if (projectile->weaponInfo->hasSensor) {
-        projectile->sensorID = weaponSensor(projectile->bodyID, projectile->weaponInfo->type);
-        b2Shape_SetUserData(projectile->sensorID, ent);
-    }
 }
 
 // compute value generally from 0-1 based off of how much a projectile(s)
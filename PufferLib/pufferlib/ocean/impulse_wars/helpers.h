@@ -2,10 +2,15 @@
 #define IMPULSE_WARS_HELPERS_H
 
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <time.h>
 
+#ifndef __EMSCRIPTEN__
+#include <pthread.h>
+#endif
+
 #include "box2d/box2d.h"
 
 #include "include/cc_array.h"
@@ -243,4 +248,310 @@ static inline bool bitTest(const uint8_t *b, const uint16_t n) {
     return b[bitSlot(n)] & bitMask(n);
 }
 
+// a small job system Box2D can run solver tasks on; one pool of threads is
+// shared by every world in the process, and threads stepping a world run
+// blocks of the task they are waiting on themselves so a task never waits on
+// a busy pool; each thread stepping a world is Box2D worker 0, pool threads
+// are workers 1 to numWorkers - 1. Worlds must all use the same worker
+// count, since Box2D sizes its per worker state by it
+#define MAX_POOL_WORKERS 32
+// Box2D has at most one solver task per worker plus a couple of others,
+// like the broadphase tree update, in flight per world
+#define WORLD_EXTRA_TASKS 4
+#define MAX_WORLD_TASKS (MAX_POOL_WORKERS + WORLD_EXTRA_TASKS)
+// split tasks into up to this many blocks per worker to balance load
+#define POOL_BLOCKS_PER_WORKER 4
+
+typedef struct poolTask poolTask;
+struct poolTask {
+    b2TaskCallback *task;
+    void *taskContext;
+    int32_t itemCount;
+    int32_t blockSize;
+    int32_t numBlocks;
+    int32_t nextBlock;
+    int32_t doneBlocks;
+    bool active;
+    // links in the pool's queue of tasks with unclaimed blocks
+    poolTask *prev;
+    poolTask *next;
+};
+
+typedef struct taskPool taskPool;
+
+typedef struct poolWorker {
+    taskPool *pool;
+    uint32_t workerIdx;
+} poolWorker;
+
+struct taskPool {
+    uint8_t numWorkers;
+    // envs using the pool
+    atomic_uint refs;
+#ifndef __EMSCRIPTEN__
+    pthread_t threads[MAX_POOL_WORKERS];
+    poolWorker workers[MAX_POOL_WORKERS];
+    pthread_mutex_t lock;
+    // signaled when a task with unclaimed blocks is added
+    pthread_cond_t workReady;
+    // signaled when the last block of a task finishes
+    pthread_cond_t workDone;
+#endif
+    bool stop;
+    // tasks with blocks no worker has claimed yet, oldest first
+    poolTask *pendingHead;
+    poolTask *pendingTail;
+};
+
+// the task slots of one world, passed to Box2D as its userTaskContext; a
+// slot is only freed by the thread stepping the world, so slots aren't
+// shared between worlds where one world's tasks could wait on another's
+typedef struct worldTasks {
+    taskPool *pool;
+    uint8_t numTasks;
+    poolTask tasks[MAX_WORLD_TASKS];
+} worldTasks;
+
+// process wide pool shared by every env that enables threaded physics
+taskPool *sharedTaskPool = NULL;
+#ifndef __EMSCRIPTEN__
+// held while the shared pool is created or destroyed
+pthread_mutex_t sharedTaskPoolLock = PTHREAD_MUTEX_INITIALIZER;
+#endif
+
+void initWorldTasks(worldTasks *w, taskPool *pool) {
+    memset(w, 0x0, sizeof(worldTasks));
+    w->pool = pool;
+    w->numTasks = pool->numWorkers + WORLD_EXTRA_TASKS;
+}
+
+#ifndef __EMSCRIPTEN__
+// claims the next block of a task and runs it; the pool lock must be held,
+// and is held again when this returns
+static void runPoolBlock(taskPool *pool, poolTask *t, const uint32_t workerIdx) {
+    const int32_t block = t->nextBlock++;
+    if (t->nextBlock == t->numBlocks) {
+        if (t->prev != NULL) {
+            t->prev->next = t->next;
+        } else {
+            pool->pendingHead = t->next;
+        }
+        if (t->next != NULL) {
+            t->next->prev = t->prev;
+        } else {
+            pool->pendingTail = t->prev;
+        }
+        t->prev = NULL;
+        t->next = NULL;
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    const int32_t start = block * t->blockSize;
+    const int32_t end = min(start + t->blockSize, t->itemCount);
+    t->task(start, end, workerIdx, t->taskContext);
+
+    pthread_mutex_lock(&pool->lock);
+    t->doneBlocks++;
+    if (t->doneBlocks == t->numBlocks) {
+        pthread_cond_broadcast(&pool->workDone);
+    }
+}
+
+static void *poolWorkerLoop(void *arg) {
+    const poolWorker *worker = arg;
+    taskPool *pool = worker->pool;
+
+    pthread_mutex_lock(&pool->lock);
+    while (true) {
+        while (!pool->stop && pool->pendingHead == NULL) {
+            pthread_cond_wait(&pool->workReady, &pool->lock);
+        }
+        if (pool->stop) {
+            break;
+        }
+        runPoolBlock(pool, pool->pendingHead, worker->workerIdx);
+    }
+    pthread_mutex_unlock(&pool->lock);
+
+    return NULL;
+}
+#endif
+
+// matches b2EnqueueTaskCallback; returns NULL if the task was run before
+// returning, in which case Box2D won't call finishPoolTask for it. That
+// only happens without pool threads
+void *enqueuePoolTask(b2TaskCallback *task, int itemCount, int minRange, void *taskContext, void *userContext) {
+    worldTasks *world = userContext;
+#ifndef __EMSCRIPTEN__
+    // tasks are never run here if the pool has threads, Box2D's solver
+    // tasks wait on each other so they all need to be queued before any of
+    // them are run by the stepping thread
+    taskPool *pool = world->pool;
+    if (pool->numWorkers > 1 && itemCount > 0) {
+        const int32_t maxBlocks = pool->numWorkers * POOL_BLOCKS_PER_WORKER;
+        int32_t numBlocks = min(maxBlocks, (itemCount + minRange - 1) / max(minRange, 1));
+        numBlocks = max(numBlocks, 1);
+        const int32_t blockSize = (itemCount + numBlocks - 1) / numBlocks;
+
+        // only this world's stepping thread uses its slots, so they can be
+        // searched without the pool lock
+        poolTask *t = NULL;
+        for (uint8_t i = 0; i < world->numTasks; i++) {
+            if (!world->tasks[i].active) {
+                t = &world->tasks[i];
+                break;
+            }
+        }
+        if (t == NULL) {
+            ERRORF("more than %u physics tasks in flight in one world", world->numTasks);
+        }
+
+        t->task = task;
+        t->taskContext = taskContext;
+        t->itemCount = itemCount;
+        t->blockSize = blockSize;
+        t->numBlocks = (itemCount + blockSize - 1) / blockSize;
+        t->nextBlock = 0;
+        t->doneBlocks = 0;
+        t->active = true;
+
+        pthread_mutex_lock(&pool->lock);
+        t->prev = pool->pendingTail;
+        t->next = NULL;
+        if (pool->pendingTail != NULL) {
+            pool->pendingTail->next = t;
+        } else {
+            pool->pendingHead = t;
+        }
+        pool->pendingTail = t;
+        pthread_cond_broadcast(&pool->workReady);
+        pthread_mutex_unlock(&pool->lock);
+        return t;
+    }
+#endif
+    MAYBE_UNUSED(minRange);
+    MAYBE_UNUSED(world);
+    task(0, itemCount, 0, taskContext);
+    return NULL;
+}
+
+// matches b2FinishTaskCallback; runs any unclaimed blocks of the task and
+// waits for the rest to finish
+void finishPoolTask(void *userTask, void *userContext) {
+#ifndef __EMSCRIPTEN__
+    taskPool *pool = ((worldTasks *)userContext)->pool;
+    poolTask *t = userTask;
+
+    pthread_mutex_lock(&pool->lock);
+    while (t->nextBlock < t->numBlocks) {
+        runPoolBlock(pool, t, 0);
+    }
+    while (t->doneBlocks < t->numBlocks) {
+        pthread_cond_wait(&pool->workDone, &pool->lock);
+    }
+    pthread_mutex_unlock(&pool->lock);
+    t->active = false;
+#else
+    MAYBE_UNUSED(userTask);
+    MAYBE_UNUSED(userContext);
+#endif
+}
+
+// the number of workers a pool asked for numWorkers will have
+static inline uint8_t taskPoolWorkers(const uint32_t numWorkers) {
+#ifndef __EMSCRIPTEN__
+    return min(max(numWorkers, 1u), (uint32_t)MAX_POOL_WORKERS);
+#else
+    MAYBE_UNUSED(numWorkers);
+    return 1;
+#endif
+}
+
+// true if acquireTaskPool(numWorkers) will succeed, because the shared pool
+// doesn't exist yet or has as many workers
+bool taskPoolAvailable(const uint32_t numWorkers) {
+#ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&sharedTaskPoolLock);
+#endif
+    const bool available = sharedTaskPool == NULL || sharedTaskPool->numWorkers == taskPoolWorkers(numWorkers);
+#ifndef __EMSCRIPTEN__
+    pthread_mutex_unlock(&sharedTaskPoolLock);
+#endif
+    return available;
+}
+
+// returns the process wide task pool, creating it with numWorkers workers
+// including the stepping thread if it doesn't exist yet; it is an error to
+// ask for a different number of workers than the existing pool has. Every
+// call must be paired with a call to releaseTaskPool
+taskPool *acquireTaskPool(const uint32_t numWorkers) {
+#ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&sharedTaskPoolLock);
+#endif
+    if (sharedTaskPool != NULL) {
+        if (sharedTaskPool->numWorkers != taskPoolWorkers(numWorkers)) {
+            ERRORF("physics threads %u don't match the %u of the shared task pool", numWorkers, sharedTaskPool->numWorkers);
+        }
+        atomic_fetch_add(&sharedTaskPool->refs, 1);
+#ifndef __EMSCRIPTEN__
+        pthread_mutex_unlock(&sharedTaskPoolLock);
+#endif
+        return sharedTaskPool;
+    }
+
+    taskPool *pool = fastCalloc(1, sizeof(taskPool));
+    atomic_init(&pool->refs, 1);
+    pool->numWorkers = taskPoolWorkers(numWorkers);
+#ifndef __EMSCRIPTEN__
+    pthread_mutex_init(&pool->lock, NULL);
+    pthread_cond_init(&pool->workReady, NULL);
+    pthread_cond_init(&pool->workDone, NULL);
+    for (uint8_t i = 1; i < pool->numWorkers; i++) {
+        poolWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->workerIdx = i;
+        if (pthread_create(&pool->threads[i], NULL, poolWorkerLoop, worker) != 0) {
+            ERROR("failed to create task pool thread");
+        }
+    }
+#endif
+    sharedTaskPool = pool;
+#ifndef __EMSCRIPTEN__
+    pthread_mutex_unlock(&sharedTaskPoolLock);
+#endif
+    return pool;
+}
+
+void releaseTaskPool(taskPool *pool) {
+    ASSERT(pool == sharedTaskPool);
+    // the lock keeps acquireTaskPool from handing out a pool being destroyed
+#ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&sharedTaskPoolLock);
+#endif
+    if (atomic_fetch_sub(&pool->refs, 1) != 1) {
+#ifndef __EMSCRIPTEN__
+        pthread_mutex_unlock(&sharedTaskPoolLock);
+#endif
+        return;
+    }
+
+#ifndef __EMSCRIPTEN__
+    pthread_mutex_lock(&pool->lock);
+    pool->stop = true;
+    pthread_cond_broadcast(&pool->workReady);
+    pthread_mutex_unlock(&pool->lock);
+    for (uint8_t i = 1; i < pool->numWorkers; i++) {
+        pthread_join(pool->threads[i], NULL);
+    }
+    pthread_mutex_destroy(&pool->lock);
+    pthread_cond_destroy(&pool->workReady);
+    pthread_cond_destroy(&pool->workDone);
+#endif
+    fastFree(pool);
+    sharedTaskPool = NULL;
+#ifndef __EMSCRIPTEN__
+    pthread_mutex_unlock(&sharedTaskPoolLock);
+#endif
+}
+
 #endif
@@ -23,7 +23,7 @@ int main(void) {
     rayClient *client = createRayClient();
     e->client = client;
 
-    initEnv(e, NUM_DRONES, 0, -1, time(NULL), false, false, false, false);
+    initEnv(e, NUM_DRONES, 0, -1, time(NULL), false, false, false, false, 1);
     initMaps(e);
     setupEnv(e);
     // e->humanInput = true;
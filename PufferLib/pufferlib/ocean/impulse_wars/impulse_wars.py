@@ -29,6 +29,7 @@ class ImpulseWars(pufferlib.PufferEnv):
         is_training: bool = True,
         human_control: bool = False,
         seed: int = 0,
+        physics_threads: int = 1,
         render: bool = False,
         report_interval: int = 64,
         buf = None,
@@ -43,6 +44,8 @@ class ImpulseWars(pufferlib.PufferEnv):
             raise ValueError("num_agents must greater than 0 and less than or equal to num_drones")
         if enable_teams and (num_drones % 2 != 0 or num_drones <= 2):
             raise ValueError("enable_teams is only supported for even numbers of drones greater than 2")
+        if physics_threads <= 0:
+            raise ValueError("physics_threads must be greater than 0")
 
         self.numDrones = num_drones
         self.continuous = continuous
@@ -98,6 +101,7 @@ class ImpulseWars(pufferlib.PufferEnv):
             sitting_duck=sitting_duck,
             is_training=is_training,
             continuous=continuous,
+            physics_threads=physics_threads,
         )
 
         binding.shared(self.c_envs)
@@ -128,6 +132,26 @@ class ImpulseWars(pufferlib.PufferEnv):
 
         return self.observations, self.rewards, self.terminals, self.truncations, infos
 
+    def snapshot(self, env_idx=0, buf=None):
+        '''Returns a snapshot of an env that can be passed to restore. If buf
+        is given the snapshot is written into it, avoiding an allocation'''
+        if buf is None:
+            buf = np.empty(binding.snapshot_size(self.c_envs, env_idx), dtype=np.uint8)
+        size = binding.snapshot(self.c_envs, env_idx, buf)
+        return buf[:size]
+
+    def restore(self, snapshot, env_idx=0):
+        '''Replaces the state of an env with a snapshot from snapshot. The
+        whole snapshot is checked first, and a ValueError is raised without
+        changing the env if it is corrupt or from an env with different
+        settings. The env's bodies are moved into place where they match
+        the snapshot's entities, and only the ones that don't are
+        recreated, so restoring between nearby steps rarely allocates.
+        Continuing may differ slightly from continuing the env the
+        snapshot was taken from, since physics contact state isn't
+        copied'''
+        binding.restore(self.c_envs, env_idx, snapshot)
+
     def render(self):
         binding.vec_render(self.c_envs, 0)
 
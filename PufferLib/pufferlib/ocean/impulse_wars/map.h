@@ -364,6 +364,10 @@ mapEntry *maps[] = {
     &siegeMap,
 };
 
+// maps are shared by every env in the process and only need to be
+// initialized once
+bool mapsInitialized = false;
+
 void resetMap(iwEnv *e) {
     // if sudden death walls were placed, remove them
     if (e->suddenDeathWallsPlaced) {
@@ -421,14 +425,7 @@ void resetMap(iwEnv *e) {
     }
 }
 
-void setupMap(iwEnv *e, const uint8_t mapIdx) {
-    // reset the map if we're switching to the same map
-    if (e->mapIdx == mapIdx) {
-        resetMap(e);
-        return;
-    }
-
-    // clear the old map
+void clearMap(iwEnv *e) {
     for (size_t i = 0; i < cc_array_size(e->walls); i++) {
         wallEntity *wall = safe_array_get_at(e->walls, i);
         destroyWall(e, wall, false);
@@ -442,17 +439,15 @@ void setupMap(iwEnv *e, const uint8_t mapIdx) {
     cc_array_remove_all(e->walls);
     cc_array_remove_all(e->cells);
     e->suddenDeathWallsPlaced = false;
+    e->mapIdx = -1;
+}
 
-    const uint8_t columns = maps[mapIdx]->columns;
-    const uint8_t rows = maps[mapIdx]->rows;
-    const char *layout = maps[mapIdx]->layout;
-
-    e->mapIdx = mapIdx;
-    e->map = maps[mapIdx];
-    e->defaultWeapon = weaponInfos[maps[mapIdx]->defaultWeapon];
-    if (e->isTraining && randFloat(&e->randState, 0.0f, 1.0f) < 0.25f) {
-        e->defaultWeapon = weaponInfos[randInt(&e->randState, 0, NUM_WEAPONS - 1)];
-    }
+// creates the cells and walls of the current map; floating walls with
+// set positions are skipped if placeFloatingWalls is false
+void createMapWalls(iwEnv *e, const bool placeFloatingWalls) {
+    const uint8_t columns = e->map->columns;
+    const uint8_t rows = e->map->rows;
+    const char *layout = e->map->layout;
 
     uint16_t cellIdx = 0;
     for (int row = 0; row < rows; row++) {
@@ -496,6 +491,11 @@ void setupMap(iwEnv *e, const uint8_t mapIdx) {
                 ERRORF("unknown map layout cell %c", cellType);
             }
 
+            if (floating && !placeFloatingWalls) {
+                cellIdx++;
+                continue;
+            }
+
             entity *ent = createWall(e, pos, thickness, thickness, cellIdx, wallType, floating);
             if (!floating) {
                 cell->ent = ent;
@@ -505,6 +505,25 @@ void setupMap(iwEnv *e, const uint8_t mapIdx) {
     }
 }
 
+void setupMap(iwEnv *e, const uint8_t mapIdx) {
+    // reset the map if we're switching to the same map
+    if (e->mapIdx == mapIdx) {
+        resetMap(e);
+        return;
+    }
+
+    clearMap(e);
+
+    e->mapIdx = mapIdx;
+    e->map = maps[mapIdx];
+    e->defaultWeapon = weaponInfos[maps[mapIdx]->defaultWeapon];
+    if (e->isTraining && randFloat(&e->randState, 0.0f, 1.0f) < 0.25f) {
+        e->defaultWeapon = weaponInfos[randInt(&e->randState, 0, NUM_WEAPONS - 1)];
+    }
+
+    createMapWalls(e, true);
+}
+
 void computeMapBoundsAndQuadrants(iwEnv *e, mapEntry *map) {
     mapBounds bounds = {.min = {.x = FLT_MAX, .y = FLT_MAX}, .max = {.x = FLT_MIN, .y = FLT_MIN}};
     for (size_t i = 0; i < cc_array_size(e->walls); i++) {
@@ -576,7 +595,109 @@ bool posValidDroneSpawnPoint(const iwEnv *e, const b2Vec2 pos) {
     return true;
 }
 
+static inline uint32_t mapPathIdx(const mapEntry *map, const uint16_t srcCellIdx, const uint16_t destCellIdx) {
+    const uint32_t numCells = map->rows * map->columns;
+    return (destCellIdx * numCells) + srcCellIdx;
+}
+
+// fills the directions to move in from every cell to reach destCellIdx,
+// walls are set to 8 and unreachable cells are left at UINT8_MAX
+void pathfindBFS(const iwEnv *e, uint8_t *flatPaths, int8_t *pathBuffer, uint16_t destCellIdx) {
+    uint8_t (*paths)[e->map->columns] = (uint8_t (*)[e->map->columns])flatPaths;
+    int8_t (*buffer)[3] = (int8_t (*)[3])pathBuffer;
+
+    uint16_t start = 0;
+    uint16_t end = 1;
+
+    const mapCell *cell = safe_array_get_at(e->cells, destCellIdx);
+    if (cell->ent != NULL && entityTypeIsWall(cell->ent->type)) {
+        return;
+    }
+    const int8_t destCol = destCellIdx % e->map->columns;
+    const int8_t destRow = destCellIdx / e->map->columns;
+
+    buffer[start][0] = 8;
+    buffer[start][1] = destCol;
+    buffer[start][2] = destRow;
+    while (start < end) {
+        const int8_t direction = buffer[start][0];
+        const int8_t startCol = buffer[start][1];
+        const int8_t startRow = buffer[start][2];
+        start++;
+
+        if (startCol < 0 || startCol >= e->map->columns || startRow < 0 || startRow >= e->map->rows || paths[startRow][startCol] != UINT8_MAX) {
+            continue;
+        }
+        int16_t cellIdx = cellIndex(e, startCol, startRow);
+        const mapCell *cell = safe_array_get_at(e->cells, cellIdx);
+        if (cell->ent != NULL && entityTypeIsWall(cell->ent->type)) {
+            paths[startRow][startCol] = 8;
+            continue;
+        }
+
+        paths[startRow][startCol] = direction;
+
+        buffer[end][0] = 6; // up
+        buffer[end][1] = startCol;
+        buffer[end][2] = startRow + 1;
+        end++;
+
+        buffer[end][0] = 2; // down
+        buffer[end][1] = startCol;
+        buffer[end][2] = startRow - 1;
+        end++;
+
+        buffer[end][0] = 0; // right
+        buffer[end][1] = startCol - 1;
+        buffer[end][2] = startRow;
+        end++;
+
+        buffer[end][0] = 4; // left
+        buffer[end][1] = startCol + 1;
+        buffer[end][2] = startRow;
+        end++;
+
+        buffer[end][0] = 5; // up left
+        buffer[end][1] = startCol + 1;
+        buffer[end][2] = startRow + 1;
+        end++;
+
+        buffer[end][0] = 3; // down left
+        buffer[end][1] = startCol + 1;
+        buffer[end][2] = startRow - 1;
+        end++;
+
+        buffer[end][0] = 1; // down right
+        buffer[end][1] = startCol - 1;
+        buffer[end][2] = startRow - 1;
+        end++;
+
+        buffer[end][0] = 7; // up right
+        buffer[end][1] = startCol - 1;
+        buffer[end][2] = startRow + 1;
+        end++;
+    }
+}
+
+// precompute the paths between every pair of cells of the current map
+uint8_t *computeMapPaths(const iwEnv *e) {
+    const uint16_t numCells = cc_array_size(e->cells);
+    uint8_t *paths = fastMalloc(numCells * numCells * sizeof(uint8_t));
+    memset(paths, UINT8_MAX, numCells * numCells * sizeof(uint8_t));
+    // every visited cell queues its 8 neighbors
+    int8_t *pathBuffer = fastCalloc(3 * ((8 * numCells) + 1), sizeof(int8_t));
+    for (uint16_t i = 0; i < numCells; i++) {
+        pathfindBFS(e, &paths[mapPathIdx(e->map, 0, i)], pathBuffer, i);
+    }
+    fastFree(pathBuffer);
+    return paths;
+}
+
 void initMaps(iwEnv *e) {
+    if (mapsInitialized) {
+        return;
+    }
+
     for (uint8_t i = 0; i < NUM_MAPS; i++) {
         setupMap(e, i);
         mapEntry *map = maps[i];
@@ -621,6 +742,7 @@ void initMaps(iwEnv *e) {
         map->droneSpawns = droneSpawns;
         map->packedLayout = packedLayout;
         map->nearestWalls = nearestWalls;
+        map->paths = computeMapPaths(e);
 
         // clear floating walls from the map
         for (uint8_t i = 0; i < cc_array_size(e->floatingWalls); i++) {
@@ -631,15 +753,22 @@ void initMaps(iwEnv *e) {
     }
 
     e->mapIdx = -1;
+    mapsInitialized = true;
 }
 
 void destroyMaps() {
+    if (!mapsInitialized) {
+        return;
+    }
+
     for (uint8_t i = 0; i < NUM_MAPS; i++) {
         mapEntry *map = maps[i];
         fastFree(map->droneSpawns);
         fastFree(map->packedLayout);
         fastFree(map->nearestWalls);
+        fastFree(map->paths);
     }
+    mapsInitialized = false;
 }
 
 void placeRandFloatingWall(iwEnv *e, const enum entityType wallType) {
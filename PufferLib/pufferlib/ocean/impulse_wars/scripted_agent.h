@@ -37,91 +37,6 @@ float castCircleCallback(b2ShapeId shapeId, b2Vec2 point, b2Vec2 normal, float f
     return 0.0f;
 }
 
-static inline uint32_t pathOffset(const iwEnv *e, uint16_t srcCellIdx, uint16_t destCellIdx) {
-    const uint8_t srcCol = srcCellIdx % e->map->columns;
-    const uint8_t srcRow = srcCellIdx / e->map->columns;
-    const uint8_t destCol = destCellIdx % e->map->columns;
-    const uint8_t destRow = destCellIdx / e->map->columns;
-    return (destRow * e->map->rows * e->map->columns * e->map->rows) + (destCol * e->map->rows * e->map->columns) + (srcRow * e->map->columns) + srcCol;
-}
-
-void pathfindBFS(const iwEnv *e, uint8_t *flatPaths, uint16_t destCellIdx) {
-    uint8_t (*paths)[e->map->columns] = (uint8_t (*)[e->map->columns])flatPaths;
-    int8_t (*buffer)[3] = (int8_t (*)[3])e->mapPathing[e->mapIdx].pathBuffer;
-
-    uint16_t start = 0;
-    uint16_t end = 1;
-
-    const mapCell *cell = safe_array_get_at(e->cells, destCellIdx);
-    if (cell->ent != NULL && entityTypeIsWall(cell->ent->type)) {
-        return;
-    }
-    const int8_t destCol = destCellIdx % e->map->columns;
-    const int8_t destRow = destCellIdx / e->map->columns;
-
-    buffer[start][0] = 8;
-    buffer[start][1] = destCol;
-    buffer[start][2] = destRow;
-    while (start < end) {
-        const int8_t direction = buffer[start][0];
-        const int8_t startCol = buffer[start][1];
-        const int8_t startRow = buffer[start][2];
-        start++;
-
-        if (startCol < 0 || startCol >= e->map->columns || startRow < 0 || startRow >= e->map->rows || paths[startRow][startCol] != UINT8_MAX) {
-            continue;
-        }
-        int16_t cellIdx = cellIndex(e, startCol, startRow);
-        const mapCell *cell = safe_array_get_at(e->cells, cellIdx);
-        if (cell->ent != NULL && entityTypeIsWall(cell->ent->type)) {
-            paths[startRow][startCol] = 8;
-            continue;
-        }
-
-        paths[startRow][startCol] = direction;
-
-        buffer[end][0] = 6; // up
-        buffer[end][1] = startCol;
-        buffer[end][2] = startRow + 1;
-        end++;
-
-        buffer[end][0] = 2; // down
-        buffer[end][1] = startCol;
-        buffer[end][2] = startRow - 1;
-        end++;
-
-        buffer[end][0] = 0; // right
-        buffer[end][1] = startCol - 1;
-        buffer[end][2] = startRow;
-        end++;
-
-        buffer[end][0] = 4; // left
-        buffer[end][1] = startCol + 1;
-        buffer[end][2] = startRow;
-        end++;
-
-        buffer[end][0] = 5; // up left
-        buffer[end][1] = startCol + 1;
-        buffer[end][2] = startRow + 1;
-        end++;
-
-        buffer[end][0] = 3; // down left
-        buffer[end][1] = startCol + 1;
-        buffer[end][2] = startRow - 1;
-        end++;
-
-        buffer[end][0] = 1; // down right
-        buffer[end][1] = startCol - 1;
-        buffer[end][2] = startRow - 1;
-        end++;
-
-        buffer[end][0] = 7; // up right
-        buffer[end][1] = startCol - 1;
-        buffer[end][2] = startRow + 1;
-        end++;
-    }
-}
-
 float distanceWithDamping(const iwEnv *e, const droneEntity *drone, const b2Vec2 direction, const float linearDamping, const float steps) {
     float speed = drone->weaponInfo->recoilMagnitude * DRONE_INV_MASS;
     if (!b2VecEqual(drone->velocity, b2Vec2_zero)) {
@@ -188,14 +103,7 @@ void moveTo(iwEnv *e, const droneEntity *drone, agentActions *actions, const b2V
         return;
     }
 
-    uint32_t pathIdx = pathOffset(e, drone->mapCellIdx, dstIdx);
-    uint8_t *paths = e->mapPathing[e->mapIdx].paths;
-    uint8_t direction = paths[pathIdx];
-    if (direction == UINT8_MAX) {
-        uint32_t bfsIdx = pathOffset(e, 0, dstIdx);
-        pathfindBFS(e, &paths[bfsIdx], dstIdx);
-        direction = paths[pathIdx];
-    }
+    const uint8_t direction = e->map->paths[mapPathIdx(e->map, drone->mapCellIdx, dstIdx)];
     if (direction >= 8) {
         return;
     }
@@ -350,22 +258,22 @@ agentActions scriptedAgentActions(iwEnv *e, droneEntity *drone) {
 
     // get a weapon if the standard weapon is active
     if (drone->weaponInfo->type == STANDARD_WEAPON && cc_array_size(e->pickups) != 0) {
-        nearEntity nearPickups[MAX_WEAPON_PICKUPS] = {0};
-        uint8_t numActivePickups = 0;
+        nearEntity nearPickup;
+        uint8_t numNearPickups = 0;
         for (uint8_t i = 0; i < cc_array_size(e->pickups); i++) {
             weaponPickupEntity *pickup = safe_array_get_at(e->pickups, i);
             if (pickup->floatingWallsTouching > 0) {
                 continue;
             }
             const nearEntity nearEnt = {
+                .idx = i,
                 .entity = pickup,
                 .distanceSquared = b2DistanceSquared(pickup->pos, drone->pos),
             };
-            nearPickups[numActivePickups++] = nearEnt;
+            numNearPickups = nearHeapPush(&nearPickup, numNearPickups, 1, nearEnt);
         }
-        if (numActivePickups > 0) {
-            insertionSort(nearPickups, numActivePickups);
-            const weaponPickupEntity *pickup = nearPickups[0].entity;
+        if (numNearPickups > 0) {
+            const weaponPickupEntity *pickup = nearPickup.entity;
             moveTo(e, drone, &actions, pickup->pos);
             return actions;
         }
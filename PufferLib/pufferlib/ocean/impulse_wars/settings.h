@@ -66,7 +66,8 @@ const uint16_t NEAR_WALL_TYPES_OBS_OFFSET = MAP_OBS_SIZE;
 const uint8_t NUM_FLOATING_WALL_OBS = _NUM_FLOATING_WALL_OBS;
 const uint16_t FLOATING_WALL_TYPES_OBS_OFFSET = NEAR_WALL_TYPES_OBS_OFFSET + NUM_NEAR_WALL_OBS;
 
-const uint8_t NUM_PROJECTILE_OBS = 30;
+#define _NUM_PROJECTILE_OBS 30
+const uint8_t NUM_PROJECTILE_OBS = _NUM_PROJECTILE_OBS;
 const uint16_t PROJECTILE_DRONE_OBS_OFFSET = FLOATING_WALL_TYPES_OBS_OFFSET + NUM_FLOATING_WALL_OBS;
 const uint16_t PROJECTILE_WEAPONS_OBS_OFFSET = PROJECTILE_DRONE_OBS_OFFSET + NUM_PROJECTILE_OBS;
 
@@ -802,4 +803,69 @@ void insertionSort(nearEntity arr[], uint8_t size) {
     }
 }
 
+// nearEntity.idx must be the order entities are pushed in, so entities the
+// same distance away are ordered the same way insertionSort orders them
+static inline bool nearEntityFarther(const nearEntity *a, const nearEntity *b) {
+    return a->distanceSquared > b->distanceSquared || (a->distanceSquared == b->distanceSquared && a->idx > b->idx);
+}
+
+static inline void nearHeapSiftDown(nearEntity heap[], const uint16_t size, uint16_t i) {
+    while (true) {
+        const uint16_t left = (2 * i) + 1;
+        const uint16_t right = left + 1;
+        uint16_t farthest = i;
+        if (left < size && nearEntityFarther(&heap[left], &heap[farthest])) {
+            farthest = left;
+        }
+        if (right < size && nearEntityFarther(&heap[right], &heap[farthest])) {
+            farthest = right;
+        }
+        if (farthest == i) {
+            return;
+        }
+        const nearEntity tmp = heap[i];
+        heap[i] = heap[farthest];
+        heap[farthest] = tmp;
+        i = farthest;
+    }
+}
+
+// keeps the k nearest entities pushed so far in a max heap with the
+// farthest entity first, so finding the N nearest of M entities takes
+// O(M log N) instead of sorting all M; returns the new heap size
+uint16_t nearHeapPush(nearEntity heap[], uint16_t size, const uint16_t k, const nearEntity ent) {
+    if (size < k) {
+        uint16_t i = size;
+        heap[i] = ent;
+        while (i > 0) {
+            const uint16_t parent = (i - 1) / 2;
+            if (!nearEntityFarther(&heap[i], &heap[parent])) {
+                break;
+            }
+            const nearEntity tmp = heap[i];
+            heap[i] = heap[parent];
+            heap[parent] = tmp;
+            i = parent;
+        }
+        return size + 1;
+    }
+    if (k == 0 || !nearEntityFarther(&heap[0], &ent)) {
+        return size;
+    }
+    heap[0] = ent;
+    nearHeapSiftDown(heap, size, 0);
+    return size;
+}
+
+// sorts a heap built with nearHeapPush from nearest to farthest
+void nearHeapSort(nearEntity heap[], uint16_t size) {
+    while (size > 1) {
+        size--;
+        const nearEntity tmp = heap[0];
+        heap[0] = heap[size];
+        heap[size] = tmp;
+        nearHeapSiftDown(heap, size, 0);
+    }
+}
+
 #endif
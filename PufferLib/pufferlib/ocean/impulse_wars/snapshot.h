@@ -0,0 +1,864 @@
+#ifndef IMPULSE_WARS_SNAPSHOT_H
+#define IMPULSE_WARS_SNAPSHOT_H
+
+#include "env.h"
+
+// Snapshots are a flat, pointer free copy of an env mid episode: env
+// state, every entity with the transform and velocities of its body, and
+// the agent buffers. They can be written to any buffer of at least
+// snapshotEnvSize bytes without allocating, and restored into any env
+// created with the same number of drones and agents. The whole snapshot
+// is validated before the env is touched, so a corrupt or truncated one
+// is rejected instead of read past its end.
+//
+// Restoring works in place when the snapshot is of the map the env is on:
+// live entities are matched to the snapshot's by index, and every one
+// that matches (same kind of body, like a projectile of the same weapon)
+// keeps its Box2D body and entity record and only has its state and
+// transform set. Only entities that differ are destroyed and created, so
+// restoring into the env a snapshot was taken from doesn't allocate. A
+// snapshot of another map frees the env's entities and Box2D world and
+// rebuilds them, the same as a reset does.
+//
+// Box2D's internal contact and sensor state isn't copied; reused bodies
+// keep the live world's and new bodies get theirs on the first step after
+// a restore. Continuing from a restore may so differ slightly from
+// continuing the env the snapshot was taken from, or from restoring the
+// same snapshot into an env in another state. Counters that mirror that
+// state, like the floating walls touching a pickup, are left out of
+// snapshots for the same reason.
+
+#define SNAPSHOT_MAGIC 0x53574921
+#define SNAPSHOT_VERSION 1
+
+typedef struct bodySnapshot {
+    b2Transform transform;
+    b2Vec2 linearVelocity;
+    float angularVelocity;
+    bool awake;
+    bool enabled;
+} bodySnapshot;
+
+typedef struct envSnapshot {
+    uint32_t magic;
+    uint16_t version;
+    uint32_t size;
+
+    uint8_t numDrones;
+    uint8_t numAgents;
+    bool teamsEnabled;
+    bool isTraining;
+    uint16_t obsBytes;
+
+    uint64_t randState;
+    bool needsReset;
+    uint16_t episodeLength;
+    Log log;
+    droneStats stats[_MAX_DRONES];
+
+    int8_t mapIdx;
+    int8_t lastSpawnQuad;
+    uint8_t spawnedWeaponPickups[_NUM_WEAPONS];
+    enum weaponType defaultWeapon;
+    uint16_t stepsLeft;
+    uint16_t suddenDeathSteps;
+    uint8_t suddenDeathWallCounter;
+    bool suddenDeathWallsPlaced;
+
+    uint16_t numSuddenDeathWalls;
+    uint16_t numFloatingWalls;
+    uint16_t numPickups;
+    uint16_t numProjectiles;
+    uint16_t numDronePieces;
+} envSnapshot;
+
+typedef struct wallSnapshot {
+    wallEntity wall;
+    bodySnapshot body;
+} wallSnapshot;
+
+// followed by numPhysicsSteps physicsStepInfos
+typedef struct droneSnapshot {
+    droneEntity drone;
+    enum weaponType weapon;
+    bodySnapshot body;
+    uint16_t numPhysicsSteps;
+    bool hasShield;
+    shieldEntity shield;
+    bodySnapshot shieldBody;
+} droneSnapshot;
+
+typedef struct projectileSnapshot {
+    projectileEntity projectile;
+    enum weaponType weapon;
+    bodySnapshot body;
+    // index of the wall a set mine is welded to, -1 if it isn't welded
+    int16_t weldedWallIdx;
+    bool weldedWallFloating;
+} projectileSnapshot;
+
+typedef struct dronePieceSnapshot {
+    dronePieceEntity piece;
+    bodySnapshot body;
+} dronePieceSnapshot;
+
+static inline size_t agentBuffersSize(const iwEnv *e) {
+    return e->numAgents * ((e->obsBytes * sizeof(uint8_t)) + sizeof(float) + (3 * sizeof(uint8_t)));
+}
+
+size_t snapshotEnvSize(const iwEnv *e) {
+    size_t size = sizeof(envSnapshot);
+    for (uint8_t i = 0; i < cc_array_size(e->drones); i++) {
+        const droneEntity *drone = safe_array_get_at(e->drones, i);
+        size += sizeof(droneSnapshot) + (cc_array_size(drone->physicsTracking) * sizeof(physicsStepInfo));
+    }
+    for (size_t i = 0; i < cc_array_size(e->walls); i++) {
+        const wallEntity *wall = safe_array_get_at(e->walls, i);
+        if (wall->isSuddenDeath) {
+            size += sizeof(wallSnapshot);
+        }
+    }
+    size += cc_array_size(e->floatingWalls) * sizeof(wallSnapshot);
+    size += cc_array_size(e->pickups) * sizeof(weaponPickupEntity);
+    size += cc_array_size(e->projectiles) * sizeof(projectileSnapshot);
+    size += cc_array_size(e->dronePieces) * sizeof(dronePieceSnapshot);
+    return size + agentBuffersSize(e);
+}
+
+static inline void snapshotWrite(uint8_t *buf, size_t *offset, const void *src, const size_t size) {
+    memcpy(buf + *offset, src, size);
+    *offset += size;
+}
+
+static inline void snapshotRead(const uint8_t *buf, size_t *offset, void *dst, const size_t size) {
+    memcpy(dst, buf + *offset, size);
+    *offset += size;
+}
+
+bodySnapshot snapshotBody(const b2BodyId bodyID) {
+    bodySnapshot body;
+    memset(&body, 0x0, sizeof(bodySnapshot));
+    body.transform = b2Body_GetTransform(bodyID);
+    body.linearVelocity = b2Body_GetLinearVelocity(bodyID);
+    body.angularVelocity = b2Body_GetAngularVelocity(bodyID);
+    body.awake = b2Body_IsAwake(bodyID);
+    body.enabled = b2Body_IsEnabled(bodyID);
+    return body;
+}
+
+void restoreBody(const b2BodyId bodyID, const bodySnapshot *body) {
+    b2Body_SetTransform(bodyID, body->transform.p, body->transform.q);
+    b2Body_SetLinearVelocity(bodyID, body->linearVelocity);
+    b2Body_SetAngularVelocity(bodyID, body->angularVelocity);
+    if (!body->enabled) {
+        b2Body_Disable(bodyID);
+    } else {
+        // a reused body may be disabled, like the body of a dead drone
+        b2Body_Enable(bodyID);
+        b2Body_SetAwake(bodyID, body->awake);
+    }
+}
+
+void snapshotWall(const wallEntity *wall, uint8_t *buf, size_t *offset) {
+    wallSnapshot snap;
+    memset(&snap, 0x0, sizeof(wallSnapshot));
+    memcpy(&snap.wall, wall, sizeof(wallEntity));
+    snap.wall.bodyID = b2_nullBodyId;
+    snap.wall.shapeID = b2_nullShapeId;
+    snap.wall.ent = NULL;
+    snap.body = snapshotBody(wall->bodyID);
+    snapshotWrite(buf, offset, &snap, sizeof(wallSnapshot));
+}
+
+// finds the wall a set mine was welded to when it hit it
+int16_t findMineWall(const iwEnv *e, const projectileEntity *projectile, bool *floating) {
+    if (!projectile->setMine || b2Body_GetJointCount(projectile->bodyID) == 0) {
+        return -1;
+    }
+    b2JointId jointID;
+    b2Body_GetJoints(projectile->bodyID, &jointID, 1);
+    const entity *ent = b2Body_GetUserData(b2Joint_GetBodyA(jointID));
+    if (ent == projectile->ent) {
+        ent = b2Body_GetUserData(b2Joint_GetBodyB(jointID));
+    }
+    ASSERT(ent != NULL && entityTypeIsWall(ent->type));
+    wallEntity *wall = ent->entity;
+
+    *floating = wall->isFloating;
+    CC_Array *walls = e->walls;
+    if (wall->isFloating) {
+        walls = e->floatingWalls;
+    }
+    size_t wallIdx;
+    const enum cc_stat res = cc_array_index_of(walls, wall, &wallIdx);
+    MAYBE_UNUSED(res);
+    ASSERT(res == CC_OK);
+    return wallIdx;
+}
+
+// writes a snapshot of the env to buf and returns its size, or 0 if buf
+// is smaller than snapshotEnvSize; must be called between steps
+size_t snapshotEnv(const iwEnv *e, uint8_t *buf, const size_t bufSize) {
+    ASSERT(cc_array_size(e->explodingProjectiles) == 0);
+    const size_t size = snapshotEnvSize(e);
+    if (bufSize < size) {
+        return 0;
+    }
+
+    envSnapshot header;
+    memset(&header, 0x0, sizeof(envSnapshot));
+    header.magic = SNAPSHOT_MAGIC;
+    header.version = SNAPSHOT_VERSION;
+    header.size = size;
+    header.numDrones = e->numDrones;
+    header.numAgents = e->numAgents;
+    header.teamsEnabled = e->teamsEnabled;
+    header.isTraining = e->isTraining;
+    header.obsBytes = e->obsBytes;
+    header.randState = e->randState;
+    header.needsReset = e->needsReset;
+    header.episodeLength = e->episodeLength;
+    header.log = e->log;
+    memcpy(header.stats, e->stats, sizeof(e->stats));
+    header.mapIdx = e->mapIdx;
+    header.lastSpawnQuad = e->lastSpawnQuad;
+    memcpy(header.spawnedWeaponPickups, e->spawnedWeaponPickups, sizeof(e->spawnedWeaponPickups));
+    header.defaultWeapon = e->defaultWeapon->type;
+    header.stepsLeft = e->stepsLeft;
+    header.suddenDeathSteps = e->suddenDeathSteps;
+    header.suddenDeathWallCounter = e->suddenDeathWallCounter;
+    header.suddenDeathWallsPlaced = e->suddenDeathWallsPlaced;
+    for (size_t i = 0; i < cc_array_size(e->walls); i++) {
+        const wallEntity *wall = safe_array_get_at(e->walls, i);
+        header.numSuddenDeathWalls += wall->isSuddenDeath;
+    }
+    header.numFloatingWalls = cc_array_size(e->floatingWalls);
+    header.numPickups = cc_array_size(e->pickups);
+    header.numProjectiles = cc_array_size(e->projectiles);
+    header.numDronePieces = cc_array_size(e->dronePieces);
+
+    size_t offset = 0;
+    snapshotWrite(buf, &offset, &header, sizeof(envSnapshot));
+
+    for (uint8_t i = 0; i < cc_array_size(e->drones); i++) {
+        const droneEntity *drone = safe_array_get_at(e->drones, i);
+        droneSnapshot snap;
+        memset(&snap, 0x0, sizeof(droneSnapshot));
+        memcpy(&snap.drone, drone, sizeof(droneEntity));
+        snap.drone.bodyID = b2_nullBodyId;
+        snap.drone.shapeID = b2_nullShapeId;
+        snap.drone.weaponInfo = NULL;
+        snap.drone.physicsTracking = NULL;
+        snap.drone.shield = NULL;
+        snap.drone.ent = NULL;
+        snap.drone.brakeTrailPoints = NULL;
+        snap.weapon = drone->weaponInfo->type;
+        snap.body = snapshotBody(drone->bodyID);
+        snap.numPhysicsSteps = cc_array_size(drone->physicsTracking);
+        if (drone->shield != NULL) {
+            snap.hasShield = true;
+            memcpy(&snap.shield, drone->shield, sizeof(shieldEntity));
+            snap.shield.drone = NULL;
+            snap.shield.bodyID = b2_nullBodyId;
+            snap.shield.shapeID = b2_nullShapeId;
+            snap.shield.bufferShapeID = b2_nullShapeId;
+            snap.shield.ent = NULL;
+            snap.shieldBody = snapshotBody(drone->shield->bodyID);
+        }
+        snapshotWrite(buf, &offset, &snap, sizeof(droneSnapshot));
+
+        for (uint16_t j = 0; j < snap.numPhysicsSteps; j++) {
+            const physicsStepInfo *physicsStep = safe_array_get_at(drone->physicsTracking, j);
+            snapshotWrite(buf, &offset, physicsStep, sizeof(physicsStepInfo));
+        }
+    }
+
+    // sudden death walls are always after the walls of the map
+    for (size_t i = 0; i < cc_array_size(e->walls); i++) {
+        const wallEntity *wall = safe_array_get_at(e->walls, i);
+        if (wall->isSuddenDeath) {
+            snapshotWall(wall, buf, &offset);
+        }
+    }
+    for (size_t i = 0; i < cc_array_size(e->floatingWalls); i++) {
+        snapshotWall(safe_array_get_at(e->floatingWalls, i), buf, &offset);
+    }
+
+    for (size_t i = 0; i < cc_array_size(e->pickups); i++) {
+        const weaponPickupEntity *pickup = safe_array_get_at(e->pickups, i);
+        weaponPickupEntity snap;
+        memset(&snap, 0x0, sizeof(weaponPickupEntity));
+        memcpy(&snap, pickup, sizeof(weaponPickupEntity));
+        snap.bodyID = b2_nullBodyId;
+        snap.shapeID = b2_nullShapeId;
+        snap.ent = NULL;
+        snap.floatingWallsTouching = 0;
+        snapshotWrite(buf, &offset, &snap, sizeof(weaponPickupEntity));
+    }
+
+    for (size_t i = 0; i < cc_array_size(e->projectiles); i++) {
+        const projectileEntity *projectile = safe_array_get_at(e->projectiles, i);
+        projectileSnapshot snap;
+        memset(&snap, 0x0, sizeof(projectileSnapshot));
+        memcpy(&snap.projectile, projectile, sizeof(projectileEntity));
+        snap.projectile.bodyID = b2_nullBodyId;
+        snap.projectile.shapeID = b2_nullShapeId;
+        snap.projectile.sensorID = b2_nullShapeId;
+        snap.projectile.weaponInfo = NULL;
+        snap.projectile.entsInBlackHole = NULL;
+        snap.projectile.ent = NULL;
+        snap.projectile.contacts = 0;
+        snap.projectile.numDronesBehindWalls = 0;
+        memset(snap.projectile.dronesBehindWalls, 0x0, sizeof(snap.projectile.dronesBehindWalls));
+        snap.weapon = projectile->weaponInfo->type;
+        snap.body = snapshotBody(projectile->bodyID);
+        snap.weldedWallIdx = findMineWall(e, projectile, &snap.weldedWallFloating);
+        snapshotWrite(buf, &offset, &snap, sizeof(projectileSnapshot));
+    }
+
+    for (size_t i = 0; i < cc_array_size(e->dronePieces); i++) {
+        const dronePieceEntity *piece = safe_array_get_at(e->dronePieces, i);
+        dronePieceSnapshot snap;
+        memset(&snap, 0x0, sizeof(dronePieceSnapshot));
+        memcpy(&snap.piece, piece, sizeof(dronePieceEntity));
+        snap.piece.bodyID = b2_nullBodyId;
+        snap.piece.shapeID = b2_nullShapeId;
+        snap.piece.ent = NULL;
+        snap.body = snapshotBody(piece->bodyID);
+        snapshotWrite(buf, &offset, &snap, sizeof(dronePieceSnapshot));
+    }
+
+    snapshotWrite(buf, &offset, e->observations, e->numAgents * e->obsBytes * sizeof(uint8_t));
+    snapshotWrite(buf, &offset, e->rewards, e->numAgents * sizeof(float));
+    snapshotWrite(buf, &offset, e->masks, e->numAgents * sizeof(uint8_t));
+    snapshotWrite(buf, &offset, e->terminals, e->numAgents * sizeof(uint8_t));
+    snapshotWrite(buf, &offset, e->truncations, e->numAgents * sizeof(uint8_t));
+
+    ASSERTF(offset == size, "offset: %zu size: %zu", offset, size);
+    return size;
+}
+
+// restores a wall to index idx of the env's walls or floating walls,
+// reusing the wall there if it has the same shape and, if static, position
+void restoreWall(iwEnv *e, const wallSnapshot *snap, const bool floating, const size_t idx) {
+    const wallEntity *src = &snap->wall;
+    CC_Array *walls = e->walls;
+    if (floating) {
+        walls = e->floatingWalls;
+    }
+
+    wallEntity *wall = NULL;
+    if (idx < cc_array_size(walls)) {
+        wall = safe_array_get_at(walls, idx);
+        const bool samePos = floating || b2VecEqual(wall->pos, src->pos);
+        if (wall->type != src->type || !b2VecEqual(wall->extent, src->extent) || !samePos) {
+            destroyWall(e, wall, false);
+            wall = NULL;
+        }
+    }
+    if (wall == NULL) {
+        createWall(e, src->pos, src->extent.x * 2.0f, src->extent.y * 2.0f, src->mapCellIdx, src->type, floating);
+        if (idx < cc_array_size(walls) - 1) {
+            cc_array_remove_last(walls, (void **)&wall);
+            cc_array_replace_at(walls, wall, idx, NULL);
+        } else {
+            wall = safe_array_get_at(walls, idx);
+        }
+    }
+
+    const b2BodyId bodyID = wall->bodyID;
+    const b2ShapeId shapeID = wall->shapeID;
+    entity *ent = wall->ent;
+    memcpy(wall, src, sizeof(wallEntity));
+    wall->bodyID = bodyID;
+    wall->shapeID = shapeID;
+    wall->ent = ent;
+    if (floating) {
+        restoreBody(wall->bodyID, &snap->body);
+    }
+}
+
+void weldMine(iwEnv *e, const projectileEntity *projectile, const wallEntity *wall) {
+    b2WeldJointDef jointDef = b2DefaultWeldJointDef();
+    jointDef.base.bodyIdA = wall->bodyID;
+    jointDef.base.bodyIdB = projectile->bodyID;
+    jointDef.base.localFrameA = b2InvMulTransforms(b2Body_GetTransform(wall->bodyID), b2Body_GetTransform(projectile->bodyID));
+    jointDef.base.localFrameB = b2Transform_identity;
+    b2CreateWeldJoint(e->worldID, &jointDef);
+}
+
+static inline bool snapshotCanRead(const size_t offset, const size_t count, const size_t itemSize, const size_t size) {
+    return offset <= size && count <= (size - offset) / itemSize;
+}
+
+static inline bool snapshotCellValid(const int16_t cellIdx, const uint16_t numCells, const bool allowNone) {
+    return (allowNone && cellIdx == -1) || (cellIdx >= 0 && cellIdx < numCells);
+}
+
+// the number of walls createMapWalls creates when not placing floating walls
+static uint16_t mapWallCount(const mapEntry *map) {
+    uint16_t count = 0;
+    for (uint16_t i = 0; i < map->rows * map->columns; i++) {
+        const char cellType = map->layout[i];
+        count += cellType == 'W' || cellType == 'B' || cellType == 'D';
+    }
+    return count;
+}
+
+static bool validateSnapshotWall(const wallSnapshot *snap, const bool floating, const uint16_t numCells) {
+    return snap->wall.isFloating == floating && entityTypeIsWall(snap->wall.type) && snapshotCellValid(snap->wall.mapCellIdx, numCells, floating);
+}
+
+// checks a whole snapshot against the env it will be restored into
+// without modifying it: the header, that every count and index in it is
+// in range, and that the entities it lists add up to exactly size bytes
+bool validateSnapshot(const iwEnv *e, const uint8_t *buf, const size_t size) {
+    envSnapshot header;
+    if (size < sizeof(envSnapshot)) {
+        return false;
+    }
+    memcpy(&header, buf, sizeof(envSnapshot));
+    if (header.magic != SNAPSHOT_MAGIC || header.version != SNAPSHOT_VERSION || header.size != size) {
+        return false;
+    }
+    if (header.numDrones != e->numDrones || header.numAgents != e->numAgents || header.teamsEnabled != e->teamsEnabled || header.isTraining != e->isTraining || header.obsBytes != e->obsBytes) {
+        return false;
+    }
+    if (header.mapIdx < 0 || header.mapIdx >= NUM_MAPS || header.defaultWeapon >= NUM_WEAPONS || header.lastSpawnQuad < -1 || header.lastSpawnQuad > 3) {
+        return false;
+    }
+    const mapEntry *map = maps[header.mapIdx];
+    const uint16_t numCells = map->rows * map->columns;
+    const uint8_t numTeams = e->teamsEnabled ? 2 : e->numDrones;
+    size_t offset = sizeof(envSnapshot);
+
+    for (uint8_t i = 0; i < header.numDrones; i++) {
+        droneSnapshot snap;
+        if (!snapshotCanRead(offset, 1, sizeof(droneSnapshot), size)) {
+            return false;
+        }
+        snapshotRead(buf, &offset, &snap, sizeof(droneSnapshot));
+        const droneEntity *drone = &snap.drone;
+        if (snap.weapon >= NUM_WEAPONS || drone->stepInfo.prevWeapon >= NUM_WEAPONS || drone->idx != i || drone->team >= numTeams) {
+            return false;
+        }
+        if (!snapshotCellValid(drone->mapCellIdx, numCells, true) || drone->killedBy < -1 || drone->killedBy >= header.numDrones) {
+            return false;
+        }
+        if (!snapshotCanRead(offset, snap.numPhysicsSteps, sizeof(physicsStepInfo), size)) {
+            return false;
+        }
+        for (uint16_t j = 0; j < snap.numPhysicsSteps; j++) {
+            physicsStepInfo physicsStep;
+            snapshotRead(buf, &offset, &physicsStep, sizeof(physicsStepInfo));
+            if (physicsStep.srcIdx >= header.numDrones) {
+                return false;
+            }
+        }
+    }
+
+    if (!snapshotCanRead(offset, header.numSuddenDeathWalls + header.numFloatingWalls, sizeof(wallSnapshot), size)) {
+        return false;
+    }
+    for (uint16_t i = 0; i < header.numSuddenDeathWalls + header.numFloatingWalls; i++) {
+        wallSnapshot snap;
+        snapshotRead(buf, &offset, &snap, sizeof(wallSnapshot));
+        if (!validateSnapshotWall(&snap, i >= header.numSuddenDeathWalls, numCells)) {
+            return false;
+        }
+    }
+
+    if (!snapshotCanRead(offset, header.numPickups, sizeof(weaponPickupEntity), size)) {
+        return false;
+    }
+    for (uint16_t i = 0; i < header.numPickups; i++) {
+        weaponPickupEntity pickup;
+        snapshotRead(buf, &offset, &pickup, sizeof(weaponPickupEntity));
+        if (pickup.weapon >= NUM_WEAPONS || !snapshotCellValid(pickup.mapCellIdx, numCells, pickup.bodyDestroyed)) {
+            return false;
+        }
+    }
+
+    // welded walls are indexed into the walls the env will have once
+    // restored, the map's walls then the sudden death walls
+    const uint16_t numWalls = mapWallCount(map) + header.numSuddenDeathWalls;
+    if (!snapshotCanRead(offset, header.numProjectiles, sizeof(projectileSnapshot), size)) {
+        return false;
+    }
+    for (uint16_t i = 0; i < header.numProjectiles; i++) {
+        projectileSnapshot snap;
+        snapshotRead(buf, &offset, &snap, sizeof(projectileSnapshot));
+        if (snap.weapon >= NUM_WEAPONS || snap.projectile.droneIdx >= header.numDrones || !snapshotCellValid(snap.projectile.mapCellIdx, numCells, true)) {
+            return false;
+        }
+        const uint16_t weldableWalls = snap.weldedWallFloating ? header.numFloatingWalls : numWalls;
+        if (snap.weldedWallIdx < -1 || (snap.weldedWallIdx != -1 && snap.weldedWallIdx >= weldableWalls)) {
+            return false;
+        }
+    }
+
+    if (!snapshotCanRead(offset, header.numDronePieces, sizeof(dronePieceSnapshot), size)) {
+        return false;
+    }
+    for (uint16_t i = 0; i < header.numDronePieces; i++) {
+        dronePieceSnapshot snap;
+        snapshotRead(buf, &offset, &snap, sizeof(dronePieceSnapshot));
+        if (snap.piece.droneIdx >= header.numDrones) {
+            return false;
+        }
+    }
+
+    return offset + agentBuffersSize(e) == size;
+}
+
+// puts a restored entity at index idx of arr, where a destroyed one may be
+static inline void setRestoredEntity(CC_Array *arr, void *entity, const size_t idx) {
+    if (idx < cc_array_size(arr)) {
+        cc_array_replace_at(arr, entity, idx, NULL);
+    } else {
+        cc_array_add(arr, entity);
+    }
+}
+
+// restores a drone's state and physics tracking, reusing the live drone at
+// index idx if there is one; its body and shield are restored later by
+// restoreDroneBody once the walls are
+void restoreDrone(iwEnv *e, const droneSnapshot *snap, const uint8_t idx, const uint8_t *buf, size_t *offset) {
+    droneEntity *drone = NULL;
+    if (idx < cc_array_size(e->drones)) {
+        drone = safe_array_get_at(e->drones, idx);
+        // drop the shield here, as destroying it changes the drone's energy
+        if (drone->shield != NULL && !snap->hasShield) {
+            destroyDroneShield(e, drone->shield, false);
+        }
+        for (size_t i = 0; i < cc_array_size(drone->brakeTrailPoints); i++) {
+            fastFree(safe_array_get_at(drone->brakeTrailPoints, i));
+        }
+        cc_array_remove_all(drone->brakeTrailPoints);
+
+        const droneEntity live = *drone;
+        memcpy(drone, &snap->drone, sizeof(droneEntity));
+        drone->bodyID = live.bodyID;
+        drone->shapeID = live.shapeID;
+        drone->shield = live.shield;
+        drone->ent = live.ent;
+        drone->brakeTrailPoints = live.brakeTrailPoints;
+        drone->physicsTracking = live.physicsTracking;
+    } else {
+        drone = fastMalloc(sizeof(droneEntity));
+        memcpy(drone, &snap->drone, sizeof(droneEntity));
+        create_array(&drone->brakeTrailPoints, 64);
+        create_array(&drone->physicsTracking, 128);
+        cc_array_add(e->drones, drone);
+    }
+    drone->weaponInfo = weaponInfos[snap->weapon];
+
+    // reuse the physics steps the drone already tracks
+    CC_Array *tracking = drone->physicsTracking;
+    for (uint16_t i = 0; i < snap->numPhysicsSteps; i++) {
+        physicsStepInfo *physicsStep = NULL;
+        if (i < cc_array_size(tracking)) {
+            physicsStep = safe_array_get_at(tracking, i);
+        } else {
+            physicsStep = fastMalloc(sizeof(physicsStepInfo));
+            cc_array_add(tracking, physicsStep);
+        }
+        snapshotRead(buf, offset, physicsStep, sizeof(physicsStepInfo));
+    }
+    while (cc_array_size(tracking) > snap->numPhysicsSteps) {
+        physicsStepInfo *physicsStep;
+        cc_array_remove_last(tracking, (void **)&physicsStep);
+        fastFree(physicsStep);
+    }
+}
+
+void restoreDroneBody(iwEnv *e, droneEntity *drone, const droneSnapshot *snap) {
+    if (drone->ent == NULL) {
+        drone->ent = createEntity(e, DRONE_ENTITY, drone);
+        createDroneBodyShape(e, drone, snap->body.transform.p);
+        drone->shield = NULL;
+    }
+    if (snap->hasShield) {
+        if (drone->shield == NULL) {
+            createDroneShield(e, drone, -(drone->idx + 1));
+        }
+        shieldEntity *shield = drone->shield;
+        const b2BodyId bodyID = shield->bodyID;
+        const b2ShapeId shapeID = shield->shapeID;
+        const b2ShapeId bufferShapeID = shield->bufferShapeID;
+        entity *ent = shield->ent;
+        memcpy(shield, &snap->shield, sizeof(shieldEntity));
+        shield->drone = drone;
+        shield->bodyID = bodyID;
+        shield->shapeID = shapeID;
+        shield->bufferShapeID = bufferShapeID;
+        shield->ent = ent;
+        restoreBody(shield->bodyID, &snap->shieldBody);
+    }
+    restoreBody(drone->bodyID, &snap->body);
+    float damping = DRONE_LINEAR_DAMPING;
+    if (drone->braking) {
+        damping *= DRONE_BRAKE_DAMPING_COEF;
+    }
+    b2Body_SetLinearDamping(drone->bodyID, damping);
+}
+
+void restorePickup(iwEnv *e, const weaponPickupEntity *snap, const size_t idx) {
+    weaponPickupEntity *pickup = NULL;
+    if (idx < cc_array_size(e->pickups)) {
+        pickup = safe_array_get_at(e->pickups, idx);
+        const weaponPickupEntity live = *pickup;
+        memcpy(pickup, snap, sizeof(weaponPickupEntity));
+        pickup->ent = live.ent;
+        if (live.bodyDestroyed) {
+            pickup->bodyDestroyed = true;
+        } else if (snap->bodyDestroyed) {
+            b2DestroyBody(live.bodyID);
+        } else {
+            // the sensor keeps the walls it overlaps, so keep their count
+            pickup->bodyID = live.bodyID;
+            pickup->shapeID = live.shapeID;
+            pickup->floatingWallsTouching = live.floatingWallsTouching;
+            if (!b2VecEqual(live.pos, snap->pos)) {
+                b2Body_SetTransform(pickup->bodyID, snap->pos, b2Rot_identity);
+            }
+        }
+    } else {
+        pickup = fastMalloc(sizeof(weaponPickupEntity));
+        memcpy(pickup, snap, sizeof(weaponPickupEntity));
+        pickup->ent = createEntity(e, WEAPON_PICKUP_ENTITY, pickup);
+        pickup->bodyDestroyed = true;
+        cc_array_add(e->pickups, pickup);
+    }
+    if (pickup->bodyDestroyed && !snap->bodyDestroyed) {
+        // floating walls touching the pickup will be counted again
+        // when Box2D reports them overlapping the new body
+        pickup->floatingWallsTouching = 0;
+        createWeaponPickupBodyShape(e, pickup);
+    }
+}
+
+// a live projectile can be reused for a snapshot's if its body and shapes
+// would be created the same; welded mines are always recreated
+static bool projectileReusable(const projectileEntity *projectile, const projectileSnapshot *snap) {
+    return projectile->weaponInfo->type == snap->weapon && projectile->setMine == snap->projectile.setMine && snap->weldedWallIdx == -1 && b2Body_GetJointCount(projectile->bodyID) == 0;
+}
+
+void restoreProjectile(iwEnv *e, const projectileSnapshot *snap, const size_t idx) {
+    projectileEntity *projectile = NULL;
+    if (idx < cc_array_size(e->projectiles)) {
+        projectile = safe_array_get_at(e->projectiles, idx);
+        if (!projectileReusable(projectile, snap)) {
+            destroyProjectile(e, projectile, false, false);
+            projectile = NULL;
+        }
+    }
+
+    if (projectile != NULL) {
+        // contacts and sensor overlaps are kept by the reused body, so keep
+        // what was counted from them
+        const projectileEntity live = *projectile;
+        memcpy(projectile, &snap->projectile, sizeof(projectileEntity));
+        projectile->bodyID = live.bodyID;
+        projectile->shapeID = live.shapeID;
+        projectile->sensorID = live.sensorID;
+        projectile->weaponInfo = live.weaponInfo;
+        projectile->entsInBlackHole = live.entsInBlackHole;
+        projectile->ent = live.ent;
+        projectile->contacts = live.contacts;
+        projectile->numDronesBehindWalls = live.numDronesBehindWalls;
+        memcpy(projectile->dronesBehindWalls, live.dronesBehindWalls, sizeof(live.dronesBehindWalls));
+        restoreBody(projectile->bodyID, &snap->body);
+        return;
+    }
+
+    projectile = fastMalloc(sizeof(projectileEntity));
+    memcpy(projectile, &snap->projectile, sizeof(projectileEntity));
+    projectile->weaponInfo = weaponInfos[snap->weapon];
+    if (projectile->weaponInfo->type == BLACK_HOLE_WEAPON) {
+        create_array(&projectile->entsInBlackHole, 4);
+    }
+    projectile->ent = createEntity(e, PROJECTILE_ENTITY, projectile);
+    createProjectileBodyShape(e, projectile, snap->body.transform.p);
+    restoreBody(projectile->bodyID, &snap->body);
+    if (snap->weldedWallIdx != -1) {
+        CC_Array *walls = e->walls;
+        if (snap->weldedWallFloating) {
+            walls = e->floatingWalls;
+        }
+        weldMine(e, projectile, safe_array_get_at(walls, snap->weldedWallIdx));
+    }
+    setRestoredEntity(e->projectiles, projectile, idx);
+}
+
+void restoreDronePiece(iwEnv *e, const dronePieceSnapshot *snap, const size_t idx) {
+    dronePieceEntity *piece = NULL;
+    if (idx < cc_array_size(e->dronePieces)) {
+        piece = safe_array_get_at(e->dronePieces, idx);
+        // shield pieces are smaller, so they have different shapes
+        if (piece->isShieldPiece != snap->piece.isShieldPiece) {
+            destroyDronePiece(e, piece);
+            piece = NULL;
+        }
+    }
+
+    if (piece != NULL) {
+        const dronePieceEntity live = *piece;
+        memcpy(piece, &snap->piece, sizeof(dronePieceEntity));
+        piece->bodyID = live.bodyID;
+        piece->shapeID = live.shapeID;
+        piece->ent = live.ent;
+    } else {
+        piece = fastMalloc(sizeof(dronePieceEntity));
+        memcpy(piece, &snap->piece, sizeof(dronePieceEntity));
+        piece->ent = createEntity(e, DRONE_PIECE_ENTITY, piece);
+        createDronePieceBodyShape(e, piece, snap->body.linearVelocity, snap->body.angularVelocity);
+        setRestoredEntity(e->dronePieces, piece, idx);
+    }
+    restoreBody(piece->bodyID, &snap->body);
+}
+
+// points each map cell at the static wall or weapon pickup in it
+void restoreMapCells(iwEnv *e) {
+    for (size_t i = 0; i < cc_array_size(e->cells); i++) {
+        mapCell *cell = safe_array_get_at(e->cells, i);
+        cell->ent = NULL;
+    }
+    for (size_t i = 0; i < cc_array_size(e->walls); i++) {
+        const wallEntity *wall = safe_array_get_at(e->walls, i);
+        mapCell *cell = safe_array_get_at(e->cells, wall->mapCellIdx);
+        cell->ent = wall->ent;
+    }
+    for (size_t i = 0; i < cc_array_size(e->pickups); i++) {
+        const weaponPickupEntity *pickup = safe_array_get_at(e->pickups, i);
+        if (!pickup->bodyDestroyed) {
+            mapCell *cell = safe_array_get_at(e->cells, pickup->mapCellIdx);
+            cell->ent = pickup->ent;
+        }
+    }
+}
+
+// replaces the state of an env with a snapshot taken by snapshotEnv;
+// returns false and leaves the env untouched if validateSnapshot rejects
+// it. Reuses the env's bodies and entities that match the snapshot's and
+// only rebuilds the world if the snapshot is of another map
+bool restoreEnv(iwEnv *e, const uint8_t *buf, const size_t size) {
+    if (!validateSnapshot(e, buf, size)) {
+        return false;
+    }
+    envSnapshot header;
+    memcpy(&header, buf, sizeof(envSnapshot));
+
+    if (e->mapIdx != header.mapIdx) {
+        clearEnv(e);
+        clearMap(e);
+        b2DestroyWorld(e->worldID);
+        createWorld(e);
+        b2DestroyIdPool(&e->idPool);
+        e->idPool = b2CreateIdPool();
+        e->mapIdx = header.mapIdx;
+        e->map = maps[header.mapIdx];
+        createMapWalls(e, false);
+    }
+    for (size_t i = 0; i < cc_array_size(e->explosions); i++) {
+        fastFree(safe_array_get_at(e->explosions, i));
+    }
+    cc_array_remove_all(e->explosions);
+    cc_array_remove_all(e->explodingProjectiles);
+
+    size_t offset = sizeof(envSnapshot);
+    droneSnapshot droneSnaps[_MAX_DRONES];
+    for (uint8_t i = 0; i < header.numDrones; i++) {
+        snapshotRead(buf, &offset, &droneSnaps[i], sizeof(droneSnapshot));
+        restoreDrone(e, &droneSnaps[i], i, buf, &offset);
+    }
+
+    // sudden death walls are after the map's walls like they originally
+    // were; createWall marks them as sudden death walls from this
+    e->suddenDeathWallsPlaced = true;
+    const size_t numMapWalls = mapWallCount(e->map);
+    for (uint16_t i = 0; i < header.numSuddenDeathWalls; i++) {
+        wallSnapshot snap;
+        snapshotRead(buf, &offset, &snap, sizeof(wallSnapshot));
+        restoreWall(e, &snap, false, numMapWalls + i);
+    }
+    while (cc_array_size(e->walls) > numMapWalls + header.numSuddenDeathWalls) {
+        wallEntity *wall;
+        cc_array_remove_last(e->walls, (void **)&wall);
+        destroyWall(e, wall, false);
+    }
+    for (uint16_t i = 0; i < header.numFloatingWalls; i++) {
+        wallSnapshot snap;
+        snapshotRead(buf, &offset, &snap, sizeof(wallSnapshot));
+        restoreWall(e, &snap, true, i);
+    }
+    while (cc_array_size(e->floatingWalls) > header.numFloatingWalls) {
+        wallEntity *wall;
+        cc_array_remove_last(e->floatingWalls, (void **)&wall);
+        destroyWall(e, wall, false);
+    }
+
+    for (uint8_t i = 0; i < header.numDrones; i++) {
+        restoreDroneBody(e, safe_array_get_at(e->drones, i), &droneSnaps[i]);
+    }
+
+    for (uint16_t i = 0; i < header.numPickups; i++) {
+        weaponPickupEntity snap;
+        snapshotRead(buf, &offset, &snap, sizeof(weaponPickupEntity));
+        restorePickup(e, &snap, i);
+    }
+    while (cc_array_size(e->pickups) > header.numPickups) {
+        weaponPickupEntity *pickup;
+        cc_array_remove_last(e->pickups, (void **)&pickup);
+        destroyWeaponPickup(e, pickup);
+    }
+
+    for (uint16_t i = 0; i < header.numProjectiles; i++) {
+        projectileSnapshot snap;
+        snapshotRead(buf, &offset, &snap, sizeof(projectileSnapshot));
+        restoreProjectile(e, &snap, i);
+    }
+    while (cc_array_size(e->projectiles) > header.numProjectiles) {
+        projectileEntity *projectile;
+        cc_array_remove_last(e->projectiles, (void **)&projectile);
+        destroyProjectile(e, projectile, false, false);
+    }
+
+    for (uint16_t i = 0; i < header.numDronePieces; i++) {
+        dronePieceSnapshot snap;
+        snapshotRead(buf, &offset, &snap, sizeof(dronePieceSnapshot));
+        restoreDronePiece(e, &snap, i);
+    }
+    while (cc_array_size(e->dronePieces) > header.numDronePieces) {
+        dronePieceEntity *piece;
+        cc_array_remove_last(e->dronePieces, (void **)&piece);
+        destroyDronePiece(e, piece);
+    }
+
+    restoreMapCells(e);
+
+    // set last, destroying projectiles above adds to the stats
+    e->randState = header.randState;
+    e->needsReset = header.needsReset;
+    e->episodeLength = header.episodeLength;
+    e->log = header.log;
+    memcpy(e->stats, header.stats, sizeof(e->stats));
+    e->lastSpawnQuad = header.lastSpawnQuad;
+    memcpy(e->spawnedWeaponPickups, header.spawnedWeaponPickups, sizeof(e->spawnedWeaponPickups));
+    e->defaultWeapon = weaponInfos[header.defaultWeapon];
+    e->stepsLeft = header.stepsLeft;
+    e->suddenDeathSteps = header.suddenDeathSteps;
+    e->suddenDeathWallCounter = header.suddenDeathWallCounter;
+    e->suddenDeathWallsPlaced = header.suddenDeathWallsPlaced;
+
+    snapshotRead(buf, &offset, e->observations, e->numAgents * e->obsBytes * sizeof(uint8_t));
+    snapshotRead(buf, &offset, e->rewards, e->numAgents * sizeof(float));
+    snapshotRead(buf, &offset, e->masks, e->numAgents * sizeof(uint8_t));
+    snapshotRead(buf, &offset, e->terminals, e->numAgents * sizeof(uint8_t));
+    snapshotRead(buf, &offset, e->truncations, e->numAgents * sizeof(uint8_t));
+    ASSERTF(offset == size, "offset: %zu size: %zu", offset, size);
+
+    return true;
+}
+
+#endif
@@ -100,6 +100,9 @@ typedef struct mapEntry {
     bool *droneSpawns;
     uint8_t *packedLayout;
     nearEntity *nearestWalls;
+    // direction to move in from each cell to reach each destination cell,
+    // indexed by (destination cell * number of cells) + source cell
+    uint8_t *paths;
 } mapEntry;
 
 // a cell in the map; ent will be NULL if the cell is empty
@@ -393,10 +396,6 @@ typedef struct agentActions {
     bool discardWeapon;
 } agentActions;
 
-typedef struct pathingInfo {
-    uint8_t *paths;
-    int8_t *pathBuffer;
-} pathingInfo;
 
 typedef struct iwEnv {
     uint8_t numDrones;
@@ -429,6 +428,10 @@ typedef struct iwEnv {
     droneStats stats[_MAX_DRONES];
 
     b2WorldId worldID;
+    // NULL if the world is stepped on the calling thread only
+    taskPool *physicsPool;
+    // the world's task slots in physicsPool
+    worldTasks physicsTasks;
     int8_t pinnedMapIdx;
     int8_t mapIdx;
     mapEntry *map;
@@ -446,8 +449,6 @@ typedef struct iwEnv {
     CC_Array *explodingProjectiles;
     CC_Array *dronePieces;
 
-    pathingInfo *mapPathing;
-
     uint16_t totalSteps;
     uint16_t totalSuddenDeathSteps;
     // steps left until sudden death
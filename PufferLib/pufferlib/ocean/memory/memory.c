@@ -19,7 +19,7 @@ int main() {
                 env.actions[0] = -1;
             }
         } else {
-            env.actions[0] = rand() % 2;
+            env.actions[0] = puffer_randint(&env.rng, 0, 2);
         }
         c_step(&env);
         c_render(&env);
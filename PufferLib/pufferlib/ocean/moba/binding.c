@@ -1,22 +1,51 @@
+#include <Python.h>
+
 #include "moba.h"
 
 #define Env MOBA
 #define MY_SHARED
+static PyObject* build_paths(PyObject* self, PyObject* args);
+#define MY_METHODS {"build_path_table", build_paths, METH_VARARGS, "Precompute and save the moba path table"}
 #include "../env_binding.h"
 
+// Builds and saves the path table ahead of time, rather than on first use
+static PyObject* build_paths(PyObject* self, PyObject* args) {
+    const char* map_path = "resources/moba/game_map.npy";
+    const char* table_path = MOBA_PATHS;
+    if (!PyArg_ParseTuple(args, "|ss", &map_path, &table_path)) {
+        return NULL;
+    }
+    unsigned char* game_map_npy = read_file((char*)map_path);
+    if (game_map_npy == NULL) {
+        PyErr_Format(PyExc_IOError, "Failed to read %s", map_path);
+        return NULL;
+    }
+    size_t size;
+    char* blob;
+    Py_BEGIN_ALLOW_THREADS
+    blob = build_path_table(game_map_npy, 128, &size);
+    Py_END_ALLOW_THREADS
+    int failed = save_path_table(table_path, blob, size);
+    free(blob);
+    free(game_map_npy);
+    if (failed) {
+        PyErr_Format(PyExc_IOError, "Failed to write %s", table_path);
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
 static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
     unsigned char* game_map_npy = read_file("resources/moba/game_map.npy");
-    int* ai_path_buffer = calloc(3*8*128*128, sizeof(int));
-    unsigned char* ai_paths = calloc(128*128*128*128, sizeof(unsigned char));
-    for (int i = 0; i < 128*128*128*128; i++) {
-        ai_paths[i] = 255;
+    if (game_map_npy == NULL) {
+        PyErr_SetString(PyExc_IOError, "Failed to read resources/moba/game_map.npy");
+        return NULL;
     }
+    PathTable* ai_paths = load_path_table(MOBA_PATHS, game_map_npy, 128);
 
-    PyObject* ai_path_buffer_handle = PyLong_FromVoidPtr(ai_path_buffer);
     PyObject* ai_paths_handle = PyLong_FromVoidPtr(ai_paths);
     PyObject* game_map_handle = PyLong_FromVoidPtr(game_map_npy);
     PyObject* state = PyDict_New();
-    PyDict_SetItemString(state, "ai_path_buffer", ai_path_buffer_handle);
     PyDict_SetItemString(state, "ai_paths", ai_paths_handle);
     PyDict_SetItemString(state, "game_map", game_map_handle);
     return PyLong_FromVoidPtr(state);
@@ -63,22 +92,6 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
         return 1;
     }
 
-    // Extract ai_path_buffer
-    PyObject* ai_path_buffer_obj = PyDict_GetItemString(state_dict, "ai_path_buffer");
-    if (ai_path_buffer_obj == NULL) {
-        PyErr_SetString(PyExc_KeyError, "Key 'ai_path_buffer' not found in state");
-        return 1;
-    }
-    if (!PyLong_Check(ai_path_buffer_obj)) {
-        PyErr_SetString(PyExc_TypeError, "ai_path_buffer must be an integer");
-        return 1;
-    }
-    env->ai_path_buffer = (int*)PyLong_AsVoidPtr(ai_path_buffer_obj);
-    if (env->ai_path_buffer == NULL) {
-        PyErr_SetString(PyExc_ValueError, "Invalid ai_path_buffer pointer");
-        return 1;
-    }
-
     // Extract ai_paths
     PyObject* ai_paths_obj = PyDict_GetItemString(state_dict, "ai_paths");
     if (ai_paths_obj == NULL) {
@@ -89,7 +102,7 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
         PyErr_SetString(PyExc_TypeError, "ai_paths must be an integer");
         return 1;
     }
-    env->ai_paths = (unsigned char*)PyLong_AsVoidPtr(ai_paths_obj);
+    env->ai_paths = (PathTable*)PyLong_AsVoidPtr(ai_paths_obj);
     if (env->ai_paths == NULL) {
         PyErr_SetString(PyExc_ValueError, "Invalid ai_paths pointer");
         return 1;
@@ -160,12 +160,12 @@ void test_performance(float test_time) {
     int i = 0;
     while (time(NULL) - start < test_time) {
         for (int j = 0; j < num_agents; j++) {
-            env.actions[6*j] = rand()%600 - 300;
-            env.actions[6*j + 1] = rand()%600 - 300;
-            env.actions[6*j + 2] = rand()%3;
-            env.actions[6*j + 3] = rand()%2;
-            env.actions[6*j + 4] = rand()%2;
-            env.actions[6*j + 5] = rand()%2;
+            env.actions[6*j] = puffer_randint(&env.rng, 0, 600) - 300;
+            env.actions[6*j + 1] = puffer_randint(&env.rng, 0, 600) - 300;
+            env.actions[6*j + 2] = puffer_randint(&env.rng, 0, 3);
+            env.actions[6*j + 3] = puffer_randint(&env.rng, 0, 2);
+            env.actions[6*j + 4] = puffer_randint(&env.rng, 0, 2);
+            env.actions[6*j + 5] = puffer_randint(&env.rng, 0, 2);
         }
         c_step(&env);
         i++;
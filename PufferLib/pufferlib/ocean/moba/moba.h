@@ -5,6 +5,12 @@
 #include <string.h>
 #include <math.h>
 #include <time.h> // xxd -i game_map.npy > game_map.h #include "game_map.h"
+#include <stdint.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "../rng.h"
 
 #include "raylib.h"
 
@@ -42,6 +48,8 @@
 #define DIRE_CARRY 15
 
 #define TOWER_VISION 5
+
+#define MOBA_PATHS "resources/moba/ai_paths.bin"
 #define CREEP_VISION 7
 #define NEUTRAL_VISION 3
 
@@ -213,10 +221,6 @@ static inline int map_offset(Map* map, int y, int x) {
     return y*map->width + x;
 }
 
-static inline int ai_offset(int y_dst, int x_dst, int y_src, int x_src) {
-    return y_dst*128*128*128 + x_dst*128*128 + y_src*128 + x_src;
-}
-
 typedef struct {
     float death;
     float xp;
@@ -318,23 +322,233 @@ int bfs(Map *map, unsigned char *flat_paths, int* flat_buffer, int dest_r, int d
     return 0;
 }
 
-unsigned char* precompute_pathing(Map* map){
-    int N = map->width;
-    unsigned char* paths = calloc(N*N*N*N, 1);
+// Precomputed pathing: the bfs next step from every walkable cell towards
+// every other walkable cell, packed 3 bits per pair. Walls never change and
+// bfs only treats walls as blocked, so this matches what bfs would fill in
+// lazily. Stops (source is the destination, a wall or cut off from it) are
+// answered from the cell index and connected components instead of the
+// table. The table is built once and saved next to the map. Every env and
+// process maps the same file read-only, so lookups need no scratch
+#define PATH_TABLE_MAGIC 0x48544150  // "PATH"
+#define PATH_TABLE_VERSION 1
+#define PATH_STOP 8
+
+typedef struct PathTableHeader PathTableHeader;
+struct PathTableHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t width;
+    uint32_t walkable;
+    uint64_t size;          // file bytes
+    uint64_t grid;          // width*width map the table was built from
+    uint64_t cells;         // int32 per cell, walkable index or -1
+    uint64_t components;    // int32 per walkable cell
+    uint64_t directions;    // 3 bits per (destination, source) pair
+};
+
+typedef struct PathTable PathTable;
+struct PathTable {
+    char* path;
+    const char* data;       // mapping, or a heap copy if saving failed
+    size_t size;
+    int width;
+    int walkable;
+    const unsigned char* grid;
+    const int* cells;
+    const int* components;
+    const unsigned char* directions;
+    PathTable* next;
+};
+
+static PathTable* path_table_cache = NULL;
+
+// Direction index into ATN_MAP, or PATH_STOP
+static inline int path_direction(const PathTable* table, int y_dst, int x_dst, int y_src, int x_src) {
+    int dst = table->cells[y_dst*table->width + x_dst];
+    int src = table->cells[y_src*table->width + x_src];
+    if (dst < 0 || src < 0 || src == dst || table->components[src] != table->components[dst]) {
+        return PATH_STOP;
+    }
+    uint64_t bit = 3*((uint64_t)dst*table->walkable + src);
+    const unsigned char* p = &table->directions[bit >> 3];
+    return ((p[0] | p[1] << 8) >> (bit & 7)) & 7;
+}
+
+static uint64_t path_table_bytes(int width, int walkable) {
+    uint64_t pairs = (uint64_t)walkable*walkable;
+    // One pad byte so lookups can always read two
+    return sizeof(PathTableHeader) + width*width + sizeof(int)*(width*width + walkable)
+        + (3*pairs + 7)/8 + 1;
+}
+
+// Builds the table file contents for a width*width map. Returns a heap
+// blob of *size bytes
+char* build_path_table(const unsigned char* grid, int width, size_t* size) {
+    int N = width;
+    int walkable = 0;
+    for (int i = 0; i < N*N; i++) {
+        walkable += grid[i] != WALL;
+    }
+    *size = path_table_bytes(N, walkable);
+    char* blob = calloc(*size, 1);
+    PathTableHeader* h = (PathTableHeader*)blob;
+    h->magic = PATH_TABLE_MAGIC;
+    h->version = PATH_TABLE_VERSION;
+    h->width = N;
+    h->walkable = walkable;
+    h->size = *size;
+    h->grid = sizeof(PathTableHeader);
+    h->cells = h->grid + N*N;
+    h->components = h->cells + sizeof(int)*N*N;
+    h->directions = h->components + sizeof(int)*walkable;
+    memcpy(blob + h->grid, grid, N*N);
+    int* cells = (int*)(blob + h->cells);
+    int* components = (int*)(blob + h->components);
+    unsigned char* directions = (unsigned char*)(blob + h->directions);
+
+    int* cell_of = calloc(walkable, sizeof(int));
+    for (int i = 0, w = 0; i < N*N; i++) {
+        cells[i] = (grid[i] != WALL) ? w : -1;
+        if (grid[i] != WALL) cell_of[w++] = i;
+    }
+
+    // bfs needs a writable map and paths preset to 255
+    Map map = {.grid = malloc(N*N), .width = N, .height = N};
+    memcpy(map.grid, grid, N*N);
+    unsigned char* paths = malloc(N*N);
     int* buffer = calloc(3*8*N*N, sizeof(int));
-    for (int r = 0; r < N; r++) {
-        for (int c = 0; c < N; c++) {
-            for (int rr = 0; rr < N; rr++) {
-                for (int cc = 0; cc < N; cc++) {
-                    int adr = ai_offset(r, c, rr, cc);
-                    paths[adr] = 255;
-                }
+    for (int w = 0; w < walkable; w++) {
+        components[w] = -1;
+    }
+    for (int dst = 0; dst < walkable; dst++) {
+        int dst_r = cell_of[dst] / N;
+        int dst_c = cell_of[dst] % N;
+        memset(paths, 255, N*N);
+        bfs(&map, paths, buffer, dst_r, dst_c);
+        // Moves are symmetric, so the cells bfs reaches are a component
+        if (components[dst] == -1) {
+            for (int src = 0; src < walkable; src++) {
+                if (paths[cell_of[src]] != 255) components[src] = dst;
             }
-            int adr = ai_offset(r, c, 0, 0);
-            bfs(map, &paths[adr], buffer, r, c);
         }
+        uint64_t row = (uint64_t)dst*walkable;
+        for (int src = 0; src < walkable; src++) {
+            int atn = paths[cell_of[src]];
+            if (atn >= PATH_STOP) continue;
+            uint64_t bit = 3*(row + src);
+            directions[bit >> 3] |= atn << (bit & 7);
+            if ((bit & 7) > 5) directions[(bit >> 3) + 1] |= atn >> (8 - (bit & 7));
+        }
+    }
+    free(buffer);
+    free(paths);
+    free(map.grid);
+    free(cell_of);
+    return blob;
+}
+
+// Writes through a temporary file, so processes building at the same time
+// never see a partial table
+int save_path_table(const char* path, const char* blob, size_t size) {
+    char tmp[512];
+    snprintf(tmp, sizeof(tmp), "%s.%d.tmp", path, (int)getpid());
+    FILE* file = fopen(tmp, "wb");
+    if (file == NULL) {
+        return 1;
+    }
+    int failed = fwrite(blob, 1, size, file) != size;
+    failed |= fclose(file) != 0;
+    if (!failed) {
+        failed = rename(tmp, path) != 0;
+    }
+    if (failed) {
+        remove(tmp);
+    }
+    return failed;
+}
+
+// Validates a table blob against the map it should have been built from
+PathTable* wrap_path_table(const char* path, const char* data, size_t size,
+        const unsigned char* grid, int width) {
+    const PathTableHeader* h = (const PathTableHeader*)data;
+    int valid = size >= sizeof(PathTableHeader) && h->magic == PATH_TABLE_MAGIC
+        && h->version == PATH_TABLE_VERSION && h->width == (uint32_t)width
+        && h->walkable <= (uint32_t)(width*width) && h->size == size
+        && size == path_table_bytes(width, h->walkable)
+        && h->grid == sizeof(PathTableHeader) && h->cells == h->grid + width*width
+        && h->components == h->cells + sizeof(int)*width*width
+        && h->directions == h->components + sizeof(int)*h->walkable
+        && memcmp(data + h->grid, grid, width*width) == 0;
+    const int* cells = valid ? (const int*)(data + h->cells) : NULL;
+    for (int i = 0; valid && i < width*width; i++) {
+        valid = cells[i] >= -1 && cells[i] < (int)h->walkable;
+    }
+    if (!valid) {
+        return NULL;
+    }
+    PathTable* table = calloc(1, sizeof(PathTable));
+    table->path = strdup(path);
+    table->data = data;
+    table->size = size;
+    table->width = width;
+    table->walkable = h->walkable;
+    table->grid = (const unsigned char*)(data + h->grid);
+    table->cells = cells;
+    table->components = (const int*)(data + h->components);
+    table->directions = (const unsigned char*)(data + h->directions);
+    table->next = path_table_cache;
+    path_table_cache = table;
+    return table;
+}
+
+PathTable* open_path_table(const char* path, const unsigned char* grid, int width) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PathTableHeader)) {
+        close(fd);
+        return NULL;
+    }
+    size_t size = st.st_size;
+    void* data = mmap(NULL, size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    PathTable* table = wrap_path_table(path, data, size, grid, width);
+    if (table == NULL) {
+        munmap(data, size);
+    }
+    return table;
+}
+
+// Table for a width*width map, shared per process and never freed. Maps
+// path if it holds a table for this map, otherwise builds one and saves it
+// there. If saving fails the table is kept in memory for this process
+PathTable* load_path_table(const char* path, const unsigned char* grid, int width) {
+    for (PathTable* t = path_table_cache; t != NULL; t = t->next) {
+        if (strcmp(t->path, path) == 0 && t->width == width
+                && memcmp(t->grid, grid, width*width) == 0) {
+            return t;
+        }
+    }
+    PathTable* table = open_path_table(path, grid, width);
+    if (table != NULL) {
+        return table;
+    }
+    size_t size;
+    char* blob = build_path_table(grid, width, &size);
+    if (save_path_table(path, blob, size) == 0) {
+        table = open_path_table(path, grid, width);
+    }
+    if (table != NULL) {
+        free(blob);
+        return table;
     }
-    return paths;
+    fprintf(stderr, "Could not save %s, keeping the path table in memory\n", path);
+    return wrap_path_table(path, blob, size, grid, width);
 }
 
 struct MOBA {
@@ -350,8 +564,7 @@ struct MOBA {
 
     Map* map;
     unsigned char* orig_grid;
-    unsigned char* ai_paths;
-    int* ai_path_buffer;
+    PathTable* ai_paths;  // shared, see load_path_table
     unsigned char* observations;
     int* actions;
     float* rewards;
@@ -360,6 +573,7 @@ struct MOBA {
     Entity* entities;
     Reward* reward_components;
     Log log;
+    PufferRng rng;
     PlayerLog player_logs[10];
 
     float reward_death;
@@ -376,7 +590,7 @@ struct MOBA {
     Entity* scanned_targets[256][121];
     skill skills[10][3];
 
-    CachedRNG *rng;
+    CachedRNG *cached_rng;
 };
 
 void add_log(MOBA* env, int radiant_victory, int dire_victory) {
@@ -429,15 +643,13 @@ void c_close(MOBA* env) {
     free(env->map->grid);
     free(env->map);
     free(env->orig_grid);
-    free(env->rng->rng);
-    free(env->rng);
+    free(env->cached_rng->rng);
+    free(env->cached_rng);
 }
 
 void free_allocated_moba(MOBA* env) {
     free(env->rewards);
     free(env->map->pids);
-    free(env->ai_path_buffer);
-    free(env->ai_paths);
     free(env->observations);
     free(env->actions);
     free(env->terminals);
@@ -588,17 +800,8 @@ int move_towards(MOBA* env, Entity* entity, int y_dst, int x_dst, float speed) {
     int y_src = entity->y;
     int x_src = entity->x;
 
-    int adr = ai_offset(y_dst, x_dst, y_src, x_src);
-    int atn = env->ai_paths[adr];
-
-    // Compute path if not cached
-    if (atn == 255) {
-        int bfs_adr = ai_offset(y_dst, x_dst, 0, 0);
-        bfs(env->map, &env->ai_paths[bfs_adr], env->ai_path_buffer, y_dst, x_dst);
-        atn = env->ai_paths[adr];
-    }
-
-    if (atn >= 8)
+    int atn = path_direction(env->ai_paths, y_dst, x_dst, y_src, x_src);
+    if (atn == PATH_STOP)
         return 0;
 
     float modifier = speed * entity->move_modifier;
@@ -608,8 +811,8 @@ int move_towards(MOBA* env, Entity* entity, int y_dst, int x_dst, float speed) {
     if (move_to(env->map, entity, y_dst, x_dst) == 0)
         return 0;
 
-    float jitter_x = fast_rng(env->rng);
-    float jitter_y = fast_rng(env->rng);
+    float jitter_x = fast_rng(env->cached_rng);
+    float jitter_y = fast_rng(env->cached_rng);
     return move_to(env->map, entity, entity->y + jitter_y, entity->x + jitter_x);
 }
 
@@ -629,7 +832,7 @@ void kill_entity(Map* map, Entity* entity) {
     entity->y = 0;
 }
 
-void spawn_player(Map* map, Entity* entity) {
+void spawn_player(PufferRng* rng, Map* map, Entity* entity) {
     int pid = entity->pid;
     kill_entity(map, entity);
     entity->pid = pid;
@@ -655,8 +858,8 @@ void spawn_player(Map* map, Entity* entity) {
     bool valid_pos = false;
     int y, x;
     while (!valid_pos) {
-        y = entity->spawn_y + rand()%15 - 7;
-        x = entity->spawn_x + rand()%15 - 7;
+        y = entity->spawn_y + puffer_randint(rng, 0, 15) - 7;
+        x = entity->spawn_x + puffer_randint(rng, 0, 15) - 7;
         valid_pos = map->grid[map_offset(map, y, x)] == EMPTY;
     }
     entity->last_x = x;
@@ -714,7 +917,7 @@ int attack(MOBA* env, Entity* player, Entity* target, float damage) {
         target_log->reward_death = env->reward_death;
         player_log->kills += 1;
         target_log->deaths += 1;
-        spawn_player(env->map, target);
+        spawn_player(&env->rng, env->map, target);
     } else if (target_type == ENTITY_CREEP) {
         player_log->creeps_killed += 1;
         kill_entity(env->map, target);
@@ -848,8 +1051,8 @@ int spawn_creep(MOBA* env, int idx, int lane) {
     Map* map = env->map;
     int y, x;
     for (int i = 0; i < 10; i++) {
-        y = spawn_y + rand() % 7 - 3;
-        x = spawn_x + rand() % 7 - 3;
+        y = spawn_y + puffer_randint(&env->rng, 0, 7) - 3;
+        x = spawn_x + puffer_randint(&env->rng, 0, 7) - 3;
         int adr = map_offset(map, y, x);
         if (map->grid[adr] == EMPTY) {
             break;
@@ -878,8 +1081,8 @@ int spawn_neutral(MOBA* env, int idx) {
     int spawn_y = (int)neutral->spawn_y;
     int spawn_x = (int)neutral->spawn_x;
     for (int i = 0; i < 100; i++) {
-        y = spawn_y + rand() % 7 - 3;
-        x = spawn_x + rand() % 7 - 3;
+        y = spawn_y + puffer_randint(&env->rng, 0, 7) - 3;
+        x = spawn_x + puffer_randint(&env->rng, 0, 7) - 3;
         int adr = map_offset(map, y, x);
         if (map->grid[adr] == EMPTY) {
             break;
@@ -1107,7 +1310,7 @@ void randomize_tower_hp(MOBA* env) {
     for (int i = 0; i < NUM_TOWERS; i++) {
         int pid = TOWER_OFFSET + i;
         Entity* tower = &env->entities[pid];
-        tower->health = rand() % (int)tower->max_health + 1;
+        tower->health = puffer_randint(&env->rng, 0, (int)tower->max_health) + 1;
     }
 }
 
@@ -1612,12 +1815,12 @@ void init_moba(MOBA* env, unsigned char* game_map_npy) {
         env->scanned_targets[i][1] = NULL;
     }
 
-    env->rng = (CachedRNG*)calloc(1, sizeof(CachedRNG));
-    env->rng->rng_n = 10000;
-    env->rng->rng_idx = 0;
-    env->rng->rng = calloc(env->rng->rng_n, sizeof(float));
-    for (int i = 0; i < env->rng->rng_n; i++)
-        env->rng->rng[i] = -1+2*((float)rand())/(float)RAND_MAX;
+    env->cached_rng = (CachedRNG*)calloc(1, sizeof(CachedRNG));
+    env->cached_rng->rng_n = 10000;
+    env->cached_rng->rng_idx = 0;
+    env->cached_rng->rng = calloc(env->cached_rng->rng_n, sizeof(float));
+    for (int i = 0; i < env->cached_rng->rng_n; i++)
+        env->cached_rng->rng[i] = -1+2*((float)puffer_rand(&env->rng))/(float)RAND_MAX;
 
     // Initialize Players
     Entity *player;
@@ -1794,11 +1997,7 @@ MOBA* allocate_moba(MOBA* env) {
     env->truncations = calloc(agents, sizeof(unsigned char));
 
     unsigned char* game_map_npy = read_file("resources/moba/game_map.npy");
-    env->ai_path_buffer = calloc(3*8*128*128, sizeof(int));
-    env->ai_paths = calloc(128*128*128*128, sizeof(unsigned char));
-    for (int i = 0; i < 128*128*128*128; i++) {
-        env->ai_paths[i] = 255;
-    }
+    env->ai_paths = load_path_table(MOBA_PATHS, game_map_npy, 128);
 
     init_moba(env, game_map_npy);
     free(game_map_npy);
@@ -1863,7 +2062,7 @@ void c_reset(MOBA* env) {
         player->level = 1;
         //player->x = 0;
         //player->y = 0;
-        spawn_player(env->map, player);
+        spawn_player(&env->rng, env->map, player);
     }
 
     rad = &env->entities[205];
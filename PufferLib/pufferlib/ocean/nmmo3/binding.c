@@ -1,8 +1,92 @@
+#include <Python.h>
+
 #include "nmmo3.h"
 
 #define Env MMO
+#define MY_SHARED
+static PyObject* free_shared(PyObject* self, PyObject* args);
+#define MY_METHODS {"free_shared", free_shared, METH_VARARGS, "Free a map pool made by shared"}
 #include "../env_binding.h"
 
+// Builds a map pool shared by all envs of one size. With a path, loads the
+// pool from that file if it exists, otherwise generates and saves it there
+static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
+    int num_maps = unpack(kwargs, "num_maps");
+    int width = unpack(kwargs, "width");
+    int height = unpack(kwargs, "height");
+    int x_window = unpack(kwargs, "x_window");
+    int y_window = unpack(kwargs, "y_window");
+    int num_threads = unpack(kwargs, "num_threads");
+    int seed = unpack(kwargs, "seed");
+    if (PyErr_Occurred()) {
+        return NULL;
+    }
+    if (num_maps < 1) {
+        PyErr_SetString(PyExc_ValueError, "num_maps must be >= 1");
+        return NULL;
+    }
+
+    const char* path = NULL;
+    PyObject* path_obj = PyDict_GetItemString(kwargs, "path");
+    if (path_obj != NULL && path_obj != Py_None) {
+        path = PyUnicode_AsUTF8(path_obj);
+        if (path == NULL) {
+            return NULL;
+        }
+    }
+
+    MapPool* pool = NULL;
+    if (path != NULL) {
+        pool = load_map_pool(path);
+    }
+    if (pool != NULL) {
+        if (!map_pool_matches(pool, num_maps, width, height, x_window, y_window, seed)) {
+            PyErr_Format(PyExc_ValueError,
+                "Map pool %s holds %d maps of %dx%d, window %dx%d, seed %lld, "
+                "not %d maps of %dx%d, window %dx%d, seed %d", path,
+                pool->num_maps, pool->width, pool->height, pool->x_border,
+                pool->y_border, (long long)pool->seed, num_maps, width, height,
+                x_window, y_window, seed);
+            free_map_pool(pool);
+            return NULL;
+        }
+        return PyLong_FromVoidPtr(pool);
+    }
+
+    Py_BEGIN_ALLOW_THREADS
+    pool = make_map_pool(num_maps, width, height, x_window, y_window, num_threads, seed);
+    Py_END_ALLOW_THREADS
+    if (pool == NULL) {
+        PyErr_SetString(PyExc_MemoryError, "Failed to allocate map pool");
+        return NULL;
+    }
+    if (path != NULL && save_map_pool(pool, path) != 0) {
+        free_map_pool(pool);
+        PyErr_Format(PyExc_OSError, "Failed to write map pool %s", path);
+        return NULL;
+    }
+    return PyLong_FromVoidPtr(pool);
+}
+
+// Frees a pool from my_shared. Close every env using it first
+static PyObject* free_shared(PyObject* self, PyObject* args) {
+    PyObject* handle_obj;
+    if (!PyArg_ParseTuple(args, "O", &handle_obj)) {
+        return NULL;
+    }
+    if (!PyObject_TypeCheck(handle_obj, &PyLong_Type)) {
+        PyErr_SetString(PyExc_TypeError, "map_pool handle must be an integer");
+        return NULL;
+    }
+    MapPool* pool = (MapPool*)PyLong_AsVoidPtr(handle_obj);
+    if (pool == NULL) {
+        PyErr_SetString(PyExc_ValueError, "Invalid map_pool handle");
+        return NULL;
+    }
+    free_map_pool(pool);
+    Py_RETURN_NONE;
+}
+
 static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
     env->width = unpack(kwargs, "width");
     env->height = unpack(kwargs, "height");
@@ -23,6 +107,16 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
     env->reward_item_level = unpack(kwargs, "reward_item_level");
     env->reward_market = unpack(kwargs, "reward_market");
     env->reward_death = unpack(kwargs, "reward_death");
+    env->packed_obs = unpack(kwargs, "packed_obs");
+
+    PyObject* pool_obj = PyDict_GetItemString(kwargs, "map_pool");
+    if (pool_obj != NULL && pool_obj != Py_None) {
+        if (!PyObject_TypeCheck(pool_obj, &PyLong_Type)) {
+            PyErr_SetString(PyExc_TypeError, "map_pool handle must be an integer");
+            return 1;
+        }
+        env->map_pool = (MapPool*)PyLong_AsVoidPtr(pool_obj);
+    }
     init(env);
     return 0;
 }
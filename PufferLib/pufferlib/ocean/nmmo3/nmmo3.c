@@ -160,7 +160,6 @@ void forward(MMONet* net, unsigned char* observations, int* actions) {
 }
 
 void demo(int num_players) {
-    srand(time(NULL));
     Weights* weights = load_weights("resources/nmmo3/nmmo3_weights.bin", 3387547);
     MMONet* net = init_mmonet(weights, num_players);
 
@@ -181,6 +180,7 @@ void demo(int num_players) {
         .x_window = 7,
         .y_window = 5,
     };
+    puffer_rng_seed(&env.rng, time(NULL));
     allocate_mmo(&env);
 
     c_reset(&env);
@@ -323,15 +323,17 @@ void test_perlin_noise(int width, int height,
 }
 
 void test_flood_fill(int width, int height, int colors) {
+    PufferRng rng;
+    puffer_rng_seed(&rng, time(NULL));
     unsigned char unfilled[width][height];
     memset(unfilled, 0, width*height);
 
     // Draw some squares
     for (int i = 0; i < 32; i++) {
-        int w = rand() % width/4;
-        int h = rand() % height/4;
-        int start_r = rand() % (3*height/4);
-        int start_c = rand() % (3*width/4);
+        int w = puffer_randint(&rng, 0, width)/4;
+        int h = puffer_randint(&rng, 0, height)/4;
+        int start_r = puffer_randint(&rng, 0, 3*height/4);
+        int start_c = puffer_randint(&rng, 0, 3*width/4);
         int end_r = start_r + h;
         int end_c = start_c + w;
         for (int r = start_r; r < end_r; r++) {
@@ -345,7 +347,7 @@ void test_flood_fill(int width, int height, int colors) {
     }
 
     char filled[width*height];
-    flood_fill((unsigned char*)unfilled, (char*)filled,
+    flood_fill(&rng, (unsigned char*)unfilled, (char*)filled,
         width, height, colors, width*height);
 
     // Cast and colorize
@@ -365,6 +367,8 @@ void test_flood_fill(int width, int height, int colors) {
 }
 
 void test_cellular_automata(int width, int height, int colors, int max_fill) {
+    PufferRng rng;
+    puffer_rng_seed(&rng, time(NULL));
     char grid[width][height];
     for (int r = 0; r < height; r++) {
         for (int c = 0; c < width; c++) {
@@ -374,13 +378,13 @@ void test_cellular_automata(int width, int height, int colors, int max_fill) {
 
     // Fill some squares
     for (int i = 0; i < 32; i++) {
-        int w = rand() % width/4;
-        int h = rand() % height/4;
-        int start_r = rand() % (3*height/4);
-        int start_c = rand() % (3*width/4);
+        int w = puffer_randint(&rng, 0, width)/4;
+        int h = puffer_randint(&rng, 0, height)/4;
+        int start_r = puffer_randint(&rng, 0, 3*height/4);
+        int start_c = puffer_randint(&rng, 0, 3*width/4);
         int end_r = start_r + h;
         int end_c = start_c + w;
-        int color = rand() % colors;
+        int color = puffer_randint(&rng, 0, colors);
         for (int r = start_r; r < end_r; r++) {
             for (int c = start_c; c < end_c; c++) {
                 grid[r][c] = color;
@@ -388,7 +392,7 @@ void test_cellular_automata(int width, int height, int colors, int max_fill) {
         }
     }
 
-    cellular_automata((char*)grid, width, height, colors, max_fill);
+    cellular_automata(&rng, (char*)grid, width, height, colors, max_fill);
 
     // Colorize
     unsigned char output[width*height];
@@ -407,9 +411,11 @@ void test_cellular_automata(int width, int height, int colors, int max_fill) {
 }
 
 void test_generate_terrain(int width, int height, int x_border, int y_border) {
+    PufferRng rng;
+    puffer_rng_seed(&rng, time(NULL));
     char terrain[width][height];
     unsigned char rendered[width][height][3];
-    generate_terrain((char*)terrain, (unsigned char*)rendered, width, height, x_border, y_border);
+    generate_terrain(&rng, (char*)terrain, (unsigned char*)rendered, width, height, x_border, y_border);
 
 
     // Colorize
@@ -454,7 +460,7 @@ void test_performance(int num_players, int timeout) {
     int num_steps = 0;
     while (time(NULL) - start < timeout) {
         for (int i = 0; i < num_players; i++) {
-            env.actions[i] = rand() % 23;
+            env.actions[i] = puffer_randint(&env.rng, 0, 23);
         }
         c_step(&env);
         num_steps++;
@@ -466,6 +472,113 @@ void test_performance(int num_players, int timeout) {
     free_allocated_mmo(&env);
 }
 
+// Mean c_reset time generating a fresh map each reset vs drawing from a
+// pool of num_maps pregenerated maps
+void test_reset_latency(int num_maps, int num_threads, int num_resets) {
+    MMO env = {
+        .width = 512,
+        .height = 512,
+        .num_players = 1024,
+        .num_enemies = 2048,
+        .num_resources = 2048,
+        .num_weapons = 1024,
+        .num_gems = 512,
+        .tiers = 5,
+        .levels = 40,
+        .teleportitis_prob = 0.001,
+        .enemy_respawn_ticks = 2,
+        .item_respawn_ticks = 100,
+        .x_window = 7,
+        .y_window = 5,
+    };
+    allocate_mmo(&env);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_resets; i++) {
+        c_reset(&env);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double generate_ms = 1e3*(end.tv_sec - start.tv_sec) + 1e-6*(end.tv_nsec - start.tv_nsec);
+    free_allocated_mmo(&env);
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    MapPool* pool = make_map_pool(num_maps, env.width, env.height,
+        env.x_window, env.y_window, num_threads, 42);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double build_ms = 1e3*(end.tv_sec - start.tv_sec) + 1e-6*(end.tv_nsec - start.tv_nsec);
+
+    env.map_pool = pool;
+    allocate_mmo(&env);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    for (int i = 0; i < num_resets; i++) {
+        c_reset(&env);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double pool_ms = 1e3*(end.tv_sec - start.tv_sec) + 1e-6*(end.tv_nsec - start.tv_nsec);
+    free_allocated_mmo(&env);
+    free_map_pool(pool);
+
+    printf("Reset latency: generate %.2f ms, map pool %.2f ms (%.1fx). "
+        "Built %d maps on %d threads in %.0f ms\n",
+        generate_ms/num_resets, pool_ms/num_resets, generate_ms/pool_ms,
+        num_maps, num_threads, build_ms);
+}
+
+// Steps with random actions, checking compute_all_obs against the full
+// rebuild after every step, and times both
+void test_obs_incremental(int num_players, int num_steps) {
+    MMO env = {
+        .width = 512,
+        .height = 512,
+        .num_players = num_players,
+        .num_enemies = 2048,
+        .num_resources = 2048,
+        .num_weapons = 1024,
+        .num_gems = 512,
+        .tiers = 5,
+        .levels = 40,
+        .teleportitis_prob = 0.001,
+        .enemy_respawn_ticks = 2,
+        .item_respawn_ticks = 100,
+        .x_window = 7,
+        .y_window = 5,
+    };
+    allocate_mmo(&env);
+    c_reset(&env);
+
+    int obs_size = num_players*(11*15*10+47+10);
+    unsigned char* incremental = calloc(obs_size, sizeof(unsigned char));
+    int mismatches = 0;
+    double incremental_ms = 0;
+    double full_ms = 0;
+    struct timespec start, end;
+    for (int i = 0; i < num_steps; i++) {
+        for (int pid = 0; pid < num_players; pid++) {
+            env.actions[pid] = puffer_randint(&env.rng, 0, 23);
+        }
+        c_step(&env);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        compute_all_obs(&env);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        incremental_ms += 1e3*(end.tv_sec - start.tv_sec) + 1e-6*(end.tv_nsec - start.tv_nsec);
+        memcpy(incremental, env.observations, obs_size);
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        compute_all_obs_full(&env);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        full_ms += 1e3*(end.tv_sec - start.tv_sec) + 1e-6*(end.tv_nsec - start.tv_nsec);
+        mismatches += memcmp(incremental, env.observations, obs_size) != 0;
+    }
+
+    printf("Obs: full %.3f ms, incremental %.3f ms (%.1fx), %d of %d steps mismatched\n",
+        full_ms/num_steps, incremental_ms/num_steps, full_ms/incremental_ms,
+        mismatches, num_steps);
+    free(incremental);
+    free_allocated_mmo(&env);
+}
+
 int main() {
 
     /*
@@ -480,6 +593,8 @@ int main() {
     test_generate_terrain(width, height, 8, 8);
     */
     //test_performance(64, 10);
+    //test_reset_latency(16, 8, 32);
+    //test_obs_incremental(1024, 1000);
     demo(NUM_AGENTS);
     //test_mmonet_performance(1024, 10);
 }
@@ -16,9 +16,16 @@
 #include <assert.h>
 #include <time.h>
 #include <limits.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "simplex.h"
 #include "tile_atlas.h"
 #include "raylib.h"
+#include "../rng.h"
 
 #if defined(PLATFORM_DESKTOP)
     #define GLSL_VERSION 330
@@ -161,6 +168,18 @@
 #define D_ITEM 1
 
 // Extra constants
+// Observation layout: an 11x15 map window of 10 features per tile, then
+// 47 player and 10 reward features. The packed layout fits each tile in 4
+// bytes with every field inside one byte (see pack_tile_obs), so the policy
+// can unpack on device with shifts and masks
+#define OBS_TILES (11*15)
+#define OBS_TILE_FEATURES 10
+#define OBS_PACKED_TILE_BYTES 4
+#define OBS_PLAYER 47
+#define OBS_REWARD 10
+#define OBS_SIZE (OBS_TILES*OBS_TILE_FEATURES + OBS_PLAYER + OBS_REWARD)
+#define OBS_PACKED_SIZE (OBS_TILES*OBS_PACKED_TILE_BYTES + OBS_PLAYER + OBS_REWARD)
+
 #define IN_COMBAT_TICKS 5
 #define LEVEL_MUL 2.0
 #define EQUIP_MUL 1.0
@@ -174,17 +193,17 @@ void range(int* array, int n) {
     }
 }
 
-void shuffle(int* array, int n) {
+void shuffle(PufferRng* rng, int* array, int n) {
     for (int i = 0; i < n; i++) {
-        int j = rand() % n;
+        int j = puffer_randint(rng, 0, n);
         int temp = array[i];
         array[i] = array[j];
         array[j] = temp;
     }
 }
 
-double sample_exponential(double halving_rate) {
-    double u = (double)rand() / RAND_MAX; // Random number u in [0, 1)
+double sample_exponential(PufferRng* rng, double halving_rate) {
+    double u = (double)puffer_rand(rng) / RAND_MAX; // Random number u in [0, 1)
     return 1 + halving_rate*(-log(1 - u) / log(2));
 }
 
@@ -274,7 +293,7 @@ void perlin_noise(float* map, int width, int height,
     }
 }
 
-void flood_fill(unsigned char* input, char* output,
+void flood_fill(PufferRng* rng, unsigned char* input, char* output,
         int width, int height, int n, int max_fill) {
 
     for (int r = 0; r < height; r++) {
@@ -285,7 +304,7 @@ void flood_fill(unsigned char* input, char* output,
 
     int* pos = calloc(width*height, sizeof(int));
     range((int*)pos, width*height);
-    shuffle((int*)pos, width*height);
+    shuffle(rng, (int*)pos, width*height);
 
     short queue[2*max_fill];
     for (int i = 0; i < 2*max_fill; i++) {
@@ -301,7 +320,7 @@ void flood_fill(unsigned char* input, char* output,
             continue;
         }
 
-        int color = rand() % n;
+        int color = puffer_randint(rng, 0, n);
         output[adr] = color;
         queue[0] = r;
         queue[1] = c;
@@ -365,7 +384,7 @@ void flood_fill(unsigned char* input, char* output,
     free(pos);
 }
 
-void cellular_automata(char* grid,
+void cellular_automata(PufferRng* rng, char* grid,
         int width, int height, int colors, int max_fill) {
 
     int* pos = calloc(2*width*height, sizeof(int));
@@ -389,7 +408,7 @@ void cellular_automata(char* grid,
         for (int i = 0; i < pos_sz; i+=2) {
             int r = pos[i];
             int c = pos[i + 1];
-            int adr = rand() % pos_sz;
+            int adr = puffer_randint(rng, 0, pos_sz);
             if (adr % 2 == 1) {
                 adr--;
             }
@@ -450,7 +469,7 @@ void cellular_automata(char* grid,
             }
 
             int idx = 0;
-            int winner = rand() % num_ties;
+            int winner = puffer_randint(rng, 0, num_ties);
             for (int j = 0; j < colors; j++) {
                 if (counts[j] == max_count) {
                     if (idx == winner) {
@@ -468,13 +487,13 @@ void cellular_automata(char* grid,
     free(pos);
 }
 
-void generate_terrain(char* terrain, unsigned char* rendered,
+void generate_terrain(PufferRng* rng, char* terrain, unsigned char* rendered,
         int R, int C, int x_border, int y_border) {
     // Perlin noise for the base terrain
     // TODO: Not handling octaves correctly
     float* perlin_map = calloc(R*C, sizeof(float));
-    int offset_x = rand() % 100000;
-    int offset_y = rand() % 100000;
+    int offset_x = puffer_randint(rng, 0, 100000);
+    int offset_y = puffer_randint(rng, 0, 100000);
     perlin_noise(perlin_map, C, R, 1.0/64.0, 2, offset_x, offset_y);
  
     // Flood fill connected components to determine biomes
@@ -486,10 +505,10 @@ void generate_terrain(char* terrain, unsigned char* rendered,
         }
     }
     char *biomes = calloc(R*C, sizeof(char));
-    flood_fill(ridges, biomes, R, C, 4, 4000);
+    flood_fill(rng, ridges, biomes, R, C, 4, 4000);
 
     // Cellular automata to cover unfilled ridges
-    cellular_automata(biomes, R, C, 4, 4000);
+    cellular_automata(rng, biomes, R, C, 4, 4000);
 
     unsigned char (*rendered_ary)[C][3] = (unsigned char(*)[C][3])rendered;
 
@@ -521,6 +540,201 @@ void generate_terrain(char* terrain, unsigned char* rendered,
     free(biomes);
 }
 
+// Map pool: num_maps terrains generated once up front and shared read only
+// by every env that resets from it, so c_reset skips noise, flood fill and
+// cellular automata and only rerolls items and spawns. The pool is a single
+// buffer laid out as the file format (header, then all terrain, then all
+// rendered colors), so saving is one write and loading is one mmap whose
+// pages are shared between processes through the page cache.
+#define MAP_POOL_MAGIC 0x3350414d4f4d4d4eULL // "NMMOMAP3"
+#define MAP_POOL_HEADER 64
+
+typedef struct MapPoolHeader MapPoolHeader;
+struct MapPoolHeader {
+    uint64_t magic;
+    int32_t num_maps;
+    int32_t width;
+    int32_t height;
+    int32_t x_border;
+    int32_t y_border;
+    uint64_t seed;
+};
+
+typedef struct MapPool MapPool;
+struct MapPool {
+    int num_maps;
+    int width;
+    int height;
+    int x_border;
+    int y_border;
+    uint64_t seed;
+    char* terrain;
+    unsigned char* rendered;
+    void* data;
+    size_t size;
+    bool mapped;
+};
+
+size_t map_pool_size(int num_maps, int width, int height) {
+    return MAP_POOL_HEADER + (size_t)num_maps*width*height*4;
+}
+
+void map_pool_views(MapPool* pool) {
+    MapPoolHeader* header = (MapPoolHeader*)pool->data;
+    pool->num_maps = header->num_maps;
+    pool->width = header->width;
+    pool->height = header->height;
+    pool->x_border = header->x_border;
+    pool->y_border = header->y_border;
+    pool->seed = header->seed;
+    size_t sz = (size_t)pool->width*pool->height;
+    pool->terrain = (char*)pool->data + MAP_POOL_HEADER;
+    pool->rendered = (unsigned char*)pool->terrain + pool->num_maps*sz;
+}
+
+// Map idx always draws from its own stream seeded by seed + idx, so the
+// pool is the same however many threads generate it
+void generate_pool_map(MapPool* pool, int idx, uint64_t seed) {
+    PufferRng rng;
+    puffer_rng_seed(&rng, seed + idx);
+    size_t sz = (size_t)pool->width*pool->height;
+    generate_terrain(&rng, pool->terrain + idx*sz, pool->rendered + 3*idx*sz,
+        pool->width, pool->height, pool->x_border, pool->y_border);
+}
+
+typedef struct MapPoolWorker MapPoolWorker;
+struct MapPoolWorker {
+    MapPool* pool;
+    uint64_t seed;
+    int start;
+    int stride;
+};
+
+void* map_pool_worker(void* arg) {
+    MapPoolWorker* worker = (MapPoolWorker*)arg;
+    for (int i = worker->start; i < worker->pool->num_maps; i += worker->stride) {
+        generate_pool_map(worker->pool, i, worker->seed);
+    }
+    return NULL;
+}
+
+// Returns NULL if the pool cannot be allocated
+MapPool* make_map_pool(int num_maps, int width, int height,
+        int x_border, int y_border, int num_threads, uint64_t seed) {
+    MapPool* pool = calloc(1, sizeof(MapPool));
+    if (pool == NULL) {
+        return NULL;
+    }
+    pool->size = map_pool_size(num_maps, width, height);
+    pool->data = calloc(pool->size, 1);
+    if (pool->data == NULL) {
+        free(pool);
+        return NULL;
+    }
+    *(MapPoolHeader*)pool->data = (MapPoolHeader){
+        .magic = MAP_POOL_MAGIC,
+        .num_maps = num_maps,
+        .width = width,
+        .height = height,
+        .x_border = x_border,
+        .y_border = y_border,
+        .seed = seed,
+    };
+    map_pool_views(pool);
+
+    if (num_threads > num_maps) {
+        num_threads = num_maps;
+    }
+    if (num_threads < 1) {
+        num_threads = 1;
+    }
+    pthread_t threads[num_threads];
+    MapPoolWorker workers[num_threads];
+    int started = 0;
+    for (int t = 0; t < num_threads; t++) {
+        workers[t] = (MapPoolWorker){pool, seed, t, num_threads};
+    }
+    // Worker 0 runs on the calling thread. If a thread fails to start,
+    // its maps are generated here after the others finish
+    for (int t = 1; t < num_threads; t++) {
+        if (pthread_create(&threads[t], NULL, map_pool_worker, &workers[t]) != 0) {
+            break;
+        }
+        started = t;
+    }
+    map_pool_worker(&workers[0]);
+    for (int t = 1; t <= started; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    for (int t = started + 1; t < num_threads; t++) {
+        map_pool_worker(&workers[t]);
+    }
+    return pool;
+}
+
+int save_map_pool(MapPool* pool, const char* path) {
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        return 1;
+    }
+    size_t written = fwrite(pool->data, 1, pool->size, file);
+    int err = fclose(file);
+    return (written != pool->size) || err;
+}
+
+// Maps a pool file read only. Returns NULL if the file is missing or is
+// not a pool file
+MapPool* load_map_pool(const char* path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < MAP_POOL_HEADER) {
+        close(fd);
+        return NULL;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return NULL;
+    }
+    MapPoolHeader* header = (MapPoolHeader*)data;
+    if (header->magic != MAP_POOL_MAGIC || header->num_maps < 1
+            || (size_t)st.st_size != map_pool_size(
+            header->num_maps, header->width, header->height)) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    MapPool* pool = calloc(1, sizeof(MapPool));
+    if (pool == NULL) {
+        munmap(data, st.st_size);
+        return NULL;
+    }
+    pool->data = data;
+    pool->size = st.st_size;
+    pool->mapped = true;
+    map_pool_views(pool);
+    return pool;
+}
+
+// True if the pool was made with exactly these arguments
+bool map_pool_matches(MapPool* pool, int num_maps, int width, int height,
+        int x_border, int y_border, uint64_t seed) {
+    return pool->num_maps == num_maps && pool->width == width
+        && pool->height == height && pool->x_border == x_border
+        && pool->y_border == y_border && pool->seed == seed;
+}
+
+void free_map_pool(MapPool* pool) {
+    if (pool->mapped) {
+        munmap(pool->data, pool->size);
+    } else {
+        free(pool->data);
+    }
+    free(pool);
+}
+
 typedef struct Entity Entity;
 struct Entity {
     int type;
@@ -687,6 +901,13 @@ struct MMO {
     int num_gems;
     char* terrain; // TODO: Unsigned?
     unsigned char* rendered;
+    MapPool* map_pool; // Not owned. NULL generates a new map every reset
+    int* spawn_cands;
+    unsigned char* tile_obs; // Encoded obs of every tile, see compute_all_obs
+    int* occupied; // Tiles with a pid, in no particular order
+    int* occupied_idx; // Position of each tile in occupied, or -1
+    int num_occupied;
+    bool obs_rebuild;
     Entity* players;
     Entity* enemies;
     short* pids;
@@ -705,6 +926,7 @@ struct MMO {
     int x_window;
     int y_window;
     int obs_size;
+    bool packed_obs;
     int enemy_respawn_ticks;
     int item_respawn_ticks;
     ItemMarket* market;
@@ -714,6 +936,7 @@ struct MMO {
     RespawnBuffer* enemy_respawn_buffer;
     RespawnBuffer* drop_respawn_buffer;
     Log log;
+    PufferRng rng;
     float reward_combat_level;
     float reward_prof_level;
     float reward_item_level;
@@ -762,11 +985,19 @@ void add_player_log(MMO* env, int pid) {
 
 void init(MMO* env) {
     init_items();
+    env->obs_size = env->packed_obs ? OBS_PACKED_SIZE : OBS_SIZE;
 
     int sz = env->width*env->height;
     env->counts = calloc(sz, sizeof(unsigned char));
-    env->terrain = calloc(sz, sizeof(char));
-    env->rendered = calloc(sz*3, sizeof(unsigned char));
+    // With a map pool, terrain and rendered point into the pool on reset
+    if (env->map_pool == NULL) {
+        env->terrain = calloc(sz, sizeof(char));
+        env->rendered = calloc(sz*3, sizeof(unsigned char));
+    }
+    env->spawn_cands = calloc(sz, sizeof(int));
+    env->tile_obs = calloc(sz*10, sizeof(unsigned char));
+    env->occupied = calloc(sz, sizeof(int));
+    env->occupied_idx = calloc(sz, sizeof(int));
 
     env->pids = calloc(sz, sizeof(short));
     env->items = calloc(sz, sizeof(unsigned char));
@@ -790,7 +1021,8 @@ void init(MMO* env) {
 
 void allocate_mmo(MMO* env) {
     // TODO: Not hardcode
-    env->observations = calloc(env->num_players*(11*15*10+47+10), sizeof(unsigned char));
+    int obs_size = env->packed_obs ? OBS_PACKED_SIZE : OBS_SIZE;
+    env->observations = calloc(env->num_players*obs_size, sizeof(unsigned char));
     env->rewards = calloc(env->num_players, sizeof(float));
     env->terminals = calloc(env->num_players, sizeof(float));
     env->actions = calloc(env->num_players, sizeof(int));
@@ -799,8 +1031,14 @@ void allocate_mmo(MMO* env) {
 
 void c_close(MMO* env) {
     free(env->counts);
-    free(env->terrain);
-    free(env->rendered);
+    if (env->map_pool == NULL) {
+        free(env->terrain);
+        free(env->rendered);
+    }
+    free(env->spawn_cands);
+    free(env->tile_obs);
+    free(env->occupied);
+    free(env->occupied_idx);
     free(env->pids);
     free(env->items);
     free_respawn_buffer(env->resource_respawn_buffer);
@@ -919,7 +1157,53 @@ float sell_price(int idx) {
     return 0.5 + 0.1*idx;
 }
 
-void compute_all_obs(MMO* env) {
+// Player and reward observation, written after the map window
+void compute_player_obs(MMO* env, int pid, int obs_adr) {
+    Entity* player = get_entity(env, pid);
+    env->observations[obs_adr] = player->type;
+    env->observations[obs_adr+1] = player->comb_lvl;
+    env->observations[obs_adr+2] = player->element;
+    env->observations[obs_adr+3] = player->dir;
+    env->observations[obs_adr+4] = player->anim;
+    env->observations[obs_adr+5] = player->hp;
+    env->observations[obs_adr+6] = player->hp_max;
+    env->observations[obs_adr+7] = player->prof_lvl;
+    env->observations[obs_adr+8] = player->ui_mode;
+    env->observations[obs_adr+9] = player->market_tier;
+    env->observations[obs_adr+10] = player->sell_idx;
+    env->observations[obs_adr+11] = player->gold;
+    env->observations[obs_adr+12] = player->in_combat;
+    for (int j = 0; j < 5; j++) {
+        env->observations[obs_adr+13+j] = player->equipment[j];
+    }
+    for (int j = 0; j < 12; j++) {
+        env->observations[obs_adr+18+j] = player->inventory[j];
+    }
+    for (int j = 0; j < 12; j++) {
+        env->observations[obs_adr+30+j] = player->is_equipped[j];
+    }
+    env->observations[obs_adr+42] = player->wander_range;
+    env->observations[obs_adr+43] = player->ranged;
+    env->observations[obs_adr+44] = player->goal;
+    env->observations[obs_adr+45] = player->equipment_attack;
+    env->observations[obs_adr+46] = player->equipment_defense;
+
+    // Reward observation
+    Reward* reward = &env->reward_struct[pid];
+    env->observations[obs_adr+47] = (reward->death == 0) ? 0 : 1;
+    env->observations[obs_adr+48] = (reward->pioneer == 0) ? 0 : 1;
+    env->observations[obs_adr+49] = reward->comb_lvl / 20;
+    env->observations[obs_adr+50] = reward->prof_lvl / 20;
+    env->observations[obs_adr+51] = reward->item_atk_lvl / 20;
+    env->observations[obs_adr+52] = reward->item_def_lvl / 20;
+    env->observations[obs_adr+53] = reward->item_tool_lvl / 20;
+    env->observations[obs_adr+54] = reward->market_buy / 20;
+    env->observations[obs_adr+55] = reward->market_sell / 20;
+}
+
+// Reference implementation that reads every visible tile for every player.
+// compute_all_obs must match it exactly. Unpacked layout only
+void compute_all_obs_full(MMO* env) {
     for (int pid = 0; pid < env->num_players; pid++) {
         Entity* player = get_entity(env, pid);
         int r = player->r;
@@ -936,7 +1220,7 @@ void compute_all_obs(MMO* env) {
         assert(end_col <= env->width);
 
         int comb_lvl = player->comb_lvl;
-        int obs_adr = pid*(11*15*10+47+10);
+        int obs_adr = pid*OBS_SIZE;
         for (int obs_r = start_row; obs_r < end_row; obs_r++) {
             for (int obs_c = start_col; obs_c < end_col; obs_c++) {
                 int map_adr = map_offset(env, obs_r, obs_c);
@@ -967,51 +1251,154 @@ void compute_all_obs(MMO* env) {
                     env->observations[obs_adr+7] = seen->hp / 20; // Bucketed for discrete
                     env->observations[obs_adr+8] = seen->anim;
                     env->observations[obs_adr+9] = seen->dir;
+                } else {
+                    memset(&env->observations[obs_adr+4], 0, 6);
                 }
                 obs_adr += 10;
             }
         }
 
-        // Player observation
-        env->observations[obs_adr] = player->type;
-        env->observations[obs_adr+1] = player->comb_lvl;
-        env->observations[obs_adr+2] = player->element;
-        env->observations[obs_adr+3] = player->dir;
-        env->observations[obs_adr+4] = player->anim;
-        env->observations[obs_adr+5] = player->hp;
-        env->observations[obs_adr+6] = player->hp_max;
-        env->observations[obs_adr+7] = player->prof_lvl;
-        env->observations[obs_adr+8] = player->ui_mode;
-        env->observations[obs_adr+9] = player->market_tier;
-        env->observations[obs_adr+10] = player->sell_idx;
-        env->observations[obs_adr+11] = player->gold;
-        env->observations[obs_adr+12] = player->in_combat;
-        for (int j = 0; j < 5; j++) {
-            env->observations[obs_adr+13+j] = player->equipment[j];
-        }
-        for (int j = 0; j < 12; j++) {
-            env->observations[obs_adr+18+j] = player->inventory[j];
-        }
-        for (int j = 0; j < 12; j++) {
-            env->observations[obs_adr+30+j] = player->is_equipped[j];
-        }
-        env->observations[obs_adr+42] = player->wander_range;
-        env->observations[obs_adr+43] = player->ranged;
-        env->observations[obs_adr+44] = player->goal;
-        env->observations[obs_adr+45] = player->equipment_attack;
-        env->observations[obs_adr+46] = player->equipment_defense;
-
-        // Reward observation
-        Reward* reward = &env->reward_struct[pid];
-        env->observations[obs_adr+47] = (reward->death == 0) ? 0 : 1;
-        env->observations[obs_adr+48] = (reward->pioneer == 0) ? 0 : 1;
-        env->observations[obs_adr+49] = reward->comb_lvl / 20;
-        env->observations[obs_adr+50] = reward->prof_lvl / 20;
-        env->observations[obs_adr+51] = reward->item_atk_lvl / 20;
-        env->observations[obs_adr+52] = reward->item_def_lvl / 20;
-        env->observations[obs_adr+53] = reward->item_tool_lvl / 20;
-        env->observations[obs_adr+54] = reward->market_buy / 20;
-        env->observations[obs_adr+55] = reward->market_sell / 20;
+        compute_player_obs(env, pid, obs_adr);
+    }
+}
+
+// Writes the entity part of a tile. Holds the raw combat level, which
+// compute_all_obs converts to a level delta relative to each viewer
+void encode_tile_entity(MMO* env, int adr) {
+    unsigned char* tile = &env->tile_obs[10*adr];
+    Entity* seen = get_entity(env, env->pids[adr]);
+    tile[4] = seen->type;
+    tile[5] = seen->element;
+    tile[6] = seen->comb_lvl;
+    tile[7] = seen->hp / 20; // Bucketed for discrete
+    tile[8] = seen->anim;
+    tile[9] = seen->dir;
+}
+
+// Re-encodes the whole map after a reset, when terrain, items and pids
+// were all written directly
+void rebuild_tile_obs(MMO* env) {
+    env->num_occupied = 0;
+    for (int adr = 0; adr < env->width*env->height; adr++) {
+        unsigned char* tile = &env->tile_obs[10*adr];
+        unsigned char terrain = env->terrain[adr];
+        unsigned char item = env->items[adr];
+        tile[0] = terrain % 4;
+        tile[1] = terrain / 4;
+        tile[2] = item % 17;
+        tile[3] = item / 17;
+        memset(tile + 4, 0, 6);
+        env->occupied_idx[adr] = -1;
+        if (env->pids[adr] != -1) {
+            env->occupied_idx[adr] = env->num_occupied;
+            env->occupied[env->num_occupied++] = adr;
+        }
+    }
+}
+
+// Item and pid writes during steps go through these, keeping tile_obs and
+// the occupied list in sync without rescanning the map
+void set_item(MMO* env, int adr, int item) {
+    env->items[adr] = item;
+    env->tile_obs[10*adr + 2] = item % 17;
+    env->tile_obs[10*adr + 3] = item / 17;
+}
+
+void set_pid(MMO* env, int adr, int pid) {
+    env->pids[adr] = pid;
+    int idx = env->occupied_idx[adr];
+    if (pid != -1) {
+        if (idx == -1) {
+            env->occupied_idx[adr] = env->num_occupied;
+            env->occupied[env->num_occupied++] = adr;
+        }
+        return;
+    }
+    memset(&env->tile_obs[10*adr + 4], 0, 6);
+    if (idx != -1) {
+        int last = env->occupied[--env->num_occupied];
+        env->occupied[idx] = last;
+        env->occupied_idx[last] = idx;
+        env->occupied_idx[adr] = -1;
+    }
+}
+
+int delta_comb_obs(int seen_lvl, int comb_lvl) {
+    int delta = (seen_lvl - comb_lvl) / 2;
+    if (delta < 0) {
+        return 0;
+    }
+    if (delta > 4) {
+        return 4;
+    }
+    return delta;
+}
+
+// Byte 0: terrain type, season, entity type, dir. Byte 1: item type, tier.
+// Byte 2: element, level delta. Byte 3: hp bucket, anim
+void pack_tile_obs(unsigned char* out, unsigned char* tile) {
+    out[0] = tile[0] | tile[1] << 2 | tile[4] << 4 | tile[9] << 6;
+    out[1] = tile[2] | tile[3] << 5;
+    out[2] = tile[5] | tile[6] << 3;
+    out[3] = tile[7] | tile[8] << 3;
+}
+
+// Each player's window is copied row by row out of tile_obs, which holds
+// every tile already encoded. Terrain never changes within an episode and
+// item/pid changes are written through by set_item/set_pid, so the only
+// per tick encoding is for occupied tiles, since hp, anim and dir change
+// for most entities every tick
+void compute_all_obs(MMO* env) {
+    if (env->obs_rebuild) {
+        rebuild_tile_obs(env);
+        env->obs_rebuild = false;
+    }
+    for (int i = 0; i < env->num_occupied; i++) {
+        encode_tile_entity(env, env->occupied[i]);
+    }
+
+    int cols = 2*env->x_window + 1;
+    int rows = 2*env->y_window + 1;
+    for (int pid = 0; pid < env->num_players; pid++) {
+        Entity* player = get_entity(env, pid);
+        int start_row = player->r - env->y_window;
+        int start_col = player->c - env->x_window;
+        assert(start_row >= 0);
+        assert(start_row + rows <= env->height);
+        assert(start_col >= 0);
+        assert(start_col + cols <= env->width);
+
+        int obs_adr = pid*env->obs_size;
+        unsigned char* obs = &env->observations[obs_adr];
+        int comb_lvl = player->comb_lvl;
+        if (env->packed_obs) {
+            for (int r = 0; r < rows; r++) {
+                int map_adr = map_offset(env, start_row + r, start_col);
+                for (int c = 0; c < cols; c++) {
+                    unsigned char tile[OBS_TILE_FEATURES];
+                    memcpy(tile, &env->tile_obs[10*(map_adr + c)], OBS_TILE_FEATURES);
+                    if (tile[4] != ENTITY_NULL) {
+                        tile[6] = delta_comb_obs(tile[6], comb_lvl);
+                    }
+                    pack_tile_obs(obs, tile);
+                    obs += OBS_PACKED_TILE_BYTES;
+                }
+            }
+            compute_player_obs(env, pid, obs_adr + OBS_PACKED_TILE_BYTES*rows*cols);
+            continue;
+        }
+
+        for (int r = 0; r < rows; r++) {
+            int map_adr = map_offset(env, start_row + r, start_col);
+            memcpy(obs + 10*cols*r, &env->tile_obs[10*map_adr], 10*cols);
+        }
+        for (int i = 0; i < rows*cols; i++) {
+            unsigned char* tile = obs + 10*i;
+            if (tile[4] != ENTITY_NULL) {
+                tile[6] = delta_comb_obs(tile[6], comb_lvl);
+            }
+        }
+        compute_player_obs(env, pid, obs_adr + 10*rows*cols);
     }
 }
 
@@ -1020,7 +1407,7 @@ int safe_tile(MMO* env, int delta) {
     int idx;
     while (!valid) {
         valid = true;
-        idx = rand() % (env->width * env->height);
+        idx = puffer_randint(&env->rng, 0, env->width * env->height);
         char tile = env->terrain[idx];
         if (!is_grass(tile)) {
             valid = false;
@@ -1089,7 +1476,7 @@ void spawn(MMO* env, Entity* entity) {
         entity->is_equipped[idx] = 0;
     }
 
-    entity->goal = (rand() % 2) == 0;
+    entity->goal = puffer_randint(&env->rng, 0, 2) == 0;
     memset(entity->min_comb_prof, 0, sizeof(entity->min_comb_prof));
     entity->min_comb_prof_idx = 0;
 }
@@ -1099,8 +1486,8 @@ void give_starter_gear(MMO* env, int pid, int tier) {
     assert(tier <= env->tiers);
 
     Entity* player = &env->players[pid];
-    int idx = (rand() % 6) + 1;
-    tier = (rand() % tier) + 1;
+    int idx = puffer_randint(&env->rng, 0, 6) + 1;
+    tier = puffer_randint(&env->rng, 0, tier) + 1;
     player->inventory[0] = item_index(idx, tier);
     player->gold += 50;
 }
@@ -1143,7 +1530,7 @@ void pickup_item(MMO* env, int pid) {
     // This is the only item that can be picked up without a tool
     if (ground_type == I_TOOL) {
         player->inventory[inventory_idx] = ground_id;
-        env->items[adr] = 0;
+        set_item(env, adr, 0);
         return;
     }
 
@@ -1174,7 +1561,7 @@ void pickup_item(MMO* env, int pid) {
 
     // Some items are different on the ground and in inventory
     if (ground_type == I_ORE) {
-        int armor_id = I_HELM + rand() % 3;
+        int armor_id = I_HELM + puffer_randint(&env->rng, 0, 3);
         ground_id = item_index(armor_id, ground_tier);
     } else if (ground_type == I_HILT) {
         ground_id = item_index(I_SWORD, ground_tier);
@@ -1184,7 +1571,7 @@ void pickup_item(MMO* env, int pid) {
         ground_id = item_index(ground_type, ground_tier);
     }
     player->inventory[inventory_idx] = ground_id;
-    env->items[adr] = 0;
+    set_item(env, adr, 0);
 }
 
 bool dest_check(MMO* env, int r, int c);
@@ -1220,10 +1607,10 @@ void move(MMO* env, int pid, int direction, bool run) {
     entity->r = rr;
     entity->c = cc;
     entity->anim = (run ? ANIM_RUN : ANIM_MOVE);
-    env->pids[map_offset(env, rr, cc)] = pid;
+    set_pid(env, map_offset(env, rr, cc), pid);
 
     int old_adr = map_offset(env, r, c);
-    env->pids[old_adr] = -1;
+    set_pid(env, old_adr, -1);
 
     // Update visitation map. Skips run tiles
     if (entity->type == ENTITY_PLAYER) {
@@ -1264,7 +1651,7 @@ void wander(MMO* env, int pid) {
     }
 
     // Move randomly
-    int direction = rand() % 4;
+    int direction = puffer_randint(&env->rng, 0, 4);
     if (direction == ATN_UP) {
         end_r -= 1;
     } else if (direction == ATN_DOWN) {
@@ -1373,7 +1760,7 @@ void drop_loot(MMO* env, int pid) {
             if (env->items[adr] != 0) {
                 continue;
             }
-            env->items[adr] = drop;
+            set_item(env, adr, drop);
             Respawnable elem = {.id = drop, .r = r+dr, .c = c+dc};
             add_to_buffer(env->drop_respawn_buffer, elem, env->tick);
             return;
@@ -1634,6 +2021,7 @@ void enemy_ai(MMO* env, int pid) {
 
 void c_reset(MMO* env) {
     env->tick = 0;
+    env->obs_rebuild = true;
 
     env->market_sells = 0;
     env->market_buys = 0;
@@ -1642,14 +2030,21 @@ void c_reset(MMO* env) {
     clear_respawn_buffer(env->enemy_respawn_buffer);
 
     // TODO: Check width/height args!
-    generate_terrain(env->terrain, env->rendered, env->width, env->height,
-        env->x_window, env->y_window);
-
-    for (int i = 0; i < env->width*env->height; i++) {
-        env->pids[i] = -1;
-        env->items[i] = 0;
-        //env->counts[i] = 0;
+    MapPool* pool = env->map_pool;
+    if (pool == NULL) {
+        generate_terrain(&env->rng, env->terrain, env->rendered, env->width, env->height,
+            env->x_window, env->y_window);
+    } else {
+        assert(pool->width == env->width && pool->height == env->height);
+        size_t sz = (size_t)env->width*env->height;
+        int map = puffer_randint(&env->rng, 0, pool->num_maps);
+        env->terrain = pool->terrain + map*sz;
+        env->rendered = pool->rendered + 3*map*sz;
     }
+
+    // All bits set is -1 for pids
+    memset(env->pids, 0xFF, env->width*env->height*sizeof(short));
+    memset(env->items, 0, env->width*env->height*sizeof(unsigned char));
     
     // Pid crops?
     int ore_count = 0;
@@ -1660,31 +2055,33 @@ void c_reset(MMO* env) {
     int fire_gem_count = 0;
     int air_gem_count = 0;
     int water_gem_count = 0;
-    int player_count = 0;
-    int enemy_count = 0;
 
-    // Randomly generate spawn candidates
-    int *spawn_cands = calloc(env->width*env->height, sizeof(int));
-    range((int*)spawn_cands, env->width*env->height);
-    shuffle((int*)spawn_cands, env->width*env->height);
+    // Spawn candidates are grass tiles in random order. Shuffled lazily,
+    // since the loop usually stops long before visiting all of them
+    int* spawn_cands = env->spawn_cands;
+    int num_cands = 0;
+    for (int i = 0; i < env->width*env->height; i++) {
+        spawn_cands[num_cands] = i;
+        num_cands += is_grass(env->terrain[i]);
+    }
+
+    for (int cand_idx = 0; cand_idx < num_cands; cand_idx++) {
+        int swap = cand_idx + puffer_randint(&env->rng, 0, num_cands - cand_idx);
+        int cand = spawn_cands[swap];
+        spawn_cands[swap] = spawn_cands[cand_idx];
+        spawn_cands[cand_idx] = cand;
 
-    for (int cand_idx = 0; cand_idx < env->width*env->height; cand_idx++) {
-        int cand = spawn_cands[cand_idx];
         int r = cand / env->width;
         int c = cand % env->width;
         int tile = env->terrain[cand];
 
-        if (!is_grass(tile)) {
-            continue;
-        }
-
         // Materials only spawn south
         //if (r < env->height/2) {
         //    continue;
         //}
 
         int spawned = false;
-        int i_type;
+        int i_type = 0;
         for (int d = 0; d < 4; d++) {
             int adr = map_offset(env, r+DELTAS[d][0], c+DELTAS[d][1]);
             int tile = env->terrain[adr];
@@ -1717,41 +2114,36 @@ void c_reset(MMO* env) {
             }
         }
 
-        int adr = map_offset(env, r, c);
-        //int tier = 1 + env->tiers*level/env->levels;
-        int tier = 0;
-        while (tier < 1 || tier > env->tiers) {
-            tier = sample_exponential(1);
-        }
-
-        if (spawned) {
-            env->items[adr] = item_index(i_type, tier);
-            continue;
-        }
-
         // Spawn gems
-        i_type = 0;
-        if (tile == TILE_SPRING_GRASS && earth_gem_count < env->num_gems) {
-            earth_gem_count += 1;
-            i_type = I_EARTH;
-        } else if (tile == TILE_SUMMER_GRASS && fire_gem_count < env->num_gems) {
-            fire_gem_count += 1;
-            i_type = I_FIRE;
-        } else if (tile == TILE_AUTUMN_GRASS && air_gem_count < env->num_gems) {
-            air_gem_count += 1;
-            i_type = I_AIR;
-        } else if (tile == TILE_WINTER_GRASS && water_gem_count < env->num_gems) {
-            water_gem_count += 1;
-            i_type = I_WATER;
+        if (!spawned) {
+            if (tile == TILE_SPRING_GRASS && earth_gem_count < env->num_gems) {
+                earth_gem_count += 1;
+                i_type = I_EARTH;
+            } else if (tile == TILE_SUMMER_GRASS && fire_gem_count < env->num_gems) {
+                fire_gem_count += 1;
+                i_type = I_FIRE;
+            } else if (tile == TILE_AUTUMN_GRASS && air_gem_count < env->num_gems) {
+                air_gem_count += 1;
+                i_type = I_AIR;
+            } else if (tile == TILE_WINTER_GRASS && water_gem_count < env->num_gems) {
+                water_gem_count += 1;
+                i_type = I_WATER;
+            }
         }
 
+        // Tiers are only drawn for tiles that get an item
         if (i_type > 0) {
+            //int tier = 1 + env->tiers*level/env->levels;
+            int tier = 0;
+            while (tier < 1 || tier > env->tiers) {
+                tier = sample_exponential(&env->rng, 1);
+            }
+            int adr = map_offset(env, r, c);
             env->items[adr] = item_index(i_type, tier);
         }
 
+        // Players and enemies spawn after this loop, so only items count
         if (
-            player_count == env->num_players && 
-            enemy_count == env->num_enemies && 
             ore_count == env->num_resources && 
             herb_count == env->num_resources && 
             wood_count == env->num_weapons && 
@@ -1773,7 +2165,6 @@ void c_reset(MMO* env) {
     assert(fire_gem_count == env->num_gems);
     assert(air_gem_count == env->num_gems);
     assert(water_gem_count == env->num_gems);
-    free(spawn_cands);
 
     //int distance = abs(r - env->height/2);
     for (int player_count = 0; player_count < env->num_players; player_count++) {
@@ -1797,9 +2188,9 @@ void c_reset(MMO* env) {
     for (int enemy_count = 0; enemy_count < env->num_enemies; enemy_count++) {
         int level = 0;
         while (level < 1 || level > env->levels) {
-            level = sample_exponential(8);
+            level = sample_exponential(&env->rng, 8);
         }
-        if (rand() % 8 == 0) {
+        if (puffer_randint(&env->rng, 0, 8) == 0) {
             level = 1;
         }
         //if (distance > 8 && r < env->height/2 && enemy_count < env->num_enemies) {
@@ -1846,7 +2237,7 @@ void c_step(MMO* env) {
         int item_id = item.id;
         assert(item_id > 0);
         int adr = map_offset(env, item.r, item.c);
-        env->items[adr] = item_id;
+        set_item(env, adr, item_id);
     }
 
     // Respawn enemies
@@ -1858,7 +2249,7 @@ void c_step(MMO* env) {
         int lvl = entity->comb_lvl;
         spawn(env, entity);
         int adr = map_offset(env, entity->r, entity->c);
-        env->pids[adr] = pid;
+        set_pid(env, adr, pid);
         entity->comb_lvl = lvl;
     }
 
@@ -1871,7 +2262,7 @@ void c_step(MMO* env) {
         int c = item.c;
         int adr = map_offset(env, r, c);
         if (env->items[adr] == id) {
-            env->items[adr] = 0;
+            set_item(env, adr, 0);
         }
     }
 
@@ -1888,11 +2279,11 @@ void c_step(MMO* env) {
             if (entity->anim != ANIM_DEATH) {
                 entity->anim = ANIM_DEATH;
             } else if (env->pids[adr] == pid) {
-                env->pids[adr] = -1;
+                set_pid(env, adr, -1);
             } else if (entity_type == ENTITY_PLAYER) {
                 spawn(env, entity);
                 adr = map_offset(env, entity->r, entity->c);
-                env->pids[adr] = pid;
+                set_pid(env, adr, pid);
                 //give_starter_gear(env, pid, env->tiers);
             }
             continue;
@@ -1901,19 +2292,19 @@ void c_step(MMO* env) {
         // Teleportitis: Randomly teleport players and enemies
         // to a safe tile. This prevents players from clumping
         // and messing up training dynamics
-        double prob = (double)rand() / RAND_MAX;
+        double prob = (double)puffer_rand(&env->rng) / RAND_MAX;
         if (prob < env->teleportitis_prob) {
             r = entity->r;
             c = entity->c;
             adr = map_offset(env, r, c);
-            env->pids[adr] = -1;
+            set_pid(env, adr, -1);
 
             int idx = safe_tile(env, 5);
             r = idx / env->width;
             c = idx % env->width;
 
             adr = map_offset(env, r, c);
-            env->pids[adr] = pid;
+            set_pid(env, adr, pid);
 
             entity->r = r;
             entity->c = c;
@@ -1935,13 +2326,13 @@ void c_step(MMO* env) {
                     r = entity->r;
                     c = entity->c;
                     adr = map_offset(env, r, c);
-                    env->pids[adr] = -1;
+                    set_pid(env, adr, -1);
                     int lvl = entity->comb_lvl;
                     spawn(env, entity);
                     r = entity->r;
                     c = entity->c;
                     adr = map_offset(env, r, c);
-                    env->pids[adr] = pid;
+                    set_pid(env, adr, pid);
                     if (entity->type == ENTITY_PLAYER) {
                         //give_starter_gear(env, pid, env->tiers);
                     } else {
@@ -2330,7 +2721,7 @@ Animation ANIMATIONS[7] = {
 #define STONE_OFFSET OFF * 1
 #define DIRT_OFFSET  0
 
-void render_conversion(char* flat_tiles, int* flat_converted, int R, int C) {
+void render_conversion(PufferRng* rng, char* flat_tiles, int* flat_converted, int R, int C) {
     char* tex_codes = tile_atlas;
     char (*tiles)[C] = (char(*)[C])flat_tiles;
     int (*converted)[C] = (int(*)[C])flat_converted;
@@ -2374,11 +2765,11 @@ void render_conversion(char* flat_tiles, int* flat_converted, int R, int C) {
             int idx = code;
             if (code == TEX_FULL) {
                 if (is_dirt(tile)) {
-                    idx = DIRT_OFFSET + rand() % 5;
+                    idx = DIRT_OFFSET + puffer_randint(rng, 0, 5);
                 } else if (is_stone(tile)) {
-                    idx = STONE_OFFSET + rand() % 5;
+                    idx = STONE_OFFSET + puffer_randint(rng, 0, 5);
                 } else if (is_water(tile)) {
-                    idx = WATER_OFFSET + rand() % 5;
+                    idx = WATER_OFFSET + puffer_randint(rng, 0, 5);
                 }
             } else if (is_dirt(tile)) {
                 idx += DIRT_OFFSET + 5;
@@ -2426,13 +2817,13 @@ void render_conversion(char* flat_tiles, int* flat_converted, int R, int C) {
                 } else {
                     int lookup = (1000*num_spring + 100*num_summer
                         + 10*num_autumn + num_winter);
-                    int offset = (rand() % 4) * 714; // num_lerps;
+                    int offset = puffer_randint(rng, 0, 4) * 714; // num_lerps;
                     idx = lerps[lookup] + offset + 240 + 5*4*3*4;
                 }
             }
             if (code == TEX_FULL && is_water(tile)) {
-                int variant = (rand() % 5);
-                int anim = rand() % 3;
+                int variant = puffer_randint(rng, 0, 5);
+                int anim = puffer_randint(rng, 0, 3);
                 idx = 240 + 3*4*4*variant + 4*4*anim;
                 if (tile == TILE_SPRING_WATER) {
                     idx += 0;
@@ -2459,7 +2850,7 @@ Client* make_client(MMO* env) {
     client->command_len = 0;
 
     client->terrain = calloc(env->height*env->width, sizeof(int));
-    render_conversion(env->terrain, client->terrain, env->height, env->width);
+    render_conversion(&env->rng, env->terrain, client->terrain, env->height, env->width);
 
     client->shader = LoadShader("", TextFormat("resources/nmmo3/map_shader_%i.fs", GLSL_VERSION));
 
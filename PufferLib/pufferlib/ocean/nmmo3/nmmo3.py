@@ -11,6 +11,12 @@ from pufferlib.ocean.nmmo3 import binding
 import pufferlib
 
 class NMMO3(pufferlib.PufferEnv):
+    # (byte, shift, bits) of each map tile feature in packed observations,
+    # in unpacked order. Matches pack_tile_obs in nmmo3.h
+    PACKED_TILE_BYTES = 4
+    PACKED_FIELDS = [(0, 0, 2), (0, 2, 2), (1, 0, 5), (1, 5, 3), (0, 4, 2),
+        (2, 0, 3), (2, 3, 3), (3, 0, 3), (3, 3, 3), (0, 6, 2)]
+
     def __init__(self, width=8*[512], height=8*[512], num_envs=4,
             num_players=1024, num_enemies=2048, num_resources=2048,
             num_weapons=1024, num_gems=512, tiers=5, levels=40,
@@ -18,9 +24,12 @@ class NMMO3(pufferlib.PufferEnv):
             item_respawn_ticks=100, x_window=7, y_window=5,
             reward_combat_level=1.0, reward_prof_level=1.0,
             reward_item_level=0.5, reward_market=0.01,
-            reward_death=-1.0, log_interval=128, buf=None, seed=0):
+            reward_death=-1.0, map_pool_size=0, map_pool_path=None,
+            map_pool_threads=8, packed_obs=False, log_interval=128,
+            buf=None, seed=0):
 
         self.log_interval = log_interval
+        self.packed_obs = packed_obs
 
         if len(width) > num_envs:
             width = width[:num_envs]
@@ -140,12 +149,29 @@ class NMMO3(pufferlib.PufferEnv):
         self.prof_goal_mask = np.array([0, 0, 0, 1, 0, 0, 1, 1, 1, 1])
         self.tick = 0
 
+        # Packed observations cut each map tile from 10 bytes to 4. Policies
+        # unpack them on device with pufferlib.pytorch.unpack_bitfields
+        tile_bytes = self.PACKED_TILE_BYTES if packed_obs else 10
         self.single_observation_space = gymnasium.spaces.Box(low=0,
-            high=255, shape=(11*15*10+47+10,), dtype=np.uint8)
+            high=255, shape=(11*15*tile_bytes+47+10,), dtype=np.uint8)
         self.single_action_space = gymnasium.spaces.Discrete(26)
         self.render_mode = 'human'
 
         super().__init__(buf)
+
+        # Resets draw from a pool of pregenerated maps instead of generating
+        # a new one. One pool per map size
+        map_pools = {}
+        if map_pool_size > 0:
+            for shape in sorted(set(zip(width, height))):
+                path = map_pool_path
+                if path is not None and len(set(zip(width, height))) > 1:
+                    path = f'{path}.{shape[0]}x{shape[1]}'
+                map_pools[shape] = binding.shared(num_maps=map_pool_size,
+                    width=shape[0], height=shape[1], x_window=x_window,
+                    y_window=y_window, num_threads=map_pool_threads,
+                    seed=seed, path=path)
+
         player_count = 0
         enemy_count = 0
         c_envs = []
@@ -178,12 +204,15 @@ class NMMO3(pufferlib.PufferEnv):
                 reward_item_level=reward_item_level,
                 reward_market=reward_market,
                 reward_death=reward_death,
+                packed_obs=packed_obs,
+                map_pool=map_pools.get((width[i], height[i])),
             )
             c_envs.append(env_id)
             player_count += players
             enemy_count += enemies
 
         self.c_envs = binding.vectorize(*c_envs)
+        self.map_pools = list(map_pools.values())
 
     def reset(self, seed=0):
         self.rewards.fill(0)
@@ -211,6 +240,9 @@ class NMMO3(pufferlib.PufferEnv):
 
     def close(self):
         binding.vec_close(self.c_envs)
+        for pool in self.map_pools:
+            binding.free_shared(pool)
+        self.map_pools = []
 
 def test_performance(cls, timeout=10, atn_cache=1024):
     env = cls(num_envs=1)
@@ -1,5 +1,6 @@
 #include <stdlib.h>
 #include <stdbool.h>
+#include "../rng.h"
 
 typedef struct Position {
     int x;
@@ -45,10 +46,10 @@ static inline Position pos_move(Position pos, int direction, int distance) {
     return pos;
 }
 
-static inline int rand_range(int min, int max) {
+static inline int rand_range(PufferRng* rng, int min, int max) {
   if (min == max) {
     return min;
   }
 
-  return min + (rand() % (max - min));
+  return puffer_randint(rng, min, max);
 }
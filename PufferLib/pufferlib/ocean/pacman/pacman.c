@@ -62,7 +62,7 @@ void performance_test() {
     long start = time(NULL);
     int i = 0;
     while (time(NULL) - start < test_time) {
-        env.actions[0] = rand() % 4;
+        env.actions[0] = puffer_randint(&env.rng, 0, 4);
         c_step(&env);
         i++;
     }
@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <time.h>
+#include "../rng.h"
 
 #define PX_PADDING_TOP 40 // 40px padding on top of the window
 
@@ -122,6 +123,7 @@ typedef struct PacmanEnv {
         float *rewards;
         char *terminals;
         Log log;
+        PufferRng rng;
 
         int step_count;
         int score;
@@ -314,7 +316,7 @@ static inline void reset_round(PacmanEnv *env) {
         Ghost *ghost = &env->ghosts[i];
         ghost->pos = ghost->spawn_pos;
         ghost->direction = UP;
-        ghost->start_timeout = rand_range(env->min_start_timeout, env->max_start_timeout);
+        ghost->start_timeout = rand_range(&env->rng, env->min_start_timeout, env->max_start_timeout);
         ghost->frightened = false;
         ghost->return_to_spawn = false;
         ghost->half_move = false;
@@ -327,7 +329,7 @@ static inline void reset_round(PacmanEnv *env) {
     }
 
     if (env->randomize_starting_position) {
-        int player_randomizer = rand() % NUM_DOTS;
+        int player_randomizer = puffer_randint(&env->rng, 0, NUM_DOTS);
         env->player_pos = env->possible_spawn_pos[player_randomizer];
     } else {
         env->player_pos = env->player_spawn_pos;
@@ -424,7 +426,7 @@ static inline int ghost_direction(PacmanEnv *env, Ghost *ghost) {
     }
 
     if (ghost->frightened) {
-        int random_index = rand() % option_count;
+        int random_index = puffer_randint(&env->rng, 0, option_count);
         return directions[random_index];
     }
 
@@ -641,8 +643,6 @@ Client *make_client(PacmanEnv *env) {
 
     update_interpolation(env);
 
-    srand(time(NULL));
-
     InitWindow(client->tile_size * MAP_WIDTH, client->tile_size * MAP_HEIGHT + PX_PADDING_TOP,
                "PufferLib Pacman");
     SetTargetFPS(60);
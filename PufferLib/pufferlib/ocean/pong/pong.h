@@ -2,6 +2,7 @@
 #include <stdbool.h>
 #include <math.h>
 #include "raylib.h"
+#include "../rng.h"
 
 typedef struct Log Log;
 struct Log {
@@ -17,6 +18,7 @@ typedef struct Pong Pong;
 struct Pong {
     Client* client;
     Log log;
+    PufferRng rng;
     float* observations;
     float* actions;
     float* rewards;
@@ -108,7 +110,7 @@ void reset_round(Pong* env) {
     env->ball_x = env->width / 5;
     env->ball_y = env->height / 2 - env->ball_height / 2;
     env->ball_vx = env->ball_initial_speed_x;
-    env->ball_vy = (rand() % 2 - 1) * env->ball_initial_speed_y;
+    env->ball_vy = (puffer_randint(&env->rng, 0, 2) - 1) * env->ball_initial_speed_y;
     env->tick = 0;
     env->n_bounces = 0;
 }
@@ -0,0 +1,137 @@
+// Random numbers for Ocean envs, in place of libc rand()/srand().
+// Counter based: draw n of a stream is the SplitMix64 finalizer applied to
+// key + n*golden, so seeding is one hash, separately seeded streams do not
+// overlap in practice, and batch fills are independent per element.
+//
+// Every draw takes the stream explicitly. Envs keep a PufferRng rng field
+// that env_binding.h seeds from the env seed, and pass &env->rng down to
+// whatever draws, so envs are reproducible from their seed whichever
+// thread steps them. Demos seed their env's stream themselves.
+#pragma once
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(__EMSCRIPTEN__)
+    #define PUFFER_RNG_X86 1
+#else
+    #define PUFFER_RNG_X86 0
+#endif
+
+#define PUFFER_RNG_GOLDEN 0x9e3779b97f4a7c15ULL
+
+typedef struct {
+    uint64_t key;
+    uint64_t counter;
+} PufferRng;
+
+static inline uint64_t puffer_rng_mix(uint64_t z) {
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+static inline void puffer_rng_seed(PufferRng* rng, uint64_t seed) {
+    rng->key = puffer_rng_mix(seed + PUFFER_RNG_GOLDEN);
+    rng->counter = 0;
+}
+
+static inline uint64_t puffer_rng_next(PufferRng* rng) {
+    return puffer_rng_mix(rng->key + (rng->counter++)*PUFFER_RNG_GOLDEN);
+}
+
+// Uniform in [0, RAND_MAX], the range of rand()
+static inline int puffer_rand(PufferRng* rng) {
+    return (int)((puffer_rng_next(rng) >> 32) & RAND_MAX);
+}
+
+// Uniform float in [0, 1)
+static inline float puffer_randf(PufferRng* rng) {
+    return (float)(int32_t)(puffer_rng_next(rng) >> 40) * 0x1p-24f;
+}
+
+// Uniform int in [lo, hi), without the modulo bias of rand() % n. Lemire's
+// multiply shift with rejection: the division only runs when the low half
+// lands in the biased zone, which is rare for small ranges
+static inline int puffer_randint(PufferRng* rng, int lo, int hi) {
+    uint32_t range = (uint32_t)(hi - lo);
+    uint64_t m = (puffer_rng_next(rng) >> 32)*range;
+    if ((uint32_t)m < range) {
+        uint32_t threshold = -range % range;
+        while ((uint32_t)m < threshold) {
+            m = (puffer_rng_next(rng) >> 32)*range;
+        }
+    }
+    return lo + (int)(m >> 32);
+}
+
+// Standard normal by Box-Muller
+static inline float puffer_randn(PufferRng* rng) {
+    float u1 = 1.0f - puffer_randf(rng);
+    float u2 = puffer_randf(rng);
+    return sqrtf(-2.0f*logf(u1))*cosf(6.28318530718f*u2);
+}
+
+typedef uint64_t PufferRngU64x8 __attribute__((vector_size(64)));
+typedef int32_t PufferRngI32x8 __attribute__((vector_size(32)));
+typedef float PufferRngF32x8 __attribute__((vector_size(32)));
+
+// Eight counters per iteration with vector extensions, since -O2 does
+// not vectorize the scalar loop
+static inline __attribute__((always_inline)) void _puffer_rand_fill(
+        uint64_t key, uint64_t counter, float* out, int n) {
+    PufferRngU64x8 z0 = {0, 1, 2, 3, 4, 5, 6, 7};
+    z0 = key + (counter + z0)*PUFFER_RNG_GOLDEN;
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        PufferRngU64x8 z = z0 + (uint64_t)i*PUFFER_RNG_GOLDEN;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        z = z ^ (z >> 31);
+        PufferRngI32x8 bits = __builtin_convertvector(z >> 40, PufferRngI32x8);
+        PufferRngF32x8 f = __builtin_convertvector(bits, PufferRngF32x8) * 0x1p-24f;
+        memcpy(out + i, &f, sizeof(f));
+    }
+    for (; i < n; i++) {
+        uint64_t z = puffer_rng_mix(key + (counter + i)*PUFFER_RNG_GOLDEN);
+        out[i] = (float)(int32_t)(z >> 40) * 0x1p-24f;
+    }
+}
+
+static inline void _puffer_rand_fill_default(uint64_t key, uint64_t counter, float* out, int n) {
+    _puffer_rand_fill(key, counter, out, n);
+}
+
+#if PUFFER_RNG_X86
+__attribute__((target("avx2")))
+static inline void _puffer_rand_fill_avx2(uint64_t key, uint64_t counter, float* out, int n) {
+    _puffer_rand_fill(key, counter, out, n);
+}
+
+// avx512dq has the 64 bit multiply the hash needs
+__attribute__((target("avx512f,avx512dq")))
+static inline void _puffer_rand_fill_avx512(uint64_t key, uint64_t counter, float* out, int n) {
+    _puffer_rand_fill(key, counter, out, n);
+}
+#endif
+
+// Fills out with n uniform floats in [0, 1) from rng, the same values n
+// puffer_randf calls would return
+static inline void puffer_rand_fill(PufferRng* rng, float* out, int n) {
+    typedef void (*FillFn)(uint64_t, uint64_t, float*, int);
+    static FillFn fill = NULL;
+    if (fill == NULL) {
+        fill = _puffer_rand_fill_default;
+#if PUFFER_RNG_X86
+        if (__builtin_cpu_supports("avx512dq")) {
+            fill = _puffer_rand_fill_avx512;
+        } else if (__builtin_cpu_supports("avx2")) {
+            fill = _puffer_rand_fill_avx2;
+        }
+#endif
+    }
+    fill(rng->key, rng->counter, out, n);
+    rng->counter += n;
+}
@@ -4,6 +4,7 @@
 #include <assert.h>
 #include <math.h>
 #include "raylib.h"
+#include "../rng.h"
 
 #define NUM_ACTIONS 5
 #define NUM_BULLETS 16
@@ -47,6 +48,7 @@ struct Env {
     Robot* robots;
     Bullet* bullets;
     float* actions;
+    PufferRng rng;
 };
 
 void allocate_env(Env* env) {
@@ -148,8 +150,8 @@ void reset(Env* env) {
     float x, y;
     while (idx < env->num_agents) {
         Robot* robot = &env->robots[idx];
-        x = 16 + rand() % (env->width-32);
-        y = 16 + rand() % (env->height-32);
+        x = 16 + puffer_randint(&env->rng, 0, env->width-32);
+        y = 16 + puffer_randint(&env->rng, 0, env->height-32);
         bool collided = false;
         for (int j = 0; j < idx; j++) {
             Robot* other = &env->robots[j];
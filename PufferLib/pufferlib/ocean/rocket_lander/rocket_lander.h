@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <assert.h>
 #include <math.h>
+#include "../rng.h"
 
 #include "raylib.h"
 #include "box2d/box2d.h"
@@ -147,6 +148,7 @@ struct Lander {
     unsigned char* truncation;
     LogBuffer* log_buffer;
     Log log;
+    PufferRng rng;
     int tick;
     b2WorldId world_id;
     b2BodyId barge_id;
@@ -277,7 +279,7 @@ void step(Lander* env) {
 
     // Main thruster
     float atn_thrust = THRUST_SCALE * env->actions[0];
-    float rad_thrust = radians + 0.02*(float)rand()/RAND_MAX;
+    float rad_thrust = radians + 0.02*(float)puffer_rand(&env->rng)/RAND_MAX;
     force = (b2Vec2){
         atn_thrust*sin(rad_thrust),
         atn_thrust*cos(rad_thrust)
@@ -286,7 +288,7 @@ void step(Lander* env) {
 
     // Top left thruster
     float atn_left = SIDE_THRUST_SCALE * env->actions[1];
-    float rad_left = -radians + PI/2 + 0.02*(float)rand()/RAND_MAX;
+    float rad_left = -radians + PI/2 + 0.02*(float)puffer_rand(&env->rng)/RAND_MAX;
     force = (b2Vec2){
         atn_left*sin(rad_left),
         atn_left*cos(rad_left)
@@ -295,7 +297,7 @@ void step(Lander* env) {
 
     // Top right thruster
     float atn_right = SIDE_THRUST_SCALE * env->actions[2];
-    float rad_right = -radians - PI/2 + 0.02*(float)rand()/RAND_MAX;
+    float rad_right = -radians - PI/2 + 0.02*(float)puffer_rand(&env->rng)/RAND_MAX;
     force = (b2Vec2){
         atn_right*sin(rad_right),
         atn_right*cos(rad_right)
@@ -392,13 +394,13 @@ void render(Client* client, Lander* env) {
     float mag = 1000000;
 
     if (IsKeyDown(KEY_W)) {
-        float rad_thrust = radians + 0.02*(float)rand()/RAND_MAX;
+        float rad_thrust = radians + 0.02*(float)puffer_rand(&env->rng)/RAND_MAX;
         b2Vec2 force = (b2Vec2){mag*sin(rad_thrust), mag*cos(rad_thrust)};
         b2Body_ApplyForce(lander_id, force, p_thrust, true);
         DrawCircle(p_thrust.x, -p_thrust.y, 20, RED);
     }
     if (IsKeyDown(KEY_Q)) {
-        float rad_left = -radians + PI/2 + 0.02*(float)rand()/RAND_MAX;
+        float rad_left = -radians + PI/2 + 0.02*(float)puffer_rand(&env->rng)/RAND_MAX;
         if (rad_left > PI) {
             rad_left -= 2*PI;
         }
@@ -407,7 +409,7 @@ void render(Client* client, Lander* env) {
         DrawCircle(p_left.x, -p_left.y, 20, RED);
     }
     if (IsKeyDown(KEY_E)) {
-        float rad_right = -radians - PI/2 + 0.02*(float)rand()/RAND_MAX;
+        float rad_right = -radians - PI/2 + 0.02*(float)puffer_rand(&env->rng)/RAND_MAX;
         b2Vec2 force = (b2Vec2){mag*sin(rad_right), mag*cos(rad_right)};
         b2Body_ApplyForce(lander_id, force, p_right, true);
         DrawCircle(p_right.x, -p_right.y, 20, RED);
@@ -5,6 +5,7 @@
 #include <string.h>
 #include <time.h>
 #include "raylib.h"
+#include "../rng.h"
 
 #define NOOP 0
 #define FORWARD 1
@@ -156,6 +157,7 @@ struct CRware {
     unsigned char* terminals;
     Log* agent_logs;
     Log log;
+    PufferRng rng;
     float* scores;
     int reward_type;
     int width;
@@ -197,7 +199,7 @@ void place_agent(CRware* env, int agent_idx) {
     
     int found_valid_position = 0;
     while (!found_valid_position) {
-        int random_pos = rand() % map_size;
+        int random_pos = puffer_randint(&env->rng, 0, map_size);
         
         // Skip if position is not empty
         if (env->warehouse_states[random_pos] != EMPTY) {
@@ -213,7 +215,7 @@ void place_agent(CRware* env, int agent_idx) {
         // Position is valid, place the agent
         env->old_agent_locations[agent_idx] = random_pos;
         env->agent_locations[agent_idx] = random_pos;
-        env->agent_directions[agent_idx] = rand() % 4;
+        env->agent_directions[agent_idx] = puffer_randint(&env->rng, 0, 4);
         env->agent_states[agent_idx] = 0;
         found_valid_position = 1;
     }
@@ -232,7 +234,7 @@ int request_new_shelf(CRware* env) {
         total_shelves = 144;
         shelf_locations = medium_shelf_locations;
     }
-    int random_index = rand() % total_shelves;
+    int random_index = puffer_randint(&env->rng, 0, total_shelves);
     int shelf_location = shelf_locations[random_index];
     if (env->warehouse_states[shelf_location] == SHELF ) {
         env->warehouse_states[shelf_location] = REQUESTED_SHELF;
@@ -242,8 +244,6 @@ int request_new_shelf(CRware* env) {
 }
 
 void generate_map(CRware* env,const int* map) {
-    // seed new random
-    srand(time(NULL));
     int map_size = map_sizes[env->map_choice - 1];
     memcpy(env->warehouse_states, map, map_size * sizeof(int));
 
@@ -68,7 +68,7 @@ void test_performance(float test_time) {
     int i = 0;
     while (time(NULL) - start < test_time) {
         for (int j = 0; j < env.num_snakes; j++) {
-            env.actions[j] = rand()%4;
+            env.actions[j] = puffer_randint(&env.rng, 0, 4);
         }
         c_step(&env);
         i++;
@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <math.h>
 #include "raylib.h"
+#include "../rng.h"
 
 #define EMPTY 0
 #define FOOD 1
@@ -26,6 +27,7 @@ struct CSnake {
     float* rewards;
     unsigned char* terminals;
     Log log;
+    PufferRng rng;
     Log* snake_logs;
     char* grid;
     int* snake;
@@ -141,8 +143,8 @@ void spawn_snake(CSnake* env, int snake_id) {
     int head_r, head_c, tile, grid_idx;
     delete_snake(env, snake_id);
     do {
-        head_r = rand() % (env->height - 1);
-        head_c = rand() % (env->width - 1);
+        head_r = puffer_randint(&env->rng, 0, env->height - 1);
+        head_c = puffer_randint(&env->rng, 0, env->width - 1);
         grid_idx = head_r*env->width + head_c;
         tile = env->grid[grid_idx];
     } while (tile != EMPTY && tile != CORPSE);
@@ -159,8 +161,8 @@ void spawn_snake(CSnake* env, int snake_id) {
 void spawn_food(CSnake* env) {
     int idx, tile;
     do {
-        int r = rand() % (env->height - 1);
-        int c = rand() % (env->width - 1);
+        int r = puffer_randint(&env->rng, 0, env->height - 1);
+        int c = puffer_randint(&env->rng, 0, env->width - 1);
         idx = r*env->width + c;
         tile = env->grid[idx];
     } while (tile != EMPTY && tile != CORPSE);
@@ -25,7 +25,7 @@ int main() {
             if (IsKeyDown(KEY_LEFT)  || IsKeyDown(KEY_A)) env.actions[0] = LEFT;
             if (IsKeyDown(KEY_RIGHT) || IsKeyDown(KEY_D)) env.actions[0] = RIGHT;
         } else {
-            env.actions[0] = rand() % 5;
+            env.actions[0] = puffer_randint(&env.rng, 0, 5);
         }
         c_step(&env);
         c_render(&env);
@@ -7,6 +7,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include "raylib.h"
+#include "../rng.h"
 
 const unsigned char NOOP = 0;
 const unsigned char DOWN = 1;
@@ -32,6 +33,7 @@ typedef struct {
 // Recommended that you name it the same as the env file
 typedef struct {
     Log log; // Required field. Env binding code uses this to aggregate logs
+    PufferRng rng;
     unsigned char* observations; // Required. You can use any obs type, but make sure it matches in Python!
     int* actions; // Required. int* for discrete/multidiscrete, float* for box
     float* rewards; // Required
@@ -60,7 +62,7 @@ void c_reset(Squared* env) {
     env->tick = 0;
     int target_idx;
     do {
-        target_idx = rand() % tiles;
+        target_idx = puffer_randint(&env->rng, 0, tiles);
     } while (target_idx == tiles/2);
     env->observations[target_idx] = TARGET;
 }
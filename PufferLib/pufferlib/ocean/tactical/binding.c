@@ -1,7 +1,11 @@
 #include "tactical.h"
 #define Env Tactical
+#define MY_SEED
 #include "../env_binding.h"
 
+// no randomness to seed
+static void my_seed(Env* env, int seed) {}
+
 // no init args needed
 static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
     return 0;
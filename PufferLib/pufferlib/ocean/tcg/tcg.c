@@ -27,7 +27,7 @@ int main() {
         if (IsKeyPressed(KEY_ENTER)) atn = 10;
 
         if (env.turn == 1) {
-            atn = rand() % 11;
+            atn = puffer_randint(&env.rng, 0, 11);
         }
  
         render(&env);
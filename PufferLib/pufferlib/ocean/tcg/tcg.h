@@ -3,6 +3,7 @@
 #include <stdio.h>
 #include <assert.h>
 #include "raylib.h"
+#include "../rng.h"
 
 #define HAND_SIZE 10
 #define BOARD_SIZE 10
@@ -109,6 +110,7 @@ struct TCG {
     //bool defenders[BOARD_SIZE][BOARD_SIZE];
     int block_idx;
     int turn;
+    PufferRng rng;
 };
 
 void allocate_tcg(TCG* env) {
@@ -130,13 +132,13 @@ void free_tcg(TCG* env) {
     free_card_array(env->op_deck);
 }
 
-void randomize_deck(CardArray* deck) {
+void randomize_deck(PufferRng* rng, CardArray* deck) {
     for (int i = 0; i < deck->length; i++) {
         deck->cards[i].defending = -1;
-        if (rand() % 3 == 0) {
+        if (puffer_randint(rng, 0, 3) == 0) {
             deck->cards[i].is_land = true;
         } else {
-            int cost = rand() % 6;
+            int cost = puffer_randint(rng, 0, 6);
             deck->cards[i].cost = cost;
             deck->cards[i].attack = cost + 1;
             deck->cards[i].health = cost + 1;
@@ -482,9 +484,9 @@ void reset(TCG* env) {
     env->op_board->length = 0;
     env->my_health = 20;
     env->op_health = 20;
-    randomize_deck(env->my_deck);
-    randomize_deck(env->op_deck);
-    env->turn = rand() % 2;
+    randomize_deck(&env->rng, env->my_deck);
+    randomize_deck(&env->rng, env->op_deck);
+    env->turn = puffer_randint(&env->rng, 0, 2);
     for (int i = 0; i < 5; i++) {
         draw_card(env, env->my_deck, env->my_hand);
         draw_card(env, env->op_deck, env->op_hand);
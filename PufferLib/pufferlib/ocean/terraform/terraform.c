@@ -178,8 +178,8 @@ void forward(TerraformNet* net, float* observations, int* actions, int vision_si
 void demo() {
     Weights* weights = load_weights("resources/terraform/puffer_terraform_weights.bin", 2476814);
     TerraformNet* net = init_terranet(weights, 1, 11, 6);
-    srand(time(NULL));
     Terraform env = {.size = 64, .num_agents = 1, .reset_frequency = 8192, .reward_scale = 0.04f};
+    puffer_rng_seed(&env.rng, time(NULL));
     allocate(&env);
 
     c_reset(&env);
@@ -211,13 +211,13 @@ void demo() {
 }
 
 void test_performance(int timeout) {
-    srand(time(NULL));
     Terraform env = {
         .size = 64,
         .num_agents = 8,
         .reset_frequency = 512,
         .reward_scale = 0.01f,
     };
+    puffer_rng_seed(&env.rng, time(NULL));
     allocate(&env);
     c_reset(&env);
 
@@ -225,9 +225,9 @@ void test_performance(int timeout) {
     int num_steps = 0;
     while (time(NULL) - start < timeout) {
         for (int i = 0; i < env.num_agents; i++) {
-            env.actions[3*i] = rand() % 5;
-            env.actions[3*i + 1] = rand() % 5;
-            env.actions[3*i + 2] = rand() % 3;
+            env.actions[3*i] = puffer_randint(&env.rng, 0, 5);
+            env.actions[3*i + 1] = puffer_randint(&env.rng, 0, 5);
+            env.actions[3*i + 2] = puffer_randint(&env.rng, 0, 3);
         }
 
         c_step(&env);
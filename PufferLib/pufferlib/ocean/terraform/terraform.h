@@ -11,6 +11,7 @@
 #include "simplex.h"
 #include "raymath.h"
 #include "rlgl.h"
+#include "../rng.h"
 
 #if defined(PLATFORM_DESKTOP)
     #define GLSL_VERSION 330
@@ -72,6 +73,7 @@ typedef struct Dozer {
 typedef struct Client Client;
 typedef struct Terraform {
     Log log;
+    PufferRng rng;
     Log* agent_logs;
     Client* client;
     Dozer* dozers;
@@ -104,8 +106,8 @@ typedef struct Terraform {
     float* quadrant_centroids;
 } Terraform;
 
-float randf(float min, float max) {
-    return min + (max - min)*(float)rand()/(float)RAND_MAX;
+float randf(PufferRng* rng, float min, float max) {
+    return min + (max - min)*(float)puffer_rand(rng)/(float)RAND_MAX;
 }
 
 void perlin_noise(float* map, int width, int height,
@@ -269,18 +271,19 @@ void init(Terraform* env) {
     unsigned int base_seed = (unsigned int)(ts.tv_nsec ^ ts.tv_sec ^ getpid());
     unsigned int seed1 = base_seed;
     unsigned int seed2 = base_seed + 99991;
-    srand(seed1);
-    int offset_x1 = rand() % 10000;
-    int offset_y1 = rand() % 10000;
-    srand(seed2);
-    int offset_x2 = rand() % 10000;
-    int offset_y2 = rand() % 10000;
+    PufferRng noise_rng;
+    puffer_rng_seed(&noise_rng, seed1);
+    int offset_x1 = puffer_randint(&noise_rng, 0, 10000);
+    int offset_y1 = puffer_randint(&noise_rng, 0, 10000);
+    puffer_rng_seed(&noise_rng, seed2);
+    int offset_x2 = puffer_randint(&noise_rng, 0, 10000);
+    int offset_y2 = puffer_randint(&noise_rng, 0, 10000);
     perlin_noise(env->orig_map, env->size, env->size, 1.0/(env->size / 4.0), 8, offset_x1, offset_y1, MAX_DIRT_HEIGHT+20);
     // perlin_noise(env->target_map, env->size, env->size, 1.0/(env->size / 4.0), 8, offset_x2, offset_y2, MAX_DIRT_HEIGHT+55);
     env->returns = calloc(env->num_agents, sizeof(float));
     calculate_total_delta(env);
     env->stuck_count = calloc(env->num_agents, sizeof(int));
-    env->tick = rand() % 512;
+    env->tick = puffer_randint(&env->rng, 0, 512);
     env->quadrants_solved = 0.0f;
 }
 
@@ -386,7 +389,7 @@ void c_reset(Terraform* env) {
     memcpy(env->quadrant_volume_deltas, env->volume_deltas, env->num_quadrants*sizeof(float));
     memset(env->complete_quadrants, 0, env->num_quadrants*sizeof(int));
 
-    int num_quadrants_to_precomplete = rand() % 5 + 25; // e.g. 30 to 34
+    int num_quadrants_to_precomplete = puffer_randint(&env->rng, 0, 5) + 25; // e.g. 30 to 34
     
     // Create array of available quadrants
     int available[env->num_quadrants];
@@ -451,8 +454,8 @@ void c_reset(Terraform* env) {
         temp.load_indices = env->dozers[i].load_indices;
         env->dozers[i] = temp;
         do {
-            env->dozers[i].x = rand() % env->size;
-            env->dozers[i].y = rand() % env->size;
+            env->dozers[i].x = puffer_randint(&env->rng, 0, env->size);
+            env->dozers[i].y = puffer_randint(&env->rng, 0, env->size);
         } while (env->map[map_idx(env, env->dozers[i].x, env->dozers[i].y)] != 0.0f);
         for (int j = 0; j < (2*SCOOP_SIZE + 1)*(2*SCOOP_SIZE + 1); j++) {
             env->dozers[i].load_indices[j] = -1;
@@ -676,8 +679,8 @@ void c_step(Terraform* env) {
         // Teleportitis
         if (env->tick % 512 == 0) {
              do {
-                 env->dozers[i].x = rand() % env->size;
-                 env->dozers[i].y = rand() % env->size;
+                 env->dozers[i].x = puffer_randint(&env->rng, 0, env->size);
+                 env->dozers[i].y = puffer_randint(&env->rng, 0, env->size);
                  env->stuck_count[i] = 0;
              } while (env->map[map_idx(env, env->dozers[i].x, env->dozers[i].y)] != 0.0f);
         }
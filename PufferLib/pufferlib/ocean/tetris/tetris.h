@@ -6,6 +6,7 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
+#include "../rng.h"
 #define min(a, b) (((a) < (b)) ? (a) : (b))
 #define max(a, b) (((a) > (b)) ? (a) : (b))
 
@@ -57,6 +58,7 @@ typedef struct Client {
 typedef struct Tetris {
 	Client *client;
 	Log log;
+	PufferRng rng;
 	float *observations;
 	int *actions;
 	float *rewards;
@@ -168,14 +170,14 @@ void restore_grid(Tetris *env) { memset(env->grid, 0, env->n_rows * env->n_cols
 
 void initialize_deck(Tetris *env) {
 	for (int i = 0; i < env->deck_size; i++) {
-		env->tetromino_deck[i] = rand() % NUM_TETROMINOES;
+		env->tetromino_deck[i] = puffer_randint(&env->rng, 0, NUM_TETROMINOES);
 	}
 	env->cur_position_in_deck = 0;
 	env->cur_tetromino = env->tetromino_deck[env->cur_position_in_deck];
 }
 
 void spawn_new_tetromino(Tetris *env) {
-	env->tetromino_deck[env->cur_position_in_deck] = rand() % NUM_TETROMINOES;
+	env->tetromino_deck[env->cur_position_in_deck] = puffer_randint(&env->rng, 0, NUM_TETROMINOES);
 	env->cur_position_in_deck = (env->cur_position_in_deck + 1) % env->deck_size;
 	env->cur_tetromino = env->tetromino_deck[env->cur_position_in_deck];
 	env->cur_tetromino_rot = 0;
@@ -69,6 +69,10 @@ class NMMO3(nn.Module):
 
         self.multihot_dim = self.factors.sum()
         self.is_continuous = False
+        self.packed_obs = getattr(env, 'packed_obs', False)
+        if self.packed_obs:
+            self.packed_tile_bytes = env.PACKED_TILE_BYTES
+            self.packed_fields = env.PACKED_FIELDS
 
         self.map_2d = nn.Sequential(
             pufferlib.pytorch.layer_init(nn.Conv2d(self.multihot_dim, 128, 5, stride=3)),
@@ -101,6 +105,12 @@ class NMMO3(nn.Module):
 
     def encode_observations(self, observations, state=None):
         batch = observations.shape[0]
+        if self.packed_obs:
+            ob_map = pufferlib.pytorch.unpack_bitfields(observations,
+                self.packed_tile_bytes, 11*15, self.packed_fields)
+            observations = torch.cat([ob_map,
+                observations[:, 11*15*self.packed_tile_bytes:]], dim=1)
+
         ob_map = observations[:, :11*15*10].view(batch, 11, 15, 10)
         ob_player = observations[:, 11*15*10:-10]
         ob_reward = observations[:, -10:]
@@ -555,6 +565,11 @@ class TowerClimb(nn.Module):
         self.value_fn = pufferlib.pytorch.layer_init(
                 nn.Linear(hidden_size, 1 ), std=1)
 
+        self.packed_obs = getattr(env, 'packed_obs', False)
+        if self.packed_obs:
+            self.packed_vision = env.PACKED_VISION
+            self.packed_fields = env.PACKED_FIELDS
+
     def forward(self, observations, state=None):
         hidden = self.encode_observations(observations)
         actions, value = self.decode_actions(hidden)
@@ -564,7 +579,11 @@ class TowerClimb(nn.Module):
         return self.forward(x, state)
 
     def encode_observations(self, observations, state=None):
-        board_state = observations[:,:225]
+        if self.packed_obs:
+            board_state = pufferlib.pytorch.unpack_bitfields(observations,
+                1, self.packed_vision, self.packed_fields)[:, :225]
+        else:
+            board_state = observations[:,:225]
         player_info = observations[:, -3:] 
         board_features = board_state.view(-1, 1, 5,5,9).float()
         cnn_features = self.network(board_features)
@@ -8,9 +8,11 @@ static PyObject* my_shared(PyObject* self, PyObject* args, PyObject* kwargs) {
     int num_maps = unpack(kwargs, "num_maps");
     Level* levels = calloc(num_maps, sizeof(Level));
     PuzzleState* puzzle_states = calloc(num_maps, sizeof(PuzzleState));
+    PufferRng rng;
+    puffer_rng_seed(&rng, time(NULL));
 
     for (int i = 0; i < num_maps; i++) {
-        int goal_height = rand() % 4 + 5;
+        int goal_height = puffer_randint(&rng, 5, 9);
         int min_moves = 10;
         int max_moves = 15;
         init_level(&levels[i]);
@@ -33,6 +35,7 @@ static int my_init(Env* env, PyObject* args, PyObject* kwargs) {
     env->reward_fall_row = unpack(kwargs, "reward_fall_row");
     env->reward_illegal_move = unpack(kwargs, "reward_illegal_move");
     env->reward_move_block = unpack(kwargs, "reward_move_block");
+    env->packed_obs = unpack(kwargs, "packed_obs");
     init(env);
 
     PyObject* handle_obj = PyDict_GetItemString(kwargs, "state");
@@ -108,10 +108,11 @@ void demo() {
     Level* levels = calloc(num_maps, sizeof(Level));
     PuzzleState* puzzle_states = calloc(num_maps, sizeof(PuzzleState));
 
-    srand(time(NULL));
+    PufferRng rng;
+    puffer_rng_seed(&rng, time(NULL));
     
     for (int i = 0; i < num_maps; i++) {
-        int goal_height = rand() % 4 + 5;
+        int goal_height = puffer_randint(&rng, 5, 9);
         int min_moves = 10;
         int max_moves = 15;
         init_level(&levels[i]);
@@ -121,12 +122,13 @@ void demo() {
     }
 
     CTowerClimb* env = allocate();
+    env->rng = rng;
     env->num_maps = num_maps;
     env->all_levels = levels;
     env->all_puzzles = puzzle_states;
 
-    int random_level = 5 + (rand() % 4);
-    init_random_level(env, random_level, 15, 10, rand());
+    int random_level = puffer_randint(&env->rng, 5, 9);
+    init_random_level(env, random_level, 15, 10, puffer_rand(&env->rng));
     c_reset(env);
     c_render(env);
     Client* client = env->client;
@@ -206,7 +208,7 @@ void performance_test() {
     long start = time(NULL);
     int i = 0;
     while (time(NULL) - start < test_time) {
-        env->actions[0] = rand() % 5;
+        env->actions[0] = puffer_randint(&env->rng, 0, 5);
         c_step(env);
         i++;
     }
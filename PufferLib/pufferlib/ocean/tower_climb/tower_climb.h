@@ -9,6 +9,7 @@
 #include "rlgl.h"
 #include <time.h>
 #include <unistd.h>
+#include "../rng.h"
 
 #if defined(PLATFORM_DESKTOP)
     #define GLSL_VERSION            330
@@ -33,6 +34,8 @@
 // observation space
 #define PLAYER_OBS 3
 #define OBS_VISION 225
+// packed mode: four 2 bit cells per byte
+#define OBS_PACKED_VISION ((OBS_VISION + 3) / 4)
 // PLG VS ENV
 #define PLG_MODE 0
 #define RL_MODE 1
@@ -158,6 +161,7 @@ struct CTowerClimb {
     unsigned char* terminals;
     unsigned char* truncations;
     Log log;
+    PufferRng rng;
     Log buffer;
     float score;
     int num_maps;
@@ -172,6 +176,7 @@ struct CTowerClimb {
     float reward_move_block;
     bool pending_reset;
     bool goal_reached;
+    bool packed_obs;
     // Celebration timing (for visual effects)
     float celebrationStartTime;
     bool celebrationStarted;
@@ -299,6 +304,9 @@ void compute_observations(CTowerClimb* env) {
     calculate_window_bounds(x_bounds, player_x, 9, cols);
     calculate_window_bounds(z_bounds, player_z, 5, rows);
     // Fill in observations
+    if (env->packed_obs) {
+        memset(env->observations, 0, OBS_PACKED_VISION);
+    }
     for (int y = 0; y < 5; y++) {
         int world_y = y + y_bounds[0];
         for (int z = 0; z < 5; z++) {
@@ -309,21 +317,27 @@ void compute_observations(CTowerClimb* env) {
                 // Check if position is out of bounds
                 int board_idx = world_y * sz + world_z * cols + world_x;
                 // Position is in bounds, set observation
+                unsigned char cell;
                 if (board_idx == env->state->robot_position) {
-                    env->observations[obs_idx] = 3;
-                    continue;
+                    cell = 3;
                 }
                 else if (board_idx == env->level->goal_location){
-                    env->observations[obs_idx] = 2;
-                    continue;
+                    cell = 2;
+                }
+                else {
+                    // Use bitmask directly instead of board_state array
+                    cell = TEST_BIT(env->state->blocks, board_idx);
+                }
+                if (env->packed_obs) {
+                    env->observations[obs_idx / 4] |= cell << (2 * (obs_idx % 4));
+                } else {
+                    env->observations[obs_idx] = cell;
                 }
-                // Use bitmask directly instead of board_state array
-                env->observations[obs_idx] = TEST_BIT(env->state->blocks, board_idx);
             }
         }
     }
     // Add player state information at the end
-    int state_start = 9 * 5 * 5;
+    int state_start = env->packed_obs ? OBS_PACKED_VISION : OBS_VISION;
     env->observations[state_start] = env->state->robot_orientation;
     env->observations[state_start + 1] = env->state->robot_state;
     env->observations[state_start + 2] = (env->state->block_grabbed != -1);
@@ -345,7 +359,7 @@ void c_reset(CTowerClimb* env) {
     // Always use pre-generated maps (ensure at least 1 exists during initialization)
     // printf("num maps: %d\n", env->num_maps);
     if (env->num_maps > 0) {
-        int idx = rand() % env->num_maps;
+        int idx = puffer_randint(&env->rng, 0, env->num_maps);
         setPuzzle(env, &env->all_puzzles[idx], &env->all_levels[idx]);
     } else {
         // Emergency fallback: use a simple default level
@@ -1129,7 +1143,7 @@ int verify_level(Level* level, int max_moves, int min_moves){
     return solvable;
 }
 
-void gen_level(Level* lvl, int goal_level) {
+void gen_level(PufferRng* rng, Level* lvl, int goal_level) {
     // Initialize an illegal level in case we need to return early
     int legal_width_size = 8;
     int legal_depth_size = 8;
@@ -1145,7 +1159,7 @@ void gen_level(Level* lvl, int goal_level) {
                 int within_legal_bounds = x>=1 && x < legal_width_size && z >= 1 && z < legal_depth_size && y>=1 && y < goal_level;
                 int allowed_block_placement = within_legal_bounds && (z <= (legal_depth_size - y));
                 if (allowed_block_placement){
-                    int chance = (rand() % 2 ==0) ? 1 : 0;
+                    int chance = (puffer_randint(rng, 0, 2) ==0) ? 1 : 0;
                     lvl->map[block_index] = chance;
                     // create spawn point above an existing block
                     if (spawn_created == 0 && y == 2 && lvl->map[block_index - area] == 1){
@@ -1159,7 +1173,7 @@ void gen_level(Level* lvl, int goal_level) {
                      lvl->map[block_index - 1 - area] == 1 || 
                      lvl->map[block_index + 1 - area] == 1)) {
                     // 33% chance to place goal here, unless we're at the last valid position
-                    if (rand() % 3 == 0 || (x == col_max-1 && z == 0)) {
+                    if (puffer_randint(rng, 0, 3) == 0 || (x == col_max-1 && z == 0)) {
                         goal_created = 1;
                         goal_index = block_index;
                         lvl->map[goal_index] = 2;
@@ -1184,24 +1198,26 @@ void gen_level(Level* lvl, int goal_level) {
 
 void init_random_level(CTowerClimb* env, int goal_level, int max_moves, int min_moves, int seed) {
 	time_t t;
-    srand((unsigned) time(&t) + seed); // Increment seed for each level
+    PufferRng rng;
+    puffer_rng_seed(&rng, (unsigned) time(&t) + seed); // Increment seed for each level
     reset_level(env->level);
-    gen_level(env->level, goal_level);
+    gen_level(&rng, env->level, goal_level);
     // guarantee a map is created
     while(env->level->spawn_location == 0 || env->level->goal_location == 999 || verify_level(env->level,max_moves, min_moves) == 0){
         reset_level(env->level);
-        gen_level(env->level,goal_level);
+        gen_level(&rng, env->level,goal_level);
     }
     levelToPuzzleState(env->level, env->state);
 }
 
 void cy_init_random_level(Level* level, int goal_level, int max_moves, int min_moves, int seed) {
     time_t t;
-    srand((unsigned) time(&t) + seed); // Increment seed for each level
-    gen_level(level, goal_level);
+    PufferRng rng;
+    puffer_rng_seed(&rng, (unsigned) time(&t) + seed); // Increment seed for each level
+    gen_level(&rng, level, goal_level);
     // guarantee a map is created
     while(level->spawn_location == 0 || level->goal_location == 999 || verify_level(level,max_moves, min_moves) == 0){
-        gen_level(level, goal_level);
+        gen_level(&rng, level, goal_level);
     }
 }
 
@@ -6,16 +6,21 @@ from pufferlib.ocean.tower_climb import binding
 
 
 class TowerClimb(pufferlib.PufferEnv):
+    # Packed mode: four 2 bit cells per byte, then the 3 player bytes
+    PACKED_FIELDS = [(0, 0, 2), (0, 2, 2), (0, 4, 2), (0, 6, 2)]
+    PACKED_VISION = 57
+
     def __init__(self, num_envs=4096, render_mode=None, report_interval=1,
             num_maps=50, reward_climb_row = .25, reward_fall_row = 0, reward_illegal_move = -0.01,
-            reward_move_block = 0.2, buf = None, seed=0):
+            reward_move_block = 0.2, packed_obs=False, buf = None, seed=0):
 
         # env
         self.num_agents = num_envs
         self.render_mode = render_mode
         self.report_interval = report_interval
         
-        self.num_obs = 228
+        self.packed_obs = packed_obs
+        self.num_obs = self.PACKED_VISION + 3 if packed_obs else 228
         self.single_observation_space = gymnasium.spaces.Box(low=0, high=255,
             shape=(self.num_obs,), dtype=np.uint8)
         self.single_action_space = gymnasium.spaces.Discrete(6)
@@ -27,7 +32,8 @@ class TowerClimb(pufferlib.PufferEnv):
             self.rewards, self.terminals, self.truncations, num_envs, seed,
             num_maps=num_maps, reward_climb_row=reward_climb_row,
             reward_fall_row=reward_fall_row, reward_illegal_move=reward_illegal_move,
-            reward_move_block=reward_move_block, state=self.c_state)
+            reward_move_block=reward_move_block, packed_obs=packed_obs,
+            state=self.c_state)
 
     def reset(self, seed=None):
         binding.vec_reset(self.c_envs, seed)
@@ -42,7 +42,7 @@ void demo(int grid_size, int num_agents, int num_trash, int num_bins, int max_st
                     forward_convlstm(net, net->obs, env.actions);    
                 }
                 else{
-                    env.actions[i] = rand() % 4; // 0 = UP, 1 = DOWN, 2 = LEFT, 3 = RIGHT
+                    env.actions[i] = puffer_randint(&env.rng, 0, 4); // 0 = UP, 1 = DOWN, 2 = LEFT, 3 = RIGHT
                 }
                 // printf("action: %d \n", env.actions[i]);
             }
@@ -97,7 +97,7 @@ void performance_test() {
     int inc = env.num_agents;
     while (time(NULL) - start < test_time) {
         for (int e = 0; e < env.num_agents; e++) {
-            env.actions[e] = rand() % 4;
+            env.actions[e] = puffer_randint(&env.rng, 0, 4);
         }
         c_step(&env);
         i += inc;
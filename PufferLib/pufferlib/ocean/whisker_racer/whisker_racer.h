@@ -6,6 +6,7 @@
 #include <string.h>
 #include "raylib.h"
 #include <time.h>
+#include "../rng.h"
 
 #define LEFT 0
 #define NOOP 1
@@ -57,6 +58,7 @@ typedef struct Client {
 typedef struct WhiskerRacer {
     Client* client;
     Log log;
+    PufferRng rng;
     float* observations;
     float* actions;
     float* rewards;
@@ -64,7 +66,7 @@ typedef struct WhiskerRacer {
     int i;
 
     int debug;
-    unsigned int rng;
+    unsigned int rng_seed;
     int render_many;
 
     float corner_thresh;
@@ -191,7 +193,7 @@ void close_client(Client* client) {
 }
 
 void get_random_start(WhiskerRacer* env) {
-    int start_idx = rand() % env->track.total_points;
+    int start_idx = puffer_randint(&env->rng, 0, env->track.total_points);
     env->near_point_idx = start_idx;
 
     env->px = env->track.centerline[start_idx].x;
@@ -432,24 +434,24 @@ void GenerateRandomControlPoints(WhiskerRacer* env) {
     int n = env->num_points;
 
     if (env->method == -1) {
-        env->method = rand() % 3;
+        env->method = puffer_randint(&env->rng, 0, 3);
     }
 
     if (env->method == 0) {
         // Randomly choose distinct, non-adjacent indices for tight and medium corners
-        int opt1 = rand() % n;
+        int opt1 = puffer_randint(&env->rng, 0, n);
         int opt2;
         do {
-            opt2 = rand() % n;
+            opt2 = puffer_randint(&env->rng, 0, n);
         } while (opt2 == opt1 || abs(opt2 - opt1) == 1 || abs(opt2 - opt1) == n - 1);
 
         int opt3, opt4;
         do {
-            opt3 = rand() % n;
+            opt3 = puffer_randint(&env->rng, 0, n);
         } while (opt3 == opt1 || opt3 == opt2);
 
         do {
-            opt4 = rand() % n;
+            opt4 = puffer_randint(&env->rng, 0, n);
         } while (opt4 == opt1 || opt4 == opt2 || opt4 == opt3 || abs(opt4 - opt3) == 1 || abs(opt4 - opt3) == n - 1);
 
         // Generate control points
@@ -458,11 +460,11 @@ void GenerateRandomControlPoints(WhiskerRacer* env) {
 
             float dist_from_center;
             if (i == opt1) {
-                dist_from_center = env->height * 0.2 + (rand() % 30);
+                dist_from_center = env->height * 0.2 + puffer_randint(&env->rng, 0, 30);
             } else if (i == opt2 || i == opt3) {
-                dist_from_center = env->height * 0.3 + (rand() % 40);
+                dist_from_center = env->height * 0.3 + puffer_randint(&env->rng, 0, 40);
             } else {
-                dist_from_center = env->height * 0.5 + (rand() % 30);
+                dist_from_center = env->height * 0.5 + puffer_randint(&env->rng, 0, 30);
             }
 
             env->track.controls[i].position.x = center_x + dist_from_center * cosf(angle);
@@ -485,7 +487,7 @@ void GenerateRandomControlPoints(WhiskerRacer* env) {
             int attempts = 0;
             int pos;
             do {
-                pos = rand() % n;
+                pos = puffer_randint(&env->rng, 0, n);
                 bool valid = (assigned[pos] == 0);
                 if (valid) break;
                 attempts++;
@@ -502,7 +504,7 @@ void GenerateRandomControlPoints(WhiskerRacer* env) {
             int attempts = 0;
             int pos;
             do {
-                pos = rand() % n;
+                pos = puffer_randint(&env->rng, 0, n);
                 int prev_prev = (pos - 2 + n) % n;
                 int prev = (pos - 1 + n) % n;
                 int next = (pos + 1) % n;
@@ -538,11 +540,11 @@ void GenerateRandomControlPoints(WhiskerRacer* env) {
 
             float dist_from_center;
             if (corner_types[i] == 0) {
-                dist_from_center = env->height * 0.35 + (rand() % 30);
+                dist_from_center = env->height * 0.35 + puffer_randint(&env->rng, 0, 30);
             } else if (corner_types[i] == 1) {
-                dist_from_center = env->height * 0.45 + (rand() % 40);
+                dist_from_center = env->height * 0.45 + puffer_randint(&env->rng, 0, 40);
             } else {
-                dist_from_center = env->height * 0.6 + (rand() % 30);
+                dist_from_center = env->height * 0.6 + puffer_randint(&env->rng, 0, 30);
             }
 
             env->track.controls[i].position.x = center_x + dist_from_center * 1.2f * cosf(angle);
@@ -556,17 +558,17 @@ void GenerateRandomControlPoints(WhiskerRacer* env) {
         float track_stretch_x = 1.0;
         float track_stretch_y = 0.6;
 
-        float freq1 = 2.0f + (rand() % 5);
-        float amp1 = (1.0f / freq1) * (0.9f + 0.2f * (rand() % 100) / 100.0f);
-        float phase1 = PI2 * (rand() % 100) / 100.0f;
+        float freq1 = 2.0f + puffer_randint(&env->rng, 0, 5);
+        float amp1 = (1.0f / freq1) * (0.9f + 0.2f * puffer_randint(&env->rng, 0, 100) / 100.0f);
+        float phase1 = PI2 * puffer_randint(&env->rng, 0, 100) / 100.0f;
 
-        float freq2 = 1.0f + (rand() % 2);
-        float amp2 = 0.2f + 0.2f * (rand() % 100) / 100.0f;
-        float phase2 = PI2 * (rand() % 100) / 100.0f;
+        float freq2 = 1.0f + puffer_randint(&env->rng, 0, 2);
+        float amp2 = 0.2f + 0.2f * puffer_randint(&env->rng, 0, 100) / 100.0f;
+        float phase2 = PI2 * puffer_randint(&env->rng, 0, 100) / 100.0f;
 
-        float freq3 = 10.0f + 0.5f * (rand() % 3);
-        float amp3 = 0.3f + 0.1f * (rand() % 100) / 100.0f;
-        float phase3 = PI2 * (rand() % 100) / 100.0f;
+        float freq3 = 10.0f + 0.5f * puffer_randint(&env->rng, 0, 3);
+        float amp3 = 0.3f + 0.1f * puffer_randint(&env->rng, 0, 100) / 100.0f;
+        float phase3 = PI2 * puffer_randint(&env->rng, 0, 100) / 100.0f;
 
         for (int i = 0; i < n; i++) {
             float angle = (PI2 * i) / n;
@@ -898,7 +900,7 @@ void c_render(WhiskerRacer* env) {
 
     if (env->render_many)
     {
-        env->method = rand() % 3;
+        env->method = puffer_randint(&env->rng, 0, 3);
         GenerateRandomTrack(env);
     }
 
@@ -940,7 +942,7 @@ void init(WhiskerRacer* env) {
 
     env->texture_initialized = 0;
 
-    srand(env->rng + env->i);
+    puffer_rng_seed(&env->rng, env->rng_seed + env->i);
 
     GenerateRandomTrack(env);
 }
@@ -0,0 +1,167 @@
+// Python bindings for worker_signal.h, used by vector.Multiprocessing.
+// Signal buffers are any writable buffer of int32 words, such as a
+// multiprocessing RawArray('i', words(num_workers)). Worker lists are int32
+// arrays. Waits release the GIL.
+#include <Python.h>
+#include "worker_signal.h"
+
+static uint32_t* unpack_signals(Py_buffer* view, int min_workers) {
+    if (view->len < (Py_ssize_t)(sizeof(uint32_t)*signal_words(min_workers))) {
+        PyErr_SetString(PyExc_ValueError, "Signal buffer too small for the number of workers");
+        return NULL;
+    }
+    if ((uintptr_t)view->buf % sizeof(uint32_t) != 0) {
+        PyErr_SetString(PyExc_ValueError, "Signal buffer must be 4 byte aligned");
+        return NULL;
+    }
+    return (uint32_t*)view->buf;
+}
+
+// Worker ids must index the buffer, which was sized for buf[0] workers
+static int check_workers(uint32_t* buf, Py_buffer* view) {
+    if (view->len % sizeof(int) != 0) {
+        PyErr_SetString(PyExc_ValueError, "Workers must be an int32 array");
+        return 1;
+    }
+    const int* workers = (const int*)view->buf;
+    int n = view->len / sizeof(int);
+    int num_workers = buf[SIGNAL_NUM_WORKERS];
+    for (int i = 0; i < n; i++) {
+        if (workers[i] < 0 || workers[i] >= num_workers) {
+            PyErr_Format(PyExc_IndexError, "Worker %d out of range for %d workers", workers[i], num_workers);
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static PyObject* py_words(PyObject* self, PyObject* args) {
+    int num_workers;
+    if (!PyArg_ParseTuple(args, "i", &num_workers)) {
+        return NULL;
+    }
+    return PyLong_FromLong(signal_words(num_workers));
+}
+
+static PyObject* py_init(PyObject* self, PyObject* args) {
+    Py_buffer view;
+    int num_workers;
+    unsigned int state;
+    if (!PyArg_ParseTuple(args, "w*iI", &view, &num_workers, &state)) {
+        return NULL;
+    }
+    uint32_t* buf = unpack_signals(&view, num_workers);
+    if (buf != NULL) {
+        signal_init(buf, num_workers, state);
+    }
+    PyBuffer_Release(&view);
+    if (buf == NULL) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* py_post(PyObject* self, PyObject* args) {
+    Py_buffer view;
+    Py_buffer workers;
+    unsigned int request;
+    if (!PyArg_ParseTuple(args, "w*y*I", &view, &workers, &request)) {
+        return NULL;
+    }
+    uint32_t* buf = unpack_signals(&view, 0);
+    int failed = buf == NULL || check_workers(buf, &workers);
+    if (!failed) {
+        signal_post(buf, (const int*)workers.buf, workers.len / sizeof(int), request);
+    }
+    PyBuffer_Release(&workers);
+    PyBuffer_Release(&view);
+    if (failed) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* py_wait_request(PyObject* self, PyObject* args) {
+    Py_buffer view;
+    int worker;
+    unsigned int idle;
+    int timeout_ms;
+    if (!PyArg_ParseTuple(args, "w*iIi", &view, &worker, &idle, &timeout_ms)) {
+        return NULL;
+    }
+    uint32_t* buf = unpack_signals(&view, worker + 1);
+    if (buf == NULL) {
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    uint32_t state;
+    Py_BEGIN_ALLOW_THREADS
+    state = signal_wait_request(buf, worker, idle, timeout_ms);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&view);
+    return PyLong_FromUnsignedLong(state);
+}
+
+static PyObject* py_post_done(PyObject* self, PyObject* args) {
+    Py_buffer view;
+    int worker;
+    unsigned int state;
+    if (!PyArg_ParseTuple(args, "w*iI", &view, &worker, &state)) {
+        return NULL;
+    }
+    uint32_t* buf = unpack_signals(&view, worker + 1);
+    if (buf != NULL) {
+        signal_post_done(buf, worker, state);
+    }
+    PyBuffer_Release(&view);
+    if (buf == NULL) {
+        return NULL;
+    }
+    Py_RETURN_NONE;
+}
+
+static PyObject* py_wait_ready(PyObject* self, PyObject* args) {
+    Py_buffer view;
+    Py_buffer workers;
+    int k;
+    unsigned int idle;
+    int timeout_ms;
+    if (!PyArg_ParseTuple(args, "w*y*iIi", &view, &workers, &k, &idle, &timeout_ms)) {
+        return NULL;
+    }
+    uint32_t* buf = unpack_signals(&view, 0);
+    if (buf == NULL || check_workers(buf, &workers)) {
+        PyBuffer_Release(&workers);
+        PyBuffer_Release(&view);
+        return NULL;
+    }
+    int ready;
+    Py_BEGIN_ALLOW_THREADS
+    ready = signal_wait_ready(buf, (const int*)workers.buf, workers.len / sizeof(int), k, idle, timeout_ms);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&workers);
+    PyBuffer_Release(&view);
+    return PyLong_FromLong(ready);
+}
+
+static PyMethodDef methods[] = {
+    {"words", py_words, METH_VARARGS, "Number of int32 words in a signal buffer for num_workers"},
+    {"init", py_init, METH_VARARGS, "Initialize a signal buffer with every worker in the given state"},
+    {"post", py_post, METH_VARARGS, "Store a request for each listed worker and wake the sleeping ones"},
+    {"wait_request", py_wait_request, METH_VARARGS, "Wait for a worker state below idle, returns the state"},
+    {"post_done", py_post_done, METH_VARARGS, "Store an idle state for a worker and wake the main process"},
+    {"wait_ready", py_wait_ready, METH_VARARGS, "Wait until k of the listed workers are idle, returns how many are"},
+    {NULL, NULL, 0, NULL}
+};
+
+static PyModuleDef module = {
+    PyModuleDef_HEAD_INIT,
+    "worker_signal",
+    NULL,
+    -1,
+    methods
+};
+
+PyMODINIT_FUNC PyInit_worker_signal(void) {
+    return PyModule_Create(&module);
+}
@@ -0,0 +1,180 @@
+// Wait/notify between the vector.Multiprocessing main process and its
+// workers over a shared memory buffer of 32 bit words, without locks.
+//
+// Each worker owns one cache line holding its state word and a sleeping
+// flag. The main process posts a request by storing it in the state word,
+// the worker posts completion by storing an idle state, which also bumps a
+// shared completion counter in the header line. Both sides spin briefly,
+// then sleep on a futex on the word they wait for; wakers only make the
+// wake syscall when the sleeping flag is up. Sleepers raise their flag
+// before rechecking the word and wakers store before reading the flag,
+// both sequentially consistent, so a wakeup is never lost.
+//
+// A worker has at most one outstanding request, so its state word is the
+// whole request queue. States at or above a caller chosen idle value mean
+// the worker is done and waiting, below it mean there is work to do.
+//
+// Layout, in words: header line {num_workers, completions, main sleeping},
+// then one line per worker {state, sleeping}. Works across processes as
+// long as the buffer is a shared mapping (RawArray, mmap, shm_open).
+// Off Linux, sleeping falls back to short naps.
+#pragma once
+
+#include <stdint.h>
+#include <time.h>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#define SIGNAL_LINE 16  // words per cache line
+#define SIGNAL_SPIN 2000
+
+#define SIGNAL_NUM_WORKERS 0
+#define SIGNAL_COMPLETIONS 1
+#define SIGNAL_MAIN_SLEEPING 2
+
+static inline int signal_words(int num_workers) {
+    return (num_workers + 1)*SIGNAL_LINE;
+}
+
+static inline uint32_t* signal_state(uint32_t* buf, int worker) {
+    return &buf[(worker + 1)*SIGNAL_LINE];
+}
+
+static inline uint32_t* signal_sleeping(uint32_t* buf, int worker) {
+    return &buf[(worker + 1)*SIGNAL_LINE + 1];
+}
+
+static inline uint32_t signal_load(uint32_t* word) {
+    return __atomic_load_n(word, __ATOMIC_SEQ_CST);
+}
+
+static inline void signal_store(uint32_t* word, uint32_t value) {
+    __atomic_store_n(word, value, __ATOMIC_SEQ_CST);
+}
+
+static inline void signal_pause(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Sleeps while *word == expected, at most timeout_ms. May return early
+static void signal_sleep(uint32_t* word, uint32_t expected, int timeout_ms) {
+#ifdef __linux__
+    struct timespec timeout = {timeout_ms/1000, (timeout_ms%1000)*1000000L};
+    syscall(SYS_futex, word, FUTEX_WAIT, expected, &timeout, NULL, 0);
+#else
+    struct timespec nap = {0, 100000};
+    (void)word;
+    (void)expected;
+    (void)timeout_ms;
+    nanosleep(&nap, NULL);
+#endif
+}
+
+static void signal_wake(uint32_t* word, int count) {
+#ifdef __linux__
+    syscall(SYS_futex, word, FUTEX_WAKE, count, NULL, NULL, 0);
+#else
+    (void)word;
+    (void)count;
+#endif
+}
+
+static double signal_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return 1e3*ts.tv_sec + 1e-6*ts.tv_nsec;
+}
+
+void signal_init(uint32_t* buf, int num_workers, uint32_t state) {
+    buf[SIGNAL_NUM_WORKERS] = num_workers;
+    signal_store(&buf[SIGNAL_COMPLETIONS], 0);
+    signal_store(&buf[SIGNAL_MAIN_SLEEPING], 0);
+    for (int w = 0; w < num_workers; w++) {
+        signal_store(signal_state(buf, w), state);
+        signal_store(signal_sleeping(buf, w), 0);
+    }
+}
+
+// Main process: hands a request to each listed worker
+void signal_post(uint32_t* buf, const int* workers, int n, uint32_t request) {
+    for (int i = 0; i < n; i++) {
+        signal_store(signal_state(buf, workers[i]), request);
+    }
+    for (int i = 0; i < n; i++) {
+        if (signal_load(signal_sleeping(buf, workers[i]))) {
+            signal_wake(signal_state(buf, workers[i]), 1);
+        }
+    }
+}
+
+// Worker: waits up to timeout_ms for a state below idle and returns the
+// state, which is still idle on timeout
+uint32_t signal_wait_request(uint32_t* buf, int worker, uint32_t idle, int timeout_ms) {
+    uint32_t* state = signal_state(buf, worker);
+    uint32_t* sleeping = signal_sleeping(buf, worker);
+    for (int i = 0; i < SIGNAL_SPIN; i++) {
+        uint32_t s = signal_load(state);
+        if (s < idle) return s;
+        signal_pause();
+    }
+    signal_store(sleeping, 1);
+    uint32_t s = signal_load(state);
+    if (s >= idle) {
+        signal_sleep(state, s, timeout_ms);
+        s = signal_load(state);
+    }
+    signal_store(sleeping, 0);
+    return s;
+}
+
+// Worker: marks its request done with an idle state and wakes the main
+// process if it sleeps
+void signal_post_done(uint32_t* buf, int worker, uint32_t state) {
+    signal_store(signal_state(buf, worker), state);
+    __atomic_fetch_add(&buf[SIGNAL_COMPLETIONS], 1, __ATOMIC_SEQ_CST);
+    if (signal_load(&buf[SIGNAL_MAIN_SLEEPING])) {
+        signal_wake(&buf[SIGNAL_COMPLETIONS], 1);
+    }
+}
+
+int signal_count_ready(uint32_t* buf, const int* workers, int n, uint32_t idle) {
+    int ready = 0;
+    for (int i = 0; i < n; i++) {
+        ready += signal_load(signal_state(buf, workers[i])) >= idle;
+    }
+    return ready;
+}
+
+// Main process: waits until at least k of the listed workers are idle, or
+// timeout_ms passes. Returns how many are idle
+int signal_wait_ready(uint32_t* buf, const int* workers, int n, int k,
+        uint32_t idle, int timeout_ms) {
+    uint32_t* completions = &buf[SIGNAL_COMPLETIONS];
+    uint32_t* sleeping = &buf[SIGNAL_MAIN_SLEEPING];
+    int ready = 0;
+    for (int i = 0; i < SIGNAL_SPIN; i++) {
+        ready = signal_count_ready(buf, workers, n, idle);
+        if (ready >= k) return ready;
+        signal_pause();
+    }
+    double deadline = signal_now_ms() + timeout_ms;
+    while (1) {
+        uint32_t seen = signal_load(completions);
+        signal_store(sleeping, 1);
+        ready = signal_count_ready(buf, workers, n, idle);
+        if (ready >= k) break;
+        int remaining = (int)(deadline - signal_now_ms());
+        if (remaining <= 0) break;
+        signal_sleep(completions, seen, remaining);
+    }
+    signal_store(sleeping, 0);
+    return ready;
+}
@@ -400,15 +400,12 @@ class PuffeRL:
             profile('train_misc', epoch, nest=True)
             self.amp_context.__enter__()
 
-            shape = self.values.shape
-            advantages = torch.zeros(shape, device=device)
-            advantages = compute_puff_advantage(self.values, self.rewards,
-                self.terminals, self.ratio, advantages, config['gamma'],
-                config['gae_lambda'], config['vtrace_rho_clip'], config['vtrace_c_clip'])
+            advantages, returns, prio_weights = compute_puff_advantage_fused(
+                self.values, self.rewards, self.terminals, self.ratio,
+                config['gamma'], config['gae_lambda'], config['vtrace_rho_clip'],
+                config['vtrace_c_clip'], a)
 
             profile('train_copy', epoch)
-            adv = advantages.abs().sum(axis=1)
-            prio_weights = torch.nan_to_num(adv**a, 0, 0, 0)
             prio_probs = (prio_weights + 1e-6)/(prio_weights.sum() + 1e-6)
             idx = torch.multinomial(prio_probs, self.minibatch_segments)
             mb_prio = (self.segments*prio_probs[idx, None])**-anneal_beta
@@ -420,7 +417,7 @@ class PuffeRL:
             mb_truncations = self.truncations[idx]
             mb_ratio = self.ratio[idx]
             mb_values = self.values[idx]
-            mb_returns = advantages[idx] + mb_values
+            mb_returns = returns[idx]
             mb_advantages = advantages[idx]
 
             profile('train_forward', epoch)
@@ -726,6 +723,30 @@ def compute_puff_advantage(values, rewards, terminals,
     return advantages
 
 
+def compute_puff_advantage_fused(values, rewards, terminals, ratio,
+        gamma, gae_lambda, vtrace_rho_clip, vtrace_c_clip, prio_alpha):
+    '''Advantages, returns and per-segment priority weights in one pass.
+    Same CPU fallback as compute_puff_advantage.'''
+    device = values.device
+    if not ADVANTAGE_CUDA:
+        values = values.cpu()
+        rewards = rewards.cpu()
+        terminals = terminals.cpu()
+        ratio = ratio.cpu()
+
+    advantages = torch.empty_like(values)
+    returns = torch.empty_like(values)
+    priorities = torch.empty(values.shape[0], device=values.device)
+    torch.ops.pufferlib.compute_puff_advantage_fused(values, rewards, terminals,
+        ratio, advantages, returns, priorities, gamma, gae_lambda,
+        vtrace_rho_clip, vtrace_c_clip, prio_alpha)
+
+    if not ADVANTAGE_CUDA:
+        return advantages.to(device), returns.to(device), priorities.to(device)
+
+    return advantages, returns, priorities
+
+
 def abbreviate(num, b2, c2):
     if num < 1e3:
         return str(num)
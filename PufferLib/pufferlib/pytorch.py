@@ -10,6 +10,13 @@ from torch.distributions.utils import logits_to_probs
 
 import pufferlib
 import pufferlib.models
+try:
+    from pufferlib import _C
+except ImportError:
+    pass
+
+# Registered by the pufferlib._C extension, which is optional here
+HAS_UNPACK_BITFIELDS_OP = hasattr(torch.ops.pufferlib, 'unpack_bitfields')
 
 
 numpy_to_torch_dtype_dict = {
@@ -162,6 +169,27 @@ def _flattened_tensor_size(native_dtype):
             res += _flattened_tensor_size(dtype)
         return res
 
+def unpack_bitfields(packed, group_bytes, num_groups, fields):
+    '''Unpacks observations from the packed mode of Ocean envs, on the
+    device they are on. Rows hold num_groups groups of group_bytes bytes,
+    and fields lists the (byte offset, shift, bits) of each field of a group.
+    Returns [batch, num_groups*len(fields)] uint8, the env's unpacked layout.
+    Uses the pufferlib extension op when it is built for the device and
+    plain torch ops otherwise. Only a missing kernel falls back; errors
+    raised by the kernel itself propagate'''
+    if HAS_UNPACK_BITFIELDS_OP:
+        offsets, shifts, bits = (list(f) for f in zip(*fields))
+        try:
+            return torch.ops.pufferlib.unpack_bitfields(
+                packed, group_bytes, num_groups, offsets, shifts, bits)
+        except NotImplementedError:
+            pass # e.g. a CPU-only build given a CUDA tensor
+
+    batch = packed.shape[0]
+    groups = packed[:, :group_bytes*num_groups].reshape(batch, num_groups, group_bytes)
+    unpacked = [(groups[:, :, o] >> s) & ((1 << b) - 1) for o, s, b in fields]
+    return torch.stack(unpacked, dim=2).view(batch, -1)
+
 def layer_init(layer, std=np.sqrt(2), bias_const=0.0):
     """CleanRL's default layer initialization"""
     torch.nn.init.orthogonal_(layer.weight, std)
@@ -11,6 +11,13 @@ from pufferlib import PufferEnv, set_buffers
 import pufferlib.spaces
 import gymnasium
 
+# Futex wait/notify between Multiprocessing workers and the main process.
+# Without the extension, both sides poll the same shared state words
+try:
+    from pufferlib import worker_signal
+except ImportError:
+    worker_signal = None
+
 RESET = 0
 STEP = 1
 SEND = 2
@@ -19,6 +26,17 @@ CLOSE = 4
 MAIN = 5
 INFO = 6
 
+# Shared worker states, one per 64 byte line after a header line, as laid
+# out by worker_signal.h. States >= MAIN mean the worker is idle
+SIGNAL_LINE = 16
+
+def signal_words(num_workers):
+    return (num_workers + 1) * SIGNAL_LINE
+
+def signal_states(shm_signals, num_workers):
+    return np.ndarray(num_workers, dtype=np.int32, buffer=shm_signals,
+        offset=4*SIGNAL_LINE, strides=(4*SIGNAL_LINE,))
+
 def recv_precheck(vecenv):
     if vecenv.flag != RECV:
         raise pufferlib.APIUsageError('Call reset before stepping')
@@ -192,7 +210,8 @@ def _worker_process(env_creators, env_args, env_kwargs, obs_shape, obs_dtype, at
     else:
         envs = Serial(env_creators, env_args, env_kwargs, num_envs, buf=buf, seed=seed*num_envs)
 
-    semaphores=np.ndarray(num_workers, dtype=np.uint8, buffer=shm['semaphores'])
+    signals = shm['semaphores']
+    semaphores = signal_states(signals, num_workers)
     notify=np.ndarray(num_workers, dtype=bool, buffer=shm['notify'])
     start = time.time()
     while True:
@@ -200,13 +219,21 @@ def _worker_process(env_creators, env_args, env_kwargs, obs_shape, obs_dtype, at
             envs.notify()
             notify[worker_idx] = False
 
-        sem = semaphores[worker_idx]
-        if sem >= MAIN:
-            if time.time() - start > 0.5:
-                time.sleep(0.01)
-            continue
+        if worker_signal is not None:
+            # Spins briefly, then sleeps until the main process posts work.
+            # The timeout keeps notify responsive while idle
+            sem = worker_signal.wait_request(signals, worker_idx, MAIN, 100)
+            if sem >= MAIN:
+                continue
+        else:
+            sem = semaphores[worker_idx]
+            if sem >= MAIN:
+                if time.time() - start > 0.5:
+                    time.sleep(0.01)
+                continue
+
+            start = time.time()
 
-        start = time.time()
         if sem == RESET:
             seed = recv_pipe.recv()
             _, infos = envs.reset(seed=seed)
@@ -217,11 +244,14 @@ def _worker_process(env_creators, env_args, env_kwargs, obs_shape, obs_dtype, at
             send_pipe.send(None)
             break
 
+        done = INFO if infos else MAIN
+        if worker_signal is not None:
+            worker_signal.post_done(signals, worker_idx, done)
+        else:
+            semaphores[worker_idx] = done
+
         if infos:
-            semaphores[worker_idx] = INFO
             send_pipe.send(infos)
-        else:
-            semaphores[worker_idx] = MAIN
 
 class Multiprocessing:
     '''Runs environments in parallel using multiprocessing
@@ -304,7 +334,7 @@ class Multiprocessing:
             terminals=RawArray('b', num_agents),
             truncateds=RawArray('b', num_agents),
             masks=RawArray('b', num_agents),
-            semaphores=RawArray('c', num_workers),
+            semaphores=RawArray('i', signal_words(num_workers)),
             notify=RawArray('b', num_workers),
         )
         shape = (num_workers, agents_per_worker)
@@ -319,10 +349,15 @@ class Multiprocessing:
             terminals=np.ndarray(shape, dtype=bool, buffer=self.shm['terminals']),
             truncations=np.ndarray(shape, dtype=bool, buffer=self.shm['truncateds']),
             masks=np.ndarray(shape, dtype=bool, buffer=self.shm['masks']),
-            semaphores=np.ndarray(num_workers, dtype=np.uint8, buffer=self.shm['semaphores']),
+            semaphores=signal_states(self.shm['semaphores'], num_workers),
             notify=np.ndarray(num_workers, dtype=bool, buffer=self.shm['notify']),
         )
-        self.buf['semaphores'][:] = MAIN 
+        if worker_signal is not None:
+            worker_signal.init(self.shm['semaphores'], num_workers, MAIN)
+        else:
+            self.buf['semaphores'][:] = MAIN
+
+        self.worker_ids = np.arange(num_workers, dtype=np.int32)
 
         from multiprocessing import Pipe, Process
         self.send_pipes, w_recv_pipes = zip(*[Pipe() for _ in range(num_workers)])
@@ -353,13 +388,30 @@ class Multiprocessing:
         self.ready_workers = []
         self.waiting_workers = []
 
+    def _post(self, idxs, request):
+        if worker_signal is not None:
+            worker_signal.post(self.shm['semaphores'],
+                np.ascontiguousarray(self.worker_ids[idxs]), request)
+        else:
+            self.buf['semaphores'][idxs] = request
+
+    def _wait_ready(self, workers, k=1):
+        '''Sleeps until k of workers are idle. Polls without the extension'''
+        if worker_signal is not None:
+            worker_signal.wait_ready(self.shm['semaphores'],
+                np.asarray(workers, dtype=np.int32), k, MAIN, 100)
+
     def recv(self):
         recv_precheck(self)
+        misses = 0
         while True:
             # Bandaid patch for new experience buffer desync
             if self.sync_traj:
                 worker = self.waiting_workers[0]
                 sem = self.buf['semaphores'][worker]
+                if sem < MAIN:
+                    self._wait_ready([worker])
+                    sem = self.buf['semaphores'][worker]
                 if sem >= MAIN:
                     self.waiting_workers.pop(0)
                     self.ready_workers.append(worker)
@@ -368,8 +420,19 @@ class Multiprocessing:
                 sem = self.buf['semaphores'][worker]
                 if sem >= MAIN:
                     self.ready_workers.append(worker)
+                    misses = 0
                 else:
                     self.waiting_workers.append(worker)
+                    misses += 1
+
+                # A full pass found nothing new, sleep until enough
+                # workers finish to make progress
+                if self.waiting_workers and misses >= len(self.waiting_workers):
+                    needed = 1
+                    if not self.zero_copy and self.workers_per_batch < self.num_workers:
+                        needed = max(1, self.workers_per_batch - len(self.ready_workers))
+                    self._wait_ready(self.waiting_workers, needed)
+                    misses = 0
 
             if sem == INFO:
                 self.infos[worker] = self.recv_pipes[worker].recv()
@@ -450,7 +513,7 @@ class Multiprocessing:
         
         idxs = self.w_slice
         self.actions[idxs] = actions
-        self.buf['semaphores'][idxs] = STEP
+        self._post(idxs, STEP)
 
     def async_reset(self, seed=0):
         # Flush any waiting workers
@@ -473,7 +536,7 @@ class Multiprocessing:
         self.waiting_workers = list(range(self.num_workers))
         self.infos = [[] for _ in range(self.num_workers)]
 
-        self.buf['semaphores'][:] = RESET
+        self._post(slice(None), RESET)
         for i in range(self.num_workers):
             start = i*self.envs_per_worker
             end = (i+1)*self.envs_per_worker
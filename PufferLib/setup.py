@@ -213,6 +213,14 @@ if not NO_OCEAN:
             c_ext.include_dirs.append('/usr/local/include')
             c_ext.extra_link_args.extend(['-L/usr/local/lib', '-llammps'])
 
+# Worker wait/notify for vector.Multiprocessing, needed with or without ocean
+c_extensions.append(Extension(
+    'pufferlib.worker_signal',
+    sources=['pufferlib/ocean/worker_signal.c'],
+    extra_compile_args=extra_compile_args,
+    extra_link_args=extra_link_args,
+))
+
 # Check if CUDA compiler is available. You need cuda dev, not just runtime.
 torch_extensions = []
 if not NO_TRAIN:
@@ -0,0 +1,197 @@
+// Microbenchmark for battle compute_observations: the unit grid with top k
+// selection against the original per agent distance pass and qsort,
+// sweeping num_agents and num_armies. "reset" times units stacked on their
+// bases right after c_reset, "spread" units scattered over the arena.
+// Exits non-zero if any observation differs from the original's.
+// Build: gcc -O2 -I./raylib-5.5_linux_amd64/include -I./pufferlib/ocean/battle tests/bench_battle_obs.c -o bench_battle_obs ./raylib-5.5_linux_amd64/lib/libraylib.a -lm -lpthread -ldl
+// Run: ./bench_battle_obs
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "battle.h"
+
+// Original implementation from battle.h
+typedef struct {
+    float distance;
+    float dx;
+    float dy;
+    float dz;
+    float same_team;
+    int idx;
+} AgentObs;
+
+int compare_agent_obs(const void* a, const void* b) {
+    AgentObs* oa = (AgentObs*)a;
+    AgentObs* ob = (AgentObs*)b;
+    if (oa->distance < ob->distance) {
+        return -1;
+    } else if (oa->distance > ob->distance) {
+        return 1;
+    }
+    return 0;
+}
+
+void ref_compute_observations(Battle* env) {
+    AgentObs agent_obs[env->num_agents];
+
+    int obs_idx = 0;
+    for (int a=0; a<env->num_agents/2; a++) {
+        // Distance to each base
+        Entity* agent = &env->agents[a];
+        float dists[env->num_armies];
+        for (int i=0; i<env->num_armies; i++) {
+            dists[i] = 999999;
+        }
+        for (int f=0; f<env->num_armies; f++) {
+            Entity* base = &env->bases[f];
+            float dx = base->x - agent->x;
+            float dy = base->y - agent->y;
+            float dz = base->z - agent->z;
+            float dd = dx*dx + dy*dy + dz*dz;
+            int type = f % env->num_armies;
+            if (dd < dists[type]) {
+                dists[type] = dd;
+                env->observations[obs_idx + 3*type] = dx;
+                env->observations[obs_idx + 3*type + 1] = dy;
+                env->observations[obs_idx + 3*type + 2] = dz;
+            }
+        }
+        obs_idx += 3*env->num_armies;
+
+        // Distance to each agent. Slow O(n^2) naive implementation
+        float x = agent->x;
+        float y = agent->y;
+        float z = agent->z;
+        for (int i=0; i<env->num_agents; i++) {
+            Entity* other = &env->agents[i];
+            float dx = other->x - x;
+            float dy = other->y - y;
+            float dz = other->z - z;
+            float distance = dx*dx + dy*dy + dz*dz;
+            AgentObs* o = &agent_obs[i];
+            o->dx = dx;
+            o->dy = dy;
+            o->dz = dz;
+            if (other->army == agent->army) {
+                o->same_team = 1.0f;
+                o->distance = 99999.0f;
+            } else {
+                o->same_team = 0.0f;
+                o->distance = distance;
+            }
+            o->idx = i;
+        }
+        qsort(agent_obs, env->num_agents, sizeof(AgentObs), compare_agent_obs);
+
+        for (int i=0; i<AGENT_OBS; i++) {
+            env->observations[obs_idx++] = agent_obs[i].dx;
+            env->observations[obs_idx++] = agent_obs[i].dy;
+            env->observations[obs_idx++] = agent_obs[i].dz;
+            env->observations[obs_idx++] = agent_obs[i].same_team;
+        }
+
+        // Individual agent stats
+        env->observations[obs_idx++] = agent->vx/MAX_SPEED;
+        env->observations[obs_idx++] = agent->vy/MAX_SPEED;
+        env->observations[obs_idx++] = agent->vz/MAX_SPEED;
+        env->observations[obs_idx++] = agent->orientation.w;
+        env->observations[obs_idx++] = agent->orientation.x;
+        env->observations[obs_idx++] = agent->orientation.y;
+        env->observations[obs_idx++] = agent->orientation.z;
+        env->observations[obs_idx++] = agent->x;
+        env->observations[obs_idx++] = agent->y;
+        env->observations[obs_idx++] = agent->z;
+        env->observations[obs_idx++] = agent->y - ground_height(env, agent->x, agent->z);
+        env->observations[obs_idx++] = abs(agent->x) - 0.95f*env->size_x;
+        env->observations[obs_idx++] = abs(agent->z) - 0.95f*env->size_z;
+        env->observations[obs_idx++] = abs(agent->y) - 0.95f*env->size_y;
+        env->observations[obs_idx++] = agent->speed;
+        env->observations[obs_idx++] = agent->health;
+        env->observations[obs_idx++] = agent->max_turn;
+        env->observations[obs_idx++] = agent->max_speed;
+        env->observations[obs_idx++] = agent->attack_damage;
+        env->observations[obs_idx++] = agent->attack_range;
+        env->observations[obs_idx++] = env->rewards[a];
+        env->observations[obs_idx++] = env->terminals[a];
+
+        memset(&env->observations[obs_idx], 0, 8*sizeof(float));
+        env->observations[obs_idx + agent->unit] = 1.0f;
+        obs_idx += 8;
+    }
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Returns the number of observations that differ from the original's
+int bench(Battle* env, const char* name, float* ref_obs, int num_obs) {
+    int iters = 1 + (1 << 24)/(env->num_agents*env->num_agents);
+    double start = now();
+    for (int it=0; it<iters; it++) {
+        ref_compute_observations(env);
+    }
+    double ref_us = 1e6*(now() - start)/iters;
+    memcpy(ref_obs, env->observations, num_obs*sizeof(float));
+
+    start = now();
+    for (int it=0; it<iters; it++) {
+        compute_observations(env);
+    }
+    double grid_us = 1e6*(now() - start)/iters;
+
+    int mismatches = 0;
+    for (int i=0; i<num_obs; i++) {
+        mismatches += (ref_obs[i] != env->observations[i]);
+    }
+    printf("%4d agents %d armies %-6s | qsort %9.1f us | grid %7.1f us (%5.1fx) %s\n",
+        env->num_agents, env->num_armies, name, ref_us, grid_us, ref_us/grid_us,
+        mismatches ? "MISMATCH" : "");
+    return mismatches;
+}
+
+int main() {
+    int sizes[] = {64, 128, 256, 512, 1024, 2048, 4096};
+    int armies[] = {2, 4, 8};
+    int mismatches = 0;
+    for (int a=0; a<3; a++) {
+        for (int s=0; s<7; s++) {
+            Battle env = {
+                .size_x = 4,
+                .size_y = 1,
+                .size_z = 4,
+                .num_agents = sizes[s],
+                .num_armies = armies[a],
+            };
+            puffer_rng_seed(&env.rng, 42);
+            init(&env);
+            int num_obs = env.num_agents/2*(3*env.num_armies + 4*AGENT_OBS + 22 + 8);
+            env.observations = calloc(num_obs, sizeof(float));
+            env.actions = calloc(3*env.num_agents, sizeof(float));
+            env.rewards = calloc(env.num_agents, sizeof(float));
+            env.terminals = calloc(env.num_agents, sizeof(unsigned char));
+            float* ref_obs = calloc(num_obs, sizeof(float));
+
+            c_reset(&env);
+            mismatches += bench(&env, "reset", ref_obs, num_obs);
+            for (int i=0; i<env.num_agents; i++) {
+                Entity* agent = &env.agents[i];
+                agent->x = randf(&env.rng, -env.size_x, env.size_x);
+                agent->z = randf(&env.rng, -env.size_z, env.size_z);
+                agent->y = randf(&env.rng, ground_height(&env, agent->x, agent->z), env.size_y);
+            }
+            mismatches += bench(&env, "spread", ref_obs, num_obs);
+
+            free(ref_obs);
+            free(env.observations);
+            free(env.actions);
+            free(env.rewards);
+            free(env.terminals);
+            free(env.terrain);
+            c_close(&env);
+        }
+    }
+    return mismatches != 0;
+}
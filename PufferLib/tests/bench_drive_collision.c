@@ -0,0 +1,170 @@
+// Microbenchmark for drive vehicle collisions: the broadphase in
+// broadphase.h against the original linear scan over all cars with
+// check_aabb_collision. First on a map stepped with random actions, where
+// every agent's result must match, then on synthetic scenes of 64 to 512
+// cars to show how each scales with scene density, where every query must
+// match too. Exits non-zero on any mismatch.
+// Build: gcc -O2 -I./raylib-5.5_linux_amd64/include -I./pufferlib/ocean/drive tests/bench_drive_collision.c -o bench_drive_collision ./raylib-5.5_linux_amd64/lib/libraylib.a -lm -lpthread -ldl
+// Run: ./bench_drive_collision [resources/drive/map_942.bin]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "drive.h"
+
+#define STEPS 91
+#define ITERS 50
+#define SCENE_QUERIES 64
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Vehicle part of collision_check before the broadphase
+int ref_first_car(Drive* env, Entity* agent, int agent_idx) {
+    for(int i = 0; i < MAX_CARS; i++){
+        int index = -1;
+        if(i < env->active_agent_count){
+            index = env->active_agent_indices[i];
+        } else if (i < env->num_cars){
+            index = env->static_car_indices[i - env->active_agent_count];
+        }
+        if(index == -1) continue;
+        if(index == agent_idx) continue;
+        Entity* entity = &env->entities[index];
+        float x1 = entity->x;
+        float y1 = entity->y;
+        float dist = ((x1 - agent->x)*(x1 - agent->x) + (y1 - agent->y)*(y1 - agent->y));
+        if(dist > 225.0f) continue;
+        if(check_aabb_collision(agent, entity)) {
+            return index;
+        }
+    }
+    return -1;
+}
+
+int first_car(Drive* env, Entity* agent, int agent_idx) {
+    int slot = broadphase_first_overlap(&env->car_broadphase, agent->x, agent->y,
+        agent->heading_x, agent->heading_y, agent->length, agent->width, 15.0f, agent_idx);
+    return (slot == -1) ? -1 : env->car_broadphase.ids[slot];
+}
+
+int bench_map(const char* path) {
+    Drive env = {.map_name = (char*)path};
+    allocate(&env);
+    int n = env.active_agent_count;
+    double ref_time = 0;
+    double new_time = 0;
+    int mismatches = 0;
+    int collisions = 0;
+    puffer_rng_seed(&env.rng, 7);
+    c_reset(&env);
+    for (int t = 0; t < STEPS - 1; t++) {
+        for (int i = 0; i < 2*n; i++) {
+            env.actions[i] = puffer_randint(&env.rng, 0, 7);
+        }
+        c_step(&env);
+        int ref[n], got[n];
+        double start = now();
+        for (int it = 0; it < ITERS; it++) {
+            for (int i = 0; i < n; i++) {
+                int agent_idx = env.active_agent_indices[i];
+                ref[i] = ref_first_car(&env, &env.entities[agent_idx], agent_idx);
+            }
+        }
+        ref_time += now() - start;
+        start = now();
+        for (int it = 0; it < ITERS; it++) {
+            update_car_broadphase(&env);
+            for (int i = 0; i < n; i++) {
+                int agent_idx = env.active_agent_indices[i];
+                got[i] = first_car(&env, &env.entities[agent_idx], agent_idx);
+            }
+        }
+        new_time += now() - start;
+        for (int i = 0; i < n; i++) {
+            mismatches += ref[i] != got[i];
+            collisions += ref[i] != -1;
+        }
+    }
+    int steps = (STEPS - 1)*ITERS;
+    printf("map: %d agents %d cars | scan %6.2f us | broadphase %6.2f us per step | %d collisions, %d mismatched %s\n",
+        n, env.num_cars, 1e6*ref_time/steps, 1e6*new_time/steps, collisions, mismatches,
+        mismatches ? "MISMATCH" : "ok");
+    free_allocated(&env);
+    return mismatches;
+}
+
+// Random cars in a square sized for a roughly constant density of one car
+// per 60 m^2, so most cars have a few neighbours and some overlap
+int bench_scene(int count) {
+    Entity* cars = calloc(count, sizeof(Entity));
+    float side = sqrtf(60.0f*count);
+    PufferRng rng;
+    puffer_rng_seed(&rng, count);
+    for (int i = 0; i < count; i++) {
+        cars[i].x = side*puffer_randf(&rng);
+        cars[i].y = side*puffer_randf(&rng);
+        cars[i].heading = 2*PI*puffer_randf(&rng);
+        cars[i].heading_x = cosf(cars[i].heading);
+        cars[i].heading_y = sinf(cars[i].heading);
+        cars[i].length = 4.0f + 2.0f*puffer_randf(&rng);
+        cars[i].width = 1.8f + 0.4f*puffer_randf(&rng);
+    }
+    Broadphase bp;
+    broadphase_init(&bp, count);
+    int ref[SCENE_QUERIES], got[SCENE_QUERIES];
+    double start = now();
+    for (int it = 0; it < ITERS; it++) {
+        for (int q = 0; q < SCENE_QUERIES; q++) {
+            ref[q] = -1;
+            for (int i = 0; i < count; i++) {
+                if (i == q) continue;
+                float dx = cars[i].x - cars[q].x;
+                float dy = cars[i].y - cars[q].y;
+                if (dx*dx + dy*dy > 225.0f) continue;
+                if (check_aabb_collision(&cars[q], &cars[i])) {
+                    ref[q] = i;
+                    break;
+                }
+            }
+        }
+    }
+    double ref_us = 1e6*(now() - start)/ITERS;
+    start = now();
+    for (int it = 0; it < ITERS; it++) {
+        broadphase_begin(&bp, count);
+        for (int i = 0; i < count; i++) {
+            broadphase_set(&bp, i, i, cars[i].x, cars[i].y, cars[i].heading_x,
+                cars[i].heading_y, cars[i].length, cars[i].width);
+        }
+        broadphase_sort(&bp);
+        for (int q = 0; q < SCENE_QUERIES; q++) {
+            got[q] = broadphase_first_overlap(&bp, cars[q].x, cars[q].y, cars[q].heading_x,
+                cars[q].heading_y, cars[q].length, cars[q].width, 15.0f, q);
+        }
+    }
+    double new_us = 1e6*(now() - start)/ITERS;
+    int mismatches = 0;
+    int collisions = 0;
+    for (int q = 0; q < SCENE_QUERIES; q++) {
+        mismatches += ref[q] != got[q];
+        collisions += ref[q] != -1;
+    }
+    printf("scene: %d agents %3d cars | scan %6.2f us | broadphase %6.2f us per step | %d collisions, %d mismatched %s\n",
+        SCENE_QUERIES, count, ref_us, new_us, collisions, mismatches,
+        mismatches ? "MISMATCH" : "ok");
+    broadphase_free(&bp);
+    free(cars);
+    return mismatches;
+}
+
+int main(int argc, char** argv) {
+    const char* path = (argc > 1) ? argv[1] : "resources/drive/map_942.bin";
+    int failed = bench_map(path) != 0;
+    for (int count = 64; count <= 512; count *= 2) {
+        failed |= bench_scene(count) != 0;
+    }
+    return failed;
+}
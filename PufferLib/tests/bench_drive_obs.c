@@ -0,0 +1,192 @@
+// Microbenchmark for drive compute_observations: the lane version against
+// the original scalar loop with its full memset, on a map stepped with
+// random actions so cars spread out. Observations must match exactly: exits
+// non-zero if any step's lane observations differ from the scalar ones.
+// Build: gcc -O2 -I./raylib-5.5_linux_amd64/include -I./pufferlib/ocean/drive tests/bench_drive_obs.c -o bench_drive_obs ./raylib-5.5_linux_amd64/lib/libraylib.a -lm -lpthread -ldl
+// Run: ./bench_drive_obs [resources/drive/map_942.bin]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "drive.h"
+
+#define STEPS 91
+#define ITERS 20
+
+// Original implementation from drive.h
+void ref_compute_observations(Drive* env) {
+    int max_obs = 7 + 7*(MAX_CARS - 1) + 7*MAX_ROAD_SEGMENT_OBSERVATIONS;
+    memset(env->observations, 0, max_obs*env->active_agent_count*sizeof(float));
+    float (*observations)[max_obs] = (float(*)[max_obs])env->observations; 
+    for(int i = 0; i < env->active_agent_count; i++) {
+        float* obs = &observations[i][0];
+        Entity* ego_entity = &env->entities[env->active_agent_indices[i]];
+        if(ego_entity->type > 3) break;
+        if(ego_entity->respawn_timestep != -1) {
+            obs[6] = 1;
+            //continue;
+        }
+        float ego_heading = ego_entity->heading;
+        float cos_heading = ego_entity->heading_x;
+        float sin_heading = ego_entity->heading_y;
+        float ego_speed = sqrtf(ego_entity->vx*ego_entity->vx + ego_entity->vy*ego_entity->vy);
+        // Set goal distances
+        float goal_x = ego_entity->goal_position_x - ego_entity->x;
+        float goal_y = ego_entity->goal_position_y - ego_entity->y;
+        // Rotate to ego vehicle's frame
+        float rel_goal_x = goal_x*cos_heading + goal_y*sin_heading;
+        float rel_goal_y = -goal_x*sin_heading + goal_y*cos_heading;
+        //obs[0] = normalize_value(rel_goal_x, MIN_REL_GOAL_COORD, MAX_REL_GOAL_COORD);
+        //obs[1] = normalize_value(rel_goal_y, MIN_REL_GOAL_COORD, MAX_REL_GOAL_COORD);
+        obs[0] = rel_goal_x* 0.005f;
+        obs[1] = rel_goal_y* 0.005f;
+        //obs[2] = ego_speed / MAX_SPEED;
+        obs[2] = ego_speed * 0.01f;
+        obs[3] = ego_entity->width / MAX_VEH_WIDTH;
+        obs[4] = ego_entity->length / MAX_VEH_LEN;
+        obs[5] = (ego_entity->collision_state > 0) ? 1 : 0;
+        
+        // Relative Pos of other cars
+        int obs_idx = 7;  // Start after goal distances
+        int cars_seen = 0;
+        for(int j = 0; j < MAX_CARS; j++) {
+            int index = -1;
+            if(j < env->active_agent_count){
+                index = env->active_agent_indices[j];
+            } else if (j < env->num_cars){
+                index = env->static_car_indices[j - env->active_agent_count];
+            } 
+            if(index == -1) continue;
+            if(env->entities[index].type > 3) break;
+            if(index == env->active_agent_indices[i]) continue;  // Skip self, but don't increment obs_idx
+            Entity* other_entity = &env->entities[index];
+            if(ego_entity->respawn_timestep != -1) continue;
+            if(other_entity->respawn_timestep != -1) continue;
+            // Store original relative positions
+            float dx = other_entity->x - ego_entity->x;
+            float dy = other_entity->y - ego_entity->y;
+            float dist = (dx*dx + dy*dy);
+            if(dist > 2500.0f) continue;
+            // Rotate to ego vehicle's frame
+            float rel_x = dx*cos_heading + dy*sin_heading;
+            float rel_y = -dx*sin_heading + dy*cos_heading;
+            // Store observations with correct indexing
+            obs[obs_idx] = rel_x * 0.02f;
+            obs[obs_idx + 1] = rel_y * 0.02f;
+            obs[obs_idx + 2] = other_entity->width / MAX_VEH_WIDTH;
+            obs[obs_idx + 3] = other_entity->length / MAX_VEH_LEN;
+            // relative heading
+            float rel_heading_x = other_entity->heading_x * ego_entity->heading_x + 
+                     other_entity->heading_y * ego_entity->heading_y;  // cos(a-b) = cos(a)cos(b) + sin(a)sin(b)
+            float rel_heading_y = other_entity->heading_y * ego_entity->heading_x - 
+                                other_entity->heading_x * ego_entity->heading_y;  // sin(a-b) = sin(a)cos(b) - cos(a)sin(b)
+
+            obs[obs_idx + 4] = rel_heading_x;
+            obs[obs_idx + 5] = rel_heading_y;
+            // obs[obs_idx + 4] = cosf(rel_heading) / MAX_ORIENTATION_RAD;
+            // obs[obs_idx + 5] = sinf(rel_heading) / MAX_ORIENTATION_RAD;
+            // // relative speed
+            float other_speed = sqrtf(other_entity->vx*other_entity->vx + other_entity->vy*other_entity->vy);
+            obs[obs_idx + 6] = other_speed / MAX_SPEED;
+            cars_seen++;
+            obs_idx += 7;  // Move to next observation slot
+        }
+        int remaining_partner_obs = (MAX_CARS - 1 - cars_seen) * 7;
+        memset(&obs[obs_idx], 0, remaining_partner_obs * sizeof(float));
+        obs_idx += remaining_partner_obs;
+        // map observations
+        int entity_list[MAX_ROAD_SEGMENT_OBSERVATIONS*2];  // Array big enough for all neighboring cells
+        int grid_idx = getGridIndex(env, ego_entity->x, ego_entity->y);
+        int list_size = get_neighbor_cache_entities(env, grid_idx, entity_list, MAX_ROAD_SEGMENT_OBSERVATIONS);
+        for(int k = 0; k < list_size; k++){
+            int entity_idx = entity_list[k*2];
+            int geometry_idx = entity_list[k*2+1];
+            Entity* entity = &env->entities[entity_idx];
+            float start_x = entity->traj_x[geometry_idx];
+            float start_y = entity->traj_y[geometry_idx];
+            float end_x = entity->traj_x[geometry_idx+1];
+            float end_y = entity->traj_y[geometry_idx+1];
+            float mid_x = (start_x + end_x) / 2.0f;
+            float mid_y = (start_y + end_y) / 2.0f;
+            float rel_x = mid_x - ego_entity->x;
+            float rel_y = mid_y - ego_entity->y;
+            float x_obs = rel_x*cos_heading + rel_y*sin_heading;
+            float y_obs = -rel_x*sin_heading + rel_y*cos_heading;
+            float length = relative_distance_2d(mid_x, mid_y, end_x, end_y);
+            float width = 0.1;
+            // Calculate angle from ego to midpoint (vector from ego to midpoint)
+            float dx = end_x - mid_x;
+            float dy = end_y - mid_y;
+            float dx_norm = dx;
+            float dy_norm = dy;
+            float hypot = sqrtf(dx*dx + dy*dy);
+            if(hypot > 0) {
+                dx_norm /= hypot;
+                dy_norm /= hypot;
+            }
+            // Compute sin and cos of relative angle directly without atan2f
+            float cos_angle = dx_norm*cos_heading + dy_norm*sin_heading;
+            float sin_angle = -dx_norm*sin_heading + dy_norm*cos_heading;
+            obs[obs_idx] = x_obs * 0.02f;
+            obs[obs_idx + 1] = y_obs * 0.02f;
+            obs[obs_idx + 2] = length / MAX_ROAD_SEGMENT_LENGTH;
+            obs[obs_idx + 3] = width / MAX_ROAD_SCALE;
+            obs[obs_idx + 4] = cos_angle;
+            obs[obs_idx + 5] = sin_angle;
+            obs[obs_idx + 6] = entity->type - 4.0f;
+            obs_idx += 7;
+        }
+        int remaining_obs = (MAX_ROAD_SEGMENT_OBSERVATIONS - list_size) * 7;
+        // Set the entire block to 0 at once
+        memset(&obs[obs_idx], 0, remaining_obs * sizeof(float));
+    }
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+int main(int argc, char** argv) {
+    const char* path = (argc > 1) ? argv[1] : "resources/drive/map_942.bin";
+    Drive env = {.map_name = (char*)path};
+    allocate(&env);
+    int num_obs = env.active_agent_count*(7 + 7*(MAX_CARS - 1) + 7*MAX_ROAD_SEGMENT_OBSERVATIONS);
+    float* ref_obs = calloc(num_obs, sizeof(float));
+
+    puffer_rng_seed(&env.rng, 42);
+    c_reset(&env);
+    double ref_us = 0;
+    double lane_us = 0;
+    int mismatches = 0;
+    for (int t = 0; t < STEPS; t++) {
+        for (int i = 0; i < 2*env.active_agent_count; i++) {
+            env.actions[i] = puffer_randint(&env.rng, 0, 7);
+        }
+        c_step(&env);
+
+        // Poison the buffer so unwritten slots show up as mismatches
+        memset(env.observations, 0xff, num_obs*sizeof(float));
+        double start = now();
+        for (int it = 0; it < ITERS; it++) {
+            compute_observations(&env);
+        }
+        lane_us += 1e6*(now() - start)/ITERS;
+
+        float* obs = env.observations;
+        env.observations = ref_obs;
+        start = now();
+        for (int it = 0; it < ITERS; it++) {
+            ref_compute_observations(&env);
+        }
+        ref_us += 1e6*(now() - start)/ITERS;
+        env.observations = obs;
+        mismatches += memcmp(obs, ref_obs, num_obs*sizeof(float)) != 0;
+    }
+    printf("%d agents %d cars | scalar %7.1f us | lanes %7.1f us (%.1fx) | %d of %d steps mismatched %s\n",
+        env.active_agent_count, env.num_cars, ref_us/STEPS, lane_us/STEPS,
+        ref_us/lane_us, mismatches, STEPS, mismatches ? "MISMATCH" : "ok");
+    free(ref_obs);
+    free_allocated(&env);
+    return mismatches != 0;
+}
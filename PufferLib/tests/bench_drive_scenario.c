@@ -0,0 +1,170 @@
+// Microbenchmark for drive map loading and env construction: the legacy per
+// entity fread binary against the memory mapped scenario format, with and
+// without the stored road index, and a check that envs built from each step
+// identically under the same actions. Converts the given legacy map to /tmp
+// first. "first env" pays for building or mapping the shared road index,
+// later envs on the same map reuse it. Exits non-zero if the shared road
+// index differs from one built per env or the rollouts differ.
+// Build: gcc -O2 -I./raylib-5.5_linux_amd64/include -I./pufferlib/ocean/drive tests/bench_drive_scenario.c -o bench_drive_scenario ./raylib-5.5_linux_amd64/lib/libraylib.a -lm -lpthread -ldl
+// Run: ./bench_drive_scenario [resources/drive/map_942.bin]
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "drive.h"
+
+#define SCENARIO_PATH "/tmp/bench_drive_scenario.scn"
+#define INDEXED_PATH "/tmp/bench_drive_scenario_indexed.scn"
+#define LOADS 1000
+#define ENVS 16
+#define STEPS 273
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+double bench_load(const char* path) {
+    double start = now();
+    for (int i = 0; i < LOADS; i++) {
+        Drive env = {.map_name = (char*)path};
+        load_map(&env);
+        free_map(&env);
+    }
+    return 1e6*(now() - start)/LOADS;
+}
+
+// Builds the road index the way every env did before it was shared
+double bench_build_index(const char* path) {
+    Drive env = {.map_name = (char*)path, .vision_range = VISION_RANGE};
+    load_map(&env);
+    double start = now();
+    build_road_index(&env);
+    double ms = 1e3*(now() - start);
+    free_road_index(&env);
+    free_map(&env);
+    return ms;
+}
+
+void bench_init(const char* name, const char* path) {
+    Drive envs[ENVS];
+    double start = now();
+    double first_ms = 0;
+    for (int i = 0; i < ENVS; i++) {
+        envs[i] = (Drive){.map_name = (char*)path};
+        allocate(&envs[i]);
+        if (i == 0) {
+            first_ms = 1e3*(now() - start);
+        }
+    }
+    double rest_ms = (1e3*(now() - start) - first_ms)/(ENVS - 1);
+    for (int i = 0; i < ENVS; i++) {
+        free_allocated(&envs[i]);
+    }
+    printf("init %-16s | first env %7.2f ms | later envs %6.2f ms\n", name, first_ms, rest_ms);
+}
+
+// Returns 1 if the road index an env on path uses differs from the one
+// build_road_index makes for the legacy map
+int check_road_index(const char* legacy_path, const char* path) {
+    Drive ref = {.map_name = (char*)legacy_path, .vision_range = VISION_RANGE};
+    load_map(&ref);
+    build_road_index(&ref);
+    Drive env = {.map_name = (char*)path};
+    allocate(&env);
+    int cells = ref.grid_cols*ref.grid_rows;
+    int mismatch = env.grid_cols != ref.grid_cols || env.grid_rows != ref.grid_rows
+        || env.vision_range != ref.vision_range
+        || memcmp(env.map_corners, ref.map_corners, 4*sizeof(float)) != 0
+        || memcmp(env.grid_cells, ref.grid_cells, (size_t)cells*SLOTS_PER_CELL*sizeof(int)) != 0
+        || memcmp(env.neighbor_offsets, ref.neighbor_offsets, 2*ref.vision_range*ref.vision_range*sizeof(int)) != 0
+        || memcmp(env.neighbor_cache_indices, ref.neighbor_cache_indices, (cells + 1)*sizeof(int)) != 0
+        || memcmp(env.neighbor_cache_entities, ref.neighbor_cache_entities,
+            ref.neighbor_cache_indices[cells]*sizeof(int)) != 0;
+    printf("road index vs per env build, %s: %s\n", path, mismatch ? "MISMATCH" : "ok");
+    free_allocated(&env);
+    free_road_index(&ref);
+    free_map(&ref);
+    return mismatch;
+}
+
+size_t trajectory_bytes(Drive* env) {
+    size_t bytes = 0;
+    for (int i = 0; i < env->num_entities; i++) {
+        Entity* e = &env->entities[i];
+        bytes += e->array_size*sizeof(float)*(is_object(e->type) ? 8 : 3);
+    }
+    return bytes;
+}
+
+size_t road_index_bytes(Drive* env) {
+    int cells = env->grid_cols*env->grid_rows;
+    return sizeof(int)*((size_t)cells*SLOTS_PER_CELL + 2*env->vision_range*env->vision_range
+        + cells + 1 + env->neighbor_cache_indices[cells]);
+}
+
+int rollout(Drive* legacy, Drive* scenario) {
+    int num_obs = legacy->active_agent_count*(7 + 7*(MAX_CARS - 1) + 7*MAX_ROAD_SEGMENT_OBSERVATIONS);
+    int mismatches = 0;
+    PufferRng rng;
+    puffer_rng_seed(&rng, 42);
+    puffer_rng_seed(&legacy->rng, 42);
+    puffer_rng_seed(&scenario->rng, 42);
+    c_reset(legacy);
+    c_reset(scenario);
+    for (int t = 0; t < STEPS; t++) {
+        for (int i = 0; i < 2*legacy->active_agent_count; i++) {
+            legacy->actions[i] = scenario->actions[i] = puffer_randint(&rng, 0, 7);
+        }
+        c_step(legacy);
+        c_step(scenario);
+        mismatches += memcmp(legacy->observations, scenario->observations, num_obs*sizeof(float)) != 0;
+        mismatches += memcmp(legacy->rewards, scenario->rewards, legacy->active_agent_count*sizeof(float)) != 0;
+    }
+    return mismatches;
+}
+
+int main(int argc, char** argv) {
+    const char* legacy_path = (argc > 1) ? argv[1] : "resources/drive/map_942.bin";
+    if (convert_map_binary(legacy_path, SCENARIO_PATH, 0) != 0
+            || convert_map_binary(legacy_path, INDEXED_PATH, 1) != 0) {
+        printf("Failed to convert %s\n", legacy_path);
+        return 1;
+    }
+
+    double legacy_us = bench_load(legacy_path);
+    double scenario_us = bench_load(SCENARIO_PATH);
+    printf("load: legacy %.1f us | scenario %.1f us (%.1fx)\n",
+        legacy_us, scenario_us, legacy_us/scenario_us);
+    printf("road index build: %.2f ms per env before sharing\n", bench_build_index(legacy_path));
+    bench_init("legacy", legacy_path);
+    bench_init("scenario", SCENARIO_PATH);
+    bench_init("scenario+index", INDEXED_PATH);
+
+    int failed = 0;
+    const char* paths[2] = {SCENARIO_PATH, INDEXED_PATH};
+    for (int p = 0; p < 2; p++) {
+        failed |= check_road_index(legacy_path, paths[p]);
+    }
+    for (int p = 0; p < 2; p++) {
+        Drive legacy = {.map_name = (char*)legacy_path};
+        Drive scenario = {.map_name = (char*)paths[p]};
+        allocate(&legacy);
+        allocate(&scenario);
+        if (scenario.scenario == NULL || legacy.active_agent_count != scenario.active_agent_count) {
+            printf("Scenario envs do not match the legacy env\n");
+            return 1;
+        }
+        if (p == 0) {
+            printf("shared per map: %zu trajectory bytes, %zu road index bytes\n",
+                trajectory_bytes(&legacy), road_index_bytes(&legacy));
+        }
+        int mismatches = rollout(&legacy, &scenario);
+        printf("rollout vs %s: %d of %d steps mismatched %s\n", paths[p], mismatches, STEPS,
+            mismatches ? "MISMATCH" : "ok");
+        failed |= mismatches != 0;
+        free_allocated(&legacy);
+        free_allocated(&scenario);
+    }
+    return failed;
+}
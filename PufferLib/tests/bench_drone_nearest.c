@@ -0,0 +1,110 @@
+// Microbenchmark for drone_pp nearest_drone: the uniform grid (rebuild
+// plus one query per agent, as in c_step) against the original all pairs
+// scan, sweeping num_agents to show the crossover. The grid is forced on
+// at every size so the crossover can be measured and every size checks the
+// grid against the scan. Exits non-zero if any query finds a farther drone.
+// Build: gcc -O2 -I./raylib-5.5_linux_amd64/include -I./pufferlib/ocean -I./pufferlib/ocean/drone_pp tests/bench_drone_nearest.c -o bench_drone_nearest -lm
+// Run: ./bench_drone_nearest
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#define DRONE_GRID_MIN_AGENTS 2
+#include "drone_pp.h"
+
+// Original implementation from drone_pp.h
+Drone* ref_nearest_drone(DronePP* env, Drone *agent) {
+    float min_dist = 999999.0f;
+    Drone *nearest = NULL;
+    for (int i = 0; i < env->num_agents; i++) {
+        Drone *other = &env->agents[i];
+        if (other == agent) {
+            continue;
+        }
+        float dx = agent->state.pos.x - other->state.pos.x;
+        float dy = agent->state.pos.y - other->state.pos.y;
+        float dz = agent->state.pos.z - other->state.pos.z;
+        float dist = sqrtf(dx*dx + dy*dy + dz*dz);
+        if (dist < min_dist) {
+            min_dist = dist;
+            nearest = other;
+        }
+    }
+    return nearest;
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Uniform over the spawn volume, or packed into a 4m cube
+void place_drones(DronePP* env, bool clustered) {
+    PufferRng* rng = &env->rng;
+    for (int i = 0; i < env->num_agents; i++) {
+        Vec3* pos = &env->agents[i].state.pos;
+        if (clustered) {
+            *pos = (Vec3){rndf(rng, -2, 2), rndf(rng, -2, 2), rndf(rng, -2, 2)};
+        } else {
+            *pos = (Vec3){rndf(rng, -MARGIN_X, MARGIN_X), rndf(rng, -MARGIN_Y, MARGIN_Y), rndf(rng, -MARGIN_Z, MARGIN_Z)};
+        }
+    }
+}
+
+// Returns the number of queries whose answer was farther than the scan's
+int bench(int num_agents, bool clustered) {
+    DronePP env = {0};
+    puffer_rng_seed(&env.rng, 42);
+    env.num_agents = num_agents;
+    env.max_rings = 1;
+    init(&env);
+    place_drones(&env, clustered);
+
+    int iters = 1 + (1 << 22)/(num_agents*num_agents);
+    Drone* sink = NULL;
+    double start = now();
+    for (int it = 0; it < iters; it++) {
+        for (int i = 0; i < num_agents; i++) {
+            sink = ref_nearest_drone(&env, &env.agents[i]);
+        }
+    }
+    double ref_us = 1e6*(now() - start)/iters;
+
+    start = now();
+    for (int it = 0; it < iters; it++) {
+        build_grid(&env);
+        for (int i = 0; i < num_agents; i++) {
+            sink = nearest_drone(&env, &env.agents[i]);
+        }
+    }
+    double grid_us = 1e6*(now() - start)/iters;
+
+    int mismatches = 0;
+    for (int i = 0; i < num_agents; i++) {
+        Drone* ref = ref_nearest_drone(&env, &env.agents[i]);
+        Drone* out = nearest_drone(&env, &env.agents[i]);
+        if (ref != out && norm3(sub3(ref->state.pos, env.agents[i].state.pos))
+                != norm3(sub3(out->state.pos, env.agents[i].state.pos))) {
+            mismatches++;
+        }
+    }
+
+    printf("%-9s %5d agents | scan %9.2f us | grid %8.2f us (%5.1fx) %s%s\n",
+        clustered ? "clustered" : "uniform", num_agents, ref_us, grid_us,
+        ref_us/grid_us, mismatches ? "MISMATCH" : "", sink == NULL ? "?" : "");
+    free(env.agents);
+    free(env.ring_buffer);
+    c_close(&env);
+    return mismatches;
+}
+
+int main() {
+    int sizes[] = {2, 4, 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096};
+    int mismatches = 0;
+    for (int clustered = 0; clustered < 2; clustered++) {
+        for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+            mismatches += bench(sizes[i], clustered);
+        }
+    }
+    return mismatches != 0;
+}
@@ -0,0 +1,116 @@
+// Microbenchmark for impulse_wars pathing: the tables initMaps builds once
+// per process against the original per env tables that moveTo filled lazily
+// with pathfindBFS. Every (destination, source) pair of cells on every map
+// must give the same step, with UINT8_MAX and 8 both meaning stop. Also
+// reports what each env used to allocate and initialize in initEnv. Exits
+// non-zero if any pair differs from either original.
+// Build: gcc -O2 -std=gnu2x -I./raylib-5.5_linux_amd64/include -I./box2d-linux-amd64/include -I./pufferlib/ocean/impulse_wars -I./pufferlib/ocean/impulse_wars/include tests/bench_impulse_wars_paths.c -o bench_impulse_wars_paths ./box2d-linux-amd64/libbox2d.a ./raylib-5.5_linux_amd64/lib/libraylib.a -lm -lpthread -ldl
+// Run: ./bench_impulse_wars_paths
+#include <stdio.h>
+#include <time.h>
+#include "env.h"
+
+#define ENVS 64
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Offset into the original per env table, indexed as if maps were square
+uint32_t ref_path_offset(const mapEntry *map, uint16_t src, uint16_t dest) {
+    const uint8_t srcCol = src % map->columns;
+    const uint8_t srcRow = src / map->columns;
+    const uint8_t destCol = dest % map->columns;
+    const uint8_t destRow = dest / map->columns;
+    return (destRow * map->rows * map->columns * map->rows) + (destCol * map->rows * map->columns) + (srcRow * map->columns) + srcCol;
+}
+
+// What initEnv allocated and initialized per env for every map
+uint8_t **ref_alloc_pathing(int8_t **buffers) {
+    uint8_t **paths = fastCalloc(NUM_MAPS, sizeof(uint8_t *));
+    for (uint8_t i = 0; i < NUM_MAPS; i++) {
+        const uint32_t cells = maps[i]->rows * maps[i]->columns;
+        paths[i] = fastMalloc(cells * cells);
+        memset(paths[i], UINT8_MAX, cells * cells);
+        buffers[i] = fastCalloc(3 * 8 * cells, sizeof(int8_t));
+    }
+    return paths;
+}
+
+void ref_free_pathing(uint8_t **paths, int8_t **buffers) {
+    for (uint8_t i = 0; i < NUM_MAPS; i++) {
+        fastFree(paths[i]);
+        fastFree(buffers[i]);
+    }
+    fastFree(paths);
+}
+
+int main() {
+    iwEnv *e = fastCalloc(1, sizeof(iwEnv));
+    initEnv(e, 2, 0, -1, 0, false, false, true, false, 1);
+    double start = now();
+    initMaps(e);
+    const double init_ms = 1e3*(now() - start);
+
+    size_t shared = 0;
+    long mismatches = 0;
+    long lazy_mismatches = 0;
+    int8_t *buffer = fastCalloc(3 * ((8 * MAX_CELLS) + 1), sizeof(int8_t));
+    uint8_t *slab = fastMalloc(MAX_CELLS);
+    for (uint8_t i = 0; i < NUM_MAPS; i++) {
+        setupMap(e, i);
+        const mapEntry *map = maps[i];
+        const uint16_t cells = map->rows * map->columns;
+        shared += cells * cells;
+
+        // the original BFS for each destination on its own, and the
+        // original table filled lazily in moveTo's order
+        uint8_t *lazy = fastMalloc(cells * cells);
+        memset(lazy, UINT8_MAX, cells * cells);
+        for (uint16_t dest = 0; dest < cells; dest++) {
+            memset(slab, UINT8_MAX, cells);
+            pathfindBFS(e, slab, buffer, dest);
+            for (uint16_t src = 0; src < cells; src++) {
+                uint8_t want = slab[src] > 8 ? 8 : slab[src];
+                uint8_t got = map->paths[mapPathIdx(map, src, dest)];
+                mismatches += want != (got > 8 ? 8 : got);
+
+                uint8_t old = lazy[ref_path_offset(map, src, dest)];
+                if (old == UINT8_MAX) {
+                    pathfindBFS(e, &lazy[ref_path_offset(map, 0, dest)], buffer, dest);
+                    old = lazy[ref_path_offset(map, src, dest)];
+                }
+                lazy_mismatches += (got > 8 ? 8 : got) != (old > 8 ? 8 : old);
+            }
+        }
+        fastFree(lazy);
+    }
+    fastFree(slab);
+    fastFree(buffer);
+
+    int8_t *buffers[NUM_MAPS];
+    start = now();
+    for (int i = 0; i < ENVS; i++) {
+        ref_free_pathing(ref_alloc_pathing(buffers), buffers);
+    }
+    const double ref_us = 1e6*(now() - start)/ENVS;
+    size_t per_env = 0;
+    for (uint8_t i = 0; i < NUM_MAPS; i++) {
+        const uint32_t cells = maps[i]->rows * maps[i]->columns;
+        per_env += cells * cells + 3 * 8 * cells;
+    }
+
+    printf("initMaps %.1f ms | shared paths %.2f MiB per process | was %.2f MiB and %.0f us per env\n",
+        init_ms, shared/1048576.0, per_env/1048576.0, ref_us);
+    const bool failed = mismatches != 0 || lazy_mismatches != 0;
+    printf("%ld pairs mismatched the BFS, %ld mismatched the lazily filled table %s\n",
+        mismatches, lazy_mismatches, failed ? "MISMATCH" : "ok");
+
+    setupEnv(e);
+    destroyEnv(e);
+    destroyMaps();
+    fastFree(e);
+    return failed;
+}
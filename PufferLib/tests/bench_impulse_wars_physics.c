@@ -0,0 +1,293 @@
+// Microbenchmark for impulse_wars threaded physics: first checks the task
+// pool in helpers.h with the two task shapes Box2D enqueues, parallel loops
+// over items and solver tasks where worker 0 drives stages the others spin
+// on, plus a world with every task slot in flight, many worlds solving at
+// once with more solver tasks between them than any world has slots or the
+// pool has threads, and envs acquiring and releasing the pool from several
+// threads. Then steps envs
+// on the largest map with the most drones with and without a pool. Box2D
+// is deterministic across thread counts, so both must produce the same
+// observations. Exits non-zero if any check fails or any env differs.
+// Build: gcc -O2 -std=gnu2x -I./raylib-5.5_linux_amd64/include -I./box2d-linux-amd64/include -I./pufferlib/ocean/impulse_wars -I./pufferlib/ocean/impulse_wars/include tests/bench_impulse_wars_physics.c -o bench_impulse_wars_physics ./box2d-linux-amd64/libbox2d.a ./raylib-5.5_linux_amd64/lib/libraylib.a -lm -lpthread -ldl
+// Run: ./bench_impulse_wars_physics [threads]
+#include <stdatomic.h>
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+#include "env.h"
+
+#define ITEMS 10000
+#define LOOPS 2000
+#define STAGES 16
+#define ENVS 4
+#define STEPS 2000
+// worlds solving at once on their own threads, and solves each
+#define SOLVER_WORLDS 64
+#define WORLD_SOLVES 4
+#define ACQUIRE_THREADS 8
+#define ACQUIRES 10000
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+atomic_int counts[ITEMS];
+atomic_int bad_workers;
+uint8_t num_workers;
+
+void count_items(int start, int end, uint32_t worker, void *context) {
+    MAYBE_UNUSED(context);
+    bad_workers += worker >= num_workers;
+    for (int i = start; i < end; i++) {
+        counts[i]++;
+    }
+}
+
+// Shaped like b2SolverTask: worker 0 publishes each stage and claims its
+// blocks with the others, which spin until the next stage or the end
+typedef struct solver {
+    atomic_int stage;
+    atomic_int next_block;
+    atomic_int done_blocks;
+} solver;
+
+typedef struct solver_worker {
+    solver *s;
+    int idx;
+} solver_worker;
+
+void run_stage_blocks(solver *s) {
+    int block;
+    while ((block = atomic_fetch_add(&s->next_block, 1)) < ITEMS) {
+        counts[block]++;
+        s->done_blocks++;
+    }
+}
+
+void solver_task(int start, int end, uint32_t worker, void *context) {
+    MAYBE_UNUSED(start);
+    MAYBE_UNUSED(end);
+    MAYBE_UNUSED(worker);
+    solver_worker *w = context;
+    solver *s = w->s;
+    if (w->idx != 0) {
+        int seen = 0;
+        while (true) {
+            int stage;
+            while ((stage = atomic_load(&s->stage)) == seen) {
+                sched_yield();
+            }
+            if (stage < 0) {
+                return;
+            }
+            seen = stage;
+            run_stage_blocks(s);
+        }
+    }
+    for (int stage = 1; stage <= STAGES; stage++) {
+        s->next_block = 0;
+        s->done_blocks = 0;
+        atomic_store(&s->stage, stage);
+        run_stage_blocks(s);
+        while (atomic_load(&s->done_blocks) < ITEMS) {
+            sched_yield();
+        }
+    }
+    atomic_store(&s->stage, -1);
+}
+
+int check_counts(const char *name, int want, double us) {
+    int wrong = bad_workers;
+    for (int i = 0; i < ITEMS; i++) {
+        wrong += counts[i] != want;
+        counts[i] = 0;
+    }
+    bad_workers = 0;
+    printf("%-13s | %8.1f us per task | %d wrong %s\n", name, us, wrong, wrong ? "MISMATCH" : "ok");
+    return wrong;
+}
+
+// Fills every task slot of a world without finishing any; with pool
+// threads every task must be queued rather than run by enqueuePoolTask
+int check_full_world(worldTasks *world) {
+    if (world->pool->numWorkers == 1) {
+        return 0;
+    }
+    void *tasks[MAX_WORLD_TASKS];
+    int ran_inline = 0;
+    const double start = now();
+    for (int i = 0; i < world->numTasks; i++) {
+        tasks[i] = enqueuePoolTask(count_items, ITEMS, 64, NULL, world);
+        ran_inline += tasks[i] == NULL;
+    }
+    for (int i = 0; i < world->numTasks; i++) {
+        if (tasks[i] != NULL) {
+            finishPoolTask(tasks[i], world);
+        }
+    }
+    const double us = 1e6*(now() - start)/world->numTasks;
+    return check_counts("full world", world->numTasks, us) + (ran_inline != 0);
+}
+
+// one Box2D step's solver tasks: one per worker, all queued before any are
+// finished, and worker 0 finished first. They are queued last worker first
+// so a check passing doesn't depend on the pool claiming worker 0 first
+void solve(worldTasks *world) {
+    solver s = {0};
+    solver_worker workers[MAX_POOL_WORKERS];
+    void *tasks[MAX_POOL_WORKERS];
+    for (int w = world->pool->numWorkers - 1; w >= 0; w--) {
+        workers[w] = (solver_worker){.s = &s, .idx = w};
+        tasks[w] = enqueuePoolTask(solver_task, 1, 1, &workers[w], world);
+    }
+    for (int w = 0; w < world->pool->numWorkers; w++) {
+        if (tasks[w] != NULL) {
+            finishPoolTask(tasks[w], world);
+        }
+    }
+}
+
+void *solve_world(void *arg) {
+    worldTasks world;
+    initWorldTasks(&world, arg);
+    for (int i = 0; i < WORLD_SOLVES; i++) {
+        solve(&world);
+    }
+    return NULL;
+}
+
+// Worlds on their own threads solve at once, so pool threads run spinning
+// solver tasks of many worlds while their worker 0 may not have started.
+// Every world must still finish
+int check_concurrent_solves(taskPool *pool) {
+    pthread_t threads[SOLVER_WORLDS];
+    const double start = now();
+    for (int i = 0; i < SOLVER_WORLDS; i++) {
+        pthread_create(&threads[i], NULL, solve_world, pool);
+    }
+    for (int i = 0; i < SOLVER_WORLDS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    const double us = 1e6*(now() - start)/(SOLVER_WORLDS*WORLD_SOLVES);
+    return check_counts("many worlds", SOLVER_WORLDS*WORLD_SOLVES*STAGES, us);
+}
+
+void *acquire_release(void *arg) {
+    const uint8_t threads = *(uint8_t *)arg;
+    for (int i = 0; i < ACQUIRES; i++) {
+        releaseTaskPool(acquireTaskPool(threads));
+    }
+    return NULL;
+}
+
+// Envs in other threads take and drop references while this one holds
+// the pool, which must survive with exactly that reference left. A pool
+// of a different size must be refused
+int check_refs(taskPool *pool) {
+    pthread_t threads[ACQUIRE_THREADS];
+    for (int i = 0; i < ACQUIRE_THREADS; i++) {
+        pthread_create(&threads[i], NULL, acquire_release, &pool->numWorkers);
+    }
+    for (int i = 0; i < ACQUIRE_THREADS; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    const uint32_t other = (pool->numWorkers == 1) ? 2 : 1;
+    const int wrong = (sharedTaskPool != pool) + (atomic_load(&pool->refs) != 1)
+        + !taskPoolAvailable(pool->numWorkers) + taskPoolAvailable(other);
+    printf("pool refs     | %d threads x %d acquires | %d wrong %s\n", ACQUIRE_THREADS, ACQUIRES,
+        wrong, wrong ? "MISMATCH" : "ok");
+    return wrong;
+}
+
+int bench_pool(uint32_t threads) {
+    taskPool *pool = acquireTaskPool(threads);
+    num_workers = pool->numWorkers;
+    worldTasks world;
+    initWorldTasks(&world, pool);
+
+    double start = now();
+    for (int i = 0; i < LOOPS; i++) {
+        void *task = enqueuePoolTask(count_items, ITEMS, 64, NULL, &world);
+        if (task != NULL) {
+            finishPoolTask(task, &world);
+        }
+    }
+    int wrong = check_counts("parallel loop", LOOPS, 1e6*(now() - start)/LOOPS);
+
+    start = now();
+    const int solves = LOOPS / 20;
+    for (int i = 0; i < solves; i++) {
+        solve(&world);
+    }
+    wrong += check_counts("solver", solves*STAGES, 1e6*(now() - start)/solves);
+    wrong += check_full_world(&world);
+    wrong += check_concurrent_solves(pool);
+    wrong += check_refs(pool);
+
+    releaseTaskPool(pool);
+    wrong += sharedTaskPool != NULL;
+    return wrong;
+}
+
+double step_envs(iwEnv **envs, uint32_t threads, uint8_t numDrones, int8_t mapIdx) {
+    for (int i = 0; i < ENVS; i++) {
+        iwEnv *e = fastCalloc(1, sizeof(iwEnv));
+        const size_t obsSize = alignedSize(numDrones * obsBytes(numDrones), sizeof(float));
+        posix_memalign((void **)&e->observations, sizeof(void *), obsSize);
+        // not every byte is written each step, so compare zeroed buffers
+        memset(e->observations, 0, obsSize);
+        e->rewards = fastCalloc(numDrones, sizeof(float));
+        e->actions = fastCalloc(numDrones * CONTINUOUS_ACTION_SIZE, sizeof(float));
+        e->masks = fastCalloc(numDrones, sizeof(uint8_t));
+        e->terminals = fastCalloc(numDrones, sizeof(uint8_t));
+        initEnv(e, numDrones, 0, mapIdx, 42 + i, false, false, true, false, threads);
+        initMaps(e);
+        setupEnv(e);
+        envs[i] = e;
+    }
+    const double start = now();
+    for (int t = 0; t < STEPS; t++) {
+        for (int i = 0; i < ENVS; i++) {
+            stepEnv(envs[i]);
+        }
+    }
+    return 1e6*(now() - start)/(STEPS*ENVS);
+}
+
+void free_envs(iwEnv **envs) {
+    for (int i = 0; i < ENVS; i++) {
+        iwEnv *e = envs[i];
+        destroyEnv(e);
+        free(e->observations);
+        fastFree(e->actions);
+        fastFree(e->rewards);
+        fastFree(e->masks);
+        fastFree(e->terminals);
+        fastFree(e->truncations);
+        fastFree(e);
+    }
+}
+
+int main(int argc, char **argv) {
+    const long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    const uint32_t threads = (argc > 1) ? (uint32_t)atoi(argv[1]) : (uint32_t)min(max(cores, 2), 8);
+    int failed = bench_pool(threads) != 0;
+
+    const uint8_t numDrones = MAX_DRONES;
+    const int8_t mapIdx = NUM_MAPS - 1;
+    iwEnv *serial[ENVS], *pooled[ENVS];
+    const double serial_us = step_envs(serial, 1, numDrones, mapIdx);
+    const double pooled_us = step_envs(pooled, threads, numDrones, mapIdx);
+    int mismatched = 0;
+    for (int i = 0; i < ENVS; i++) {
+        mismatched += memcmp(serial[i]->observations, pooled[i]->observations, numDrones * obsBytes(numDrones)) != 0;
+    }
+    printf("%d drones on map %d | 1 thread %.1f us | %u threads %.1f us per step | %d of %d envs mismatched %s\n",
+        numDrones, mapIdx, serial_us, threads, pooled_us, mismatched, ENVS, mismatched ? "MISMATCH" : "ok");
+    free_envs(serial);
+    free_envs(pooled);
+    destroyMaps();
+    return failed || mismatched != 0;
+}
@@ -0,0 +1,276 @@
+// Microbenchmark for impulse_wars snapshots: plays an episode on the largest
+// map with the most drones for a while and snapshots it. Restoring it into
+// the same env must reuse every body in place. Restoring it after playing
+// on, when entities have come and gone, must recreate only those, and
+// snapshotting right after either restore must give back the same bytes.
+// Continuing from a restore must also stay close to continuing the original
+// env, which only differs by the Box2D contact state a snapshot doesn't
+// keep, and corrupted snapshots must be rejected without touching the env.
+// Also compares snapshotting and restoring against setting up a new episode.
+// Exits non-zero if any check fails. The drift check needs the real Box2D;
+// against a stub that doesn't step it passes trivially.
+// Build: gcc -O2 -std=gnu2x -I./raylib-5.5_linux_amd64/include -I./box2d-linux-amd64/include -I./pufferlib/ocean/impulse_wars -I./pufferlib/ocean/impulse_wars/include tests/bench_impulse_wars_snapshot.c -o bench_impulse_wars_snapshot ./box2d-linux-amd64/libbox2d.a ./raylib-5.5_linux_amd64/lib/libraylib.a -lm -lpthread -ldl
+// Run: ./bench_impulse_wars_snapshot
+#include <stdio.h>
+#include <time.h>
+#include "snapshot.h"
+
+#define WARMUP_STEPS 300
+#define BRANCH_STEPS 200
+#define LOOPS 1000
+// steps the original and a restored env are continued for side by side;
+// short, since small differences in contact solving compound
+#define CONTINUE_STEPS 10
+// how far a drone continued from a restore may end up from where it ends
+// up when the original is continued, a tenth of a wall. Warm starting the
+// rebuilt contacts from zero only nudges impulses for a step or two
+#define MAX_CONTINUE_DRIFT (0.1f * WALL_THICKNESS)
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// actions come from their own rand state so both branches get the same ones
+void rand_actions(iwEnv *e, uint64_t *state) {
+    for (uint16_t i = 0; i < e->numDrones * CONTINUOUS_ACTION_SIZE; i++) {
+        e->actions[i] = randFloat(state, -1.0f, 1.0f);
+    }
+}
+
+// appends the ids of the bodies of every entity, in array order
+uint16_t body_ids(const iwEnv *e, b2BodyId *ids) {
+    uint16_t n = 0;
+    for (uint8_t i = 0; i < cc_array_size(e->drones); i++) {
+        const droneEntity *drone = safe_array_get_at(e->drones, i);
+        ids[n++] = drone->bodyID;
+    }
+    for (size_t i = 0; i < cc_array_size(e->walls); i++) {
+        const wallEntity *wall = safe_array_get_at(e->walls, i);
+        ids[n++] = wall->bodyID;
+    }
+    for (size_t i = 0; i < cc_array_size(e->floatingWalls); i++) {
+        const wallEntity *wall = safe_array_get_at(e->floatingWalls, i);
+        ids[n++] = wall->bodyID;
+    }
+    for (size_t i = 0; i < cc_array_size(e->pickups); i++) {
+        const weaponPickupEntity *pickup = safe_array_get_at(e->pickups, i);
+        ids[n++] = pickup->bodyDestroyed ? b2_nullBodyId : pickup->bodyID;
+    }
+    for (size_t i = 0; i < cc_array_size(e->projectiles); i++) {
+        const projectileEntity *projectile = safe_array_get_at(e->projectiles, i);
+        ids[n++] = projectile->bodyID;
+    }
+    for (size_t i = 0; i < cc_array_size(e->dronePieces); i++) {
+        const dronePieceEntity *piece = safe_array_get_at(e->dronePieces, i);
+        ids[n++] = piece->bodyID;
+    }
+    return n;
+}
+
+// plays steps from the current state with other actions than the
+// snapshot's continuation, restores the snapshot and snapshots again.
+// Returns the number of bodies kept, or -1 if the snapshots differ
+int restore_after(iwEnv *e, const uint8_t *snap, size_t size, uint8_t *resnap, size_t bufSize, int steps) {
+    uint64_t state = 7;
+    for (int t = 0; t < steps; t++) {
+        rand_actions(e, &state);
+        stepEnv(e);
+    }
+    // every body has an entity record, and restoring only adds records
+    b2BodyId *before = fastMalloc(cc_array_size(e->entities) * sizeof(b2BodyId));
+    const uint16_t numBefore = body_ids(e, before);
+    const bool restored = restoreEnv(e, snap, size);
+    b2BodyId *after = fastMalloc(cc_array_size(e->entities) * sizeof(b2BodyId));
+    const uint16_t numAfter = body_ids(e, after);
+    int kept = 0;
+    for (uint16_t i = 0; i < min(numBefore, numAfter); i++) {
+        kept += B2_ID_EQUALS(before[i], after[i]) && !B2_IS_NULL(after[i]);
+    }
+    fastFree(before);
+    fastFree(after);
+
+    const size_t resize = snapshotEnv(e, resnap, bufSize);
+    if (!restored || resize != size || memcmp(snap, resnap, size) != 0) {
+        return -1;
+    }
+    return kept;
+}
+
+// the number of entities with a body
+uint16_t num_bodies(const iwEnv *e) {
+    uint16_t n = cc_array_size(e->drones) + cc_array_size(e->walls) + cc_array_size(e->floatingWalls) + cc_array_size(e->projectiles) + cc_array_size(e->dronePieces);
+    for (size_t i = 0; i < cc_array_size(e->pickups); i++) {
+        const weaponPickupEntity *pickup = safe_array_get_at(e->pickups, i);
+        n += !pickup->bodyDestroyed;
+    }
+    return n;
+}
+
+// continues an env and records where its drones end up
+void continue_env(iwEnv *e, b2Vec2 *pos) {
+    uint64_t state = 11;
+    for (int t = 0; t < CONTINUE_STEPS; t++) {
+        rand_actions(e, &state);
+        stepEnv(e);
+    }
+    for (uint8_t i = 0; i < e->numDrones; i++) {
+        const droneEntity *drone = safe_array_get_at(e->drones, i);
+        pos[i] = drone->pos;
+    }
+}
+
+// restores copies of snap with one field broken at a time; every restore
+// must fail and leave the env as it was. Returns the number that didn't
+int check_corrupt(iwEnv *e, const uint8_t *snap, size_t size) {
+    const size_t bufSize = snapshotEnvSize(e);
+    uint8_t *before = fastMalloc(bufSize);
+    uint8_t *after = fastMalloc(bufSize);
+    uint8_t *bad = fastMalloc(size + 1);
+    const size_t beforeSize = snapshotEnv(e, before, bufSize);
+
+    envSnapshot header;
+    memcpy(&header, snap, sizeof(envSnapshot));
+    const size_t droneOffset = sizeof(envSnapshot);
+    int failures = 0;
+    int cases = 0;
+    for (int c = 0; c < 8; c++) {
+        memcpy(bad, snap, size);
+        envSnapshot *h = (envSnapshot *)bad;
+        droneSnapshot *drone = (droneSnapshot *)(bad + droneOffset);
+        size_t badSize = size;
+        switch (c) {
+        case 0:
+            badSize = size - 1;
+            break;
+        case 1:
+            h->numProjectiles++;
+            break;
+        case 2:
+            h->numPickups = UINT16_MAX;
+            break;
+        case 3:
+            h->mapIdx = NUM_MAPS;
+            break;
+        case 4:
+            drone->weapon = NUM_WEAPONS;
+            break;
+        case 5:
+            drone->numPhysicsSteps = UINT16_MAX;
+            break;
+        case 6:
+            drone->drone.mapCellIdx = INT16_MAX;
+            break;
+        case 7:
+            // one past the last of the snapshot's welded wall indices
+            if (header.numProjectiles == 0) {
+                continue;
+            }
+            size_t offset = size - agentBuffersSize(e) - header.numDronePieces * sizeof(dronePieceSnapshot) - header.numProjectiles * sizeof(projectileSnapshot);
+            projectileSnapshot *projectile = (projectileSnapshot *)(bad + offset);
+            projectile->weldedWallIdx = INT16_MAX;
+            break;
+        }
+        cases++;
+        if (restoreEnv(e, bad, badSize)) {
+            printf("corrupt snapshot %d was restored\n", c);
+            failures++;
+        }
+    }
+
+    const size_t afterSize = snapshotEnv(e, after, bufSize);
+    failures += afterSize != beforeSize || memcmp(before, after, beforeSize) != 0;
+    printf("%d corrupt snapshots %s\n", cases, failures ? "MISMATCHED" : "rejected");
+    fastFree(before);
+    fastFree(after);
+    fastFree(bad);
+    return failures;
+}
+
+int main() {
+    const uint8_t numDrones = MAX_DRONES;
+    const int8_t mapIdx = NUM_MAPS - 1;
+    iwEnv *e = fastCalloc(1, sizeof(iwEnv));
+    posix_memalign((void **)&e->observations, sizeof(void *), alignedSize(numDrones * obsBytes(numDrones), sizeof(float)));
+    e->rewards = fastCalloc(numDrones, sizeof(float));
+    e->actions = fastCalloc(numDrones * CONTINUOUS_ACTION_SIZE, sizeof(float));
+    e->masks = fastCalloc(numDrones, sizeof(uint8_t));
+    e->terminals = fastCalloc(numDrones, sizeof(uint8_t));
+    initEnv(e, numDrones, numDrones, mapIdx, 42, false, false, true, true, 1);
+    initMaps(e);
+    setupEnv(e);
+
+    uint64_t state = 3;
+    for (int t = 0; t < WARMUP_STEPS; t++) {
+        rand_actions(e, &state);
+        stepEnv(e);
+    }
+
+    const size_t bufSize = snapshotEnvSize(e);
+    uint8_t *snap = fastMalloc(bufSize);
+    uint8_t *resnap = fastMalloc(bufSize);
+    const size_t size = snapshotEnv(e, snap, bufSize);
+    if (size == 0) {
+        printf("snapshot failed\n");
+        return 1;
+    }
+
+    // right after the snapshot every entity matches, so all are reused
+    const uint16_t numBodies = num_bodies(e);
+    const int keptInPlace = restore_after(e, snap, size, resnap, bufSize, 0);
+    const bool in_place = keptInPlace == numBodies;
+    // after playing on projectiles and pieces have come and gone
+    const int keptAfter = restore_after(e, snap, size, resnap, bufSize, BRANCH_STEPS);
+    const bool after_matches = keptAfter >= 0;
+
+    // the env is now as it was when the snapshot was taken, so continuing
+    // it is continuing the original
+    b2Vec2 originalPos[_MAX_DRONES], restoredPos[_MAX_DRONES];
+    continue_env(e, originalPos);
+    restoreEnv(e, snap, size);
+    continue_env(e, restoredPos);
+    float drift = 0.0f;
+    for (uint8_t i = 0; i < numDrones; i++) {
+        drift = fmaxf(drift, b2Distance(originalPos[i], restoredPos[i]));
+    }
+    const bool continue_matches = drift <= MAX_CONTINUE_DRIFT;
+    restoreEnv(e, snap, size);
+    const int corrupt_failures = check_corrupt(e, snap, size);
+
+    double start = now();
+    for (int i = 0; i < LOOPS; i++) {
+        snapshotEnv(e, resnap, bufSize);
+    }
+    const double snap_us = 1e6*(now() - start)/LOOPS;
+    start = now();
+    for (int i = 0; i < LOOPS; i++) {
+        restoreEnv(e, snap, size);
+    }
+    const double restore_us = 1e6*(now() - start)/LOOPS;
+    start = now();
+    for (int i = 0; i < LOOPS; i++) {
+        resetEnv(e);
+    }
+    const double reset_us = 1e6*(now() - start)/LOOPS;
+
+    printf("%d drones on map %d | snapshot %zu bytes | snapshot %.1f us | restore %.1f us | reset %.1f us\n",
+        numDrones, mapIdx, size, snap_us, restore_us, reset_us);
+    printf("restore in place kept %d of %u bodies %s | restore after %d steps kept %d %s\n",
+        keptInPlace, numBodies, in_place ? "ok" : "MISMATCH", BRANCH_STEPS, keptAfter,
+        after_matches ? "ok" : "MISMATCH");
+    printf("restored vs original drift %.3f %s\n", drift, continue_matches ? "ok" : "MISMATCH");
+
+    fastFree(snap);
+    fastFree(resnap);
+    destroyEnv(e);
+    destroyMaps();
+    free(e->observations);
+    fastFree(e->actions);
+    fastFree(e->rewards);
+    fastFree(e->masks);
+    fastFree(e->terminals);
+    fastFree(e->truncations);
+    fastFree(e);
+    return !in_place || !after_matches || !continue_matches || corrupt_failures != 0;
+}
@@ -0,0 +1,116 @@
+// Microbenchmark for the moba path table: building, saving and mapping the
+// packed table, then lookups against the original 128^4 byte table that
+// move_towards filled lazily with bfs. Every (destination, source) pair of
+// cells must give the same step, with 255 and 8 both meaning stop, and the
+// timed random lookups must agree too. Exits non-zero on any mismatch.
+// Build: gcc -O2 -I./raylib-5.5_linux_amd64/include -I./pufferlib/ocean/moba tests/bench_moba_paths.c -o bench_moba_paths ./raylib-5.5_linux_amd64/lib/libraylib.a -lm -lpthread -ldl
+// Run: ./bench_moba_paths
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "moba.h"
+
+#define TABLE_PATH "/tmp/bench_moba_paths.bin"
+#define LOOKUPS (1 << 24)
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+static inline int ref_ai_offset(int y_dst, int x_dst, int y_src, int x_src) {
+    return y_dst*128*128*128 + x_dst*128*128 + y_src*128 + x_src;
+}
+
+// The original table with every row filled, as after a long enough run
+unsigned char* ref_paths(unsigned char* grid) {
+    Map map = {.grid = grid, .width = 128, .height = 128};
+    unsigned char* paths = malloc(128*128*128*128);
+    memset(paths, 255, 128*128*128*128);
+    int* buffer = calloc(3*8*128*128, sizeof(int));
+    for (int r = 0; r < 128; r++) {
+        for (int c = 0; c < 128; c++) {
+            bfs(&map, &paths[ref_ai_offset(r, c, 0, 0)], buffer, r, c);
+        }
+    }
+    free(buffer);
+    return paths;
+}
+
+int main() {
+    unsigned char* grid = read_file("resources/moba/game_map.npy");
+    if (grid == NULL) {
+        printf("Failed to read resources/moba/game_map.npy\n");
+        return 1;
+    }
+    remove(TABLE_PATH);
+    double start = now();
+    size_t size;
+    char* blob = build_path_table(grid, 128, &size);
+    double build_s = now() - start;
+    if (save_path_table(TABLE_PATH, blob, size) != 0) {
+        printf("Failed to save %s\n", TABLE_PATH);
+        return 1;
+    }
+    free(blob);
+    start = now();
+    PathTable* table = open_path_table(TABLE_PATH, grid, 128);
+    double open_us = 1e6*(now() - start);
+    if (table == NULL) {
+        printf("Failed to open %s\n", TABLE_PATH);
+        return 1;
+    }
+    printf("table: %d walkable cells | build %.2f s | open %.1f us | %.1f MiB vs %.1f MiB\n",
+        table->walkable, build_s, open_us, size/1048576.0, 128*128*128*128/1048576.0);
+
+    unsigned char* ref = ref_paths(grid);
+    long mismatches = 0;
+    for (int y_dst = 0; y_dst < 128; y_dst++) {
+        for (int x_dst = 0; x_dst < 128; x_dst++) {
+            for (int y_src = 0; y_src < 128; y_src++) {
+                for (int x_src = 0; x_src < 128; x_src++) {
+                    int want = ref[ref_ai_offset(y_dst, x_dst, y_src, x_src)];
+                    if (want > PATH_STOP) want = PATH_STOP;
+                    mismatches += path_direction(table, y_dst, x_dst, y_src, x_src) != want;
+                }
+            }
+        }
+    }
+
+    // Random walkable pairs, as creeps and neutrals query them
+    int* pairs = malloc(4*LOOKUPS*sizeof(int));
+    PufferRng rng;
+    puffer_rng_seed(&rng, 0);
+    for (int i = 0; i < LOOKUPS; i++) {
+        int dst, src;
+        do { dst = puffer_randint(&rng, 0, 128*128); } while (grid[dst] == WALL);
+        do { src = puffer_randint(&rng, 0, 128*128); } while (grid[src] == WALL);
+        pairs[4*i] = dst / 128;
+        pairs[4*i + 1] = dst % 128;
+        pairs[4*i + 2] = src / 128;
+        pairs[4*i + 3] = src % 128;
+    }
+    long ref_sum = 0;
+    start = now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        int* p = &pairs[4*i];
+        int atn = ref[ref_ai_offset(p[0], p[1], p[2], p[3])];
+        ref_sum += (atn >= 8) ? 8 : atn;
+    }
+    double ref_ns = 1e9*(now() - start)/LOOKUPS;
+    long sum = 0;
+    start = now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        int* p = &pairs[4*i];
+        sum += path_direction(table, p[0], p[1], p[2], p[3]);
+    }
+    double ns = 1e9*(now() - start)/LOOKUPS;
+    bool failed = mismatches != 0 || sum != ref_sum;
+    printf("lookup: byte table %.1f ns | packed table %.1f ns | %ld of %d pairs mismatched %s\n",
+        ref_ns, ns, mismatches, 128*128*128*128, failed ? "MISMATCH" : "ok");
+    free(pairs);
+    free(ref);
+    free(grid);
+    return failed;
+}
@@ -0,0 +1,254 @@
+// Microbenchmark for the CPU puff advantage kernel against the original
+// single threaded row loop, and for the fused advantage/return/priority
+// op against separate passes, on [segments, horizon] shapes from training
+// configs, then how the block kernel scales with threads. OpenMP stands in
+// for at::parallel_for. Exits non-zero if any result differs from the
+// original loop by more than MAX_REL_ERR.
+// Build: g++ -O3 -fopenmp -I./pufferlib/extensions tests/bench_puff_advantage.cpp -o bench_puff_advantage
+// Run: ./bench_puff_advantage [num_threads]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <omp.h>
+#include "advantage.h"
+
+using namespace pufferlib;
+
+// Original implementation from pufferlib.cpp
+void ref_puff_advantage(float* values, float* rewards, float* dones, float* importance,
+        float* advantages, float gamma, float lambda, float rho_clip, float c_clip,
+        int num_steps, const int horizon) {
+    for (int offset = 0; offset < num_steps*horizon; offset+=horizon) {
+        puff_advantage_row(values + offset, rewards + offset,
+            dones + offset, importance + offset, advantages + offset,
+            gamma, lambda, rho_clip, c_clip, horizon
+        );
+    }
+}
+
+void par_puff_advantage(float* values, float* rewards, float* dones, float* importance,
+        float* advantages, float gamma, float lambda, float rho_clip, float c_clip,
+        int num_steps, const int horizon) {
+    int lanes = puff_advantage_kernel().lanes;
+    int num_blocks = (num_steps + lanes - 1)/lanes;
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < num_blocks; b++) {
+        int row_end = (b + 1)*lanes < num_steps ? (b + 1)*lanes : num_steps;
+        puff_advantage_rows(values, rewards, dones, importance, advantages,
+            gamma, lambda, rho_clip, c_clip, b*lanes, row_end, horizon);
+    }
+}
+
+// What train did before the fused op: advantages, then returns and
+// priorities as separate passes over the buffer
+void unfused_puff_advantage(float* values, float* rewards, float* dones,
+        float* importance, float* advantages, float* returns, float* priorities,
+        float gamma, float lambda, float rho_clip, float c_clip, float prio_alpha,
+        int num_steps, const int horizon) {
+    int n = num_steps*horizon;
+    memset(advantages, 0, n*sizeof(float));
+    par_puff_advantage(values, rewards, dones, importance, advantages,
+        gamma, lambda, rho_clip, c_clip, num_steps, horizon);
+    for (int i = 0; i < n; i++) {
+        returns[i] = advantages[i] + values[i];
+    }
+    for (int row = 0; row < num_steps; row++) {
+        float abs_sum = 0;
+        for (int t = 0; t < horizon; t++) {
+            abs_sum += fabsf(advantages[row*horizon + t]);
+        }
+        float prio = powf(abs_sum, prio_alpha);
+        priorities[row] = isfinite(prio) ? prio : 0.0f;
+    }
+}
+
+void fused_puff_advantage(float* values, float* rewards, float* dones,
+        float* importance, float* advantages, float* returns, float* priorities,
+        float gamma, float lambda, float rho_clip, float c_clip, float prio_alpha,
+        int num_steps, const int horizon) {
+    int lanes = puff_advantage_kernel().lanes;
+    int num_blocks = (num_steps + lanes - 1)/lanes;
+    #pragma omp parallel for schedule(static)
+    for (int b = 0; b < num_blocks; b++) {
+        int row_end = (b + 1)*lanes < num_steps ? (b + 1)*lanes : num_steps;
+        puff_advantage_fused_rows(values, rewards, dones, importance,
+            advantages, returns, priorities, gamma, lambda, rho_clip, c_clip,
+            prio_alpha, b*lanes, row_end, horizon);
+    }
+}
+
+float max_rel_err(float* a, float* b, int n) {
+    float max_err = 0;
+    for (int i = 0; i < n; i++) {
+        float err = fabsf(a[i] - b[i])/(1.0f + fabsf(b[i]));
+        max_err = err > max_err ? err : max_err;
+    }
+    return max_err;
+}
+
+float rand_float(float lo, float hi) {
+    return lo + (hi - lo)*(float)rand()/(float)RAND_MAX;
+}
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+typedef struct {
+    const char* name;
+    int segments;
+    int horizon;
+} Shape;
+
+// Same arithmetic in a different order, so only rounding differs
+#define MAX_REL_ERR 1e-5f
+
+Shape shapes[] = {
+    {"default (batch 2^16, bptt 64)", 1024, 64},
+    {"ocean (batch 2^18, bptt 64)", 4096, 64},
+    {"large (batch 2^19, bptt 64)", 8192, 64},
+    {"long bptt (batch 2^18, bptt 256)", 1024, 256},
+    {"short bptt (batch 2^18, bptt 16)", 16384, 16},
+    {"odd (batch 250k, bptt 61)", 4099, 61},
+};
+
+// Block kernel time on one shape for 1, 2, 4, ... threads up to the
+// number of cores, relative to one thread
+void bench_threads(Shape* shape, float gamma, float lambda, float rho_clip, float c_clip) {
+    int n = shape->segments*shape->horizon;
+    float* values = (float*)calloc(n, sizeof(float));
+    float* rewards = (float*)calloc(n, sizeof(float));
+    float* dones = (float*)calloc(n, sizeof(float));
+    float* importance = (float*)calloc(n, sizeof(float));
+    float* out = (float*)calloc(n, sizeof(float));
+    for (int i = 0; i < n; i++) {
+        values[i] = rand_float(-1, 1);
+        rewards[i] = rand_float(-1, 1);
+        dones[i] = (rand() % 50 == 0) ? 1.0f : 0.0f;
+        importance[i] = rand_float(0.5f, 1.5f);
+    }
+
+    int max_threads = omp_get_max_threads();
+    int procs = omp_get_num_procs();
+    max_threads = procs > max_threads ? procs : max_threads;
+    printf("%s thread scaling:", shape->name);
+    int iters = 1 + (1 << 26)/n;
+    double base_ms = 0;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        omp_set_num_threads(threads);
+        double start = now();
+        for (int i = 0; i < iters; i++) {
+            par_puff_advantage(values, rewards, dones, importance, out,
+                gamma, lambda, rho_clip, c_clip, shape->segments, shape->horizon);
+        }
+        double ms = 1000*(now() - start)/iters;
+        base_ms = (threads == 1) ? ms : base_ms;
+        printf(" | %d: %.3f ms (%.1fx)", threads, ms, base_ms/ms);
+    }
+    printf("\n");
+
+    free(values);
+    free(rewards);
+    free(dones);
+    free(importance);
+    free(out);
+}
+
+int main(int argc, char** argv) {
+    if (argc > 1) {
+        omp_set_num_threads(atoi(argv[1]));
+    }
+    printf("%d lanes, %d threads\n", puff_advantage_kernel().lanes, omp_get_max_threads());
+    float gamma = 0.995f;
+    float lambda = 0.9f;
+    float rho_clip = 1.0f;
+    float c_clip = 1.0f;
+    float prio_alpha = 0.8f;
+
+    int failures = 0;
+    for (size_t s = 0; s < sizeof(shapes)/sizeof(shapes[0]); s++) {
+        Shape shape = shapes[s];
+        int n = shape.segments*shape.horizon;
+        float* values = (float*)calloc(n, sizeof(float));
+        float* rewards = (float*)calloc(n, sizeof(float));
+        float* dones = (float*)calloc(n, sizeof(float));
+        float* importance = (float*)calloc(n, sizeof(float));
+        float* ref = (float*)calloc(n, sizeof(float));
+        float* out = (float*)calloc(n, sizeof(float));
+        for (int i = 0; i < n; i++) {
+            values[i] = rand_float(-1, 1);
+            rewards[i] = rand_float(-1, 1);
+            dones[i] = (rand() % 50 == 0) ? 1.0f : 0.0f;
+            importance[i] = rand_float(0.5f, 1.5f);
+        }
+
+        int iters = 1 + (1 << 24)/n;
+        double start = now();
+        for (int i = 0; i < iters; i++) {
+            ref_puff_advantage(values, rewards, dones, importance, ref,
+                gamma, lambda, rho_clip, c_clip, shape.segments, shape.horizon);
+        }
+        double ref_ms = 1000*(now() - start)/iters;
+
+        start = now();
+        for (int i = 0; i < iters; i++) {
+            par_puff_advantage(values, rewards, dones, importance, out,
+                gamma, lambda, rho_clip, c_clip, shape.segments, shape.horizon);
+        }
+        double out_ms = 1000*(now() - start)/iters;
+        float max_err = max_rel_err(out, ref, n);
+        failures += max_err > MAX_REL_ERR;
+
+        printf("%-34s [%5d, %3d] ref %7.3f ms | new %7.3f ms (%4.1fx, max err %.1e%s)\n",
+            shape.name, shape.segments, shape.horizon, ref_ms, out_ms,
+            ref_ms/out_ms, max_err, max_err > MAX_REL_ERR ? " MISMATCH" : "");
+
+        float* ref_returns = (float*)calloc(n, sizeof(float));
+        float* ref_prio = (float*)calloc(shape.segments, sizeof(float));
+        float* returns = (float*)calloc(n, sizeof(float));
+        float* prio = (float*)calloc(shape.segments, sizeof(float));
+        start = now();
+        for (int i = 0; i < iters; i++) {
+            unfused_puff_advantage(values, rewards, dones, importance, ref,
+                ref_returns, ref_prio, gamma, lambda, rho_clip, c_clip,
+                prio_alpha, shape.segments, shape.horizon);
+        }
+        ref_ms = 1000*(now() - start)/iters;
+
+        start = now();
+        for (int i = 0; i < iters; i++) {
+            fused_puff_advantage(values, rewards, dones, importance, out,
+                returns, prio, gamma, lambda, rho_clip, c_clip,
+                prio_alpha, shape.segments, shape.horizon);
+        }
+        out_ms = 1000*(now() - start)/iters;
+        max_err = max_rel_err(out, ref, n);
+        float returns_err = max_rel_err(returns, ref_returns, n);
+        float prio_err = max_rel_err(prio, ref_prio, shape.segments);
+        max_err = returns_err > max_err ? returns_err : max_err;
+        max_err = prio_err > max_err ? prio_err : max_err;
+        failures += max_err > MAX_REL_ERR;
+        printf("%-34s %12s unfused %7.3f ms | fused %7.3f ms (%4.1fx, max err %.1e%s)\n",
+            "  + returns, priorities", "", ref_ms, out_ms, ref_ms/out_ms, max_err,
+            max_err > MAX_REL_ERR ? " MISMATCH" : "");
+
+        free(ref_returns);
+        free(ref_prio);
+        free(returns);
+        free(prio);
+
+        free(values);
+        free(rewards);
+        free(dones);
+        free(importance);
+        free(ref);
+        free(out);
+    }
+
+    bench_threads(&shapes[2], gamma, lambda, rho_clip, c_clip);
+    return failures != 0;
+}
@@ -0,0 +1,692 @@
+// Microbenchmark for the puffernet GEMM kernels against the original
+// scalar loops, on the layer shapes used by LinearLSTM and ConvLSTM,
+// for the int8 path against fp32 (speed and accuracy), and for the graph
+// executor against the per-layer structs (speed, memory and outputs, also
+// when agents are stepped in shuffled batches of varying size). Exits
+// non-zero if any kernel disagrees with the original loops or any graph
+// output with the per-layer nets.
+// Build: gcc -O2 -I./pufferlib/extensions tests/bench_puffernet.c -o bench_puffernet -lm
+// Run: ./bench_puffernet [num_agents]
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include "puffernet.h"
+
+void ref_linear(float* input, float* weights, float* bias, float* output,
+        int batch_size, int input_dim, int output_dim) {
+    for (int b = 0; b < batch_size; b++) {
+        for (int o = 0; o < output_dim; o++) {
+            float sum = 0.0f;
+            for (int i = 0; i < input_dim; i++)
+                sum += input[b*input_dim + i] * weights[o*input_dim + i];
+            output[b*output_dim + o] = sum + bias[o];
+        }
+    }
+}
+
+void ref_conv2d(float* input, float* weights, float* bias,
+        float* output, int batch_size, int in_width, int in_height,
+        int in_channels, int out_channels, int kernel_size, int stride) {
+    int h_out = (in_height - kernel_size)/stride + 1;
+    int w_out = (in_width - kernel_size)/stride + 1;
+    for (int b = 0; b < batch_size; b++) {
+        for (int oc = 0; oc < out_channels; oc++) {
+            for (int h = 0; h < h_out; h++) {
+                for (int w = 0; w < w_out; w++) {
+                    int out_adr = b*out_channels*h_out*w_out + oc*h_out*w_out + h*w_out + w;
+                    output[out_adr] = bias[oc];
+                    for (int ic = 0; ic < in_channels; ic++) {
+                        for (int kh = 0; kh < kernel_size; kh++) {
+                            for (int kw = 0; kw < kernel_size; kw++) {
+                                int in_adr = b*in_channels*in_height*in_width
+                                    + ic*in_height*in_width
+                                    + (h*stride + kh)*in_width
+                                    + (w*stride + kw);
+                                int weight_adr = oc*in_channels*kernel_size*kernel_size
+                                    + ic*kernel_size*kernel_size
+                                    + kh*kernel_size
+                                    + kw;
+                                output[out_adr] += input[in_adr]*weights[weight_adr];
+                            }
+                        }
+                    }
+                }
+            }
+        }
+    }
+}
+
+typedef struct {
+    const char* name;
+    int is_conv;
+    int input_dim;
+    int output_dim;
+    // Conv only
+    int in_width;
+    int in_height;
+    int kernel_size;
+    int stride;
+} Shape;
+
+Shape shapes[] = {
+    {"LinearLSTM encoder (snake)", 0, 968, 128, 0, 0, 0, 0},
+    {"LinearLSTM lstm input/state", 0, 128, 512, 0, 0, 0, 0},
+    {"LinearLSTM actor", 0, 128, 4, 0, 0, 0, 0},
+    {"ConvLSTM conv1 (trash_pickup)", 1, 5, 32, 11, 11, 5, 3},
+    {"ConvLSTM conv2 (trash_pickup)", 1, 32, 32, 3, 3, 3, 1},
+    {"ConvLSTM linear", 0, 32, 128, 0, 0, 0, 0},
+    {"nmmo3 map_conv1", 1, 59, 128, 15, 11, 5, 3},
+    {"nmmo3 proj", 0, 1817, 512, 0, 0, 0, 0},
+};
+#define NUM_SHAPES (int)(sizeof(shapes)/sizeof(shapes[0]))
+
+// Max abs error allowed relative to the largest reference output
+#define MAX_REL_ERR 1e-4f
+// Same for int8 against fp32. Per row quantization gives about 6e-3
+#define MAX_INT8_REL_ERR 2e-2f
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + 1e-9*ts.tv_nsec;
+}
+
+float* rand_buffer(size_t n) {
+    float* buf = malloc(n*sizeof(float));
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = rand()/(float)RAND_MAX - 0.5f;
+    }
+    return buf;
+}
+
+float* make_conv_buffer(Shape* s, int batch_size) {
+    if (!s->is_conv) {
+        return NULL;
+    }
+    return malloc(_conv2d_buffer_size(batch_size, s->in_width, s->in_height,
+        s->input_dim, s->output_dim, s->kernel_size, s->stride)*sizeof(float));
+}
+
+void run(Shape* s, int batch_size, float* input, float* weights, float* bias,
+        float* output, float* buffer) {
+    if (s->is_conv) {
+        _conv2d(input, weights, bias, output, buffer, batch_size, s->in_width, s->in_height,
+            s->input_dim, s->output_dim, s->kernel_size, s->stride);
+    } else {
+        _linear(input, weights, bias, output, batch_size, s->input_dim, s->output_dim);
+    }
+}
+
+void run_ref(Shape* s, int batch_size, float* input, float* weights, float* bias, float* output) {
+    if (s->is_conv) {
+        ref_conv2d(input, weights, bias, output, batch_size, s->in_width, s->in_height,
+            s->input_dim, s->output_dim, s->kernel_size, s->stride);
+    } else {
+        ref_linear(input, weights, bias, output, batch_size, s->input_dim, s->output_dim);
+    }
+}
+
+void run_int8(Shape* s, int batch_size, float* input, int8_t* weights_q, float* scales,
+        float* bias, float* output, int8_t* input_q, float* input_scales, float* buffer) {
+    if (s->is_conv) {
+        _qconv2d(input, weights_q, scales, bias, output, buffer, batch_size, s->in_width,
+            s->in_height, s->input_dim, s->output_dim, s->kernel_size, s->stride);
+    } else {
+        _qlinear(input, weights_q, scales, bias, output, input_q, input_scales,
+            batch_size, s->input_dim, s->output_dim, 0);
+    }
+}
+
+// Error is max abs error relative to the largest fp32 output. Times the
+// int8 kernels even on shapes the int8 layers keep in fp32
+int bench_int8_shape(Shape* s, int batch_size) {
+    size_t in_size = s->input_dim;
+    size_t out_size = s->output_dim;
+    int K = s->input_dim;
+    if (s->is_conv) {
+        int h_out = (s->in_height - s->kernel_size)/s->stride + 1;
+        int w_out = (s->in_width - s->kernel_size)/s->stride + 1;
+        in_size *= s->in_width*s->in_height;
+        out_size *= h_out*w_out;
+        K *= s->kernel_size*s->kernel_size;
+    }
+    float* input = rand_buffer(batch_size*in_size);
+    float* weights = rand_buffer(s->output_dim*K);
+    float* bias = rand_buffer(s->output_dim);
+    float* expected = calloc(batch_size*out_size, sizeof(float));
+    float* output = calloc(batch_size*out_size, sizeof(float));
+    int8_t* weights_q = malloc(s->output_dim*K);
+    float* scales = malloc(s->output_dim*sizeof(float));
+    int8_t* input_q = malloc(batch_size*in_size);
+    float* input_scales = malloc(batch_size*sizeof(float));
+    float* buffer = make_conv_buffer(s, batch_size);
+    float* qbuffer = NULL;
+    if (s->is_conv) {
+        qbuffer = malloc(_qconv2d_buffer_size(batch_size, s->in_width, s->in_height,
+            s->input_dim, s->output_dim, s->kernel_size, s->stride)*sizeof(float));
+    }
+    _quantize_rows(weights, weights_q, scales, s->output_dim, K);
+
+    run(s, batch_size, input, weights, bias, expected, buffer);
+    run_int8(s, batch_size, input, weights_q, scales, bias, output, input_q, input_scales,
+        qbuffer);
+    float max_err = 0;
+    float max_out = 0;
+    for (size_t i = 0; i < batch_size*out_size; i++) {
+        max_err = fmaxf(max_err, fabsf(output[i] - expected[i]));
+        max_out = fmaxf(max_out, fabsf(expected[i]));
+    }
+
+    int iters = 1;
+    double start = now();
+    while (now() - start < 0.2) {
+        run(s, batch_size, input, weights, bias, expected, buffer);
+        iters++;
+    }
+    double fp32_ms = 1000*(now() - start)/iters;
+    iters = 1;
+    start = now();
+    while (now() - start < 0.2) {
+        run_int8(s, batch_size, input, weights_q, scales, bias, output, input_q, input_scales,
+            qbuffer);
+        iters++;
+    }
+    double int8_ms = 1000*(now() - start)/iters;
+    bool match = max_err <= MAX_INT8_REL_ERR*max_out;
+    bool quantized = (size_t)s->output_dim*K >= QUANTIZE_MIN_WEIGHTS;
+    printf("%-32s fp32 %8.3f | int8 %8.3f (%4.1fx, rel err %.1e%s) | layers run %s\n",
+        s->name, fp32_ms, int8_ms, fp32_ms/int8_ms, max_err/max_out,
+        match ? "" : " MISMATCH", quantized ? "int8" : "fp32");
+
+    free(input);
+    free(weights);
+    free(bias);
+    free(expected);
+    free(output);
+    free(weights_q);
+    free(scales);
+    free(input_q);
+    free(input_scales);
+    free(buffer);
+    free(qbuffer);
+    return !match;
+}
+
+// End to end LinearLSTM: fp32 vs int8 converted in memory, then
+// round tripped through save_qweights/load_qweights
+int bench_int8_net(int num_agents) {
+    int input_dim = 968;
+    int atn_sum = 4;
+    int num_weights = 128*input_dim + 128 + atn_sum*128 + atn_sum + 128 + 1
+        + 4*128*128 + 4*128*128 + 8*128;
+    Weights* weights = calloc(1, sizeof(Weights) + num_weights*sizeof(float));
+    weights->data = (float*)(weights + 1);
+    weights->size = num_weights;
+    for (int i = 0; i < num_weights; i++) {
+        weights->data[i] = 0.1f*(rand()/(float)RAND_MAX - 0.5f);
+    }
+    float* obs = rand_buffer(num_agents*input_dim);
+    int logit_sizes[1] = {atn_sum};
+    int* actions = calloc(num_agents, sizeof(int));
+
+    LinearLSTM* net = make_linearlstm(weights, num_agents, input_dim, logit_sizes, 1);
+    weights->idx = 0;
+    QWeights* converted = convert_weights(weights);
+    QLinearLSTM* qnet = make_qlinearlstm(converted, num_agents, input_dim, logit_sizes, 1);
+
+    const char* path = "bench_puffernet_int8.bin";
+    save_qweights(converted, path);
+    QWeights* loaded = load_qweights(path);
+    remove(path);
+    if (loaded == NULL) {
+        printf("LinearLSTM int8 weights failed to reload\n");
+        return 1;
+    }
+    QLinearLSTM* loaded_net = make_qlinearlstm(loaded, num_agents, input_dim, logit_sizes, 1);
+
+    float max_err = 0;
+    float max_out = 0;
+    int agree = 0;
+    int total = 0;
+    int loaded_mismatch = 0;
+    for (int step = 0; step < 16; step++) {
+        forward_linearlstm(net, obs, actions);
+        forward_qlinearlstm(qnet, obs, actions);
+        forward_qlinearlstm(loaded_net, obs, actions);
+        for (int b = 0; b < num_agents; b++) {
+            float* ref = net->actor->output + b*atn_sum;
+            float* q = qnet->actor->output + b*atn_sum;
+            int ref_best = 0;
+            int q_best = 0;
+            for (int i = 0; i < atn_sum; i++) {
+                max_err = fmaxf(max_err, fabsf(ref[i] - q[i]));
+                max_out = fmaxf(max_out, fabsf(ref[i]));
+                ref_best = (ref[i] > ref[ref_best]) ? i : ref_best;
+                q_best = (q[i] > q[q_best]) ? i : q_best;
+            }
+            agree += (ref_best == q_best);
+            total++;
+        }
+        loaded_mismatch += memcmp(qnet->actor->output, loaded_net->actor->output,
+            num_agents*atn_sum*sizeof(float)) != 0;
+    }
+
+    int iters = 1;
+    double start = now();
+    while (now() - start < 0.5) {
+        forward_linearlstm(net, obs, actions);
+        iters++;
+    }
+    double fp32_ms = 1000*(now() - start)/iters;
+    iters = 1;
+    start = now();
+    while (now() - start < 0.5) {
+        forward_qlinearlstm(qnet, obs, actions);
+        iters++;
+    }
+    double int8_ms = 1000*(now() - start)/iters;
+
+    printf("LinearLSTM forward: fp32 %.3f ms, int8 %.3f ms (%.1fx)\n",
+        fp32_ms, int8_ms, fp32_ms/int8_ms);
+    printf("LinearLSTM logits over 16 steps: rel err %.1e, argmax agreement %.1f%%, "
+        "weights %zu -> %zu bytes, reload %s\n", max_err/max_out, 100.0f*agree/total,
+        num_weights*sizeof(float), converted->size, loaded_mismatch ? "MISMATCH" : "exact");
+    int failed = max_err > MAX_INT8_REL_ERR*max_out || agree < 0.95f*total
+        || loaded_mismatch || loaded->idx != loaded->size;
+
+    free_linearlstm(net);
+    free_qlinearlstm(qnet);
+    free_qlinearlstm(loaded_net);
+    free(converted);
+    free(loaded);
+    free(weights);
+    free(obs);
+    free(actions);
+    return failed;
+}
+
+// Continuous LinearContLSTM of drone_pp: the int8 means against a fp32
+// LinearLSTM built from the same weights after the log stds
+int bench_int8_contnet(int num_agents) {
+    int input_dim = 42;
+    int action_dim = 4;
+    int num_weights = action_dim + 128*input_dim + 128 + action_dim*128 + action_dim
+        + 128 + 1 + 4*128*128 + 4*128*128 + 8*128;
+    Weights* weights = calloc(1, sizeof(Weights) + num_weights*sizeof(float));
+    weights->data = (float*)(weights + 1);
+    weights->size = num_weights;
+    for (int i = 0; i < num_weights; i++) {
+        weights->data[i] = 0.1f*(rand()/(float)RAND_MAX - 0.5f);
+    }
+    float* obs = rand_buffer(num_agents*input_dim);
+    int logit_sizes[1] = {action_dim};
+    int* discrete = calloc(num_agents, sizeof(int));
+    float* means = calloc(num_agents*action_dim, sizeof(float));
+
+    weights->idx = action_dim;
+    LinearLSTM* net = make_linearlstm(weights, num_agents, input_dim, logit_sizes, 1);
+    weights->idx = 0;
+    QWeights* converted = convert_weights(weights);
+    QLinearContLSTM* qnet = make_qlinearcontlstm(converted, num_agents, input_dim, logit_sizes, 1);
+    int log_std_mismatch = memcmp(qnet->log_std, weights->data, action_dim*sizeof(float)) != 0;
+
+    float max_err = 0;
+    float max_out = 0;
+    for (int step = 0; step < 16; step++) {
+        forward_linearlstm(net, obs, discrete);
+        forward_qlinearcontlstm(qnet, obs, means);
+        for (int i = 0; i < num_agents*action_dim; i++) {
+            max_err = fmaxf(max_err, fabsf(net->actor->output[i] - means[i]));
+            max_out = fmaxf(max_out, fabsf(net->actor->output[i]));
+        }
+    }
+    int failed = max_err > MAX_INT8_REL_ERR*max_out || log_std_mismatch
+        || converted->idx != converted->size;
+    printf("LinearContLSTM means over 16 steps: rel err %.1e, log std %s, %s\n",
+        max_err/max_out, log_std_mismatch ? "MISMATCH" : "exact", failed ? "MISMATCH" : "ok");
+
+    free_linearlstm(net);
+    free_qlinearcontlstm(qnet);
+    free(converted);
+    free(weights);
+    free(obs);
+    free(discrete);
+    free(means);
+    return failed;
+}
+
+// Graph executor versions of LinearLSTM and ConvLSTM, built from weights in
+// the order their make_ functions read them
+typedef struct {
+    Graph* graph;
+    int actor;
+    int value;
+} GraphNet;
+
+Weights* rand_weights(int num_weights) {
+    Weights* weights = calloc(1, sizeof(Weights) + num_weights*sizeof(float));
+    weights->data = (float*)(weights + 1);
+    weights->size = num_weights;
+    for (int i = 0; i < num_weights; i++) {
+        weights->data[i] = 0.1f*(rand()/(float)RAND_MAX - 0.5f);
+    }
+    return weights;
+}
+
+GraphNet _graph_heads(Graph* graph, int h, float* actor_w, float* actor_b,
+        float* value_w, float* value_b, int hidden_dim, int action_dim) {
+    GraphNet net = {.graph = graph};
+    net.actor = graph_linear(graph, h, actor_w, actor_b, action_dim);
+    net.value = graph_linear(graph, h, value_w, value_b, 1);
+    graph_output(graph, net.actor);
+    graph_output(graph, net.value);
+    compile_graph(graph);
+    return net;
+}
+
+GraphNet graph_linearlstm(Weights* weights, int num_agents, int input_dim, int atn_sum) {
+    float* enc_w = get_weights(weights, 128*input_dim);
+    float* enc_b = get_weights(weights, 128);
+    float* actor_w = get_weights(weights, atn_sum*128);
+    float* actor_b = get_weights(weights, atn_sum);
+    float* value_w = get_weights(weights, 128);
+    float* value_b = get_weights(weights, 1);
+    Graph* graph = make_graph(num_agents, num_agents);
+    int x = graph_input(graph, input_dim);
+    x = graph_linear(graph, x, enc_w, enc_b, 128);
+    x = graph_activation(graph, x, ACT_GELU);
+    int h = graph_lstm(graph, x, weights, 128);
+    return _graph_heads(graph, h, actor_w, actor_b, value_w, value_b, 128, atn_sum);
+}
+
+GraphNet graph_convlstm(Weights* weights, int num_agents, int input_dim,
+        int input_channels, int cnn_channels, int hidden_dim, int action_dim) {
+    float* conv1_w = get_weights(weights, cnn_channels*input_channels*5*5);
+    float* conv1_b = get_weights(weights, cnn_channels);
+    float* conv2_w = get_weights(weights, cnn_channels*cnn_channels*3*3);
+    float* conv2_b = get_weights(weights, cnn_channels);
+    float* linear_w = get_weights(weights, hidden_dim*cnn_channels);
+    float* linear_b = get_weights(weights, hidden_dim);
+    float* actor_w = get_weights(weights, action_dim*hidden_dim);
+    float* actor_b = get_weights(weights, action_dim);
+    float* value_w = get_weights(weights, hidden_dim);
+    float* value_b = get_weights(weights, 1);
+    Graph* graph = make_graph(num_agents, num_agents);
+    int x = graph_input(graph, input_dim*input_dim*input_channels);
+    x = graph_conv2d(graph, x, conv1_w, conv1_b, input_dim, input_dim,
+        input_channels, cnn_channels, 5, 3);
+    x = graph_activation(graph, x, ACT_RELU);
+    x = graph_conv2d(graph, x, conv2_w, conv2_b, 3, 3, cnn_channels, cnn_channels, 3, 1);
+    x = graph_activation(graph, x, ACT_RELU);
+    x = graph_linear(graph, x, linear_w, linear_b, hidden_dim);
+    int h = graph_lstm(graph, x, weights, hidden_dim);
+    return _graph_heads(graph, h, actor_w, actor_b, value_w, value_b, hidden_dim, action_dim);
+}
+
+// The per-layer forwards without action sampling
+void linearlstm_layers(void* ptr, float* obs) {
+    LinearLSTM* net = ptr;
+    linear(net->encoder, obs);
+    gelu(net->gelu1, net->encoder->output);
+    lstm(net->lstm, net->gelu1->output);
+    linear(net->actor, net->lstm->state_h);
+    linear(net->value_fn, net->lstm->state_h);
+}
+
+void convlstm_layers(void* ptr, float* obs) {
+    ConvLSTM* net = ptr;
+    conv2d(net->conv1, obs);
+    relu(net->relu1, net->conv1->output);
+    conv2d(net->conv2, net->relu1->output);
+    relu(net->relu2, net->conv2->output);
+    linear(net->linear, net->relu2->output);
+    lstm(net->lstm, net->linear->output);
+    linear(net->actor, net->lstm->state_h);
+    linear(net->value_fn, net->lstm->state_h);
+}
+
+// Floats the per-layer structs allocate for activations and state,
+// following their make_ functions
+size_t linearlstm_floats(int num_agents, int atn_sum) {
+    return (size_t)num_agents*(128 + 128 + 6*128 + atn_sum + 1);
+}
+
+size_t convlstm_floats(int num_agents, int input_dim, int input_channels,
+        int cnn_channels, int hidden_dim, int action_dim) {
+    size_t per_agent = cnn_channels*input_dim*input_dim + hidden_dim*3*3
+        + cnn_channels*3*3 + hidden_dim + hidden_dim + 6*hidden_dim + action_dim + 1;
+    return num_agents*per_agent
+        + _conv2d_buffer_size(num_agents, input_dim, input_dim, input_channels, cnn_channels, 5, 3)
+        + _conv2d_buffer_size(num_agents, 3, 3, cnn_channels, cnn_channels, 3, 1);
+}
+
+// Max abs error of graph output rows against the reference rows of their agents
+float rows_err(float* out, float* ref, const int* agents, int batch_size, int dim, float* max_out) {
+    float max_err = 0;
+    for (int b = 0; b < batch_size; b++) {
+        float* ref_row = ref + ((agents == NULL) ? b : agents[b])*dim;
+        for (int i = 0; i < dim; i++) {
+            max_err = fmaxf(max_err, fabsf(out[b*dim + i] - ref_row[i]));
+            *max_out = fmaxf(*max_out, fabsf(ref_row[i]));
+        }
+    }
+    return max_err;
+}
+
+// Steps the reference net and two graphs built from the same weights. One
+// graph steps every agent in one call, the other in two calls of shuffled
+// agents whose split moves each step, so its batch size varies per call
+int bench_graph(const char* name, void* ref, void (*ref_forward)(void*, float*),
+        float* ref_actor, float* ref_value, size_t ref_floats, GraphNet full,
+        GraphNet split, int num_agents, int obs_dim, int action_dim) {
+    float* obs = rand_buffer(num_agents*obs_dim);
+    float* split_obs = calloc(num_agents*obs_dim, sizeof(float));
+    int* agents = calloc(num_agents, sizeof(int));
+    for (int i = 0; i < num_agents; i++) {
+        agents[i] = i;
+    }
+
+    float max_err = 0;
+    float max_out = 0;
+    for (int step = 0; step < 16; step++) {
+        ref_forward(ref, obs);
+        forward_graph(full.graph, obs, num_agents, NULL);
+        max_err = fmaxf(max_err, rows_err(graph_tensor(full.graph, full.actor),
+            ref_actor, NULL, num_agents, action_dim, &max_out));
+        max_err = fmaxf(max_err, rows_err(graph_tensor(full.graph, full.value),
+            ref_value, NULL, num_agents, 1, &max_out));
+
+        for (int i = num_agents - 1; i > 0; i--) {
+            int j = rand() % (i + 1);
+            int tmp = agents[i];
+            agents[i] = agents[j];
+            agents[j] = tmp;
+        }
+        int cut = (num_agents > 1) ? 1 + rand() % (num_agents - 1) : num_agents;
+        for (int start = 0; start < num_agents; start = cut, cut = num_agents) {
+            int batch_size = cut - start;
+            int* rows = agents + start;
+            for (int b = 0; b < batch_size; b++) {
+                memcpy(split_obs + b*obs_dim, obs + rows[b]*obs_dim, obs_dim*sizeof(float));
+            }
+            forward_graph(split.graph, split_obs, batch_size, rows);
+            max_err = fmaxf(max_err, rows_err(graph_tensor(split.graph, split.actor),
+                ref_actor, rows, batch_size, action_dim, &max_out));
+            max_err = fmaxf(max_err, rows_err(graph_tensor(split.graph, split.value),
+                ref_value, rows, batch_size, 1, &max_out));
+        }
+    }
+
+    int iters = 1;
+    double start = now();
+    while (now() - start < 0.5) {
+        ref_forward(ref, obs);
+        iters++;
+    }
+    double layers_ms = 1000*(now() - start)/iters;
+    iters = 1;
+    start = now();
+    while (now() - start < 0.5) {
+        forward_graph(full.graph, obs, num_agents, NULL);
+        iters++;
+    }
+    double graph_ms = 1000*(now() - start)/iters;
+
+    Graph* g = full.graph;
+    size_t graph_floats = g->planned_size*g->max_batch + g->state_size;
+    bool match = max_err <= MAX_REL_ERR*max_out;
+    printf("%s graph: per-layer %.3f ms, graph %.3f ms (%.2fx) | activations per agent "
+        "%zu -> %zu floats planned | memory %zu -> %zu floats | rel err %.1e %s\n",
+        name, layers_ms, graph_ms, layers_ms/graph_ms, g->naive_size, g->planned_size,
+        ref_floats, graph_floats, max_err/max_out, match ? "ok" : "MISMATCH");
+
+    free(obs);
+    free(split_obs);
+    free(agents);
+    return !match;
+}
+
+int bench_graph_linearlstm(int num_agents) {
+    int input_dim = 968;
+    int atn_sum = 4;
+    int num_weights = 128*input_dim + 128 + atn_sum*128 + atn_sum + 128 + 1
+        + 4*128*128 + 4*128*128 + 8*128;
+    Weights* weights = rand_weights(num_weights);
+    int logit_sizes[1] = {atn_sum};
+    LinearLSTM* net = make_linearlstm(weights, num_agents, input_dim, logit_sizes, 1);
+    weights->idx = 0;
+    GraphNet full = graph_linearlstm(weights, num_agents, input_dim, atn_sum);
+    weights->idx = 0;
+    GraphNet split = graph_linearlstm(weights, num_agents, input_dim, atn_sum);
+
+    int failed = bench_graph("LinearLSTM", net, linearlstm_layers, net->actor->output,
+        net->value_fn->output, linearlstm_floats(num_agents, atn_sum), full, split,
+        num_agents, input_dim, atn_sum);
+
+    free_linearlstm(net);
+    free_graph(full.graph);
+    free_graph(split.graph);
+    free(weights);
+    return failed;
+}
+
+// Shapes of trash_pickup
+int bench_graph_convlstm(int num_agents) {
+    int input_dim = 11;
+    int input_channels = 5;
+    int cnn_channels = 32;
+    int hidden_dim = 128;
+    int action_dim = 4;
+    int num_weights = cnn_channels*input_channels*5*5 + cnn_channels
+        + cnn_channels*cnn_channels*3*3 + cnn_channels + hidden_dim*cnn_channels + hidden_dim
+        + action_dim*hidden_dim + action_dim + hidden_dim + 1
+        + 4*hidden_dim*hidden_dim + 4*hidden_dim*hidden_dim + 8*hidden_dim;
+    Weights* weights = rand_weights(num_weights);
+    ConvLSTM* net = make_convlstm(weights, num_agents, input_dim, input_channels,
+        cnn_channels, hidden_dim, action_dim);
+    weights->idx = 0;
+    GraphNet full = graph_convlstm(weights, num_agents, input_dim, input_channels,
+        cnn_channels, hidden_dim, action_dim);
+    weights->idx = 0;
+    GraphNet split = graph_convlstm(weights, num_agents, input_dim, input_channels,
+        cnn_channels, hidden_dim, action_dim);
+
+    size_t ref_floats = convlstm_floats(num_agents, input_dim, input_channels,
+        cnn_channels, hidden_dim, action_dim);
+    int failed = bench_graph("ConvLSTM", net, convlstm_layers, net->actor->output,
+        net->value_fn->output, ref_floats, full, split, num_agents,
+        input_dim*input_dim*input_channels, action_dim);
+
+    free_convlstm(net);
+    free_graph(full.graph);
+    free_graph(split.graph);
+    free(weights);
+    return failed;
+}
+
+int main(int argc, char** argv) {
+    int batch_size = (argc > 1) ? atoi(argv[1]) : 1024;
+    const char* kernels[] = {"scalar", "avx2", "avx512"};
+    const char* best = gemm_kernel_name();
+    printf("num_agents=%d, ms per call, speedup vs original loops\n", batch_size);
+
+    int failures = 0;
+    for (int si = 0; si < NUM_SHAPES; si++) {
+        Shape* s = &shapes[si];
+        size_t in_size = s->input_dim;
+        size_t out_size = s->output_dim;
+        size_t num_weights = s->input_dim*s->output_dim;
+        if (s->is_conv) {
+            int h_out = (s->in_height - s->kernel_size)/s->stride + 1;
+            int w_out = (s->in_width - s->kernel_size)/s->stride + 1;
+            in_size *= s->in_width*s->in_height;
+            out_size *= h_out*w_out;
+            num_weights *= s->kernel_size*s->kernel_size;
+        }
+        float* input = rand_buffer(batch_size*in_size);
+        float* weights = rand_buffer(num_weights);
+        float* bias = rand_buffer(s->output_dim);
+        float* expected = calloc(batch_size*out_size, sizeof(float));
+        float* output = calloc(batch_size*out_size, sizeof(float));
+        float* buffer = make_conv_buffer(s, batch_size);
+
+        int iters = 1;
+        double start = now();
+        while (now() - start < 0.2) {
+            run_ref(s, batch_size, input, weights, bias, expected);
+            iters++;
+        }
+        double ref_ms = 1000*(now() - start)/iters;
+        printf("%-32s original %8.3f", s->name, ref_ms);
+        float max_out = 0;
+        for (size_t i = 0; i < batch_size*out_size; i++) {
+            max_out = fmaxf(max_out, fabsf(expected[i]));
+        }
+
+        for (int ki = 0; ki < 3; ki++) {
+            if (!set_gemm_kernel(kernels[ki])) {
+                continue;
+            }
+            run(s, batch_size, input, weights, bias, output, buffer);
+            float max_err = 0;
+            for (size_t i = 0; i < batch_size*out_size; i++) {
+                max_err = fmaxf(max_err, fabsf(output[i] - expected[i]));
+            }
+            bool match = max_err <= MAX_REL_ERR*max_out;
+            failures += !match;
+            iters = 1;
+            start = now();
+            while (now() - start < 0.2) {
+                run(s, batch_size, input, weights, bias, output, buffer);
+                iters++;
+            }
+            double ms = 1000*(now() - start)/iters;
+            printf(" | %s %8.3f (%5.1fx, err %.1e%s)", kernels[ki], ms, ref_ms/ms,
+                max_err, match ? "" : " MISMATCH");
+        }
+        printf("\n");
+
+        free(input);
+        free(weights);
+        free(bias);
+        free(expected);
+        free(output);
+        free(buffer);
+    }
+
+    set_gemm_kernel(best);
+
+    printf("int8 vs fp32 with the %s kernels\n", best);
+    for (int si = 0; si < NUM_SHAPES; si++) {
+        failures += bench_int8_shape(&shapes[si], batch_size);
+    }
+    failures += bench_int8_net(batch_size);
+    failures += bench_int8_contnet(batch_size);
+
+    printf("graph executor vs per-layer structs\n");
+    failures += bench_graph_linearlstm(batch_size);
+    failures += bench_graph_convlstm(batch_size);
+    return failures != 0;
+}
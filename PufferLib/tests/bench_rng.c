@@ -0,0 +1,170 @@
+// Microbenchmark for the Ocean RNG (pufferlib/ocean/rng.h) against libc
+// rand(), single threaded and with every thread drawing at once as envs do
+// under the vec worker pool. glibc rand() takes a lock on each call.
+// Also checks the draws: puffer_rand_fill must return exactly what as many
+// puffer_randf calls would, streams must replay from their seed, and
+// puffer_randint must stay in [lo, hi) with no bucket further than
+// MAX_BUCKET_DEV from uniform. Exits non-zero on any failure.
+// Build: gcc -O2 -pthread -I./pufferlib/ocean tests/bench_rng.c -o bench_rng -lm
+// Run: ./bench_rng [num_threads]
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+#include <time.h>
+#include "rng.h"
+
+#define DRAWS (1 << 24)
+// Relative deviation of a bucket count from uniform. With 1 << 22 draws
+// over at most 7 buckets, sampling noise is under 0.2%
+#define MAX_BUCKET_DEV 0.01
+#define BIAS_DRAWS (1 << 22)
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+void* draw_libc(void* arg) {
+    float sum = 0;
+    for (int i = 0; i < DRAWS; i++) {
+        sum += (float)rand()/(float)RAND_MAX;
+    }
+    *(float*)arg = sum;
+    return NULL;
+}
+
+void* draw_puffer(void* arg) {
+    PufferRng rng;
+    puffer_rng_seed(&rng, (uint64_t)*(float*)arg);
+    float sum = 0;
+    for (int i = 0; i < DRAWS; i++) {
+        sum += puffer_randf(&rng);
+    }
+    *(float*)arg = sum;
+    return NULL;
+}
+
+void* draw_fill(void* arg) {
+    PufferRng rng;
+    puffer_rng_seed(&rng, (uint64_t)*(float*)arg);
+    float buf[1024];
+    float sum = 0;
+    for (int i = 0; i < DRAWS; i += 1024) {
+        puffer_rand_fill(&rng, buf, 1024);
+        sum += buf[i & 1023];
+    }
+    *(float*)arg = sum;
+    return NULL;
+}
+
+// ns per draw per thread
+double bench(void* (*fn)(void*), int num_threads) {
+    pthread_t threads[64];
+    float out[64];
+    double start = now();
+    for (int t = 0; t < num_threads; t++) {
+        out[t] = (float)t;
+        pthread_create(&threads[t], NULL, fn, &out[t]);
+    }
+    for (int t = 0; t < num_threads; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    return 1e9*(now() - start)/DRAWS;
+}
+
+// Odd lengths cover the scalar tail of the vector fill
+int check_fill() {
+    int failures = 0;
+    int lengths[] = {1, 7, 8, 9, 1023, 4096};
+    for (size_t l = 0; l < sizeof(lengths)/sizeof(lengths[0]); l++) {
+        int n = lengths[l];
+        float* filled = calloc(n, sizeof(float));
+        PufferRng a, b;
+        puffer_rng_seed(&a, 1234 + n);
+        puffer_rng_seed(&b, 1234 + n);
+        puffer_randf(&a);
+        puffer_randf(&b);
+        puffer_rand_fill(&a, filled, n);
+        for (int i = 0; i < n; i++) {
+            float x = puffer_randf(&b);
+            if (filled[i] != x || x < 0.0f || x >= 1.0f) {
+                failures++;
+            }
+        }
+        failures += puffer_randf(&a) != puffer_randf(&b);
+        free(filled);
+    }
+    printf("puffer_rand_fill vs puffer_randf: %s\n", failures ? "MISMATCH" : "ok");
+    return failures;
+}
+
+int check_replay() {
+    PufferRng a, b, c;
+    puffer_rng_seed(&a, 42);
+    puffer_rng_seed(&b, 42);
+    puffer_rng_seed(&c, 43);
+    int failures = 0;
+    int same_as_c = 0;
+    for (int i = 0; i < 1024; i++) {
+        int x = puffer_rand(&a);
+        failures += x != puffer_rand(&b);
+        same_as_c += x == puffer_rand(&c);
+    }
+    failures += same_as_c > 1;
+    printf("seed replay: %s\n", failures ? "MISMATCH" : "ok");
+    return failures;
+}
+
+int check_randint() {
+    int failures = 0;
+    PufferRng rng;
+    puffer_rng_seed(&rng, 7);
+    int bounds[][2] = {{0, 1}, {0, 2}, {-3, 4}, {5, 9}, {0, 100000}, {0, 1 << 30}, {-(1 << 30), 1 << 30}};
+    for (size_t b = 0; b < sizeof(bounds)/sizeof(bounds[0]); b++) {
+        int lo = bounds[b][0];
+        int hi = bounds[b][1];
+        for (int i = 0; i < 100000; i++) {
+            int x = puffer_randint(&rng, lo, hi);
+            failures += x < lo || x >= hi;
+        }
+    }
+
+    // For range 3*2^29, rand() % n would draw the low third of the range
+    // twice as often as the rest
+    long long counts[7] = {0};
+    int ranges[] = {3, 7, 3 << 29};
+    double max_dev = 0;
+    for (size_t r = 0; r < sizeof(ranges)/sizeof(ranges[0]); r++) {
+        int range = ranges[r];
+        int buckets = (range <= 7) ? range : 3;
+        memset(counts, 0, sizeof(counts));
+        for (int i = 0; i < BIAS_DRAWS; i++) {
+            int x = puffer_randint(&rng, 0, range);
+            counts[(long long)x*buckets/range]++;
+        }
+        for (int k = 0; k < buckets; k++) {
+            double dev = fabs(counts[k]*(double)buckets/BIAS_DRAWS - 1.0);
+            max_dev = (dev > max_dev) ? dev : max_dev;
+        }
+    }
+    failures += max_dev > MAX_BUCKET_DEV;
+    printf("puffer_randint bounds and bias: max bucket dev %.4f %s\n", max_dev,
+        failures ? "MISMATCH" : "ok");
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    int failures = check_fill() + check_replay() + check_randint();
+
+    int max_threads = (argc > 1) ? atoi(argv[1]) : 8;
+    max_threads = (max_threads > 64) ? 64 : max_threads;
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+        double libc_ns = bench(draw_libc, threads);
+        double puffer_ns = bench(draw_puffer, threads);
+        double fill_ns = bench(draw_fill, threads);
+        printf("%2d threads | rand() %6.2f ns | puffer_randf %5.2f ns (%5.1fx) | puffer_rand_fill %5.2f ns (%5.1fx)\n",
+            threads, libc_ns, puffer_ns, libc_ns/puffer_ns, fill_ns, libc_ns/fill_ns);
+    }
+    return failures != 0;
+}
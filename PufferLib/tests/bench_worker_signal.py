@@ -0,0 +1,97 @@
+'''Benchmark for vector.Multiprocessing worker signaling: futex wait/notify
+from the worker_signal extension against the original shared memory polling.
+Reports step throughput with more workers than cores and the CPU workers
+burn while the main process is busy elsewhere (e.g. training).
+
+Each env observes its own step count and the last action it was sent, so
+every batch is checked against what the main process sent to those envs.
+Exits non-zero if either signaling path returns a stale or wrong batch.
+
+Build the extension first: python setup.py build_ext --inplace
+Run: python tests/bench_worker_signal.py [num_workers]
+'''
+import sys
+import time
+
+import gymnasium
+import numpy as np
+import psutil
+
+import pufferlib.emulation
+import pufferlib.vector
+
+STEPS = 2000
+IDLE_SECONDS = 1.0
+
+class Work(gymnasium.Env):
+    '''Fixed amount of Python work per step. Observes (steps, last action)'''
+    def __init__(self, work=200):
+        self.observation_space = gymnasium.spaces.Box(
+            low=-1, high=1, shape=(4,), dtype=np.float32)
+        self.action_space = gymnasium.spaces.Discrete(2)
+        self.observation = np.zeros(4, dtype=np.float32)
+        self.work = work
+
+    def reset(self, seed=None):
+        self.observation[:] = (0, -1, 0, 0)
+        return self.observation, {}
+
+    def step(self, action):
+        total = 0
+        for i in range(self.work):
+            total += i
+        self.observation[0] += 1
+        self.observation[1] = action
+        return self.observation, 0, False, False, {}
+
+def make_env(buf=None, seed=0):
+    return pufferlib.emulation.GymnasiumPufferEnv(env_creator=Work, buf=buf, seed=seed)
+
+def worker_cpu(vecenv):
+    return sum(sum(psutil.Process(p.pid).cpu_times()[:2]) for p in vecenv.processes)
+
+def bench(name, num_workers, batch_workers):
+    vecenv = pufferlib.vector.make(make_env, num_envs=num_workers,
+        num_workers=num_workers, batch_size=batch_workers,
+        backend=pufferlib.vector.Multiprocessing, overwork=True)
+    vecenv.async_reset(0)
+    steps = np.zeros(num_workers, dtype=np.float32)
+    last_action = np.full(num_workers, -1, dtype=np.float32)
+    obs, _, _, _, _, ids, _ = vecenv.recv()
+    mismatches = 0
+    start = time.time()
+    for t in range(STEPS):
+        mismatches += not (np.array_equal(obs[:, 0], steps[ids])
+            and np.array_equal(obs[:, 1], last_action[ids]))
+        actions = ((ids + t) % 2).astype(np.int32)
+        vecenv.send(actions)
+        steps[ids] += 1
+        last_action[ids] = actions
+        obs, _, _, _, _, ids, _ = vecenv.recv()
+    sps = STEPS*batch_workers/(time.time() - start)
+
+    # Workers are done and waiting while the main process does other work
+    cpu = worker_cpu(vecenv)
+    time.sleep(IDLE_SECONDS)
+    idle = (worker_cpu(vecenv) - cpu)/IDLE_SECONDS
+    vecenv.close()
+    print(f'{name:8s} | {num_workers} workers, batch {batch_workers} | '
+        f'{sps:9.0f} env steps/s | idle workers use {100*idle:5.1f}% of a core | '
+        f'{mismatches} of {STEPS} batches wrong {"MISMATCH" if mismatches else "ok"}')
+    return mismatches
+
+if __name__ == '__main__':
+    num_workers = int(sys.argv[1]) if len(sys.argv) > 1 else 2*psutil.cpu_count()
+    signal = pufferlib.vector.worker_signal
+    if signal is None:
+        print('worker_signal extension not built, only polling is measured')
+
+    failures = 0
+    for batch_workers in (num_workers, num_workers // 2):
+        pufferlib.vector.worker_signal = None
+        failures += bench('polling', num_workers, batch_workers)
+        if signal is not None:
+            pufferlib.vector.worker_signal = signal
+            failures += bench('futex', num_workers, batch_workers)
+
+    sys.exit(failures != 0)
@@ -0,0 +1,73 @@
+'''Builds and runs the standalone C benches and tests in tests/. Each one
+compares its new code path against a reference and exits non-zero on a
+mismatch, so a non-zero exit fails here. Sources are found by the
+"// Build:" line in their header, which is run from the repo root with
+the binary redirected to a temp dir. Sources are skipped when the
+compiler, a directory or library their build line names (raylib, box2d),
+or a resources/ file they read is missing.
+'''
+import re
+import shlex
+import shutil
+import subprocess
+from pathlib import Path
+
+import pytest
+
+ROOT = Path(__file__).resolve().parent.parent
+TESTS = ROOT / 'tests'
+TIMEOUT = 900
+
+
+def discover():
+    sources = []
+    for pattern in ('bench_*.c', 'bench_*.cpp', 'test_*.c'):
+        for path in sorted(TESTS.glob(pattern)):
+            if build_line(path) is not None:
+                sources.append(path)
+    return sources
+
+
+def build_line(path):
+    for line in path.read_text().splitlines():
+        if line.startswith('// Build:'):
+            return line[len('// Build:'):].strip()
+    return None
+
+
+def missing_dependency(path, argv):
+    '''Returns what the build or run needs but this checkout lacks, if anything'''
+    if shutil.which(argv[0]) is None:
+        return argv[0]
+    for arg in argv[1:]:
+        if arg.startswith(('-I', '-L')):
+            dep = arg[2:]
+        elif arg.startswith('./'):
+            dep = arg
+        else:
+            continue
+        if not (ROOT / dep).exists():
+            return dep
+    for resource in re.findall(r'"(resources/[^"%]+)"', path.read_text()):
+        if not (ROOT / resource).exists():
+            return resource
+    return None
+
+
+@pytest.mark.parametrize('path', discover(), ids=lambda p: p.name)
+def test_c_bench(path, tmp_path):
+    argv = shlex.split(build_line(path))
+    out = argv.index('-o')
+    binary = tmp_path / Path(argv[out + 1]).name
+    argv[out + 1] = str(binary)
+
+    missing = missing_dependency(path, argv)
+    if missing is not None:
+        pytest.skip(f'{missing} not found')
+
+    build = subprocess.run(argv, cwd=ROOT, capture_output=True, text=True)
+    assert build.returncode == 0, build.stderr
+
+    run = subprocess.run([str(binary)], cwd=ROOT, capture_output=True,
+        text=True, timeout=TIMEOUT)
+    assert run.returncode == 0, run.stdout + run.stderr
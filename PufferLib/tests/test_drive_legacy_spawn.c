@@ -0,0 +1,94 @@
+// Checks that envs built from a legacy drive map binary spawn every entity
+// where an env built from the same map converted to the scenario format
+// does: at the start of its trajectory, or off the map if it was removed at
+// start. The heap is dirtied first so fields the legacy loader forgets to
+// initialize show up. Exits non-zero if any spawn differs.
+// Build: gcc -O2 -I./raylib-5.5_linux_amd64/include -I./pufferlib/ocean/drive tests/test_drive_legacy_spawn.c -o test_drive_legacy_spawn ./raylib-5.5_linux_amd64/lib/libraylib.a -lm -lpthread -ldl
+// Run: ./test_drive_legacy_spawn [resources/drive/map_942.bin]
+#include <stdio.h>
+#include <stdlib.h>
+#include "drive.h"
+
+#define SCENARIO_PATH "/tmp/test_drive_legacy_spawn.scn"
+
+// Frees a block of garbage the size of the entity array, which the legacy
+// loader's allocation then reuses
+void dirty_heap(const char* path) {
+    FILE* file = fopen(path, "rb");
+    int counts[2] = {0, 0};
+    if (file == NULL || fread(counts, sizeof(int), 2, file) != 2) {
+        if (file != NULL) {
+            fclose(file);
+        }
+        return;
+    }
+    fclose(file);
+    size_t bytes = (size_t)(counts[0] + counts[1])*sizeof(Entity);
+    void* garbage = malloc(bytes);
+    memset(garbage, 0x5a, bytes);
+    free(garbage);
+}
+
+bool is_static_car(Drive* env, int idx) {
+    for (int i = 0; i < env->static_car_count; i++) {
+        if (env->static_car_indices[i] == idx) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Returns the number of entities that spawn wrong
+int check_spawns(Drive* legacy, Drive* scenario) {
+    int failures = 0;
+    for (int i = 0; i < legacy->num_entities; i++) {
+        Entity* e = &legacy->entities[i];
+        Entity* s = &scenario->entities[i];
+        bool removed = e->removed_at_start;
+        float start_x = removed ? -10000 : e->traj_x[0];
+        float start_y = removed ? -10000 : e->traj_y[0];
+        bool ok = e->removed_at_start == s->removed_at_start
+            && e->x == s->x && e->y == s->y && e->z == s->z
+            && e->x == start_x && e->y == start_y
+            && (!removed || is_static_car(legacy, i));
+        if (!ok && failures < 5) {
+            printf("entity %d: legacy (%.2f, %.2f) removed %d, scenario (%.2f, %.2f) removed %d\n",
+                i, e->x, e->y, e->removed_at_start, s->x, s->y, s->removed_at_start);
+        }
+        failures += !ok;
+    }
+    return failures;
+}
+
+int main(int argc, char** argv) {
+    const char* legacy_path = (argc > 1) ? argv[1] : "resources/drive/map_942.bin";
+    if (convert_map_binary(legacy_path, SCENARIO_PATH, 0) != 0) {
+        printf("Failed to convert %s\n", legacy_path);
+        return 1;
+    }
+
+    dirty_heap(legacy_path);
+    Drive legacy = {.map_name = (char*)legacy_path};
+    allocate(&legacy);
+    Drive scenario = {.map_name = SCENARIO_PATH};
+    allocate(&scenario);
+    if (scenario.scenario == NULL || legacy.num_entities != scenario.num_entities
+            || legacy.active_agent_count != scenario.active_agent_count) {
+        printf("Scenario env does not match the legacy env\n");
+        return 1;
+    }
+
+    int failures = check_spawns(&legacy, &scenario);
+    c_reset(&legacy);
+    c_reset(&scenario);
+    failures += check_spawns(&legacy, &scenario);
+    int removed = 0;
+    for (int i = 0; i < legacy.num_entities; i++) {
+        removed += legacy.entities[i].removed_at_start;
+    }
+    printf("%d entities, %d agents, %d removed at start: %s\n", legacy.num_entities,
+        legacy.active_agent_count, removed, failures ? "MISMATCH" : "ok");
+    free_allocated(&legacy);
+    free_allocated(&scenario);
+    return failures != 0;
+}
@@ -0,0 +1,91 @@
+// Checks move_drones (drone_lanes.h) against move_drone, the scalar rk4_step
+// path, one step at a time from shared random states. Drone counts include
+// partial lane groups, and states include velocities and body rates past
+// the clamps. Exits non-zero if any state field differs by more than
+// MAX_ERR*(1 + |scalar value|).
+// Build: gcc -O2 -I./raylib-5.5_linux_amd64/include -I./pufferlib/ocean -I./pufferlib/ocean/drone_pp tests/test_drone_lanes.c -o test_drone_lanes -lm
+// Run: ./test_drone_lanes
+#include "dronelib.h"
+#include "drone_lanes.h"
+
+#define STEPS 64
+// The lanes rotate thrust in closed form and normalize with a Newton rsqrt,
+// so they round differently from rk4_step: about 1e-5 at the extremes
+#define MAX_ERR 1e-4f
+
+float state_err(State* a, State* b) {
+    float* x = (float*)a;
+    float* y = (float*)b;
+    float max_err = 0;
+    for (int i = 0; i < (int)(sizeof(State)/sizeof(float)); i++) {
+        float err = fabsf(x[i] - y[i])/(1.0f + fabsf(x[i]));
+        max_err = fmaxf(max_err, err);
+    }
+    return max_err;
+}
+
+void rnd_state(PufferRng* rng, Drone* drone) {
+    State* s = &drone->state;
+    s->pos = (Vec3){rndf(rng, -GRID_X, GRID_X), rndf(rng, -GRID_Y, GRID_Y), rndf(rng, -GRID_Z, GRID_Z)};
+    s->vel = (Vec3){rndf(rng, -60, 60), rndf(rng, -60, 60), rndf(rng, -60, 60)};
+    s->quat = rndquat(rng);
+    s->omega = (Vec3){rndf(rng, -60, 60), rndf(rng, -60, 60), rndf(rng, -60, 60)};
+    for (int i = 0; i < 4; i++) {
+        s->rpms[i] = rndf(rng, 0, drone->params.max_rpm);
+    }
+}
+
+int main() {
+    PufferRng rng_state;
+    puffer_rng_seed(&rng_state, 42);
+    PufferRng* rng = &rng_state;
+    int counts[] = {1, 15, 16, 17, 100};
+    int failures = 0;
+    for (int c = 0; c < (int)(sizeof(counts)/sizeof(counts[0])); c++) {
+        int n = counts[c];
+        Drone* scalar = calloc(n, sizeof(Drone));
+        Drone* lanes = calloc(n, sizeof(Drone));
+        float* scalar_actions = calloc(4*n, sizeof(float));
+        float* lane_actions = calloc(4*n, sizeof(float));
+        for (int i = 0; i < n; i++) {
+            init_drone(rng, &scalar[i], rndf(rng, 0.1f, 0.4f), 0.1f);
+        }
+
+        float max_err = 0;
+        for (int step = 0; step < STEPS; step++) {
+            for (int i = 0; i < n; i++) {
+                rnd_state(rng, &scalar[i]);
+            }
+            for (int i = 0; i < 4*n; i++) {
+                scalar_actions[i] = rndf(rng, -1.5f, 1.5f);
+            }
+            memcpy(lanes, scalar, n*sizeof(Drone));
+            memcpy(lane_actions, scalar_actions, 4*n*sizeof(float));
+
+            for (int i = 0; i < n; i++) {
+                move_drone(rng, &scalar[i], &scalar_actions[4*i]);
+            }
+            move_drones(rng, lanes, lane_actions, n);
+
+            for (int i = 0; i < n; i++) {
+                max_err = fmaxf(max_err, state_err(&scalar[i].state, &lanes[i].state));
+                if (memcmp(&scalar[i].prev_pos, &lanes[i].prev_pos, sizeof(Vec3)) != 0) {
+                    max_err = INFINITY;
+                }
+            }
+            if (memcmp(scalar_actions, lane_actions, 4*n*sizeof(float)) != 0) {
+                max_err = INFINITY;
+            }
+        }
+
+        bool match = max_err <= MAX_ERR;
+        failures += !match;
+        printf("%3d drones, %d steps: max rel err %.1e %s\n", n, STEPS, max_err,
+            match ? "ok" : "MISMATCH");
+        free(scalar);
+        free(lanes);
+        free(scalar_actions);
+        free(lane_actions);
+    }
+    return failures != 0;
+}
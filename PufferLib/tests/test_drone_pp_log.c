@@ -0,0 +1,110 @@
+// Checks the pick and place logs of drone_pp: each c_step must add every
+// agent's phase flags to the log exactly once, from the states the agents
+// end the step in. Also prints the c_step cost per agent, which should stay
+// flat as num_agents grows. Exits non-zero if any step's log differs from
+// one pass over the agents.
+// Build: gcc -O2 -I./raylib-5.5_linux_amd64/include -I./pufferlib/ocean -I./pufferlib/ocean/drone_pp tests/test_drone_pp_log.c -o test_drone_pp_log -lm
+// Run: ./test_drone_pp_log
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include "drone_pp.h"
+
+// Stays clear of the horizon reset, which clears the flags after logging
+#define STEPS 200
+
+double now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec*1e-9;
+}
+
+// Same sums, in the same order, as one log_pp2 pass
+void ref_log_pp2(DronePP* env, Log* log) {
+    for (int i = 0; i < env->num_agents; i++) {
+        Drone *a = &env->agents[i];
+        log->dist += env->dist;
+        log->dist100 += 100 - env->dist;
+        log->jitter += a->jitter;
+        if (a->approaching_pickup) log->to_pickup += 1.0f;
+        if (a->hovering_pickup) log->ho_pickup += 1.0f;
+        if (a->descent_pickup) log->de_pickup += 1.0f;
+        if (a->gripping) log->gripping += 1.0f;
+        if (a->delivered) log->delivered += 1.0f;
+        if (a->perfect_grip && env->grip_k < 1.01f) log->perfect_grip += 1.0f;
+        if (a->perfect_deliv && env->grip_k < 1.01f && a->perfect_grip) log->perfect_deliv += 1.0f;
+        if (a->approaching_drop) log->to_drop += 1.0f;
+        if (a->hovering_drop) log->ho_drop += 1.0f;
+    }
+}
+
+bool pp2_log_equal(Log* a, Log* b) {
+    return a->dist == b->dist && a->dist100 == b->dist100 && a->jitter == b->jitter
+        && a->to_pickup == b->to_pickup && a->ho_pickup == b->ho_pickup
+        && a->de_pickup == b->de_pickup && a->gripping == b->gripping
+        && a->delivered == b->delivered && a->perfect_grip == b->perfect_grip
+        && a->perfect_deliv == b->perfect_deliv && a->to_drop == b->to_drop
+        && a->ho_drop == b->ho_drop;
+}
+
+// Returns the number of steps whose log was wrong
+int test(int num_agents) {
+    DronePP env = {0};
+    puffer_rng_seed(&env.rng, 42);
+    env.num_agents = num_agents;
+    env.max_rings = 10;
+    env.reward_min_dist = 1.6;
+    env.reward_max_dist = 77.0;
+    env.dist_decay = 0.5;
+    env.w_position = 1.13;
+    env.w_velocity = 0.15;
+    env.w_stability = 2.0;
+    env.w_approach = 2.2;
+    env.w_hover = 1.5;
+    env.pos_const = 0.63;
+    env.pos_penalty = 0.03;
+    env.grip_k_min = 1.0;
+    env.grip_k_max = 15.0;
+    env.grip_k_decay = 0.095;
+    init(&env);
+    env.observations = calloc(num_agents*42, sizeof(float));
+    env.actions = calloc(num_agents*4, sizeof(float));
+    env.rewards = calloc(num_agents, sizeof(float));
+    env.terminals = calloc(num_agents, sizeof(unsigned char));
+    c_reset(&env);
+
+    int failures = 0;
+    double elapsed = 0;
+    for (int step = 0; step < STEPS; step++) {
+        for (int i = 0; i < 4*num_agents; i++) {
+            env.actions[i] = rndf(&env.rng, -1, 1);
+        }
+        Log expected = env.log;
+        double start = now();
+        c_step(&env);
+        elapsed += now() - start;
+        ref_log_pp2(&env, &expected);
+        failures += !pp2_log_equal(&env.log, &expected);
+    }
+
+    printf("%5d agents, %d steps: %6.3f us per agent step, to_pickup %.0f %s\n",
+        num_agents, STEPS, 1e6*elapsed/(STEPS*num_agents), env.log.to_pickup,
+        failures ? "MISMATCH" : "ok");
+    free(env.observations);
+    free(env.actions);
+    free(env.rewards);
+    free(env.terminals);
+    free(env.agents);
+    free(env.ring_buffer);
+    c_close(&env);
+    return failures;
+}
+
+int main() {
+    int sizes[] = {1, 16, 64, 256, 1024};
+    int failures = 0;
+    for (size_t i = 0; i < sizeof(sizes)/sizeof(sizes[0]); i++) {
+        failures += test(sizes[i]);
+    }
+    return failures != 0;
+}
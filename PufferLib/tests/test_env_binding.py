@@ -1,3 +1,5 @@
+import numpy as np
+
 from pufferlib.ocean.breakout import breakout
 
 kwargs = dict(
@@ -12,6 +14,9 @@ kwargs = dict(
     brick_height=12,
     brick_rows=6,
     brick_cols=18,
+    initial_ball_speed=256,
+    max_ball_speed=448,
+    paddle_speed=620,
     continuous=False,
 )
 
@@ -60,6 +65,52 @@ def test_env_binding():
     breakout.binding.vec_step(c_envs)
     breakout.binding.vec_close(c_envs)
 
+    # Threaded vec usage
+    c_envs = breakout.binding.vec_init(
+        reference.observations,
+        reference.actions,
+        reference.rewards,
+        reference.terminals,
+        reference.truncations,
+        reference.num_agents,
+        0,
+        num_threads=4,
+        **kwargs
+    )
+    breakout.binding.vec_reset(c_envs, 0)
+    for _ in range(16):
+        breakout.binding.vec_step(c_envs)
+    breakout.binding.vec_close(c_envs)
+
+    # Async vec usage
+    for num_threads in (1, 4):
+        c_envs = breakout.binding.vec_init(
+            reference.observations,
+            reference.actions,
+            reference.rewards,
+            reference.terminals,
+            reference.truncations,
+            reference.num_agents,
+            0,
+            num_threads=num_threads,
+            **kwargs
+        )
+        breakout.binding.vec_reset(c_envs, 0)
+        for _ in range(16):
+            breakout.binding.vec_step_async(c_envs)
+            breakout.binding.vec_wait(c_envs)
+            breakout.binding.vec_step(c_envs)
+
+        breakout.binding.vec_step_async(c_envs)
+        try:
+            breakout.binding.vec_step(c_envs)
+            raise Exception('vec_step while async step in flight. Should have thrown RuntimeError')
+        except RuntimeError:
+            pass
+
+        # Closing with a step in flight waits for it
+        breakout.binding.vec_close(c_envs)
+
     try:
         c_env = breakout.binding.env_init()
         raise Exception('init missing args. Should have thrown TypeError')
@@ -112,5 +163,54 @@ def test_env_binding():
     except TypeError:
         pass
 
+def make_vec(num_envs, num_threads):
+    obs_size = 10 + kwargs['brick_rows']*kwargs['brick_cols']
+    buffers = dict(
+        observations=np.zeros((num_envs, obs_size), dtype=np.float32),
+        actions=np.zeros(num_envs, dtype=np.float32),
+        rewards=np.zeros(num_envs, dtype=np.float32),
+        terminals=np.zeros(num_envs, dtype=np.uint8),
+        truncations=np.zeros(num_envs, dtype=np.uint8),
+    )
+    c_envs = breakout.binding.vec_init(*buffers.values(), num_envs, 0,
+        num_threads=num_threads, **kwargs)
+    return c_envs, buffers
+
+def test_threaded_matches_serial():
+    num_envs = 16
+    serial, serial_bufs = make_vec(num_envs, 1)
+    breakout.binding.vec_reset(serial, 0)
+    actions = np.random.default_rng(0).integers(0, 3, size=(512, num_envs))
+    for num_threads in (2, 4, 7):
+        threaded, threaded_bufs = make_vec(num_envs, num_threads)
+        breakout.binding.vec_reset(threaded, 0)
+        for t, action in enumerate(actions):
+            for bufs, c_envs in ((serial_bufs, serial), (threaded_bufs, threaded)):
+                bufs['actions'][:] = action
+                if num_threads == 7 and c_envs is threaded and t % 2:
+                    breakout.binding.vec_step_async(c_envs)
+                    breakout.binding.vec_wait(c_envs)
+                else:
+                    breakout.binding.vec_step(c_envs)
+            for key in ('observations', 'rewards', 'terminals'):
+                assert np.array_equal(serial_bufs[key], threaded_bufs[key]), \
+                    f'{key} differ at step {t} with {num_threads} threads'
+        breakout.binding.vec_close(threaded)
+        breakout.binding.vec_reset(serial, 0)
+    breakout.binding.vec_close(serial)
+
+    try:
+        make_vec(num_envs, -1)
+        raise Exception('negative num_threads. Should have thrown ValueError')
+    except ValueError:
+        pass
+
+    try:
+        breakout.binding.vec_init(*serial_bufs.values(), 2**40, 0, **kwargs)
+        raise Exception('num_envs overflows int. Should have thrown OverflowError')
+    except OverflowError:
+        pass
+
 if __name__ == '__main__':
     test_env_binding()
+    test_threaded_matches_serial()
@@ -0,0 +1,73 @@
+import pytest
+
+torch = pytest.importorskip('torch')
+try:
+    from pufferlib import _C
+except ImportError:
+    pytest.skip('pufferlib._C torch extension is not built', allow_module_level=True)
+
+GAMMA = 0.995
+GAE_LAMBDA = 0.9
+RHO_CLIP = 1.0
+C_CLIP = 1.0
+PRIO_ALPHA = 0.8
+
+# Includes a row count that is not a multiple of the SIMD block and a
+# horizon that is not a multiple of the transpose chunk
+SHAPES = [(1024, 64), (4099, 61), (37, 256), (16384, 16)]
+
+
+def make_buffers(segments, horizon, device):
+    gen = torch.Generator().manual_seed(segments*horizon)
+    values = torch.rand(segments, horizon, generator=gen)*2 - 1
+    rewards = torch.rand(segments, horizon, generator=gen)*2 - 1
+    terminals = (torch.rand(segments, horizon, generator=gen) < 0.02).float()
+    ratio = torch.rand(segments, horizon, generator=gen) + 0.5
+    return [t.to(device) for t in (values, rewards, terminals, ratio)]
+
+
+def unfused(values, rewards, terminals, ratio):
+    '''What PuffeRL.train did before the fused op'''
+    advantages = torch.zeros_like(values)
+    torch.ops.pufferlib.compute_puff_advantage(values, rewards, terminals,
+        ratio, advantages, GAMMA, GAE_LAMBDA, RHO_CLIP, C_CLIP)
+    returns = advantages + values
+    priorities = torch.nan_to_num(advantages.abs().sum(axis=1)**PRIO_ALPHA, 0, 0, 0)
+    return advantages, returns, priorities
+
+
+def fused(values, rewards, terminals, ratio):
+    # The op writes every element, the last column included, so nothing
+    # from these buffers may leak into the result
+    advantages = torch.full_like(values, float('nan'))
+    returns = torch.full_like(values, float('nan'))
+    priorities = torch.full((values.shape[0],), float('nan'), device=values.device)
+    torch.ops.pufferlib.compute_puff_advantage_fused(values, rewards, terminals,
+        ratio, advantages, returns, priorities, GAMMA, GAE_LAMBDA, RHO_CLIP,
+        C_CLIP, PRIO_ALPHA)
+    return advantages, returns, priorities
+
+
+DEVICES = ['cpu', pytest.param('cuda', marks=pytest.mark.skipif(
+    not torch.cuda.is_available(), reason='CUDA is not available'))]
+
+
+@pytest.mark.parametrize('device', DEVICES)
+@pytest.mark.parametrize('segments,horizon', SHAPES)
+def test_fused_matches_unfused(device, segments, horizon):
+    buffers = make_buffers(segments, horizon, device)
+    expected = unfused(*buffers)
+    actual = fused(*buffers)
+    for name, a, e in zip(('advantages', 'returns', 'priorities'), actual, expected):
+        torch.testing.assert_close(a, e, rtol=1e-5, atol=1e-5, msg=name)
+
+
+@pytest.mark.parametrize('device', DEVICES)
+def test_fused_zeroes_bad_priorities(device):
+    values, rewards, terminals, ratio = make_buffers(8, 32, device)
+    rewards[3, 5] = float('inf')
+    rewards[5, 7] = float('nan')
+    _, _, priorities = fused(values, rewards, terminals, ratio)
+    _, _, expected = unfused(values, rewards, terminals, ratio)
+    assert priorities[3] == 0 and priorities[5] == 0
+    torch.testing.assert_close(priorities, expected, rtol=1e-5, atol=1e-5)